@@ -1,81 +1,189 @@
+//
+// urlencode.cpp -- URL encode or decode a string
+//
+// Both directions are driven by 256 entry lookup tables. Runs of characters
+// that need no translation are copied in bulk.
+//
+// BSla, 19 oct 2026 table driven, in place, no String required
+//
+#include <string.h>
 #include "urlencode.h"
 
+#define NH (0xFF)         // not a hex digit
+#define UNRESERVED (0x01) // encode: copy as is (RFC 3986 unreserved characters)
+#define PLAIN (0x02)      // decode: copy as is (anything but '%', '+' and '\0')
+
+#define UP (UNRESERVED | PLAIN)
+#define PL PLAIN
+#define NO 0
+
+static const char hexDigits[] = "0123456789ABCDEF";
+
+const uint8_t URLencode::hexValue[256] = {
+   NH, NH, NH, NH, NH, NH, NH, NH, NH, NH, NH, NH, NH, NH, NH, NH,
+   NH, NH, NH, NH, NH, NH, NH, NH, NH, NH, NH, NH, NH, NH, NH, NH,
+   NH, NH, NH, NH, NH, NH, NH, NH, NH, NH, NH, NH, NH, NH, NH, NH,
+    0,  1,  2,  3,  4,  5,  6,  7,  8,  9, NH, NH, NH, NH, NH, NH,
+   NH, 10, 11, 12, 13, 14, 15, NH, NH, NH, NH, NH, NH, NH, NH, NH,
+   NH, NH, NH, NH, NH, NH, NH, NH, NH, NH, NH, NH, NH, NH, NH, NH,
+   NH, 10, 11, 12, 13, 14, 15, NH, NH, NH, NH, NH, NH, NH, NH, NH,
+   NH, NH, NH, NH, NH, NH, NH, NH, NH, NH, NH, NH, NH, NH, NH, NH,
+   NH, NH, NH, NH, NH, NH, NH, NH, NH, NH, NH, NH, NH, NH, NH, NH,
+   NH, NH, NH, NH, NH, NH, NH, NH, NH, NH, NH, NH, NH, NH, NH, NH,
+   NH, NH, NH, NH, NH, NH, NH, NH, NH, NH, NH, NH, NH, NH, NH, NH,
+   NH, NH, NH, NH, NH, NH, NH, NH, NH, NH, NH, NH, NH, NH, NH, NH,
+   NH, NH, NH, NH, NH, NH, NH, NH, NH, NH, NH, NH, NH, NH, NH, NH,
+   NH, NH, NH, NH, NH, NH, NH, NH, NH, NH, NH, NH, NH, NH, NH, NH,
+   NH, NH, NH, NH, NH, NH, NH, NH, NH, NH, NH, NH, NH, NH, NH, NH,
+   NH, NH, NH, NH, NH, NH, NH, NH, NH, NH, NH, NH, NH, NH, NH, NH,
+};
+
+const uint8_t URLencode::charClass[256] = {
+   NO, PL, PL, PL, PL, PL, PL, PL, PL, PL, PL, PL, PL, PL, PL, PL,
+   PL, PL, PL, PL, PL, PL, PL, PL, PL, PL, PL, PL, PL, PL, PL, PL,
+   PL, PL, PL, PL, PL, NO, PL, PL, PL, PL, PL, NO, PL, UP, UP, PL,
+   UP, UP, UP, UP, UP, UP, UP, UP, UP, UP, PL, PL, PL, PL, PL, PL,
+   PL, UP, UP, UP, UP, UP, UP, UP, UP, UP, UP, UP, UP, UP, UP, UP,
+   UP, UP, UP, UP, UP, UP, UP, UP, UP, UP, UP, PL, PL, PL, PL, UP,
+   PL, UP, UP, UP, UP, UP, UP, UP, UP, UP, UP, UP, UP, UP, UP, UP,
+   UP, UP, UP, UP, UP, UP, UP, UP, UP, UP, UP, PL, PL, PL, UP, PL,
+   PL, PL, PL, PL, PL, PL, PL, PL, PL, PL, PL, PL, PL, PL, PL, PL,
+   PL, PL, PL, PL, PL, PL, PL, PL, PL, PL, PL, PL, PL, PL, PL, PL,
+   PL, PL, PL, PL, PL, PL, PL, PL, PL, PL, PL, PL, PL, PL, PL, PL,
+   PL, PL, PL, PL, PL, PL, PL, PL, PL, PL, PL, PL, PL, PL, PL, PL,
+   PL, PL, PL, PL, PL, PL, PL, PL, PL, PL, PL, PL, PL, PL, PL, PL,
+   PL, PL, PL, PL, PL, PL, PL, PL, PL, PL, PL, PL, PL, PL, PL, PL,
+   PL, PL, PL, PL, PL, PL, PL, PL, PL, PL, PL, PL, PL, PL, PL, PL,
+   PL, PL, PL, PL, PL, PL, PL, PL, PL, PL, PL, PL, PL, PL, PL, PL,
+};
+
+#undef UP
+#undef PL
+#undef NO
+
 //----------------------
-void URLencode::encode (String &toEncode)
+size_t URLencode::decode(char *buf, size_t len)
+// decode buf in place. The output is never longer than the input,
+// so the write pointer never overtakes the read pointer.
 {
-   String output;
-   const char *cp = toEncode.c_str ();
+   const char *in = buf;
+   const char *end = buf + len;
+   char *out = buf;
 
-   char c;
-   while ((c = *cp++) ) {
-      encodeC (c, output);
-   } 
-   toEncode = output;
+   while (in < end)
+   {
+      // bulk copy a run of plain characters
+      const char *run = in;
+      while (in < end && (charClass[uint8_t(*in)] & PLAIN))
+         in++;
+      if (out != run)
+         memmove(out, run, in - run);
+      out += in - run;
+      if (in >= end)
+         break;
+
+      char c = *in++;
+      if (c == '+')
+         *out++ = ' ';
+      else if (c == '%')
+      {
+         uint8_t hi = (end - in >= 2) ? hexValue[uint8_t(in[0])] : NH;
+         uint8_t lo = (end - in >= 2) ? hexValue[uint8_t(in[1])] : NH;
+         if (hi != NH && lo != NH)
+         {
+            *out++ = char(hi << 4 | lo);
+            in += 2;
+         }
+         else
+            *out++ = '%'; // truncated or invalid escape: keep it literally
+      }
+      else
+         break; // '\0': end of string
+   }
+   *out = '\0';
+   return out - buf;
 }
 
 //----------------------
-void URLencode::decode (String &toDecode)
-// decode a string
-//
+size_t URLencode::encodedLength(const char *src, size_t len)
 {
-    String output;
-    char const *inPtr = toDecode.c_str ();
-    char c;
-    while ((c = *inPtr++))
-    {
-       if (c == '%')
-       {
-          char c1 = *inPtr++;
-          char c2 = *inPtr++;
-          output += char (hex2bin(c1) << 4 | hex2bin(c2));
-       }
-       else if (c == '+')
-          output += ' ';
-       else
-          output += c;
-    }
-    toDecode = output;
+   size_t n = len;
+   for (size_t i = 0; i < len; i++)
+   {
+      uint8_t c = uint8_t(src[i]);
+      if (!(charClass[c] & UNRESERVED) && c != ' ')
+         n += 2; // %XX
+   }
+   return n;
 }
 
-char URLencode::bin2hex(char cc)
+//----------------------
+size_t URLencode::encode(const char *src, size_t len, char *dst, size_t dstSize)
 {
-   char c = cc & 0xF;
-   if (c <= 9)
-      c += '0';
-   else
-      c += 'A' - 10;
-   return c;
-}
+   size_t n = encodedLength(src, len);
+   if (n + 1 > dstSize)
+      return 0;
 
-char URLencode::hex2bin(char c)
-{
-   if (c >= '0' && c <= '9')
-      c -= '0';
-   else if (c >= 'A' && c <= 'F')
-      c -= ('A' - 10);
-   else if (c >= 'a' && c <= 'f')
-      c -= ('a' - 10);
-   c = c & 0xF;
-   return c;
+   const char *in = src;
+   const char *end = src + len;
+   char *out = dst;
+   while (in < end)
+   {
+      // bulk copy a run of unreserved characters
+      const char *run = in;
+      while (in < end && (charClass[uint8_t(*in)] & UNRESERVED))
+         in++;
+      memcpy(out, run, in - run);
+      out += in - run;
+      if (in >= end)
+         break;
+
+      uint8_t c = uint8_t(*in++);
+      if (c == ' ')
+         *out++ = '+';
+      else
+      {
+         out[0] = '%';
+         out[1] = hexDigits[c >> 4];
+         out[2] = hexDigits[c & 0xF];
+         out += 3;
+      }
+   }
+   *out = '\0';
+   return n;
 }
 
+#ifdef ARDUINO
 //----------------------
-void URLencode::encodeC(const char c, String &output)
+void URLencode::encode(String &toEncode)
 {
-   if ((c >= '1' && c <= '9') ||
-       (c >= 'A' && c <= 'Z') ||
-       (c >= 'a' && c <= 'z'))
-   {
-      output += c;
-   }
-   else if (c == ' ')
+   const char *in = toEncode.c_str();
+   size_t len = toEncode.length();
+   String output;
+   output.reserve(encodedLength(in, len));
+
+   // encode via a small stack buffer; 20 input characters
+   // never need more than 60 output characters
+   char chunk[64];
+   while (len > 0)
    {
-      output += '+';
+      size_t n = len < 20 ? len : 20;
+      size_t m = encode(in, n, chunk, sizeof(chunk));
+      output.concat(chunk, m);
+      in += n;
+      len -= n;
    }
-   else
+   toEncode = output;
+}
+
+//----------------------
+void URLencode::decode(String &toDecode)
+// decode a string, in place
+{
+   if (toDecode.length() > 0)
    {
-      output += '%';
-      output += bin2hex(c >> 4);
-      output += bin2hex(c);
+      size_t n = decode(toDecode.begin(), toDecode.length());
+      toDecode.remove(n);
    }
 }
+#endif
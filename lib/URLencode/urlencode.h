@@ -1,20 +1,43 @@
 //
 // urlencode.h -- URL encode or decode a string
 //
+// The span based functions work on plain character buffers and never allocate.
+// The String versions are thin wrappers around them.
+//
+// size_t decode (buf, len)                decodes buf in place and returns the decoded length.
+//                                         buf must have room for len + 1 characters:
+//                                         the result is always '\0' terminated.
+// size_t encodedLength (src, len)         number of characters encode () produces (excl. '\0')
+// size_t encode (src, len, dst, dstSize)  encodes src into dst and returns the encoded length,
+//                                         or 0 if dst (incl. the terminating '\0') is too small
+//
+// Escapes that are truncated ("%" or "%4" at the end) or not hexadecimal ("%zz")
+// are copied literally.
+//
+// BSla, 19 oct 2026 table driven, in place, no String required
+//
 #ifndef _URLENCODE_H
 #define _URLENCODE_H
 
+#include <stddef.h>
+#include <stdint.h>
+#ifdef ARDUINO
 #include <Arduino.h>
+#endif
 
 class URLencode
 {
 public:
+   static size_t decode(char *buf, size_t len);
+   static size_t encodedLength(const char *src, size_t len);
+   static size_t encode(const char *src, size_t len, char *dst, size_t dstSize);
+#ifdef ARDUINO
    static void encode(String &toEncode);
    static void decode(String &toDecode);
+#endif
 
 private:
-   static char bin2hex(char c);
-   static char hex2bin(char c);
-   static void encodeC(const char c, String &output);
+   static const uint8_t hexValue[256];  // value of a hex digit, 0xFF if it is not a hex digit
+   static const uint8_t charClass[256]; // UNRESERVED and/or PLAIN, see urlencode.cpp
 };
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,155 @@
+//
+// activity.cpp -- activity index from the size of the jpg frames
+//
+// BSla, 19 oct 2026
+//
+#include <math.h>
+#include "activity.h"
+
+#define MAX_STEP_MS (1000) // a longer gap between frames counts as this
+#define LEARN_SAMPLES (20) // frames before anything is detected
+
+//----------------------
+const char *ActivityIndex::eventName(Event e)
+{
+   static const char *names[] = {"None", "VisitStart", "VisitEnd", "VisitCancelled", "LevelShift"};
+   return e >= None && e <= LevelShift ? names[e] : "ILLEGAL EVENT";
+}
+
+//----------------------
+void ActivityIndex::reset()
+{
+   started = false;
+   visiting = false;
+   up = down = back = 0;
+   lastZ = 0;
+   smoothScore = 0;
+}
+
+//----------------------
+float ActivityIndex::sigma() const
+{
+   float floor = baseMean * config.minSigmaPercent / 100;
+   return sqrtf(baseVar + floor * floor);
+}
+
+//----------------------
+ActivityIndex::Event ActivityIndex::update(uint32_t size, uint32_t now)
+{
+   float s = float(size);
+   if (!started)
+   {
+      started = true;
+      last = now;
+      nSamples = 0;
+      baseMean = recent = s;
+      baseVar = 0;
+      return None;
+   }
+   uint32_t stepMs = now - last < MAX_STEP_MS ? now - last : MAX_STEP_MS;
+   float dt = stepMs / 1000.0f;
+   last = now;
+
+   float z = (s - baseMean) / sigma();
+   lastZ = z;
+   float frameScore = fminf(fabsf(z) * 20, 100); // 5 standard deviations: 100
+   float fast = fminf(float(stepMs) / config.scoreMs, 1);
+   smoothScore += (frameScore - smoothScore) * fast;
+   recent += (s - recent) * fast;
+
+   Event event = None;
+   if (nSamples < LEARN_SAMPLES)
+   {
+      // learning the baseline: a plain average at first
+      nSamples++;
+      follow(s, fmaxf(float(stepMs) / config.baselineMs, 1.0f / nSamples));
+   }
+   else if (!visiting)
+   {
+      if (up == 0)
+         upSince = now; // the change point, if this CUSUM gets there
+      up = fmaxf(0, up + (z - config.drift) * dt);
+      if (down == 0)
+      {
+         downSum = 0; // sizes since the possible change point
+         downCount = 0;
+      }
+      down = fmaxf(0, down + (-z - config.drift) * dt);
+      downSum += s;
+      downCount++;
+      if (up > config.threshold)
+      {
+         visiting = true;
+         back = 0;
+         current.startMs = upSince;
+         current.endMs = 0;
+         current.peakScore = score();
+         nChangePoints++;
+         event = VisitStart;
+      }
+      else if (down > config.threshold)
+      {
+         // the mean since the change point; recent is still on its way there
+         recent = downSum / downCount;
+         rebase();
+         nChangePoints++;
+         event = LevelShift;
+      }
+      else
+         follow(s, float(stepMs) / config.baselineMs);
+   }
+   else
+   {
+      // the baseline stays where it was before the visit
+      if (score() > current.peakScore)
+         current.peakScore = score();
+      if (back == 0)
+         backSince = now;
+      back = fmaxf(0, back + (config.drift - z) * dt);
+      uint32_t duration = now - current.startMs;
+      if (back > config.threshold)
+      {
+         visiting = false;
+         up = down = 0;
+         nChangePoints++;
+         current.endMs = backSince;
+         if (backSince - current.startMs >= config.minVisitMs)
+         {
+            nVisits++;
+            event = VisitEnd;
+         }
+         else
+            event = VisitCancelled;
+      }
+      else if (duration > config.maxVisitMs)
+      {
+         // not a visit: the scene changed
+         visiting = false;
+         rebase();
+         nChangePoints++;
+         event = LevelShift;
+      }
+   }
+   return event;
+}
+
+//--private functions---------------------------------------
+
+//----------------------
+void ActivityIndex::follow(float size, float a)
+// exponentially weighted mean and variance, weight a of the new size
+{
+   if (a > 1)
+      a = 1;
+   float d = size - baseMean;
+   baseMean += a * d;
+   baseVar = (1 - a) * (baseVar + a * d * d);
+}
+
+//----------------------
+void ActivityIndex::rebase()
+// the baseline jumps to the recent sizes; the variance is kept, it is a property of the scene
+{
+   baseMean = recent;
+   up = down = back = 0;
+}
@@ -0,0 +1,95 @@
+//
+// activity.h -- activity index from the size of the jpg frames
+//
+// A bird in the frame adds detail, so the jpg frames get larger. The index
+// keeps a baseline of the frame size (a mean and variance that follow it with
+// time constant baselineMs) and scores every frame by its distance to the
+// baseline, in standard deviations (z). Two CUSUMs on z find the change
+// points:
+//
+//    up     z stays above drift: a visit starts; the baseline is frozen
+//    back   during a visit, z stays below drift: the visit ends
+//    down   outside a visit, z stays below -drift: the scene got simpler
+//           (less light), so the baseline jumps to the new size
+//
+// A CUSUM adds (z - drift) per second, not per frame, so the frame rate does
+// not change the detection; threshold is in standard deviation seconds.
+// A visit shorter than minVisitMs is a glitch, one longer than maxVisitMs a
+// change of the scene (the sun came out): the first ends in VisitCancelled,
+// the second in LevelShift, with the baseline moved to the new size.
+//
+// After a reset () the first frames only build the baseline.
+//
+// update () gets the frame size and the time, so the index runs on the host
+// with recorded frame sizes. It costs a handful of float operations per frame.
+//
+// BSla, 19 oct 2026
+//
+#ifndef _ACTIVITY_H
+#define _ACTIVITY_H
+
+#include <stdint.h>
+
+struct ActivityConfig
+{
+   uint32_t baselineMs;   // time constant of the baseline
+   uint32_t scoreMs;      // time constant of the score
+   float minSigmaPercent; // the standard deviation is at least this % of the mean: the noise floor
+   float drift;           // CUSUM allowance, standard deviations
+   float threshold;       // CUSUM decision level, standard deviation seconds
+   uint32_t minVisitMs;
+   uint32_t maxVisitMs;
+};
+
+struct ActivityVisit
+{
+   uint32_t startMs;
+   uint32_t endMs;
+   uint8_t peakScore;
+};
+
+class ActivityIndex
+{
+public:
+   enum Event {None, VisitStart, VisitEnd, VisitCancelled, LevelShift}; // LevelShift also ends a visit that went on too long
+
+   ActivityIndex(const ActivityConfig &config) : config(config) {}
+   void reset();                               // learn the baseline again, e.g. after a frame size change
+   Event update(uint32_t size, uint32_t now);  // one frame: its size in bytes, time in ms
+   uint8_t score() const { return uint8_t(smoothScore); } // 0..100
+   float mean() const { return baseMean; }
+   float sigma() const;
+   float z() const { return lastZ; }
+   bool inVisit() const { return visiting; }
+   const ActivityVisit &visit() const { return current; } // the current or last visit
+   uint32_t visits() const { return nVisits; }
+   uint32_t changePoints() const { return nChangePoints; }
+   static const char *eventName(Event e);
+
+private:
+   void follow(float size, float a);
+   void rebase();
+
+   ActivityConfig config;
+   bool started = false;
+   uint32_t nSamples = 0;  // while learning the baseline
+   uint32_t last = 0;      // time of the previous frame
+   float baseMean = 0;
+   float baseVar = 0;
+   float lastZ = 0;
+   float smoothScore = 0;
+   float recent = 0;       // sizes, with the score time constant
+   float up = 0;           // CUSUMs, standard deviation seconds
+   float down = 0;
+   float back = 0;
+   uint32_t upSince = 0;   // time up and back last left 0
+   uint32_t backSince = 0;
+   float downSum = 0;      // sizes since down last left 0
+   uint32_t downCount = 0;
+   bool visiting = false;
+   ActivityVisit current = {};
+   uint32_t nVisits = 0;
+   uint32_t nChangePoints = 0;
+};
+
+#endif
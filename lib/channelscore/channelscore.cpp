@@ -0,0 +1,54 @@
+//
+// channelscore.cpp -- choose the least congested channel for the access point
+//
+// BSla, 19 oct 2026
+//
+#include "channelscore.h"
+
+#define OCCUPANCY_COST (400) // cost of a network on the same channel, irrespective of its strength
+#define SWITCH_MARGIN (75)   // percent; see chooseChannel
+
+const int candidateChannels[N_CANDIDATE_CHANNELS] = {1, 6, 11};
+
+//----------------------
+uint32_t channelCost(const ScanResult *results, int nResults, int channel)
+{
+   static const uint32_t overlap[] = {100, 75, 50, 25}; // percent, by channel distance
+   uint32_t cost = 0;
+   for (int i = 0; i < nResults; i++)
+   {
+      int distance = results[i].channel - channel;
+      if (distance < 0)
+         distance = -distance;
+      if (distance >= int(sizeof(overlap) / sizeof(overlap[0])))
+         continue;
+
+      int strength = results[i].rssi + 100;
+      if (strength < 0)
+         strength = 0;
+      if (strength > 80)
+         strength = 80;
+      cost += overlap[distance] * (OCCUPANCY_COST + uint32_t(strength * strength)) / 100;
+   }
+   return cost;
+}
+
+//----------------------
+int chooseChannel(const ScanResult *results, int nResults, int currentChannel,
+                  uint32_t costs[N_CANDIDATE_CHANNELS])
+{
+   int best = 0;
+   for (int i = 0; i < N_CANDIDATE_CHANNELS; i++)
+   {
+      costs[i] = channelCost(results, nResults, candidateChannels[i]);
+      if (costs[i] < costs[best])
+         best = i;
+   }
+   if (currentChannel == 0)
+      return candidateChannels[best];
+
+   uint32_t currentCost = channelCost(results, nResults, currentChannel);
+   if (uint64_t(costs[best]) * 100 < uint64_t(currentCost) * SWITCH_MARGIN)
+      return candidateChannels[best];
+   return currentChannel;
+}
@@ -0,0 +1,40 @@
+//
+// channelscore.h -- choose the least congested channel for the access point
+//
+// Pure functions, no Arduino dependencies, so they can be tried on a PC with
+// recorded scan results.
+//
+// Every network found in a scan costs the candidate channel
+//    overlap * (OCCUPANCY_COST + strength^2)
+// where strength = RSSI + 100 dBm, clipped to 0..80, and overlap is 100% on the
+// same channel, falling 25% per channel of distance (0 from 4 channels away;
+// 2.4 GHz channels are 5 MHz apart and 20 MHz wide). OCCUPANCY_COST counts the
+// airtime even a weak network takes. A lower cost is better.
+//
+// BSla, 19 oct 2026
+//
+#ifndef _CHANNELSCORE_H
+#define _CHANNELSCORE_H
+
+#include <stdint.h>
+
+struct ScanResult
+{
+   int channel; // 1..14
+   int rssi;    // dBm
+};
+
+#define N_CANDIDATE_CHANNELS (3) // 1, 6 and 11: the non-overlapping channels
+
+extern const int candidateChannels[N_CANDIDATE_CHANNELS];
+
+// cost of channel for the networks in results
+extern uint32_t channelCost(const ScanResult *results, int nResults, int channel);
+
+// cost of each candidate channel in costs[N_CANDIDATE_CHANNELS]; returns the best channel.
+// The current channel is kept unless another one costs less than SWITCH_MARGIN % of it.
+// currentChannel 0: no current channel.
+extern int chooseChannel(const ScanResult *results, int nResults, int currentChannel,
+                         uint32_t costs[N_CANDIDATE_CHANNELS]);
+
+#endif
@@ -0,0 +1,142 @@
+//
+// clipring.cpp -- ring of jpg frames for the pre-trigger clip: bookkeeping only
+//
+// BSla, 19 oct 2026
+//
+#include <string.h>
+#include "clipring.h"
+
+//----------------------
+ClipRing::Event ClipRing::frame(const uint8_t *data, uint32_t len, uint32_t now)
+{
+   if (!ring)
+      return None;
+   Event event = None;
+   int s = stateWord.load(std::memory_order_acquire);
+   if (s >= 0)
+   {
+      int idle = 0;
+      if (now - frozenClip.at <= config.holdMs || !stateWord.compare_exchange_strong(idle, RECORDING))
+      {
+         // frozen: the window belongs to the exporters
+         nSkippedFrozen++;
+         return None;
+      }
+      event = Released;
+      s = RECORDING;
+   }
+   // the frame that comes with a trigger is always kept
+   if (s != RECORDING || now - lastStoredMs >= config.minSpacingMs)
+      store(data, len, now);
+   if (s != RECORDING)
+   {
+      freeze(-2 - s, now);
+      event = Frozen;
+   }
+   return event;
+}
+
+//----------------------
+bool ClipRing::trigger(int why)
+{
+   int expected = RECORDING;
+   if (!ring)
+      return false;
+   if (stateWord.compare_exchange_strong(expected, -2 - why))
+      return true;
+   nBusyTriggers++;
+   return false;
+}
+
+//----------------------
+bool ClipRing::release()
+{
+   int idle = 0; // frozen, nobody exporting
+   return stateWord.compare_exchange_strong(idle, RECORDING);
+}
+
+//----------------------
+ClipRing::PinResult ClipRing::pin()
+{
+   int s = stateWord.load(std::memory_order_acquire);
+   while (s >= 0)
+   {
+      if (stateWord.compare_exchange_weak(s, s + 1, std::memory_order_acquire))
+         return Pinned;
+      // s holds the new state
+   }
+   return s == RECORDING ? NotFrozen : Freezing;
+}
+
+//----------------------
+void ClipRing::unpin()
+{
+   stateWord.fetch_sub(1, std::memory_order_release);
+}
+
+//----------------------
+const char *ClipRing::stateName(int s)
+{
+   return s == RECORDING ? "recording" : s < 0 ? "freezing" : s == 0 ? "frozen" : "exporting";
+}
+
+//----------------------
+uint32_t ClipRing::spanMs() const
+{
+   uint32_t h = headNo;
+   uint32_t t = tailNo;
+   if (h == t || h - t > MAX_FRAMES)
+      return 0;
+   return frames[(h - 1) % MAX_FRAMES].ms - frames[t % MAX_FRAMES].ms;
+}
+
+//--private functions---------------------------------------
+
+//----------------------
+void ClipRing::store(const uint8_t *data, uint32_t len, uint32_t now)
+// copy the frame into the ring, after dropping the frames in its way
+{
+   if (len > config.bytes)
+   {
+      nTooLarge++;
+      return;
+   }
+   bool wrap = writePos + len > config.bytes;
+   uint32_t pos = wrap ? 0 : writePos;
+   while (headNo != tailNo)
+   {
+      // frames go in the order they came, from the tail; so when the new one
+      // goes to the start, the frames after writePos go before those it overlaps
+      const ClipRingFrame &f = frames[tailNo % MAX_FRAMES];
+      if ((wrap && f.offset >= writePos) || (f.offset < pos + len && pos < f.offset + f.len))
+         nEvictedBytes++;
+      else if (now - f.ms > config.windowMs || headNo - tailNo >= MAX_FRAMES)
+         nEvictedAge++;
+      else
+         break;
+      ringBytes -= f.len;
+      tailNo++;
+   }
+   memcpy(ring + pos, data, len);
+   ClipRingFrame &f = frames[headNo % MAX_FRAMES];
+   f.offset = pos;
+   f.len = len;
+   f.ms = now;
+   writePos = (pos + len + 3) & ~3u; // word aligned, for a fast memcpy
+   ringBytes += len;
+   headNo++;
+   nStored++;
+   lastStoredMs = now;
+}
+
+//----------------------
+void ClipRing::freeze(int why, uint32_t now)
+// the frames now in the ring are the clip
+{
+   frozenClip.first = tailNo;
+   frozenClip.count = headNo - tailNo;
+   frozenClip.bytes = ringBytes;
+   frozenClip.at = now;
+   frozenClip.why = why;
+   stateWord.store(0, std::memory_order_release);
+}
@@ -0,0 +1,122 @@
+//
+// clipring.h -- ring of jpg frames for the pre-trigger clip: bookkeeping only
+//
+// The ring is bounded by bytes, not frames: a new frame goes after the
+// previous one, or at the start when it does not fit at the end, and the
+// oldest frames it overlaps are dropped; so are frames older than windowMs,
+// and the oldest when all MAX_FRAMES descriptors are in use. Every frame is
+// contiguous in the ring, so it can be sent as it is.
+//
+// A trigger asks for a freeze; the next frame () stores its frame and
+// freezes the window: the frames in the ring at that moment are the clip,
+// and nothing is written until the clip is released, or until holdMs have
+// passed with nobody exporting it.
+//
+// No lock: one task (the writer) calls frame (). Triggers, exporters and
+// release () only change one atomic state word:
+//
+//    RECORDING      the writer fills the ring
+//    -2 - trigger   a freeze is asked for; the writer freezes the window
+//    n >= 0         frozen, n exporters are sending it; nobody writes the ring
+//
+// frame () gets the time and the caller owns the buffer, so the ring runs
+// on the host with a virtual clock (see clip.cpp for the camera side).
+//
+// BSla, 19 oct 2026
+//
+#ifndef _CLIPRING_H
+#define _CLIPRING_H
+
+#include <stdint.h>
+#include <atomic>
+
+struct ClipRingConfig
+{
+   uint32_t bytes;        // size of the buffer given to begin ()
+   uint32_t windowMs;     // frames older than this are dropped
+   uint32_t minSpacingMs; // between kept frames; the frame of a trigger is always kept
+   uint32_t holdMs;       // a frozen clip that is not exported is released after this
+};
+
+struct ClipRingFrame
+{
+   uint32_t offset; // in the ring
+   uint32_t len;
+   uint32_t ms;     // time of the capture
+};
+
+struct FrozenClip
+{
+   uint32_t first;  // frame number of the oldest frame
+   uint32_t count;
+   uint32_t bytes;
+   uint32_t at;     // time of the freeze
+   int why;         // the trigger
+};
+
+class ClipRing
+{
+public:
+   enum Event {None, Frozen, Released};           // of frame (); Released: held too long, recording again
+   enum PinResult {Pinned, NotFrozen, Freezing};  // Freezing: asked for, not there yet; try again
+   static const int RECORDING = -1;
+   static const uint32_t MAX_FRAMES = 64;         // descriptors
+
+   ClipRing(const ClipRingConfig &config) : config(config) {}
+   void begin(uint8_t *buffer) { ring = buffer; } // config.bytes
+   bool isOn() const { return ring != nullptr; }
+
+   // the writer
+   Event frame(const uint8_t *data, uint32_t len, uint32_t now);
+
+   // any task
+   bool trigger(int why);      // false if a freeze is asked for or a clip is frozen
+   bool release();             // false if not frozen or being exported
+   PinResult pin();            // count an exporter in while a clip is frozen
+   void unpin();
+   int state() const { return stateWord.load(std::memory_order_acquire); }
+   static const char *stateName(int s);
+
+   // the frozen clip, while pinned or frozen (the writer does not touch it then)
+   const FrozenClip &frozen() const { return frozenClip; }
+   const ClipRingFrame &frameAt(uint32_t n) const { return frames[n % MAX_FRAMES]; } // by frame number
+   const uint8_t *data(const ClipRingFrame &f) const { return ring + f.offset; }
+
+   // the recording; from another task, a snapshot that may be a frame behind
+   uint32_t head() const { return headNo; } // next frame number
+   uint32_t tail() const { return tailNo; } // oldest frame number
+   uint32_t frameCount() const { return headNo - tailNo; }
+   uint32_t bytes() const { return ringBytes; }
+   uint32_t spanMs() const;
+
+   // counters
+   uint32_t stored() const { return nStored; }
+   uint32_t evictedBytes() const { return nEvictedBytes; } // overwritten by a newer frame
+   uint32_t evictedAge() const { return nEvictedAge; }     // older than windowMs, or out of descriptors
+   uint32_t tooLarge() const { return nTooLarge; }         // frames larger than the ring
+   uint32_t skippedFrozen() const { return nSkippedFrozen; }
+   uint32_t busyTriggers() const { return nBusyTriggers.load(); } // triggers while a clip was frozen
+
+private:
+   void store(const uint8_t *data, uint32_t len, uint32_t now);
+   void freeze(int why, uint32_t now);
+
+   ClipRingConfig config;
+   uint8_t *ring = nullptr;
+   ClipRingFrame frames[MAX_FRAMES];
+   volatile uint32_t headNo = 0;    // written by the writer only
+   volatile uint32_t tailNo = 0;
+   volatile uint32_t ringBytes = 0; // jpg bytes of the frames in the ring
+   uint32_t writePos = 0;
+   uint32_t lastStoredMs = 0;
+   FrozenClip frozenClip = {};
+   std::atomic<int> stateWord {RECORDING};
+   uint32_t nStored = 0;
+   uint32_t nEvictedBytes = 0;
+   uint32_t nEvictedAge = 0;
+   uint32_t nTooLarge = 0;
+   uint32_t nSkippedFrozen = 0;
+   std::atomic<uint32_t> nBusyTriggers {0};
+};
+
+#endif
@@ -0,0 +1,203 @@
+//
+// fixedstring.cpp -- strings with a fixed capacity, no heap storage
+//
+// BSla, 19 oct 2026
+//
+#include <stdio.h>
+#include "fixedstring.h"
+
+static bool isSpace(char c)
+{
+   return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '\f' || c == '\v';
+}
+
+//----------------------
+size_t StringView::indexOf(char c, size_t from) const
+{
+   for (size_t i = from; i < n; i++)
+      if (p[i] == c)
+         return i;
+   return npos;
+}
+
+//----------------------
+size_t StringView::indexOf(StringView s, size_t from) const
+{
+   if (s.n == 0)
+      return from <= n ? from : npos;
+   for (size_t i = from; i + s.n <= n; i++)
+      if (p[i] == s.p[0] && memcmp(p + i, s.p, s.n) == 0)
+         return i;
+   return npos;
+}
+
+//----------------------
+StringView StringView::substring(size_t from, size_t to) const
+{
+   if (to > n)
+      to = n;
+   if (from > to)
+      from = to;
+   return StringView(p + from, to - from);
+}
+
+//----------------------
+StringView StringView::trim() const
+{
+   size_t from = 0;
+   size_t to = n;
+   while (from < to && isSpace(p[from]))
+      from++;
+   while (to > from && isSpace(p[to - 1]))
+      to--;
+   return StringView(p + from, to - from);
+}
+
+//----------------------
+long StringView::toInt() const
+{
+   size_t i = 0;
+   while (i < n && isSpace(p[i]))
+      i++;
+   bool negative = false;
+   if (i < n && (p[i] == '-' || p[i] == '+'))
+      negative = p[i++] == '-';
+   long value = 0;
+   for (; i < n && p[i] >= '0' && p[i] <= '9'; i++)
+      value = value * 10 + (p[i] - '0');
+   return negative ? -value : value;
+}
+
+//----------------------
+void FixedStringBase::clear()
+{
+   len = 0;
+   buf[0] = '\0';
+   overflow = false;
+}
+
+//----------------------
+FixedStringBase &FixedStringBase::assign(StringView s)
+// s may be a view of this string itself (e.g. from trim ()), hence memmove
+{
+   size_t n = s.length() <= cap ? s.length() : cap;
+   memmove(buf, s.data(), n);
+   len = n;
+   buf[len] = '\0';
+   overflow = n < s.length();
+   return *this;
+}
+
+//----------------------
+FixedStringBase &FixedStringBase::append(StringView s)
+{
+   size_t n = s.length();
+   if (n > cap - len)
+   {
+      n = cap - len;
+      overflow = true;
+   }
+   memmove(buf + len, s.data(), n);
+   len += n;
+   buf[len] = '\0';
+   return *this;
+}
+
+//----------------------
+FixedStringBase &FixedStringBase::append(char c)
+{
+   if (len < cap)
+   {
+      buf[len++] = c;
+      buf[len] = '\0';
+   }
+   else
+      overflow = true;
+   return *this;
+}
+
+//----------------------
+FixedStringBase &FixedStringBase::format(const char *fmt, ...)
+{
+   clear();
+   va_list args;
+   va_start(args, fmt);
+   appendFormatV(fmt, args);
+   va_end(args);
+   return *this;
+}
+
+//----------------------
+FixedStringBase &FixedStringBase::appendFormat(const char *fmt, ...)
+{
+   va_list args;
+   va_start(args, fmt);
+   appendFormatV(fmt, args);
+   va_end(args);
+   return *this;
+}
+
+//----------------------
+FixedStringBase &FixedStringBase::appendFormatV(const char *fmt, va_list args)
+{
+   int n = vsnprintf(buf + len, cap - len + 1, fmt, args);
+   if (n < 0)
+      buf[len] = '\0'; // encoding error: the string is left as it was
+   else if (size_t(n) > cap - len)
+   {
+      len = cap;
+      overflow = true;
+   }
+   else
+      len += n;
+   return *this;
+}
+
+//----------------------
+int FixedStringBase::replace(StringView from, StringView to)
+// in place: the text after a match is shifted, and cut off at the capacity.
+// to must not be a view of this string.
+{
+   if (from.isEmpty())
+      return 0;
+   int count = 0;
+   size_t i = 0;
+   while ((i = view().indexOf(from, i)) != StringView::npos)
+   {
+      size_t toLen = to.length();
+      size_t tail = len - i - from.length(); // characters after the match
+      if (toLen > cap - i)
+      {
+         toLen = cap - i; // not even the replacement fits
+         tail = 0;
+         overflow = true;
+      }
+      else if (tail > cap - i - toLen)
+      {
+         tail = cap - i - toLen;
+         overflow = true;
+      }
+      memmove(buf + i + toLen, buf + i + from.length(), tail);
+      memcpy(buf + i, to.data(), toLen);
+      len = i + toLen + tail;
+      buf[len] = '\0';
+      i += toLen;
+      count++;
+   }
+   return count;
+}
+
+//----------------------
+void FixedStringBase::trim()
+{
+   bool wasTruncated = overflow;
+   assign(view().trim());
+   overflow = wasTruncated;
+}
+
+//----------------------
+void FixedStringBase::setLength(size_t n)
+{
+   len = n <= cap ? n : cap;
+   buf[len] = '\0';
+}
@@ -0,0 +1,128 @@
+//
+// fixedstring.h -- strings with a fixed capacity, no heap storage
+//
+// FixedString<N> holds at most N characters (plus the terminating '\0') in
+// the object itself, so a local or member string never touches the heap.
+// The operations are in FixedStringBase, so a function can accept a string
+// of any capacity:
+//
+//    FixedString<16> s ("Birdcam-");
+//    s.appendFormat ("%x", chip);     // "Birdcam-3f2a"
+//    s.replace ("-", "_");            // returns the number of replacements
+//    s == "Birdcam_3f2a";             // true
+//
+// Text that does not fit is cut off and sets truncated (); the string stays
+// '\0' terminated. truncated () is cleared by clear (), assign () and format ().
+//
+// StringView is a (pointer, length) pair that does not own its characters and
+// need not be '\0' terminated: a view of a constant, of a FixedString, or the
+// result of substring () and trim (). It must not outlive what it points to.
+//
+// BSla, 19 oct 2026
+//
+#ifndef _FIXEDSTRING_H
+#define _FIXEDSTRING_H
+
+#include <stddef.h>
+#include <stdarg.h>
+#include <string.h>
+
+class StringView
+{
+public:
+   static const size_t npos = size_t(-1);
+
+   StringView() : p(""), n(0) {}
+   StringView(const char *s) : p(s ? s : ""), n(s ? strlen(s) : 0) {}
+   StringView(const char *s, size_t len) : p(s), n(len) {}
+   const char *data() const { return p; }
+   size_t length() const { return n; }
+   bool isEmpty() const { return n == 0; }
+   char operator[](size_t i) const { return p[i]; }
+   size_t indexOf(char c, size_t from = 0) const;             // npos if not found
+   size_t indexOf(StringView s, size_t from = 0) const;
+   StringView substring(size_t from, size_t to = npos) const; // characters [from, to)
+   StringView trim() const;                                   // without leading and trailing white space
+   bool startsWith(StringView s) const { return s.n <= n && memcmp(p, s.p, s.n) == 0; }
+   bool operator==(StringView s) const { return s.n == n && memcmp(p, s.p, n) == 0; }
+   bool operator!=(StringView s) const { return !(*this == s); }
+   long toInt() const; // like atol (): white space and a sign may precede the digits; 0 if there are none
+
+private:
+   const char *p;
+   size_t n;
+};
+
+class FixedStringBase
+{
+public:
+   const char *c_str() const { return buf; }
+   size_t length() const { return len; }
+   size_t capacity() const { return cap; }
+   bool isEmpty() const { return len == 0; }
+   bool truncated() const { return overflow; }
+   StringView view() const { return StringView(buf, len); }
+   operator StringView() const { return view(); }
+   char operator[](size_t i) const { return buf[i]; }
+
+   void clear();
+   FixedStringBase &assign(StringView s);
+   FixedStringBase &append(StringView s);
+   FixedStringBase &append(char c);
+   FixedStringBase &format(const char *fmt, ...) __attribute__((format(printf, 2, 3))); // replaces the contents
+   FixedStringBase &appendFormat(const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+   FixedStringBase &appendFormatV(const char *fmt, va_list args);
+   int replace(StringView from, StringView to); // every occurrence; returns the number of replacements
+   void trim();
+   FixedStringBase &operator=(const FixedStringBase &s) { return assign(s.view()); } // copies the contents
+   FixedStringBase &operator=(StringView s) { return assign(s); }
+   FixedStringBase &operator+=(StringView s) { return append(s); }
+   FixedStringBase &operator+=(char c) { return append(c); }
+   bool operator==(StringView s) const { return view() == s; }
+   bool operator!=(StringView s) const { return view() != s; }
+
+   // for functions that fill a character buffer: write at most capacity () + 1
+   // bytes (incl. the '\0') to buffer (), then call setLength ()
+   char *buffer() { return buf; }
+   void setLength(size_t n);
+
+protected:
+   FixedStringBase(char *storage, size_t capacity) : buf(storage), cap(capacity) { buf[0] = '\0'; }
+   FixedStringBase(const FixedStringBase &) = delete; // would share the storage
+
+private:
+   char *buf; // cap + 1 bytes, in the FixedString
+   size_t cap;
+   size_t len = 0;
+   bool overflow = false;
+};
+
+template <size_t N>
+class FixedString : public FixedStringBase
+{
+public:
+   FixedString() : FixedStringBase(storage, N) {}
+   FixedString(StringView s) : FixedStringBase(storage, N) { assign(s); }
+   FixedString(const char *s) : FixedStringBase(storage, N) { assign(s); }
+   FixedString(const FixedString &s) : FixedStringBase(storage, N) { assign(s.view()); }
+   FixedString &operator=(const FixedString &s)
+   {
+      assign(s.view());
+      return *this;
+   }
+   FixedString &operator=(StringView s)
+   {
+      assign(s);
+      return *this;
+   }
+   FixedString &operator=(const char *s)
+   {
+      assign(s);
+      return *this;
+   }
+
+private:
+   char storage[N + 1];
+};
+
+#endif
@@ -0,0 +1,76 @@
+//
+// governor.cpp -- memory-pressure governor: policy only
+//
+// BSla, 19 oct 2026
+//
+#include "governor.h"
+
+//----------------------
+MemoryGovernor::MemoryGovernor(const Limits limits[N_LEVELS], uint32_t recoverMs, uint32_t marginPercent)
+    : limits(limits), recoverMs(recoverMs), marginPercent(marginPercent)
+{
+}
+
+//----------------------
+const char *MemoryGovernor::levelName(Level l)
+{
+   static const char *names[N_LEVELS] = {"Normal", "SmallFrames", "FewStreams", "Shed", "Refuse"};
+   return l >= Normal && l < N_LEVELS ? names[l] : "ILLEGAL LEVEL";
+}
+
+//----------------------
+MemoryGovernor::Level MemoryGovernor::update(const MemorySample &s, uint32_t now)
+{
+   Level needed = Normal;
+   for (int l = N_LEVELS - 1; l > Normal; l--)
+   {
+      if (below(s, Level(l), 100))
+      {
+         needed = Level(l);
+         break;
+      }
+   }
+
+   if (needed > current)
+   {
+      enter(needed, now);
+      recovering = false;
+   }
+   else if (current > Normal && !below(s, current, 100 + marginPercent))
+   {
+      if (!recovering)
+      {
+         recovering = true;
+         clearSince = now;
+      }
+      else if (now - clearSince >= recoverMs)
+      {
+         enter(Level(current - 1), now);
+         recovering = false; // the next step up needs another recoverMs
+      }
+   }
+   else
+      recovering = false;
+   return current;
+}
+
+//----------------------
+bool MemoryGovernor::below(const MemorySample &s, Level l, uint32_t percent) const
+// is a reading below (percent % of) a limit of level l?
+{
+   const Limits &m = limits[l];
+   return uint64_t(s.internalFree) * 100 < uint64_t(m.internalFree) * percent ||
+          uint64_t(s.internalLargest) * 100 < uint64_t(m.internalLargest) * percent ||
+          uint64_t(s.psramLargest) * 100 < uint64_t(m.psramLargest) * percent;
+}
+
+//----------------------
+void MemoryGovernor::enter(Level l, uint32_t now)
+{
+   current = l;
+   since = now;
+   nTransitions++;
+   nEntries[l]++;
+   if (l > worst)
+      worst = l;
+}
@@ -0,0 +1,73 @@
+//
+// governor.h -- memory-pressure governor: policy only
+//
+// The governor maps memory readings to a degradation level. Every level has
+// limits; it is needed as soon as one reading drops below one of its limits:
+//
+//    Normal        everything on
+//    SmallFrames   smaller camera frames
+//    FewStreams    one stream session at most
+//    Shed          caches and kept pool blocks given back
+//    Refuse        no new stream sessions
+//
+// A more degraded level is entered at once, on the reading that needs it.
+// The way back is one level at a time, and only when all readings stayed at
+// least marginPercent above the limits of the current level for recoverMs.
+//
+// update () gets the readings and the time, so the policy runs on the host
+// with simulated memory and a virtual clock; acting on the level is up to
+// the caller (see pressure.cpp).
+//
+// BSla, 19 oct 2026
+//
+#ifndef _GOVERNOR_H
+#define _GOVERNOR_H
+
+#include <stdint.h>
+
+struct MemorySample
+{
+   uint32_t internalFree;
+   uint32_t internalLargest; // largest free block
+   uint32_t psramLargest;    // UINT32_MAX without PSRAM
+};
+
+class MemoryGovernor
+{
+public:
+   enum Level {Normal, SmallFrames, FewStreams, Shed, Refuse, N_LEVELS};
+
+   // a level is needed when a reading is below one of these
+   struct Limits
+   {
+      uint32_t internalFree;
+      uint32_t internalLargest;
+      uint32_t psramLargest;
+   };
+
+   MemoryGovernor(const Limits limits[N_LEVELS], uint32_t recoverMs, uint32_t marginPercent);
+   Level update(const MemorySample &s, uint32_t now); // returns the (new) level
+   Level level() const { return current; }
+   uint32_t levelSince() const { return since; }      // time the level was entered
+   uint32_t transitions() const { return nTransitions; }
+   uint32_t entries(Level l) const { return nEntries[l]; } // times l was entered
+   Level worstLevel() const { return worst; }
+   static const char *levelName(Level l);
+
+private:
+   bool below(const MemorySample &s, Level l, uint32_t percent) const;
+   void enter(Level l, uint32_t now);
+
+   const Limits *limits;
+   uint32_t recoverMs;
+   uint32_t marginPercent;
+   Level current = Normal;
+   Level worst = Normal;
+   uint32_t since = 0;
+   bool recovering = false; // readings are clear of the current level's limits
+   uint32_t clearSince = 0;
+   uint32_t nTransitions = 0;
+   uint32_t nEntries[N_LEVELS] = {};
+};
+
+#endif
@@ -0,0 +1,115 @@
+//
+// heapscope.cpp -- heap use per subsystem
+//
+// BSla, 19 oct 2026
+//
+#include <Arduino.h>
+#include "esp_heap_caps.h"
+#include "heapscope.h"
+
+#define HEAP_CAPS (MALLOC_CAP_8BIT) // internal RAM and PSRAM
+
+struct SubsystemStats
+{
+   // tracked
+   uint32_t live;
+   uint32_t peak;
+   uint32_t allocs;
+   uint32_t frees;
+   // scoped
+   int32_t scopedLive;
+   int32_t scopedPeak;
+   uint32_t scopes;
+};
+
+static SubsystemStats stats[N_SUBSYSTEMS];
+static portMUX_TYPE statsLock = portMUX_INITIALIZER_UNLOCKED;
+static __thread HeapScope *currentScope = nullptr; // innermost open scope of this task
+
+//----------------------
+const char *subsystemName(Subsystem s)
+{
+   static const char *names[N_SUBSYSTEMS] = {"camera", "http", "shutter", "wifi", "debug"};
+   return s >= 0 && s < N_SUBSYSTEMS ? names[s] : "ILLEGAL SUBSYSTEM";
+}
+
+//----------------------
+HeapScope::HeapScope(Subsystem s) : subsystem(s), outer(currentScope)
+{
+   currentScope = this;
+   freeBefore = heap_caps_get_free_size(HEAP_CAPS);
+}
+
+//----------------------
+HeapScope::~HeapScope()
+{
+   int32_t used = int32_t(freeBefore) - int32_t(heap_caps_get_free_size(HEAP_CAPS));
+   currentScope = outer;
+   if (outer)
+      outer->nested += used;
+   used -= nested;
+
+   portENTER_CRITICAL(&statsLock);
+   SubsystemStats &st = stats[subsystem];
+   st.scopedLive += used;
+   if (st.scopedLive > st.scopedPeak)
+      st.scopedPeak = st.scopedLive;
+   st.scopes++;
+   portEXIT_CRITICAL(&statsLock);
+}
+
+//----------------------
+void heapTrackAlloc(Subsystem s, size_t bytes)
+{
+   if (currentScope)
+      currentScope->nested += bytes; // already counted here
+   portENTER_CRITICAL(&statsLock);
+   SubsystemStats &st = stats[s];
+   st.live += bytes;
+   if (st.live > st.peak)
+      st.peak = st.live;
+   st.allocs++;
+   portEXIT_CRITICAL(&statsLock);
+}
+
+//----------------------
+void heapTrackFree(Subsystem s, size_t bytes)
+{
+   if (currentScope)
+      currentScope->nested -= bytes;
+   portENTER_CRITICAL(&statsLock);
+   stats[s].live -= bytes;
+   stats[s].frees++;
+   portEXIT_CRITICAL(&statsLock);
+}
+
+//----------------------
+void heapWriteReport(JsonWriter &w)
+{
+   SubsystemStats copy[N_SUBSYSTEMS];
+   portENTER_CRITICAL(&statsLock);
+   memcpy(copy, stats, sizeof(copy));
+   portEXIT_CRITICAL(&statsLock);
+
+   int32_t attributed = 0;
+   w.beginArray("subsystems");
+   for (int i = 0; i < N_SUBSYSTEMS; i++)
+   {
+      SubsystemStats &st = copy[i];
+      w.beginObject();
+      w.add("name", subsystemName(Subsystem(i)));
+      w.add("live", st.live);
+      w.add("peak", st.peak);
+      w.add("allocs", st.allocs);
+      w.add("frees", st.frees);
+      w.add("scopedLive", st.scopedLive);
+      w.add("scopedPeak", st.scopedPeak);
+      w.add("scopes", st.scopes);
+      w.endObject();
+      attributed += int32_t(st.live) + st.scopedLive;
+   }
+   w.endArray();
+   int32_t used = int32_t(heap_caps_get_total_size(HEAP_CAPS) - heap_caps_get_free_size(HEAP_CAPS));
+   w.add("heapUsed", used);
+   w.add("unattributed", used - attributed);
+}
@@ -0,0 +1,69 @@
+//
+// heapscope.h -- heap use per subsystem
+//
+// Two ways to attribute heap to a subsystem:
+//
+// - tracked: an allocator that knows the subsystem reports every block
+//   (heapTrackAlloc / heapTrackFree), e.g. memAlloc in allocator.cpp.
+//   Exact: live bytes, peak and number of allocations and frees.
+//
+// - scoped: a HeapScope guard around code that allocates through libraries
+//   (String, WiFi, the camera driver, the http server) measures how much
+//   free heap the scope used up, and adds that to its subsystem:
+//
+//      {
+//         HeapScope scope (SubsysWifi);
+//         WiFi.begin (...);
+//      }
+//
+//   The result is the net heap the code kept; a number that keeps growing is
+//   a leak. A scope nested in another one (same task) is subtracted from the
+//   outer scope, and so are tracked blocks allocated or freed inside the
+//   scope, so nothing is counted twice. Allocations made by other tasks
+//   while a scope is open are counted too, so keep scopes around short,
+//   synchronous calls.
+//
+// Both cost a few instructions and a spinlock, so they stay on in the field.
+// heapWriteReport () writes the totals, and the heap that is in use but not
+// attributed to any subsystem.
+//
+// BSla, 19 oct 2026
+//
+#ifndef _HEAPSCOPE_H
+#define _HEAPSCOPE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "json.h"
+
+enum Subsystem {
+   SubsysCamera,
+   SubsysHttp,
+   SubsysShutter,
+   SubsysWifi,
+   SubsysDebug,
+   N_SUBSYSTEMS
+};
+
+class HeapScope
+{
+public:
+   HeapScope(Subsystem s);
+   ~HeapScope();
+
+private:
+   Subsystem subsystem;
+   size_t freeBefore;
+   int32_t nested = 0;  // net heap used by the scopes nested in this one
+   HeapScope *outer;    // scope this one is nested in, in the same task
+
+   friend void heapTrackAlloc(Subsystem s, size_t bytes);
+   friend void heapTrackFree(Subsystem s, size_t bytes);
+};
+
+extern void        heapTrackAlloc  (Subsystem s, size_t bytes);
+extern void        heapTrackFree   (Subsystem s, size_t bytes);
+extern const char *subsystemName   (Subsystem s);
+extern void        heapWriteReport (JsonWriter &w); // "subsystems": [...], "unattributed": n
+
+#endif
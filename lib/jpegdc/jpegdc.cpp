@@ -0,0 +1,481 @@
+//
+// jpegdc.cpp -- luminance map from the DC coefficients of a baseline jpg
+//
+// BSla, 19 oct 2026
+//
+#include <string.h>
+#include "jpegdc.h"
+
+// markers
+#define SOI (0xD8)
+#define EOI (0xD9)
+#define SOF0 (0xC0) // baseline
+#define SOF1 (0xC1) // extended, Huffman
+#define DHT (0xC4)
+#define DQT (0xDB)
+#define DRI (0xDD)
+#define SOS (0xDA)
+#define RST0 (0xD0)
+#define RST7 (0xD7)
+
+// the standard Huffman tables of the jpg spec, annex K.3
+static const uint8_t dcLumBits[16] = {0, 1, 5, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0};
+static const uint8_t dcChromBits[16] = {0, 3, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0};
+static const uint8_t dcValues[12] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11};
+static const uint8_t acLumBits[16] = {0, 2, 1, 3, 3, 2, 4, 3, 5, 5, 4, 4, 0, 0, 1, 0x7d};
+static const uint8_t acLumValues[162] = {
+   0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12, 0x21, 0x31, 0x41, 0x06, 0x13, 0x51, 0x61, 0x07, 0x22, 0x71, 0x14,
+   0x32, 0x81, 0x91, 0xa1, 0x08, 0x23, 0x42, 0xb1, 0xc1, 0x15, 0x52, 0xd1, 0xf0, 0x24, 0x33, 0x62, 0x72, 0x82, 0x09,
+   0x0a, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x25, 0x26, 0x27, 0x28, 0x29, 0x2a, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a,
+   0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49, 0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5a, 0x63, 0x64, 0x65,
+   0x66, 0x67, 0x68, 0x69, 0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88,
+   0x89, 0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5, 0xa6, 0xa7, 0xa8, 0xa9,
+   0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3, 0xc4, 0xc5, 0xc6, 0xc7, 0xc8, 0xc9, 0xca,
+   0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda, 0xe1, 0xe2, 0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea,
+   0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8, 0xf9, 0xfa};
+static const uint8_t acChromBits[16] = {0, 2, 1, 2, 4, 4, 3, 4, 7, 5, 4, 4, 0, 1, 2, 0x77};
+static const uint8_t acChromValues[162] = {
+   0x00, 0x01, 0x02, 0x03, 0x11, 0x04, 0x05, 0x21, 0x31, 0x06, 0x12, 0x41, 0x51, 0x07, 0x61, 0x71, 0x13, 0x22, 0x32,
+   0x81, 0x08, 0x14, 0x42, 0x91, 0xa1, 0xb1, 0xc1, 0x09, 0x23, 0x33, 0x52, 0xf0, 0x15, 0x62, 0x72, 0xd1, 0x0a, 0x16,
+   0x24, 0x34, 0xe1, 0x25, 0xf1, 0x17, 0x18, 0x19, 0x1a, 0x26, 0x27, 0x28, 0x29, 0x2a, 0x35, 0x36, 0x37, 0x38, 0x39,
+   0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49, 0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5a, 0x63, 0x64,
+   0x65, 0x66, 0x67, 0x68, 0x69, 0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x82, 0x83, 0x84, 0x85, 0x86,
+   0x87, 0x88, 0x89, 0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5, 0xa6, 0xa7,
+   0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3, 0xc4, 0xc5, 0xc6, 0xc7, 0xc8,
+   0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda, 0xe2, 0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9,
+   0xea, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8, 0xf9, 0xfa};
+
+static inline int readU16(const uint8_t *q) { return (q[0] << 8) | q[1]; }
+
+//----------------------
+const char *JpegDc::resultName(Result r)
+{
+   static const char *names[N_RESULTS] = {"Ok", "NotJpeg", "Unsupported", "Corrupt", "Truncated"};
+   return r >= Ok && r < N_RESULTS ? names[r] : "ILLEGAL RESULT";
+}
+
+//----------------------
+JpegDc::Result JpegDc::decode(const uint8_t *jpeg, size_t len, uint8_t *map, int mapWidth, int mapHeight)
+{
+   p = jpeg;
+   end = jpeg + len;
+   gotFrame = false;
+   nComponents = 0;
+   nScanComponents = 0;
+   restartInterval = 0;
+   imageWidth = imageHeight = 0;
+   for (int i = 0; i < 2; i++)
+      dcTables[i].defined = acTables[i].defined = false;
+   for (int i = 0; i < 4; i++)
+      dcQuant[i] = 1;
+
+   Result r = readHeaders();
+   if (r != Ok)
+      return r;
+   return decodeScan(map, mapWidth, mapHeight);
+}
+
+//--private functions---------------------------------------
+
+//----------------------
+JpegDc::Result JpegDc::readHeaders()
+// up to and including the start of scan; p ends at the entropy coded data
+{
+   if (end - p < 4 || p[0] != 0xFF || p[1] != SOI)
+      return NotJpeg;
+   p += 2;
+   while (true)
+   {
+      while (p < end && *p != 0xFF)
+         p++; // not a marker: garbage between segments
+      while (p < end && *p == 0xFF)
+         p++; // fill bytes
+      if (end - p < 3)
+         return Truncated;
+      uint8_t marker = *p++;
+      if (marker == EOI)
+         return Corrupt;
+      size_t segLen = readU16(p);
+      if (segLen < 2 || segLen > size_t(end - p))
+         return Truncated;
+      const uint8_t *seg = p + 2;
+      segLen -= 2;
+      p = seg + segLen;
+
+      Result r = Ok;
+      switch (marker)
+      {
+      case DQT:
+         r = readQuantTables(seg, segLen);
+         break;
+      case DHT:
+         r = readHuffTables(seg, segLen);
+         break;
+      case SOF0:
+      case SOF1:
+         r = readFrame(seg, segLen);
+         break;
+      case DRI:
+         if (segLen < 2)
+            return Corrupt;
+         restartInterval = readU16(seg);
+         break;
+      case SOS:
+         return readScan(seg, segLen);
+      default:
+         if (marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC)
+            return Unsupported; // progressive, lossless, arithmetic coding
+         break;                 // APPn, COM, ...
+      }
+      if (r != Ok)
+         return r;
+   }
+}
+
+//----------------------
+JpegDc::Result JpegDc::readQuantTables(const uint8_t *seg, size_t len)
+// only the DC entry of each table is used
+{
+   while (len > 0)
+   {
+      int precision = seg[0] >> 4;
+      int id = seg[0] & 0x0F;
+      size_t size = 1 + 64 * (precision ? 2 : 1);
+      if (id > 3 || len < size)
+         return Corrupt;
+      dcQuant[id] = precision ? readU16(seg + 1) : seg[1];
+      seg += size;
+      len -= size;
+   }
+   return Ok;
+}
+
+//----------------------
+JpegDc::Result JpegDc::readHuffTables(const uint8_t *seg, size_t len)
+{
+   while (len > 17)
+   {
+      int tableClass = seg[0] >> 4;
+      int id = seg[0] & 0x0F;
+      int nValues = 0;
+      for (int i = 0; i < 16; i++)
+         nValues += seg[1 + i];
+      if (tableClass > 1 || id > 1 || nValues > 256 || len < size_t(17 + nValues))
+         return id > 1 ? Unsupported : Corrupt;
+      HuffTable &t = tableClass ? acTables[id] : dcTables[id];
+      if (!buildTable(t, seg + 1, seg + 17, nValues))
+         return Corrupt;
+      seg += 17 + nValues;
+      len -= 17 + nValues;
+   }
+   return len == 0 ? Ok : Corrupt;
+}
+
+//----------------------
+JpegDc::Result JpegDc::readFrame(const uint8_t *seg, size_t len)
+{
+   if (len < 6)
+      return Corrupt;
+   if (seg[0] != 8)
+      return Unsupported; // 12-bit samples
+   imageHeight = readU16(seg + 1);
+   imageWidth = readU16(seg + 3);
+   nComponents = seg[5];
+   if (imageWidth == 0 || imageHeight == 0)
+      return Unsupported; // height given by a DNL marker
+   if (nComponents < 1 || nComponents > MAX_COMPONENTS)
+      return Unsupported;
+   if (len < size_t(6 + 3 * nComponents))
+      return Corrupt;
+   for (int i = 0; i < nComponents; i++)
+   {
+      const uint8_t *c = seg + 6 + 3 * i;
+      Component &comp = components[i];
+      comp.id = c[0];
+      comp.h = c[1] >> 4;
+      comp.v = c[1] & 0x0F;
+      comp.quant = c[2] & 0x03;
+      if (comp.h < 1 || comp.h > 4 || comp.v < 1 || comp.v > 4)
+         return Corrupt;
+   }
+   gotFrame = true;
+   return Ok;
+}
+
+//----------------------
+JpegDc::Result JpegDc::readScan(const uint8_t *seg, size_t len)
+{
+   if (!gotFrame || len < 1)
+      return Corrupt;
+   nScanComponents = seg[0];
+   if (len < size_t(1 + 2 * nScanComponents + 3))
+      return Corrupt;
+   if (nScanComponents != nComponents)
+      return Unsupported; // not interleaved: one scan per component
+   for (int i = 0; i < nScanComponents; i++)
+   {
+      const uint8_t *s = seg + 1 + 2 * i;
+      if (s[0] != components[i].id)
+         return Unsupported; // scan order differs from frame order
+      components[i].dc = s[1] >> 4;
+      components[i].ac = s[1] & 0x0F;
+      if (components[i].dc > 1 || components[i].ac > 1)
+         return Unsupported;
+   }
+   if (!dcTables[0].defined && !acTables[0].defined && !dcTables[1].defined && !acTables[1].defined)
+      defaultTables();
+   for (int i = 0; i < nComponents; i++)
+   {
+      if (!dcTables[components[i].dc].defined || !acTables[components[i].ac].defined)
+         return Corrupt;
+   }
+   return Ok;
+}
+
+//----------------------
+JpegDc::Result JpegDc::decodeScan(uint8_t *map, int mapWidth, int mapHeight)
+{
+   int hMax = 1, vMax = 1;
+   for (int i = 0; i < nComponents; i++)
+   {
+      if (components[i].h > hMax)
+         hMax = components[i].h;
+      if (components[i].v > vMax)
+         vMax = components[i].v;
+   }
+   if (nComponents == 1)
+      hMax = vMax = components[0].h = components[0].v = 1; // not interleaved: one block per MCU
+   int mcusX = (imageWidth + 8 * hMax - 1) / (8 * hMax);
+   int mcusY = (imageHeight + 8 * vMax - 1) / (8 * vMax);
+   Component &luma = components[0];
+   int quant = dcQuant[luma.quant];
+
+   restart();
+   int toRestart = restartInterval;
+   for (int my = 0; my < mcusY; my++)
+   {
+      for (int mx = 0; mx < mcusX; mx++)
+      {
+         if (restartInterval && toRestart-- == 0)
+         {
+            // RSTn: byte aligned, the predictions start again
+            if (end - p < 2 || p[0] != 0xFF || p[1] < RST0 || p[1] > RST7)
+               return Corrupt;
+            p += 2;
+            restart();
+            toRestart = restartInterval - 1;
+         }
+
+         for (int by = 0; by < luma.v; by++)
+         {
+            for (int bx = 0; bx < luma.h; bx++)
+            {
+               int dc;
+               if (!skipBlock(luma, &dc))
+                  return Corrupt;
+               int x = mx * luma.h + bx;
+               int y = my * luma.v + by;
+               if (x < mapWidth && y < mapHeight)
+               {
+                  // DC = 8 x (mean - 128), rounded
+                  int v = (dc * quant + 8 * 128 + 4) >> 3;
+                  map[y * mapWidth + x] = uint8_t(v < 0 ? 0 : v > 255 ? 255 : v);
+               }
+            }
+         }
+         for (int i = 1; i < nComponents; i++)
+         {
+            Component &c = components[i];
+            for (int b = c.h * c.v; b > 0; b--)
+            {
+               if (!skipBlock(c, nullptr))
+                  return Corrupt;
+            }
+         }
+         if (padded * 8 > nBits)
+            return Truncated; // used bits that were not there
+      }
+   }
+   return Ok;
+}
+
+//----------------------
+bool JpegDc::skipBlock(Component &c, int *dc)
+// decode the DC of a block and skip its AC coefficients; false on a bad code
+{
+   int s = decodeHuffman(dcTables[c.dc]);
+   if (s < 0 || s > 11)
+      return false;
+   c.pred += receive(s);
+   if (dc)
+      *dc = c.pred;
+
+   const HuffTable &ac = acTables[c.ac];
+   for (int k = 1; k < 64; k++)
+   {
+      int rs;
+      int len;
+      if (nBits < 25)
+         fill();
+      uint16_t f = ac.fast[bits >> (64 - FAST_BITS)];
+      if (f)
+      {
+         // short code: code and value bits fit the 25 bits in one go
+         rs = f & 0xFF;
+         len = f >> 8;
+      }
+      else
+      {
+         rs = decodeHuffman(ac);
+         if (rs < 0)
+            return false;
+         len = 0;
+         if (nBits < 25)
+            fill();
+      }
+      int run = rs >> 4;
+      int size = rs & 0x0F;
+      if (size == 0 && run != 15)
+      {
+         bits <<= len;
+         nBits -= len;
+         break; // end of block
+      }
+      k += size ? run : 15; // run zeros, or sixteen zeros
+      len += size;          // the value is not needed
+      bits <<= len;
+      nBits -= len;
+   }
+   return true;
+}
+
+//----------------------
+bool JpegDc::buildTable(HuffTable &t, const uint8_t bits[16], const uint8_t *values, int nValues)
+// canonical codes, jpg spec annex C and F.2.2.3
+{
+   memset(t.fast, 0, sizeof(t.fast));
+   memcpy(t.values, values, nValues);
+   uint32_t code = 0;
+   int k = 0;
+   for (int len = 1; len <= 16; len++)
+   {
+      t.valPtr[len] = uint8_t(k);
+      t.minCode[len] = uint16_t(code);
+      for (int i = 0; i < bits[len - 1]; i++, k++, code++)
+      {
+         if (code >= (1u << len))
+            return false; // more codes than fit this length
+         if (len <= FAST_BITS)
+         {
+            // every FAST_BITS wide pattern that starts with this code
+            int shift = FAST_BITS - len;
+            for (uint32_t j = 0; j < (1u << shift); j++)
+               t.fast[(code << shift) | j] = uint16_t((len << 8) | values[k]);
+         }
+      }
+      t.maxCode[len] = bits[len - 1] ? int32_t(code - 1) : -1;
+      code <<= 1;
+   }
+   t.defined = true;
+   return true;
+}
+
+//----------------------
+void JpegDc::defaultTables()
+{
+   buildTable(dcTables[0], dcLumBits, dcValues, 12);
+   buildTable(dcTables[1], dcChromBits, dcValues, 12);
+   buildTable(acTables[0], acLumBits, acLumValues, 162);
+   buildTable(acTables[1], acChromBits, acChromValues, 162);
+}
+
+//----------------------
+void JpegDc::restart()
+{
+   bits = 0;
+   nBits = 0;
+   padded = 0;
+   atMarker = false;
+   for (int i = 0; i < nComponents; i++)
+      components[i].pred = 0;
+}
+
+//----------------------
+inline void JpegDc::fill()
+// at least 57 bits in the buffer, so most codes are read without a fill; after the entropy data (a marker) zeros
+{
+   while (nBits <= 56)
+   {
+      if (p < end && *p != 0xFF && !atMarker)
+      {
+         bits |= uint64_t(*p++) << (56 - nBits); // the usual byte
+         nBits += 8;
+         continue;
+      }
+      uint32_t c = 0;
+      bool data = false;
+      if (!atMarker && p < end)
+      {
+         c = *p++;
+         data = true;
+         if (c == 0xFF)
+         {
+            if (p < end && *p == 0x00)
+               p++; // stuffed zero
+            else
+            {
+               atMarker = true; // leave the marker for the restart handling
+               p--;
+               c = 0;
+               data = false;
+            }
+         }
+      }
+      if (!data)
+         padded++;
+      bits |= uint64_t(c) << (56 - nBits);
+      nBits += 8;
+   }
+}
+
+//----------------------
+inline int JpegDc::decodeHuffman(const HuffTable &t)
+// the next value, or -1 for a code that is not in the table
+{
+   if (nBits < 25)
+      fill();
+   uint16_t f = t.fast[bits >> (64 - FAST_BITS)];
+   if (f)
+   {
+      int len = f >> 8;
+      bits <<= len;
+      nBits -= len;
+      return f & 0xFF;
+   }
+   uint32_t code16 = uint32_t(bits >> 48);
+   for (int len = FAST_BITS + 1; len <= 16; len++)
+   {
+      int32_t code = int32_t(code16 >> (16 - len));
+      if (code <= t.maxCode[len])
+      {
+         bits <<= len;
+         nBits -= len;
+         return t.values[t.valPtr[len] + code - t.minCode[len]];
+      }
+   }
+   return -1;
+}
+
+//----------------------
+inline int JpegDc::receive(int n)
+// n bits as a signed value (jpg spec F.2.2.1, EXTEND)
+{
+   if (n == 0)
+      return 0;
+   if (nBits < 25)
+      fill();
+   int v = int(bits >> (64 - n));
+   bits <<= n;
+   nBits -= n;
+   return v < (1 << (n - 1)) ? v - (1 << n) + 1 : v;
+}
@@ -0,0 +1,95 @@
+//
+// jpegdc.h -- luminance map from the DC coefficients of a baseline jpg
+//
+// The DC coefficient of an 8 x 8 block is eight times the mean of its pixels
+// (minus 128). So Huffman-decoding only the DC coefficients of the luminance
+// blocks gives the image at 1/8 of its width and height, a byte per block,
+// without IDCT, colour conversion or upsampling:
+//
+//    static JpegDc jpegDc;                // tables: ~3.5 KB, keep it off the stack
+//    JpegDc::Result r = jpegDc.decode (frame.buf, frame.len, map, 80, 60);
+//
+// The AC coefficients still have to be Huffman-decoded to find the next block,
+// but their values are skipped, not stored. Chroma blocks are skipped the
+// same way. Restart markers are handled; progressive and arithmetic coded
+// jpgs are not (the camera makes neither). A jpg without Huffman tables (as
+// some cameras send in MJPEG) gets the standard tables of the jpg spec.
+//
+// BSla, 19 oct 2026
+//
+#ifndef _JPEGDC_H
+#define _JPEGDC_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+class JpegDc
+{
+public:
+   enum Result {Ok, NotJpeg, Unsupported, Corrupt, Truncated, N_RESULTS};
+
+   // map[y * mapWidth + x] = mean of luminance block (x, y); blocks outside the map are skipped
+   Result decode(const uint8_t *jpeg, size_t len, uint8_t *map, int mapWidth, int mapHeight);
+   int width() const { return imageWidth; }   // pixels, of the last jpg
+   int height() const { return imageHeight; }
+   static const char *resultName(Result r);
+
+private:
+   static const int FAST_BITS = 8; // codes up to this length are looked up in one step
+   static const int MAX_COMPONENTS = 3;
+
+   struct HuffTable
+   {
+      bool defined;
+      uint16_t fast[1 << FAST_BITS]; // (length << 8) | value, 0: longer code
+      int32_t maxCode[17];           // per length; -1: none
+      uint16_t minCode[17];
+      uint16_t valPtr[17];           // index in values of the first code of each length
+      uint8_t values[256];
+   };
+
+   struct Component
+   {
+      uint8_t id;
+      uint8_t h, v;   // sampling factors
+      uint8_t quant;  // table
+      uint8_t dc, ac; // Huffman tables
+      int pred;       // previous DC
+   };
+
+   Result readHeaders();
+   Result readQuantTables(const uint8_t *seg, size_t len);
+   Result readHuffTables(const uint8_t *seg, size_t len);
+   Result readFrame(const uint8_t *seg, size_t len);
+   Result readScan(const uint8_t *seg, size_t len);
+   Result decodeScan(uint8_t *map, int mapWidth, int mapHeight);
+   bool skipBlock(Component &c, int *dc);
+   static bool buildTable(HuffTable &t, const uint8_t bits[16], const uint8_t *values, int nValues);
+   void defaultTables();
+
+   // bit reader
+   void restart();
+   void fill();
+   int decodeHuffman(const HuffTable &t);
+   int receive(int n);
+
+   const uint8_t *p = nullptr;  // next byte
+   const uint8_t *end = nullptr;
+   uint64_t bits = 0;           // msb first; 64 bits: a fill per several codes
+   int nBits = 0;
+   int padded = 0;              // zero bytes put in after the entropy data ended
+   bool atMarker = false;
+
+   uint16_t dcQuant[4];         // the DC entry of each quantisation table
+   HuffTable dcTables[2];
+   HuffTable acTables[2];
+   Component components[MAX_COMPONENTS];
+   int nComponents = 0;
+   int nScanComponents = 0;
+   bool gotFrame = false;
+   int imageWidth = 0;
+   int imageHeight = 0;
+   int restartInterval = 0;     // MCUs, 0: no restarts
+};
+
+#endif
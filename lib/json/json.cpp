@@ -0,0 +1,275 @@
+//
+// json.cpp -- minimal JSON writer and reader, no heap allocation
+//
+// BSla, 19 oct 2026
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include "json.h"
+
+//----------------------
+static const char *skipSpace(const char *p)
+{
+   while (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')
+      p++;
+   return p;
+}
+
+//----------------------
+static const char *skipString(const char *p)
+// p at the opening quote; returns the character after the closing quote
+{
+   for (p++; *p && *p != '"'; p++)
+   {
+      if (*p == '\\' && p[1])
+         p++;
+   }
+   return *p ? p + 1 : p;
+}
+
+//----------------------
+void JsonWriter::beginObject(const char *key)
+{
+   separator(key);
+   put('{');
+   if (depth < MAX_DEPTH - 1)
+      depth++;
+   hasItems &= ~(1UL << depth);
+}
+
+//----------------------
+void JsonWriter::endObject()
+{
+   put('}');
+   if (depth > 0)
+      depth--;
+}
+
+//----------------------
+void JsonWriter::beginArray(const char *key)
+{
+   separator(key);
+   put('[');
+   if (depth < MAX_DEPTH - 1)
+      depth++;
+   hasItems &= ~(1UL << depth);
+}
+
+//----------------------
+void JsonWriter::endArray()
+{
+   put(']');
+   if (depth > 0)
+      depth--;
+}
+
+//----------------------
+void JsonWriter::add(const char *key, const char *value)
+{
+   separator(key);
+   putString(value);
+}
+
+//----------------------
+void JsonWriter::add(const char *key, long value)
+{
+   char number[24];
+   snprintf(number, sizeof(number), "%ld", value);
+   separator(key);
+   put(number);
+}
+
+//----------------------
+void JsonWriter::add(const char *key, unsigned long value)
+{
+   char number[24];
+   snprintf(number, sizeof(number), "%lu", value);
+   separator(key);
+   put(number);
+}
+
+//----------------------
+void JsonWriter::add(const char *key, bool value)
+{
+   separator(key);
+   put(value ? "true" : "false");
+}
+
+//----------------------
+void JsonWriter::addFloat(const char *key, float value, int decimals)
+{
+   char number[24];
+   snprintf(number, sizeof(number), "%.*f", decimals, value);
+   separator(key);
+   put(number);
+}
+
+//----------------------
+bool JsonWriter::finish()
+{
+   flush();
+   return !failed;
+}
+
+//----------------------
+void JsonWriter::separator(const char *key)
+// put a comma if this is not the first item at this level, then the key (if any)
+{
+   uint32_t bit = 1UL << depth;
+   if (hasItems & bit)
+      put(',');
+   hasItems |= bit;
+   if (key)
+   {
+      putString(key);
+      put(':');
+   }
+}
+
+//----------------------
+void JsonWriter::put(char c)
+{
+   if (len >= BUF_SIZE)
+      flush();
+   buf[len++] = c;
+}
+
+//----------------------
+void JsonWriter::put(const char *s)
+{
+   while (*s)
+      put(*s++);
+}
+
+//----------------------
+void JsonWriter::putString(const char *s)
+{
+   static const char hexDigits[] = "0123456789abcdef";
+   put('"');
+   for (; *s; s++)
+   {
+      unsigned char c = (unsigned char)*s;
+      if (c == '"' || c == '\\')
+      {
+         put('\\');
+         put(char(c));
+      }
+      else if (c < 0x20)
+      {
+         put("\\u00");
+         put(hexDigits[c >> 4]);
+         put(hexDigits[c & 0xF]);
+      }
+      else
+         put(char(c));
+   }
+   put('"');
+}
+
+//----------------------
+void JsonWriter::flush()
+{
+   if (len > 0)
+   {
+      if (!failed && !flushFunction(flushContext, buf, len))
+         failed = true;
+      total += len;
+      len = 0;
+   }
+}
+
+//----------------------
+const char *JsonReader::findValue(const char *json, const char *key)
+// return a pointer to the first character of the value of "key" in the
+// top-level object, or nullptr; strings are skipped whole, so neither their
+// contents nor keys inside nested values are mistaken for a key
+{
+   size_t keyLen = strlen(key);
+   int depth = 0;
+   const char *p = json;
+   while (*p)
+   {
+      if (*p == '"')
+      {
+         const char *s = p + 1;
+         p = skipString(p);
+         if (depth == 1 && size_t(p - s) == keyLen + 1 && strncmp(s, key, keyLen) == 0)
+         {
+            const char *v = skipSpace(p);
+            if (*v == ':')
+               return skipSpace(v + 1);
+         }
+         continue;
+      }
+      if (*p == '{' || *p == '[')
+         depth++;
+      else if (*p == '}' || *p == ']')
+      {
+         if (--depth <= 0)
+            return nullptr;
+      }
+      p++;
+   }
+   return nullptr;
+}
+
+//----------------------
+bool JsonReader::getString(const char *json, const char *key, char *value, size_t valueSize)
+// \uXXXX escapes are not decoded
+{
+   const char *v = findValue(json, key);
+   if (!v || *v != '"' || valueSize == 0)
+      return false;
+
+   size_t n = 0;
+   for (v++; *v && *v != '"'; v++)
+   {
+      char c = *v;
+      if (c == '\\' && v[1])
+      {
+         c = *++v;
+         if (c == 'n')
+            c = '\n';
+         else if (c == 't')
+            c = '\t';
+      }
+      if (n + 1 < valueSize)
+         value[n++] = c;
+   }
+   value[n] = '\0';
+   return *v == '"';
+}
+
+//----------------------
+bool JsonReader::getInt(const char *json, const char *key, int &value)
+{
+   const char *v = findValue(json, key);
+   if (!v)
+      return false;
+   char *end;
+   errno = 0;
+   long l = strtol(v, &end, 10);
+   if (end == v || errno == ERANGE || l < INT_MIN || l > INT_MAX)
+      return false;
+   end = (char *)skipSpace(end);
+   if (*end != ',' && *end != '}' && *end != ']' && *end != '\0') // e.g. 2.5 or 12abc
+      return false;
+   value = int(l);
+   return true;
+}
+
+//----------------------
+bool JsonReader::getBool(const char *json, const char *key, bool &value)
+{
+   const char *v = findValue(json, key);
+   if (v && strncmp(v, "true", 4) == 0)
+      value = true;
+   else if (v && strncmp(v, "false", 5) == 0)
+      value = false;
+   else
+      return false;
+   return true;
+}
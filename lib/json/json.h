@@ -0,0 +1,82 @@
+//
+// json.h -- minimal JSON writer and reader, no heap allocation
+//
+// JsonWriter serializes into a small internal buffer and hands every full
+// buffer to a flush function (e.g. one that calls httpd_resp_send_chunk).
+// Commas and nesting are handled by the writer:
+//
+//    JsonWriter w (flushFunction, context);
+//    w.beginObject ();
+//    w.add ("state", "Closed");
+//    w.beginObject ("shutter");
+//    w.add ("openDeg", 90);
+//    w.endObject ();
+//    w.endObject ();
+//    bool ok = w.finish ();      // flushes what is left; false if any flush failed
+//
+// JsonReader fetches values from the top level of an object, e.g.
+// {"cmd":"open","n":3}. Nested objects and arrays are skipped: their keys
+// are not found, and their values cannot be fetched.
+//
+// BSla, 19 oct 2026
+//
+#ifndef _JSON_H
+#define _JSON_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef bool (*JsonFlushFunction)(void *context, const char *data, size_t len);
+
+class JsonWriter
+{
+public:
+   JsonWriter(JsonFlushFunction flush, void *context) : flushFunction(flush), flushContext(context) {}
+   void beginObject(const char *key = nullptr);
+   void endObject();
+   void beginArray(const char *key = nullptr);
+   void endArray();
+   void add(const char *key, const char *value);
+   void add(const char *key, long value);
+   void add(const char *key, unsigned long value);
+   void add(const char *key, int value) { add(key, long(value)); }
+   void add(const char *key, unsigned int value) { add(key, (unsigned long)(value)); }
+   void add(const char *key, bool value);
+   void addFloat(const char *key, float value, int decimals = 1);
+   bool finish();                 // flush the remaining output
+   bool ok() { return !failed; }  // false if a flush failed
+   size_t bytesWritten() { return total + len; }
+
+private:
+   static const int BUF_SIZE = 128;
+   static const int MAX_DEPTH = 16;
+
+   void separator(const char *key); // comma (if needed) and "key":
+   void put(char c);
+   void put(const char *s);
+   void putString(const char *s);   // quoted and escaped
+   void flush();
+
+   JsonFlushFunction flushFunction;
+   void *flushContext;
+   char buf[BUF_SIZE];
+   size_t len = 0;
+   size_t total = 0;      // bytes flushed so far
+   uint32_t hasItems = 0; // bit n: level n already has an item, so the next one needs a comma
+   int depth = 0;
+   bool failed = false;
+};
+
+class JsonReader
+{
+public:
+   // all return false if the key is not found or its value has the wrong type
+   static bool getString(const char *json, const char *key, char *value, size_t valueSize);
+   static bool getInt(const char *json, const char *key, int &value);
+   static bool getBool(const char *json, const char *key, bool &value);
+
+private:
+   static const char *findValue(const char *json, const char *key);
+};
+
+#endif
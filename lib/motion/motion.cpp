@@ -0,0 +1,234 @@
+//
+// motion.cpp -- frame-difference motion detection on small grayscale frames
+//
+// BSla, 19 oct 2026
+//
+#include <string.h>
+#include "motion.h"
+
+#define HIGH_BITS (0x80808080u)
+#define LOW_7_BITS (0x7F7F7F7Fu)
+#define EVEN_BYTES (0x00FF00FFu)
+
+//----------------------
+uint32_t MotionEngine::absDiff4(uint32_t a, uint32_t b)
+// |a - b| per byte: subtract without borrows between the bytes, then negate the bytes where a < b
+{
+   uint32_t diff = ((a | HIGH_BITS) - (b & ~HIGH_BITS)) ^ ((a ^ ~b) & HIGH_BITS); // a - b modulo 256
+   uint32_t borrow = ((~a & b) | (~(a ^ b) & diff)) & HIGH_BITS;                  // bit 7: a < b
+   uint32_t negative = borrow >> 7;
+   return (diff ^ (negative * 0xFF)) + negative;
+}
+
+//----------------------
+uint32_t MotionEngine::average4(uint32_t a, uint32_t b)
+{
+   return (a & b) + (((a ^ b) >> 1) & LOW_7_BITS);
+}
+
+//----------------------
+uint32_t MotionEngine::average4Up(uint32_t a, uint32_t b)
+{
+   return (a | b) - (((a ^ b) >> 1) & LOW_7_BITS);
+}
+
+//----------------------
+uint32_t MotionEngine::blend4(uint32_t bg, uint32_t frame, int shift, bool roundUp)
+// halve the distance to bg shift times
+{
+   uint32_t x = frame;
+   for (int i = 0; i < shift; i++)
+      x = roundUp ? average4Up(bg, x) : average4(bg, x);
+   return x;
+}
+
+//----------------------
+bool MotionEngine::begin(int width, int height, uint8_t *background)
+{
+   if (!background || width <= 0 || height <= 0 || width % BLOCK != 0 || width > MAX_WIDTH || height > MAX_HEIGHT ||
+       (uintptr_t(background) & 3) != 0)
+   {
+      bg = nullptr;
+      w = h = cols = rows = 0;
+      return false;
+   }
+   bg = background;
+   w = width;
+   h = height;
+   cols = width / BLOCK;
+   rows = (height + BLOCK - 1) / BLOCK;
+   primed = false;
+   runMotion = 0;
+   runQuiet = 0;
+   memset(changed, 0, sizeof(changed));
+   res = MotionResult();
+   return true;
+}
+
+//----------------------
+const MotionResult &MotionEngine::update(const uint8_t *gray)
+{
+   if (!bg)
+      return res;
+   if (!primed)
+   {
+      memcpy(bg, gray, bufferSize(w, h));
+      primed = true;
+      return res;
+   }
+
+   compare(gray);
+   int nBlocks = cols * rows;
+   res.score = uint16_t(res.changedBlocks * 1000 / nBlocks);
+   res.lightChange = res.score > config.globalPermille;
+   res.motion = !res.lightChange && res.changedBlocks >= config.minBlocks;
+   if (res.lightChange)
+      memcpy(bg, gray, bufferSize(w, h));
+   else
+      learn(gray);
+   roundUp = !roundUp;
+   track();
+   return res;
+}
+
+//--private functions---------------------------------------
+
+//----------------------
+void MotionEngine::compare(const uint8_t *gray)
+// changed blocks, their number and the box around them
+{
+   const int wordsPerRow = w / 4;
+   const uint32_t *frame = (const uint32_t *)gray;
+   const uint32_t *back = (const uint32_t *)bg;
+   int minX = cols, maxX = -1, minY = rows, maxY = -1;
+   res.changedBlocks = 0;
+
+   for (int br = 0; br < rows; br++)
+   {
+      // two 16-bit sums per block: at most 8 rows x 4 pixels x 255, so they do not overflow
+      uint32_t sums[MAX_WIDTH / BLOCK] = {};
+      int y0 = br * BLOCK;
+      int y1 = y0 + BLOCK < h ? y0 + BLOCK : h;
+      for (int y = y0; y < y1; y++)
+      {
+         const uint32_t *f = frame + y * wordsPerRow;
+         const uint32_t *b = back + y * wordsPerRow;
+         for (int bc = 0; bc < cols; bc++)
+         {
+            uint32_t d0 = absDiff4(f[0], b[0]);
+            uint32_t d1 = absDiff4(f[1], b[1]);
+            sums[bc] += (d0 & EVEN_BYTES) + ((d0 >> 8) & EVEN_BYTES) + (d1 & EVEN_BYTES) + ((d1 >> 8) & EVEN_BYTES);
+            f += 2;
+            b += 2;
+         }
+      }
+
+      uint32_t limit = uint32_t(config.blockThreshold) * BLOCK * (y1 - y0);
+      uint32_t mask = 0;
+      for (int bc = 0; bc < cols; bc++)
+      {
+         uint32_t sum = (sums[bc] & 0xFFFF) + (sums[bc] >> 16);
+         if (sum > limit)
+         {
+            mask |= 1u << bc;
+            res.changedBlocks++;
+            if (bc < minX)
+               minX = bc;
+            if (bc > maxX)
+               maxX = bc;
+         }
+      }
+      changed[br] = mask;
+      if (mask)
+      {
+         if (br < minY)
+            minY = br;
+         maxY = br;
+      }
+   }
+
+   if (res.changedBlocks > 0)
+   {
+      res.box.x0 = uint16_t(minX * BLOCK);
+      res.box.y0 = uint16_t(minY * BLOCK);
+      res.box.x1 = uint16_t(maxX * BLOCK + BLOCK - 1);
+      res.box.y1 = uint16_t(maxY * BLOCK + BLOCK - 1 < h ? maxY * BLOCK + BLOCK - 1 : h - 1);
+   }
+   else
+      res.box = MotionBox();
+}
+
+//----------------------
+void MotionEngine::learn(const uint8_t *gray)
+// move the background towards the frame: slowly where it changed
+{
+   const int wordsPerRow = w / 4;
+   const uint32_t *frame = (const uint32_t *)gray;
+   uint32_t *back = (uint32_t *)bg;
+   for (int y = 0; y < h; y++)
+   {
+      uint32_t mask = changed[y / BLOCK];
+      const uint32_t *f = frame + y * wordsPerRow;
+      uint32_t *b = back + y * wordsPerRow;
+      for (int bc = 0; bc < cols; bc++)
+      {
+         int shift = (mask >> bc) & 1 ? config.holdShift : config.learnShift;
+         b[0] = blend4(b[0], f[0], shift, roundUp);
+         b[1] = blend4(b[1], f[1], shift, roundUp);
+         f += 2;
+         b += 2;
+      }
+   }
+}
+
+//----------------------
+void MotionEngine::track()
+// event state from the motion of this frame
+{
+   res.eventStart = false;
+   res.eventEnd = false;
+   if (res.motion)
+   {
+      runQuiet = 0;
+      if (runMotion < 255)
+         runMotion++;
+   }
+   else
+   {
+      runMotion = 0;
+      if (runQuiet < 255)
+         runQuiet++;
+   }
+
+   if (!res.inEvent && runMotion >= config.startFrames)
+   {
+      res.inEvent = true;
+      res.eventStart = true;
+      res.eventFrames = 0;
+      res.eventScore = 0;
+      res.eventBox = res.box;
+   }
+   if (!res.inEvent)
+      return;
+
+   res.eventFrames++;
+   if (res.motion)
+   {
+      if (res.score > res.eventScore)
+         res.eventScore = res.score;
+      MotionBox &e = res.eventBox;
+      if (res.box.x0 < e.x0)
+         e.x0 = res.box.x0;
+      if (res.box.y0 < e.y0)
+         e.y0 = res.box.y0;
+      if (res.box.x1 > e.x1)
+         e.x1 = res.box.x1;
+      if (res.box.y1 > e.y1)
+         e.y1 = res.box.y1;
+   }
+   else if (runQuiet >= config.endFrames)
+   {
+      res.inEvent = false;
+      res.eventEnd = true;
+   }
+}
@@ -0,0 +1,115 @@
+//
+// motion.h -- frame-difference motion detection on small grayscale frames
+//
+// The engine keeps a background image and compares every new frame with it,
+// in blocks of 8 x 8 pixels. A block whose mean absolute difference exceeds
+// blockThreshold has changed. A frame has motion when at least minBlocks
+// blocks changed, and an event starts after startFrames frames with motion in
+// a row and ends after endFrames frames without:
+//
+//    MotionEngine engine (config);
+//    engine.begin (80, 60, background);   // background: bufferSize (80, 60) bytes
+//    const MotionResult &r = engine.update (gray);
+//    if (r.eventStart) ...                // r.eventBox, r.eventScore
+//
+// The background follows every frame: a quiet block with 1/2^learnShift of
+// the difference, a changed block with 1/2^holdShift, so a bird that stays
+// is slowly absorbed. When more than globalPermille of the blocks change at
+// once (the sun comes out, the sensor adjusts its exposure) the frame is not
+// motion: the background is replaced by it.
+//
+// The kernels work on four pixels at a time in 32-bit words (SWAR: the ESP32
+// has no SIMD), without floating point or heap; frames and the background
+// must be 4-byte aligned, the width a multiple of 8. The engine knows no
+// time and no camera, so it runs on the host with recorded frames.
+//
+// BSla, 19 oct 2026
+//
+#ifndef _MOTION_H
+#define _MOTION_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct MotionConfig
+{
+   uint8_t blockThreshold;  // mean absolute difference of a changed block, 0..255
+   uint16_t minBlocks;      // changed blocks for a frame with motion
+   uint16_t globalPermille; // more changed blocks than this: lighting, not motion
+   uint8_t startFrames;     // frames with motion in a row that start an event
+   uint8_t endFrames;       // frames without motion in a row that end it
+   uint8_t learnShift;      // background follows quiet blocks with 1/2^learnShift
+   uint8_t holdShift;       // ... and changed blocks with 1/2^holdShift
+};
+
+struct MotionBox
+{
+   uint16_t x0, y0; // top left pixel
+   uint16_t x1, y1; // bottom right pixel, inclusive
+};
+
+struct MotionResult
+{
+   // this frame
+   bool motion;
+   bool lightChange;       // too many blocks changed: background replaced
+   uint16_t changedBlocks;
+   uint16_t score;         // changed blocks, per mille of the frame
+   MotionBox box;          // around the changed blocks
+   // the event
+   bool inEvent;
+   bool eventStart;        // this frame started an event
+   bool eventEnd;          // this frame ended it
+   uint32_t eventFrames;   // frames since the start
+   uint16_t eventScore;    // highest score
+   MotionBox eventBox;     // around all changed blocks since the start
+};
+
+class MotionEngine
+{
+public:
+   static const int BLOCK = 8;          // block width and height, pixels
+   static const int MAX_WIDTH = 256;    // 32 blocks: a row of blocks fits a uint32_t
+   static const int MAX_HEIGHT = 256;
+
+   MotionEngine(const MotionConfig &config) : config(config) {}
+   static size_t bufferSize(int width, int height) { return size_t(width) * height; }
+
+   // (re)start with frames of this size; the first update () is the background
+   bool begin(int width, int height, uint8_t *background);
+   const MotionResult &update(const uint8_t *gray);
+   const MotionResult &result() const { return res; }
+   const uint8_t *background() const { return bg; }
+   uint32_t changedMask(int blockRow) const { return changed[blockRow]; } // bit n: block column n
+   int width() const { return w; }
+   int height() const { return h; }
+   int blockColumns() const { return cols; }
+   int blockRows() const { return rows; }
+
+   // kernels, per byte of a word; public, so they can be checked and timed on the host
+   static uint32_t absDiff4(uint32_t a, uint32_t b);
+   static uint32_t average4(uint32_t a, uint32_t b); // rounded down
+   static uint32_t average4Up(uint32_t a, uint32_t b); // rounded up
+   // bg + (frame - bg) / 2^shift, rounded down or up
+   static uint32_t blend4(uint32_t bg, uint32_t frame, int shift, bool roundUp);
+
+private:
+   void compare(const uint8_t *gray);
+   void learn(const uint8_t *gray);
+   void track();
+
+   MotionConfig config;
+   uint8_t *bg = nullptr;
+   int w = 0;
+   int h = 0;
+   int cols = 0;
+   int rows = 0;
+   bool primed = false;  // background holds a frame
+   bool roundUp = false; // blend rounding, toggled every frame so the background has no bias
+   uint8_t runMotion = 0;
+   uint8_t runQuiet = 0;
+   uint32_t changed[MAX_HEIGHT / BLOCK];
+   MotionResult res = {};
+};
+
+#endif
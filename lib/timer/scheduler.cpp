@@ -0,0 +1,289 @@
+//-------------------
+// scheduler.cpp -- cooperative scheduler with a hierarchical timing wheel
+//
+// BSla, 19 oct 2026
+//
+
+#include "scheduler.h"
+
+#ifdef ARDUINO
+#include <Arduino.h>
+static portMUX_TYPE schedulerMux = portMUX_INITIALIZER_UNLOCKED;
+#define LOCK() portENTER_CRITICAL(&schedulerMux)
+#define UNLOCK() portEXIT_CRITICAL(&schedulerMux)
+
+uint32_t schedulerMillis()
+{
+  return millis();
+}
+
+Scheduler scheduler(schedulerMillis);
+#else
+#define LOCK()
+#define UNLOCK()
+#endif
+
+//--------------------
+Scheduler::Scheduler(SchedulerClock _clock) : clock(_clock)
+{
+  current = clock();
+  for (int i = 0; i < N_LISTS; i++)
+    heads[i] = NO_JOB;
+  for (int j = 0; j < MAX_JOBS; j++)
+    jobs[j].list = FREE;
+}
+
+//--------------------
+int Scheduler::every(uint32_t period, SchedulerCallback callback, void *context)
+{
+  if (period == 0)
+    period = 1;
+  return add(period, period, callback, context);
+}
+
+//--------------------
+int Scheduler::after(uint32_t delay, SchedulerCallback callback, void *context)
+{
+  return add(delay, 0, callback, context);
+}
+
+//--------------------
+int Scheduler::add(uint32_t delay, uint32_t period, SchedulerCallback callback, void *context)
+{
+  int id = NO_JOB;
+  LOCK();
+  for (int j = 0; j < MAX_JOBS; j++)
+  {
+    if (jobs[j].list == FREE)
+    {
+      jobs[j].callback = callback;
+      jobs[j].context = context;
+      jobs[j].due = clock() + delay;
+      jobs[j].period = period;
+      insert(j, false);
+      id = j;
+      break;
+    }
+  }
+  UNLOCK();
+  if (id != NO_JOB && !running)
+    wake();
+  return id;
+}
+
+//--------------------
+void Scheduler::wake()
+{
+  if (wakeFunction)
+    wakeFunction();
+}
+
+//--------------------
+void Scheduler::cancel(int id)
+{
+  if (id < 0 || id >= MAX_JOBS)
+    return;
+  LOCK();
+  if (jobs[id].list >= 0)
+    unlink(id);
+  jobs[id].list = FREE;
+  UNLOCK();
+}
+
+//--------------------
+bool Scheduler::isScheduled(int id)
+{
+  return id >= 0 && id < MAX_JOBS && jobs[id].list != FREE;
+}
+
+//--------------------
+int Scheduler::jobCount()
+{
+  int n = 0;
+  for (int j = 0; j < MAX_JOBS; j++)
+  {
+    if (jobs[j].list != FREE)
+      n++;
+  }
+  return n;
+}
+
+//--------------------
+int Scheduler::run()
+//
+// advance the wheel to now, from one occupied slot to the next
+{
+  uint32_t now = clock();
+  int nRun = 0;
+  running = true;
+  LOCK();
+  for (;;)
+  {
+    uint32_t t;
+    if (!nextEvent(t) || int32_t(t - now) > 0)
+    {
+      current = now;
+      break;
+    }
+    current = t;
+    cascade(t);
+
+    // all jobs in the level 0 slot of t are due
+    int list = t & (SLOTS - 1);
+    while (heads[list] != NO_JOB)
+    {
+      int j = heads[list];
+      unlink(j);
+      push(j, DUE_LIST);
+    }
+
+    while (heads[DUE_LIST] != NO_JOB)
+    {
+      int j = heads[DUE_LIST];
+      unlink(j);
+      jobs[j].list = RUNNING;
+      SchedulerCallback callback = jobs[j].callback;
+      void *context = jobs[j].context;
+      UNLOCK();
+      callback(context);
+      LOCK();
+      nRun++;
+      if (jobs[j].list != RUNNING) // cancelled by the callback, maybe even reused
+        continue;
+      if (jobs[j].period == 0)
+      {
+        jobs[j].list = FREE;
+        continue;
+      }
+      Job &job = jobs[j];
+      now = clock();
+      uint32_t next = job.due + job.period;
+      if (int32_t(next - now) <= 0)
+      {
+        // late: skip the missed periods, without running late
+        uint32_t late = (now - job.due) / job.period;
+        missed += late;
+        next = job.due + (late + 1) * job.period;
+      }
+      job.due = next;
+      insert(j, false);
+    }
+  }
+  UNLOCK();
+  running = false;
+  return nRun;
+}
+
+//--------------------
+uint32_t Scheduler::timeToNext(uint32_t limit)
+{
+  uint32_t t;
+  LOCK();
+  bool found = nextEvent(t);
+  UNLOCK();
+  if (!found)
+    return limit;
+  int32_t wait = int32_t(t - clock());
+  if (wait <= 0)
+    return 0;
+  return uint32_t(wait) < limit ? uint32_t(wait) : limit;
+}
+
+// -- private methods
+
+//--------------------
+void Scheduler::insert(int j, bool cascading)
+//
+// place job j in the wheel, relative to current
+// jobs that are already due go to the next tick, unless they come from a
+// higher level slot that is being cascaded right now
+{
+  int32_t delta = int32_t(jobs[j].due - current);
+  if (delta < 0 || (delta == 0 && !cascading))
+  {
+    push(j, (current + 1) & (SLOTS - 1));
+    return;
+  }
+  uint32_t at = jobs[j].due;
+  if (uint32_t(delta) > MAX_DELTA)
+    at = current + MAX_DELTA; // re-placed when that slot cascades
+  uint32_t d = at - current;
+  int level = 0;
+  while (level < LEVELS - 1 && d >= (1UL << (SLOT_BITS * (level + 1))))
+    level++;
+  int slot = (at >> (SLOT_BITS * level)) & (SLOTS - 1);
+  push(j, level * SLOTS + slot);
+}
+
+//--------------------
+void Scheduler::push(int j, int list)
+{
+  jobs[j].list = list;
+  jobs[j].prev = NO_JOB;
+  jobs[j].next = heads[list];
+  if (heads[list] != NO_JOB)
+    jobs[heads[list]].prev = j;
+  heads[list] = j;
+  if (list < DUE_LIST)
+    occupied[list / SLOTS] |= 1ULL << (list % SLOTS);
+}
+
+//--------------------
+void Scheduler::unlink(int j)
+{
+  int list = jobs[j].list;
+  if (jobs[j].prev != NO_JOB)
+    jobs[jobs[j].prev].next = jobs[j].next;
+  else
+    heads[list] = jobs[j].next;
+  if (jobs[j].next != NO_JOB)
+    jobs[jobs[j].next].prev = jobs[j].prev;
+  if (list < DUE_LIST && heads[list] == NO_JOB)
+    occupied[list / SLOTS] &= ~(1ULL << (list % SLOTS));
+}
+
+//--------------------
+bool Scheduler::nextEvent(uint32_t &t)
+//
+// level 0 slots hold jobs due in the next SLOTS ticks; a higher level slot
+// needs attention when the wheel reaches its start, to cascade its jobs down
+{
+  bool found = false;
+  uint32_t best = 0;
+  for (int level = 0; level < LEVELS; level++)
+  {
+    uint64_t bits = occupied[level];
+    if (bits == 0)
+      continue;
+    int shift = SLOT_BITS * level;
+    uint32_t index = current >> shift;
+    // rotate so that the slot after the current one is bit 0
+    int r = (index + 1) & (SLOTS - 1);
+    uint64_t rotated = r ? (bits >> r) | (bits << (SLOTS - r)) : bits;
+    uint32_t distance = __builtin_ctzll(rotated) + 1;
+    uint32_t at = (index + distance) << shift;
+    if (!found || at - current < best - current)
+      best = at;
+    found = true;
+  }
+  t = best;
+  return found;
+}
+
+//--------------------
+void Scheduler::cascade(uint32_t t)
+{
+  for (int level = LEVELS - 1; level > 0; level--)
+  {
+    int shift = SLOT_BITS * level;
+    if ((t & ((1UL << shift) - 1)) != 0)
+      continue;
+    int list = level * SLOTS + ((t >> shift) & (SLOTS - 1));
+    while (heads[list] != NO_JOB)
+    {
+      int j = heads[list];
+      unlink(j);
+      insert(j, true);
+    }
+  }
+}
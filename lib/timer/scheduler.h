@@ -0,0 +1,104 @@
+//-------------------
+// scheduler.h -- header file for the cooperative scheduler
+//
+// BSla, 19 oct 2026
+//
+// Runs registered callbacks at their due time, from loop ():
+//
+//    static void report (void *context) {...}
+//    int id = scheduler.every (1 MINUTE, report);  // periodic, first run after 1 minute
+//    scheduler.after (100 MILLISECONDS, done, this);  // once
+//    scheduler.cancel (id);
+//
+//    void loop () { scheduler.run (); }
+//
+// Jobs are kept in a hierarchical timing wheel: 4 levels of 64 slots, level n
+// slots are 64^n ticks wide, so deadlines up to 64^4 ticks (4.6 hours) ahead are
+// placed directly; later ones are re-placed when their slot comes round.
+// Each level has an occupancy bitmap, so run () jumps from one occupied slot
+// to the next: its cost depends on the number of jobs, not on the time that
+// passed since the previous call. A periodic job that missed periods is
+// rescheduled to its next period after now in one step; missedPeriods ()
+// counts the periods skipped that way.
+//
+// timeToNext () tells how long loop () may sleep before a job is due.
+// A job added by another task may be due earlier than that: add () then calls
+// the wake function (setWakeFunction ()), which should end the sleep.
+//
+// The clock is a function, so the scheduler runs on the host with a virtual
+// clock. On Arduino the global scheduler uses millis ().
+// Jobs may be added and cancelled from any task; run () should be called from
+// one task only. Callbacks run in that task, and may add or cancel jobs,
+// including themselves.
+
+#ifndef _SCHEDULER_H
+#define _SCHEDULER_H
+
+#include <stdint.h>
+
+typedef void (*SchedulerCallback)(void *context);
+typedef uint32_t (*SchedulerClock)();
+typedef void (*SchedulerWake)();
+
+class Scheduler
+{
+public:
+  static const int MAX_JOBS = 16;
+  static const int NO_JOB = -1;
+
+  Scheduler(SchedulerClock clock);
+  int every(uint32_t period, SchedulerCallback callback, void *context = nullptr); // job id, or NO_JOB if full
+  int after(uint32_t delay, SchedulerCallback callback, void *context = nullptr);  // job id, or NO_JOB if full
+  void cancel(int id);                         // cancel a job; ignores NO_JOB and finished jobs
+  bool isScheduled(int id);                    // is this job still pending (or running)?
+  int run();                                   // run all due jobs, return the number run
+  uint32_t timeToNext(uint32_t limit);         // ticks until the next job is due, at most limit
+  uint32_t missedPeriods() { return missed; }  // periods skipped by late periodic jobs
+  int jobCount();
+  void setWakeFunction(SchedulerWake w) { wakeFunction = w; }
+  void wake();                                 // end the sleep of the task that calls run ()
+
+private:
+  static const int SLOT_BITS = 6;
+  static const int SLOTS = 1 << SLOT_BITS;
+  static const int LEVELS = 4;
+  static const uint32_t MAX_DELTA = (1UL << (SLOT_BITS * LEVELS)) - 1;
+  static const int DUE_LIST = LEVELS * SLOTS; // jobs to run in this step of run ()
+  static const int N_LISTS = DUE_LIST + 1;
+  static const int16_t FREE = -1;             // job not in use
+  static const int16_t RUNNING = -2;          // callback being called
+
+  struct Job
+  {
+    SchedulerCallback callback;
+    void *context;
+    uint32_t due;    // clock value
+    uint32_t period; // 0 for a single shot
+    int16_t list;    // wheel slot (level * SLOTS + slot), DUE_LIST, FREE or RUNNING
+    int8_t prev;
+    int8_t next;
+  };
+
+  int add(uint32_t delay, uint32_t period, SchedulerCallback callback, void *context);
+  void insert(int j, bool cascading);
+  void push(int j, int list);
+  void unlink(int j);
+  bool nextEvent(uint32_t &t);  // first tick after current with work to do
+  void cascade(uint32_t t);     // re-place the jobs of higher level slots that start at t
+
+  SchedulerClock clock;
+  SchedulerWake wakeFunction = nullptr;
+  volatile bool running = false; // in run (): new jobs are seen by the next timeToNext ()
+  uint32_t current;             // all ticks up to and including current have been handled
+  uint32_t missed = 0;
+  uint64_t occupied[LEVELS] = {};
+  int8_t heads[N_LISTS];
+  Job jobs[MAX_JOBS];
+};
+
+#ifdef ARDUINO
+extern uint32_t schedulerMillis(); // SchedulerClock based on millis ()
+extern Scheduler scheduler;
+#endif
+
+#endif
@@ -5,6 +5,7 @@
 //
 // Arduino based implementation using millis () function
 
+#ifdef ARDUINO // the scheduler in this library is also built on the host, for its tests
 #include "timer.h"
 
 //--------------------
@@ -105,10 +106,8 @@ void Timer::restart()
 {
   if (hasExpired())
   {
-    while (timeSinceStart() >= pPeriod)
-    {
-      startAt += pPeriod;
-    }
+    // skip all periods that passed, in one step
+    startAt += (timeSinceStart() / pPeriod) * pPeriod;
     pExpired = false;
     pActive = true;
   }
@@ -129,11 +128,12 @@ bool Timer::isActive()
 //--------------------------
 void Timer::delay(timeType period)
 //
-// delay a fixed period, burning CPU cycles
+// delay a fixed period; the task sleeps, so other tasks and the idle task run
 {
   start(period);
   while (!hasExpired())
   {
-    // delay
+    ::delay(1 + pPeriod - timeSinceStart());
   }
 }
+#endif // ARDUINO
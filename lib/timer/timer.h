@@ -49,7 +49,7 @@ typedef uint32_t timeType;
 // void stop       ()                stops a Timer, irrespective of its state. Clear expired bit
 // void isActive   ()                tests if the timer is started but not expired
 // bool hasExpired ()                tests if the timer has expired.
-// void delay      (timeType period) delays (busy form of waiting)
+// void delay      (timeType period) delays (the task sleeps)
 // timeType timeSinceStart ()        returns expired time since the timer was started
 //
 // You can instantiate as many Timers as needed. The basic tick count is shared by all Timers.
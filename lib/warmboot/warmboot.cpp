@@ -0,0 +1,90 @@
+//
+// warmboot.cpp -- state that survives a warm reset, in RTC slow memory
+//
+// BSla, 19 oct 2026
+
+#include "esp_attr.h"
+#include "esp_system.h"
+#include "esp_rom_crc.h"
+#include "warmboot.h"
+
+#define _DEBUG 1
+#include "debug.h"
+
+#define WARM_MAGIC (0x57524D42) // "WRMB"
+
+struct WarmBlock {
+   uint32_t  magic;
+   uint32_t  size;    // sizeof (WarmState): a changed layout invalidates the block
+   WarmState s;
+   uint32_t  crc;     // of magic, size and s
+};
+
+static RTC_NOINIT_ATTR WarmBlock block;
+static portMUX_TYPE warmLock = portMUX_INITIALIZER_UNLOCKED;
+
+WarmBoot warmBoot;
+
+static uint32_t blockCrc()
+{
+   return esp_rom_crc32_le(0, (const uint8_t *)&block, offsetof(WarmBlock, crc));
+}
+
+void WarmBoot::setup()
+{
+   esp_reset_reason_t r = esp_reset_reason();
+   bool warmReset = r == ESP_RST_SW || r == ESP_RST_PANIC || r == ESP_RST_INT_WDT || r == ESP_RST_TASK_WDT ||
+                    r == ESP_RST_WDT || r == ESP_RST_BROWNOUT || r == ESP_RST_DEEPSLEEP || r == ESP_RST_EXT;
+   bool good = block.magic == WARM_MAGIC && block.size == sizeof(WarmState) && block.crc == blockCrc();
+   warm = warmReset && good;
+   if (!warm)
+   {
+      memset(&block, 0, sizeof(block));
+      block.magic = WARM_MAGIC;
+      block.size = sizeof(WarmState);
+      block.crc = blockCrc();
+   }
+   LOG("Reset reason %s: %s boot%s\n", resetReason(), warm ? "warm" : "cold",
+       warmReset && !good ? " (RTC state block not valid)" : "");
+}
+
+const char *WarmBoot::resetReason()
+{
+   switch (esp_reset_reason())
+   {
+   case ESP_RST_POWERON:   return "power on";
+   case ESP_RST_EXT:       return "external";
+   case ESP_RST_SW:        return "software";
+   case ESP_RST_PANIC:     return "panic";
+   case ESP_RST_INT_WDT:   return "interrupt watchdog";
+   case ESP_RST_TASK_WDT:  return "task watchdog";
+   case ESP_RST_WDT:       return "watchdog";
+   case ESP_RST_DEEPSLEEP: return "deep sleep";
+   case ESP_RST_BROWNOUT:  return "brownout";
+   case ESP_RST_SDIO:      return "SDIO";
+   default:                return "unknown";
+   }
+}
+
+const WarmState &WarmBoot::state()
+{
+   return block.s;
+}
+
+WarmState &WarmBoot::beginUpdate()
+{
+   portENTER_CRITICAL(&warmLock);
+   return block.s;
+}
+
+void WarmBoot::endUpdate()
+{
+   block.crc = blockCrc();
+   portEXIT_CRITICAL(&warmLock);
+}
+
+void WarmBoot::copy(char *dest, size_t size, const char *src)
+{
+   strncpy(dest, src, size - 1);
+   dest[size - 1] = '\0';
+}
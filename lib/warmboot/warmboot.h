@@ -0,0 +1,84 @@
+//
+// warmboot.h -- state that survives a warm reset, in RTC slow memory
+//
+// After a software restart, watchdog, panic or brownout reset the RTC slow
+// memory keeps its contents. The block below holds what the firmware would
+// otherwise read from flash again: the shutter position and settings, the site
+// settings, the WiFi credentials and link parameters, and the camera config.
+// It is protected by a magic number, its size and a CRC32.
+//
+// setup () checks the reset reason and the block. On a warm boot with a good
+// block, isWarm () is true and every subsystem takes its state from the block,
+// for every section that is marked valid. Otherwise the block is cleared and the
+// subsystems fill it on their normal (flash) path, for the next warm boot.
+//
+// Changes are made between beginUpdate () and endUpdate (), which recomputes the
+// CRC. That is a short critical section: do not log or touch flash in between.
+//
+// BSla, 19 oct 2026
+
+#ifndef _WARMBOOT_H
+#define _WARMBOOT_H
+
+#include <Arduino.h>
+
+#define WARM_SITE_LEN     (48)
+#define WARM_COMMENT_LEN  (96)
+#define WARM_SSID_LEN     (33)
+#define WARM_PASSWORD_LEN (65)
+
+struct WarmState {
+   // shutter, positions in us
+   bool     shutterValid;
+   int32_t  openPosition;
+   int32_t  closedPosition;
+   int32_t  endPosition;
+   int32_t  currentPosition;   // updated every step, so a move that was cut off can be finished
+   uint32_t speed;             // us per second
+   uint32_t nShutterMoves;
+   // site settings
+   bool     siteValid;
+   bool     commentValid;
+   char     site[WARM_SITE_LEN];
+   char     comment[WARM_COMMENT_LEN];
+   // WiFi
+   bool     credentialsValid;
+   char     ssid[WARM_SSID_LEN];
+   char     password[WARM_PASSWORD_LEN];
+   bool     linkValid;
+   char     linkSsid[WARM_SSID_LEN]; // network the link parameters belong to
+   uint8_t  bssid[6];
+   int32_t  channel;
+   uint32_t ip;                // from the DHCP lease
+   uint32_t gateway;
+   uint32_t mask;
+   uint32_t dns;
+   uint32_t leaseStart;        // time () of the DHCP ack; the system time survives a warm reset
+   uint32_t leaseSeconds;      // lease time from the DHCP server, 0 if unknown
+   // camera
+   bool     cameraValid;
+   int32_t  frameSize;
+   int32_t  jpegQuality;
+   int32_t  fbCount;
+   bool     vflip;
+   bool     hmirror;
+};
+
+class WarmBoot {
+  public:
+   WarmBoot () {}
+   void setup ();                    // call first in setup ()
+   bool isWarm ()                    {return warm;}
+   const char *resetReason ();
+   const WarmState &state ();        // read only
+   WarmState &beginUpdate ();
+   void endUpdate ();
+   // copy a string into a WarmState field, truncated if needed
+   static void copy (char *dest, size_t size, const char *src);
+  private:
+   bool warm = false;
+};
+
+extern WarmBoot warmBoot;
+
+#endif
@@ -3,51 +3,190 @@
 //
 // BSla, 28 aug 2023
 // 07 05 2024 BSla 'fold' the chip ID into 16 bits, instead of using only the lowest 16
+// 19 10 2026 BSla non-blocking state machine; AP and STA concurrently
 
+#include <time.h>
 #include <Preferences.h>
 #include <DNSServer.h>
+#include "esp_wifi.h"
+#include "esp_netif.h"
+#include "esp_netif_net_stack.h"
+#include "lwip/dhcp.h"
+#include "scheduler.h"
+#include "warmboot.h"
+#include "heapscope.h"
 #include "myWifi.h"
 
 #define MAX_CONNECTIONS 2
 
+#define CONNECT_TIMEOUT (15 SECONDS) // WiFi.begin to IP address
+#define CACHED_CONNECT_TIMEOUT (5 SECONDS) // idem, with cached link parameters
+#define RETRY_MIN (2 SECONDS)        // first retry backoff
+#define RETRY_MAX (2 MINUTES)        // longest retry backoff
+#define SWITCH_TRIES (2)             // failed connects before a network switch is abandoned
+#define DISCONNECT_WAIT (200)        // ms to wait for the event of WiFi.disconnect ()
+#define AP_LINGER (1 MINUTE)          // AP stays up this long after the station connected and the AP is unused
+#define SCAN_INTERVAL (15 MINUTES)       // channel scan interval while the AP is unused
+#define MAX_SCAN_RESULTS (32)
+#define SCAN_DWELL (120)                // ms per channel; 13 channels take about 1.6 s
+#define POWER_DOWN_DELAY (10 SECONDS)   // activity must be lower this long before saving more power
+#define LISTEN_INTERVAL (10)             // beacons between wake-ups in max modem sleep
+
+// estimated average current of the module (radio and CPU) per power mode, mA
+static const uint32_t modeCurrent[MyWifi::N_POWER_MODES] = {160, 70, 40};
+
 #define _DEBUG 1
 #include "debug.h"
 
 static Preferences preferences;
 
+// set by the WiFi event task, handled in loop ()
+static volatile bool gotIP = false;
+static volatile bool lostLink = false;
+static volatile bool staDown = false; // a DISCONNECTED event came since the last WiFi.begin
+
 MyWifi myWifi;
 
-String MyWifi::mySSID()
+static uint32_t dhcpLeaseSeconds()
+// the lease time of the DHCP server, 0 if unknown
 {
-   preferences.begin("Site", true); // name, read-only
-   String s(preferences.getString("SSID", ""));
-   preferences.end();
-   return s;
+   esp_netif_t *sta = esp_netif_get_handle_from_ifkey("WIFI_STA_DEF");
+   struct netif *lwipNetif = sta ? (struct netif *)esp_netif_get_netif_impl(sta) : nullptr;
+   struct dhcp *dhcp = lwipNetif ? netif_dhcp_data(lwipNetif) : nullptr;
+   return dhcp ? dhcp->offered_t0_lease : 0;
+}
+
+Ssid MyWifi::mySSID()
+{
+   loadCredentials();
+   return Ssid(warmBoot.state().ssid);
+}
+
+Ssid MyWifi::stationSSID()
+// the SSID the station is configured with, from the driver; WiFi.SSID () returns a String
+{
+   wifi_config_t conf;
+   if (esp_wifi_get_config(WIFI_IF_STA, &conf) != ESP_OK)
+      return Ssid();
+   const char *s = (const char *)conf.sta.ssid; // not '\0' terminated when it is 32 characters
+   return Ssid(StringView(s, strnlen(s, sizeof(conf.sta.ssid))));
 }
 
-String MyWifi::myPassword()
+Password MyWifi::myPassword()
 {
+   loadCredentials();
+   return Password(warmBoot.state().password);
+}
+
+static void readString(const char *key, FixedStringBase &value)
+// from the open preferences, without a String on the heap; empty if absent or too long
+{
+   size_t n = preferences.getString(key, value.buffer(), value.capacity() + 1); // incl. the '\0'; 0 on failure
+   value.setLength(n > 0 ? n - 1 : 0);
+}
+
+void MyWifi::loadCredentials()
+// the credentials are kept in RTC memory; flash is only read when they are not there
+{
+   if (warmBoot.state().credentialsValid)
+      return;
+   Ssid s;
+   Password p;
    preferences.begin("Site", true); // name, read-only
-   String s(preferences.getString("Password", ""));
+   readString("SSID", s);
+   readString("Password", p);
    preferences.end();
-   return s;
+   WarmState &w = warmBoot.beginUpdate();
+   WarmBoot::copy(w.ssid, sizeof(w.ssid), s.c_str());
+   WarmBoot::copy(w.password, sizeof(w.password), p.c_str());
+   w.credentialsValid = true;
+   warmBoot.endUpdate();
 }
 
-void MyWifi::setSSID(String s)
+void MyWifi::setSSID(const char *s)
 {
    preferences.begin("Site", false);
    preferences.putString("SSID", s);
    preferences.end();
+   warmBoot.beginUpdate().credentialsValid = false; // reloaded on the next read
+   warmBoot.endUpdate();
 }
 
-void MyWifi::setPassword(String s)
+void MyWifi::setPassword(const char *s)
 {
    preferences.begin("Site", false);
    preferences.putString("Password", s);
    preferences.end();
+   warmBoot.beginUpdate().credentialsValid = false;
+   warmBoot.endUpdate();
+}
+
+const char *MyWifi::stateName()
+{
+   return (state == NoCredentials ? "NoCredentials"
+           : state == Connecting  ? "Connecting"
+           : state == Connected   ? "Connected"
+           : state == WaitRetry   ? "WaitRetry"
+                                  : "ILLEGAL STATE");
+}
+
+const char *MyWifi::switchStateName()
+{
+   SwitchState s = getSwitchState();
+   return (s == SwitchIdle        ? "Idle"
+           : s == SwitchTrying    ? "Trying"
+           : s == SwitchSucceeded ? "Succeeded"
+           : s == SwitchFailed    ? "Failed"
+                                  : "ILLEGAL STATE");
+}
+
+void MyWifi::changeNetwork(const char *newSSID, const char *newPassword)
+// try to connect with new credentials, keeping the access point up.
+// Called from the http server task: only hand them over, loop () makes the switch.
+// They are persisted in loop () once the station is connected.
+{
+   LOG("WiFi: switch to network %s\n", newSSID);
+   portENTER_CRITICAL(&switchLock);
+   pendingSSID = newSSID;
+   pendingPassword = newPassword;
+   switchPending = true;
+   portEXIT_CRITICAL(&switchLock);
+   scheduler.wake();
 }
 
-String MyWifi::makeSSID()
+void MyWifi::startSwitch()
+// loop (): the credentials from changeNetwork ()
+{
+   Ssid newSSID;
+   Password newPassword;
+   portENTER_CRITICAL(&switchLock);
+   newSSID = pendingSSID;
+   newPassword = pendingPassword;
+   switchPending = false;
+   portEXIT_CRITICAL(&switchLock);
+
+   if (switchState != SwitchTrying)
+   {
+      previousSSID = ssid;
+      previousPassword = password;
+   }
+   ssid = newSSID;
+   password = newPassword;
+   switchState = SwitchTrying;
+   switchTries = 0;
+   retries = 0;
+   backoff = 0;
+   cache.valid = false; // the cache belongs to the previous network
+   if (!apUp)
+   {
+      WiFi.mode(WIFI_AP_STA);
+      setupAsAccessPoint();
+   }
+   disconnectStation();
+   startConnect();
+}
+
+Ssid MyWifi::makeSSID()
 {
    uint64_t chipID = ESP.getEfuseMac();
 
@@ -58,33 +197,25 @@ String MyWifi::makeSSID()
       chip16 = chip16 ^ uint16_t((chipID >> i) & 0xffff);
    }
 
-   String SSID("Birdcam-");
-   SSID += String(chip16, 16);
+   Ssid SSID;
+   SSID.format("Birdcam-%x", unsigned(chip16));
    return SSID;
 }
 
-String ip2str(const IPAddress ip)
+IpString ip2str(const IPAddress ip)
 {
-   String result;
-   uint32_t ipu = ip;
-   for (int i = 0; i < 4; i++)
-   {
-      result += (int(ipu & 0xFF));
-      ipu = ipu >> 8;
-      if (i < 3)
-         result += '.';
-   }
+   uint32_t ipu = ip; // first octet in the lowest byte
+   IpString result;
+   result.format("%u.%u.%u.%u", unsigned(ipu & 0xFF), unsigned((ipu >> 8) & 0xFF), unsigned((ipu >> 16) & 0xFF),
+                 unsigned(ipu >> 24));
    return result;
 }
 
 bool MyWifi::setupAsAccessPoint()
 {
-   WiFi.mode(WIFI_AP);
-   WiFi.softAP(makeSSID().c_str());
+   WiFi.softAP(makeSSID().c_str(), nullptr, apChannel);
    // WiFi.softAP (makeSSID ().c_str (), password,MAX_CONNECTIONS);
 
-   delay(100);
-
    LOG("Set softAPConfig\n");
    IPAddress Ip(192, 168, 1, 1);
    IPAddress NMask(255, 255, 255, 0);
@@ -93,65 +224,441 @@ bool MyWifi::setupAsAccessPoint()
    // IPAddress secundaryDNS (8,8,4,4);
    WiFi.softAPConfig(Ip, Ip, NMask);
    IPAddress myIP = WiFi.softAPIP();
-   LOG("Accesspoint IP address = %s\n", ip2str(myIP).c_str());
+   LOG("Accesspoint IP address = %s, channel %d\n", ip2str(myIP).c_str(), apChannel);
+   apUp = true;
    return true;
 }
 
-bool MyWifi::setupAsClient(int nTries)
+void MyWifi::stopAccessPoint()
 {
-   LOG("Setup as client; %d tries", nTries);
-   // connect to Wi-Fi
-   bool connected = false;
-   int waitCount = 0;
-   String ssid = mySSID();
-   String password = myPassword();
-   if (ssid.length() > 0 && password.length() > 0)
+   LOG("Station connected and access point unused: stop access point\n");
+   WiFi.softAPdisconnect(true);
+   WiFi.mode(WIFI_STA);
+   apUp = false;
+}
+
+void MyWifi::disconnectStation()
+// WiFi.disconnect (), and wait for the DISCONNECTED event it causes; coming
+// after startConnect (), that event would fail the next attempt at once
+{
+   bool down = staDown;
+   WiFi.disconnect();
+   uint32_t start = millis();
+   while (!down && !staDown && millis() - start < DISCONNECT_WAIT)
+      delay(5);
+   lostLink = false;
+}
+
+void MyWifi::startConnect()
+{
+   gotIP = false;
+   lostLink = false;
+   staDown = false;
+   usingCache = cache.valid;
+   staticLease = usingCache && leaseValid();
+   connectStartedAt = millis();
+   if (usingCache)
+   {
+      LOG("Try %d as client, network %s, cached channel %d, IP %s\n", retries + 1, ssid.c_str(),
+          (int)cache.channel, staticLease ? ip2str(IPAddress(cache.ip)).c_str() : "by DHCP");
+      if (staticLease)
+         WiFi.config(IPAddress(cache.ip), IPAddress(cache.gateway), IPAddress(cache.mask), IPAddress(cache.dns));
+      else
+         WiFi.config(INADDR_NONE, INADDR_NONE, INADDR_NONE); // DHCP
+      HeapScope scope(SubsysWifi);
+      WiFi.begin(ssid.c_str(), password.c_str(), cache.channel, cache.bssid);
+      stateTimer.start(CACHED_CONNECT_TIMEOUT);
+   }
+   else
    {
-      for (int i = 0; i < nTries; i++)
+      LOG("Try %d as client, network %s, full scan\n", retries + 1, ssid.c_str());
+      WiFi.config(INADDR_NONE, INADDR_NONE, INADDR_NONE); // DHCP
+      HeapScope scope(SubsysWifi);
+      WiFi.begin(ssid.c_str(), password.c_str());
+      stateTimer.start(CONNECT_TIMEOUT);
+   }
+   state = Connecting;
+}
+
+void MyWifi::scheduleRetry()
+{
+   if (state == Connecting && usingCache)
+   {
+      // the cached parameters are stale: retry at once with a full scan
+      WARNING("WiFi: connect with cached parameters failed; full scan\n");
+      clearCache();
+      disconnectStation();
+      startConnect();
+      return;
+   }
+   if (state == Connecting && switchState == SwitchTrying && ++switchTries >= SWITCH_TRIES)
+   {
+      WARNING("WiFi: cannot connect to %s; back to the previous network\n", ssid.c_str());
+      switchState = SwitchFailed;
+      ssid = previousSSID;
+      password = previousPassword;
+      retries = 0;
+      backoff = 0;
+      disconnectStation();
+      if (ssid.length() > 0 && password.length() > 0)
       {
-         LOG("\nTry %d as client, network %s  ", i + 1, ssid.c_str());
-         WiFi.begin(ssid, password); // from credentials.h
-         while (!connected && waitCount++ < 10)
-         {
-            connected = (WiFi.status() == WL_CONNECTED);
-            if (!connected)
-            {
-               delay(500);
-               LOG(".");
-            }
-         }
-         if (connected)
-         {
-            break; // the for-loop
-         }
-         else
-         {
-            waitCount = 0;
-         }
+         loadCache();
+         startConnect();
       }
+      else
+         state = NoCredentials;
+      return;
+   }
+
+   retries++;
+   backoff = (backoff == 0) ? RETRY_MIN : backoff * 2;
+   if (backoff > RETRY_MAX)
+      backoff = RETRY_MAX;
+   LOG("WiFi: no connection; retry in %u s\n", (unsigned)(backoff / 1000));
+   WiFi.disconnect();
+   state = WaitRetry;
+   stateTimer.start(backoff);
+   if (!apUp)
+   {
+      WiFi.mode(WIFI_AP_STA);
+      setupAsAccessPoint();
    }
-   return connected;
 }
 
-void MyWifi::setup()
+void MyWifi::loadCache()
+// from RTC memory after a warm boot, from flash otherwise. Flash has no lease:
+// after a cold boot the time since the DHCP ack is not known
 {
-   LOG("myWifi setup\n");
-   bool connected = false;
-   // connect to Wi-Fi net
-   while (!connected)
+   const WarmState &w = warmBoot.state();
+   if (w.linkValid && ssid == w.linkSsid)
+   {
+      cache.valid = true;
+      memcpy(cache.bssid, w.bssid, sizeof(cache.bssid));
+      cache.channel = w.channel;
+      cache.ip = w.ip;
+      cache.gateway = w.gateway;
+      cache.mask = w.mask;
+      cache.dns = w.dns;
+      cache.leaseStart = w.leaseStart;
+      cache.leaseSeconds = w.leaseSeconds;
+      return;
+   }
+
+   Ssid cachedSsid;
+   preferences.begin("WifiCache", true); // name, read-only
+   readString("SSID", cachedSsid);
+   cache.valid = preferences.getBool("Valid", false) &&
+                 cachedSsid == ssid &&
+                 preferences.getBytes("BSSID", cache.bssid, sizeof(cache.bssid)) == sizeof(cache.bssid);
+   cache.channel = preferences.getInt("Channel", 0);
+   cache.ip = cache.gateway = cache.mask = cache.dns = 0;
+   cache.leaseStart = cache.leaseSeconds = 0;
+   preferences.end();
+   if (cache.channel <= 0)
+      cache.valid = false;
+   if (cache.valid)
+      saveWarmCache();
+}
+
+void MyWifi::saveWarmCache()
+{
+   WarmState &w = warmBoot.beginUpdate();
+   WarmBoot::copy(w.linkSsid, sizeof(w.linkSsid), ssid.c_str());
+   memcpy(w.bssid, cache.bssid, sizeof(w.bssid));
+   w.channel = cache.channel;
+   w.ip = cache.ip;
+   w.gateway = cache.gateway;
+   w.mask = cache.mask;
+   w.dns = cache.dns;
+   w.leaseStart = cache.leaseStart;
+   w.leaseSeconds = cache.leaseSeconds;
+   w.linkValid = true;
+   warmBoot.endUpdate();
+}
+
+void MyWifi::saveCache()
+// remember the parameters of the current link. The lease is renewed only by a
+// connect with DHCP; a connect with the cached address keeps the old one.
+// RTC memory is updated on every connect, flash only when BSSID or channel changed
+{
+   LinkCache c = cache;
+   c.valid = true;
+   memcpy(c.bssid, WiFi.BSSID(), sizeof(c.bssid));
+   c.channel = WiFi.channel();
+   if (!staticLease)
    {
-      connected = setupAsClient(6);
-      if (connected)
+      c.ip = WiFi.localIP();
+      c.gateway = WiFi.gatewayIP();
+      c.mask = WiFi.subnetMask();
+      c.dns = WiFi.dnsIP();
+      c.leaseStart = time(nullptr);
+      c.leaseSeconds = dhcpLeaseSeconds();
+   }
+   bool linkChanged = !cache.valid || memcmp(c.bssid, cache.bssid, sizeof(c.bssid)) != 0 || c.channel != cache.channel;
+   cache = c;
+   saveWarmCache();
+   if (!linkChanged)
+      return;
+
+   preferences.begin("WifiCache", false);
+   preferences.putBool("Valid", true);
+   preferences.putString("SSID", ssid.c_str());
+   preferences.putBytes("BSSID", cache.bssid, sizeof(cache.bssid));
+   preferences.putInt("Channel", cache.channel);
+   preferences.end();
+   LOG("WiFi: link parameters cached, channel %d\n", (int)cache.channel);
+}
+
+void MyWifi::clearCache()
+{
+   cache.valid = false;
+   warmBoot.beginUpdate().linkValid = false;
+   warmBoot.endUpdate();
+   preferences.begin("WifiCache", false);
+   preferences.putBool("Valid", false);
+   preferences.end();
+}
+
+bool MyWifi::leaseValid()
+// the cached address may be used without DHCP until half the lease, when a DHCP
+// client would renew it. A clock that was set (SNTP) or went back ends it too
+{
+   uint32_t now = time(nullptr);
+   return cache.valid && cache.ip != 0 && cache.leaseSeconds > 0 && now - cache.leaseStart < cache.leaseSeconds / 2;
+}
+
+void MyWifi::scanLoop()
+// scan for networks and move the access point to the best channel.
+// Only when the station does not use the radio and nobody uses the AP.
+{
+   if (scanning)
+   {
+      int n;
       {
-         LOG("\nWiFi connected. IP address = %s\n", ip2str(WiFi.localIP()).c_str());
+         HeapScope scope(SubsysWifi);
+         n = WiFi.scanComplete();
       }
-      else
+      if (n == WIFI_SCAN_RUNNING)
+         return;
+      scanning = false;
+      scanTimer.start(SCAN_INTERVAL);
+      if (n < 0)
       {
-         connected = setupAsAccessPoint();
+         WARNING("WiFi: channel scan failed\n");
+         return;
       }
+
+      ScanResult results[MAX_SCAN_RESULTS];
+      int nResults = n < MAX_SCAN_RESULTS ? n : MAX_SCAN_RESULTS;
+      for (int i = 0; i < nResults; i++)
+      {
+         results[i].channel = WiFi.channel(i);
+         results[i].rssi = WiFi.RSSI(i);
+      }
+      WiFi.scanDelete(); // not scoped: the WiFi event task allocated the results, outside any scope
+      int best = chooseChannel(results, nResults, apChannel, channelCosts);
+      LOG("WiFi: %d networks; cost channel 1: %u, 6: %u, 11: %u\n", n,
+          (unsigned)channelCosts[0], (unsigned)channelCosts[1], (unsigned)channelCosts[2]);
+      if (best != apChannel && apUp && state != Connected && WiFi.softAPgetStationNum() == 0)
+      {
+         LOG("WiFi: move access point from channel %d to %d\n", apChannel, best);
+         apChannel = best;
+         setupAsAccessPoint();
+      }
+   }
+   else if (apUp && (state == NoCredentials || state == WaitRetry) &&
+            WiFi.softAPgetStationNum() == 0 && !scanTimer.isActive())
+   {
+      HeapScope scope(SubsysWifi);
+      scanning = WiFi.scanNetworks(true, false, false, SCAN_DWELL) == WIFI_SCAN_RUNNING; // async
+      if (!scanning)
+         scanTimer.start(SCAN_INTERVAL);
+   }
+}
+
+const char *MyWifi::powerModeName(PowerMode m)
+{
+   return (m == PowerNone       ? "None"
+           : m == PowerModem    ? "Modem"
+           : m == PowerMaxModem ? "MaxModem"
+                                : "ILLEGAL MODE");
+}
+
+void MyWifi::setActivity(int streams, bool controlClients)
+{
+   wantedMode = (streams > 0)                                            ? PowerNone
+                : (controlClients || (apUp && WiFi.softAPgetStationNum() > 0)) ? PowerModem
+                                                                         : PowerMaxModem;
+}
+
+void MyWifi::powerLoop()
+// more activity: switch at once; less activity: only after POWER_DOWN_DELAY
+{
+   if (wantedMode < powerMode)
+   {
+      setPowerMode(wantedMode);
+      powerDownTimer.stop();
+   }
+   else if (wantedMode > powerMode)
+   {
+      if (!powerDownTimer.isActive() && !powerDownTimer.hasExpired())
+         powerDownTimer.start(POWER_DOWN_DELAY);
+      else if (powerDownTimer.hasExpired())
+      {
+         setPowerMode(wantedMode);
+         powerDownTimer.stop();
+      }
+   }
+   else
+      powerDownTimer.stop();
+}
+
+void MyWifi::setPowerMode(PowerMode m)
+{
+   static const wifi_ps_type_t psType[N_POWER_MODES] = {WIFI_PS_NONE, WIFI_PS_MIN_MODEM, WIFI_PS_MAX_MODEM};
+   if (m == PowerMaxModem)
+   {
+      // the listen interval takes effect at the next association
+      wifi_config_t conf;
+      if (esp_wifi_get_config(WIFI_IF_STA, &conf) == ESP_OK && conf.sta.listen_interval != LISTEN_INTERVAL)
+      {
+         conf.sta.listen_interval = LISTEN_INTERVAL;
+         esp_wifi_set_config(WIFI_IF_STA, &conf);
+      }
+   }
+   if (esp_wifi_set_ps(psType[m]) == ESP_OK)
+   {
+      uint32_t now = millis();
+      modeTime[powerMode] += now - modeSince;
+      modeSince = now;
+      LOG("WiFi: power save %s -> %s\n", powerModeName(powerMode), powerModeName(m));
+      powerMode = m;
+      powerTransitions++;
+   }
+}
+
+uint32_t MyWifi::getTimeInMode(PowerMode m)
+{
+   uint32_t t = modeTime[m];
+   if (m == powerMode)
+      t += millis() - modeSince;
+   return t / 1000;
+}
+
+uint32_t MyWifi::getEstimatedCurrent()
+{
+   uint64_t mAms = 0; // mA * ms
+   uint32_t total = 0;
+   for (int m = 0; m < N_POWER_MODES; m++)
+   {
+      uint32_t t = modeTime[m] + (m == powerMode ? millis() - modeSince : 0);
+      mAms += uint64_t(modeCurrent[m]) * t;
+      total += t;
+   }
+   return total ? uint32_t(mAms / total) : modeCurrent[powerMode];
+}
+
+void MyWifi::onEvent(arduino_event_id_t event, arduino_event_info_t info)
+// runs in the WiFi event task: only set flags, and wake up loop ()
+{
+   if (event == ARDUINO_EVENT_WIFI_STA_GOT_IP)
+      gotIP = true;
+   else if (event == ARDUINO_EVENT_WIFI_STA_DISCONNECTED || event == ARDUINO_EVENT_WIFI_STA_LOST_IP)
+      lostLink = true;
+   if (event == ARDUINO_EVENT_WIFI_STA_DISCONNECTED)
+      staDown = true;
+   scheduler.wake();
+}
+
+void MyWifi::setup()
+// returns at once; the access point is up, the station connects in the background
+{
+   LOG("myWifi setup\n");
+   WiFi.persistent(false);      // credentials are kept in our own preferences
+   WiFi.setAutoReconnect(false); // loop () does the retrying
+   WiFi.onEvent(onEvent);
+   {
+      HeapScope scope(SubsysWifi); // the driver
+      WiFi.mode(WIFI_AP_STA);
+   }
+   setupAsAccessPoint();
+
+   ssid = mySSID();
+   password = myPassword();
+   if (ssid.length() > 0 && password.length() > 0)
+   {
+      // first the channel scan in scanLoop (): the station cannot connect while it
+      // runs. WaitRetry starts the connect as soon as the scan is done.
+      loadCache();
+      state = WaitRetry;
+      stateTimer.start(1 MILLISECOND);
    }
-   if (!connected)
+   else
    {
-      LOG("\nWifi NOT connected!\n");
+      LOG("No WiFi network configured; access point only\n");
+      state = NoCredentials;
    }
-}
\ No newline at end of file
+}
+
+void MyWifi::loop()
+{
+   if (switchPending)
+      startSwitch();
+   scanLoop();
+   powerLoop();
+   switch (state)
+   {
+   case NoCredentials:
+      break;
+
+   case Connecting:
+      if (gotIP)
+      {
+         connectTime = millis() - connectStartedAt;
+         LOG("\nWiFi connected in %u ms (%s). IP address = %s\n", (unsigned)connectTime,
+             usingCache ? "cached link parameters" : "full scan", ip2str(WiFi.localIP()).c_str());
+         if (switchState == SwitchTrying)
+         {
+            // the new credentials work: now they may be stored
+            setSSID(ssid.c_str());
+            setPassword(password.c_str());
+            switchState = SwitchSucceeded;
+         }
+         saveCache();
+         state = Connected;
+         retries = 0;
+         backoff = 0;
+         stateTimer.start(AP_LINGER);
+      }
+      else if (lostLink || stateTimer.hasExpired())
+         scheduleRetry();
+      break;
+
+   case Connected:
+      if (lostLink)
+      {
+         WARNING("WiFi link lost\n");
+         backoff = 0;
+         scheduleRetry();
+      }
+      else if (staticLease && !leaseValid())
+      {
+         LOG("WiFi: cached address %s at half its lease; reconnect with DHCP\n", ip2str(WiFi.localIP()).c_str());
+         disconnectStation();
+         startConnect();
+      }
+      else if (apUp && stateTimer.hasExpired())
+      {
+         if (WiFi.softAPgetStationNum() == 0)
+            stopAccessPoint();
+         else
+            stateTimer.start(AP_LINGER);
+      }
+      break;
+
+   case WaitRetry:
+      if (stateTimer.hasExpired() && !scanning)
+         startConnect();
+      break;
+   }
+}
@@ -1,31 +1,157 @@
 //
 // mywifi.h -- wifi for birdcam
 //
+// The access point and the station (client) run concurrently. setup () returns
+// at once with the access point up; loop () drives the station state machine:
+//
+//   NoCredentials   no SSID/password configured; access point only
+//   Connecting      WiFi.begin () issued, waiting for an IP address
+//   Connected       station has an IP address
+//   WaitRetry       connect failed or link lost; retry after a backoff time
+//                   that doubles on every failure (RETRY_MIN .. RETRY_MAX)
+//
+// The access point stays up until the station is connected and no device is
+// using the access point any more. It comes back when the station link is lost.
+//
+// Fast reconnect: after every successful connect the BSSID and channel are
+// cached in flash (namespace "WifiCache"). The next connect uses them directly,
+// without a scan. If that fails, the cache is dropped and the next try does a
+// full scan.
+// The credentials and the link parameters are also kept in RTC memory (see
+// warmboot.h), so after a warm reset flash is not read again. The IP configuration
+// of the DHCP lease is kept there too, with the lease time: a warm reboot within
+// half the lease (when a DHCP client would renew it) uses the address without DHCP.
+// Otherwise, and when the half lease runs out while connected, the station
+// (re)connects with DHCP, so the lease is renewed and a new address is noticed.
+//
+// changeNetwork () switches to other credentials at runtime, with the access point
+// up. The new credentials are stored only after the station connected with them;
+// if it cannot, the old credentials are restored. getSwitchState () tells the result.
+//
+// Access point channel: while the station is not connected (when it is, the AP
+// must use the station's channel) and nobody uses the access point, the networks
+// around are scanned at startup and every SCAN_INTERVAL. The AP moves to the
+// least congested of channels 1, 6 and 11 (see channelscore.h). At startup the
+// station's first connect waits for the scan.
+//
+// Power save follows the activity reported by setActivity ():
+//   PowerNone       stream sessions active: no power save, lowest latency
+//   PowerModem      only control clients (pages, api, WebSocket, AP stations): modem sleep
+//   PowerMaxModem   no clients: max modem sleep, waking every LISTEN_INTERVAL beacons
+// A more active mode is entered at once, a less active one after POWER_DOWN_DELAY.
+// Modem sleep only saves power while the access point is down.
+//
 // BSla, 28 aug 2023
+//       19 oct 2026 non-blocking, AP and STA concurrently
 
 #ifndef _MYWIFI_H
 #define _MYWIFI_H
 
 #include <WiFi.h>
+#include "timer.h"
+#include "fixedstring.h"
+#include "channelscore.h"
+
+typedef FixedString<32> Ssid;      // 802.11 limit
+typedef FixedString<64> Password;  // WPA2: 8..63 characters, or 64 hex digits
+typedef FixedString<15> IpString;  // "255.255.255.255"
 
 
 class MyWifi {
   public:
+   enum State {NoCredentials, Connecting, Connected, WaitRetry};
+   enum SwitchState {SwitchIdle, SwitchTrying, SwitchSucceeded, SwitchFailed};
+   enum PowerMode {PowerNone, PowerModem, PowerMaxModem, N_POWER_MODES};
    MyWifi () {}
    ~MyWifi () {}
    void setup ();
-   void loop ();
-   String mySSID ();
-   String myPassword ();
-   void  setSSID (String SSID);
-   void  setPassword (String password);
+   void loop ();          // call from main loop
+   Ssid  mySSID ();
+   Ssid  stationSSID ();  // as WiFi.SSID (), without a String
+   Password myPassword ();
+   void  setSSID (const char *SSID);
+   void  setPassword (const char *password);
+   void  changeNetwork (const char *newSSID, const char *newPassword);  // try new credentials, no restart
+   SwitchState getSwitchState () {return switchPending ? SwitchTrying : switchState;}
+   const char *switchStateName ();
+   int   getApChannel ()        {return state == Connected ? int(WiFi.channel()) : apChannel;}
+   uint32_t getChannelCost (int i) {return channelCosts[i];}  // cost of candidateChannels[i], last scan
+   void  setActivity (int streams, bool controlClients);        // call regularly
+   PowerMode getPowerMode ()    {return powerMode;}
+   const char *powerModeName (PowerMode m);
+   uint32_t getPowerTransitions () {return powerTransitions;}
+   uint32_t getTimeInMode (PowerMode m);                        // seconds since boot
+   uint32_t getEstimatedCurrent ();                             // average mA since boot, radio and CPU
+   State getState ()            {return state;}
+   const char *stateName ();
+   bool  isConnected ()         {return state == Connected;}
+   bool  isAccessPointUp ()     {return apUp;}
+   uint32_t getRetries ()       {return retries;}
+   uint32_t getConnectTime ()   {return connectTime;}   // ms from WiFi.begin to IP address, last connect
+   bool  connectedFromCache ()  {return usingCache;}    // last connect used the cached link parameters
   private:
-   String makeSSID ();
+   struct LinkCache {
+      bool     valid;
+      uint8_t  bssid[6];
+      int32_t  channel;
+      uint32_t ip;
+      uint32_t gateway;
+      uint32_t mask;
+      uint32_t dns;
+      uint32_t leaseStart;     // time () of the DHCP ack
+      uint32_t leaseSeconds;   // 0: no lease to use
+   };
+   Ssid  makeSSID ();
    bool setupAsAccessPoint ();
-   bool setupAsClient (int nTries);
-   void setupServer ();
+   void stopAccessPoint ();
+   void disconnectStation ();
+   void startConnect ();
+   void scheduleRetry ();
+   void startSwitch ();
+   void loadCredentials ();
+   void loadCache ();
+   void saveCache ();
+   void saveWarmCache ();
+   void clearCache ();
+   bool leaseValid ();
+   void scanLoop ();
+   void powerLoop ();
+   void setPowerMode (PowerMode m);
+   static void onEvent (arduino_event_id_t event, arduino_event_info_t info);
+
+   State    state = NoCredentials;
+   bool     apUp = false;
+   uint32_t retries = 0;          // failed connects since the last success
+   uint32_t backoff = 0;          // current retry backoff, ms
+   uint32_t connectStartedAt = 0; // millis () of the most recent WiFi.begin
+   uint32_t connectTime = 0;
+   Timer    stateTimer;           // connect time-out, retry backoff or AP linger time
+   LinkCache cache = {};
+   SwitchState switchState = SwitchIdle;
+   uint32_t switchTries = 0;      // failed connects with the new credentials
+   Ssid     previousSSID;         // credentials to restore if a switch fails
+   Password previousPassword;
+   portMUX_TYPE switchLock = portMUX_INITIALIZER_UNLOCKED; // changeNetwork () runs in another task
+   volatile bool switchPending = false; // new credentials wait in pendingSSID/pendingPassword
+   Ssid     pendingSSID;
+   Password pendingPassword;
+   int      apChannel = 1;
+   uint32_t channelCosts[N_CANDIDATE_CHANNELS] = {};
+   bool     scanning = false;
+   Timer    scanTimer;            // time to the next channel scan
+   PowerMode powerMode = PowerModem;  // the Arduino default
+   PowerMode wantedMode = PowerModem; // according to the most recent activity
+   uint32_t powerTransitions = 0;
+   uint32_t modeSince = 0;            // millis () when powerMode was entered
+   uint32_t modeTime[N_POWER_MODES] = {};  // ms spent in each mode, excluding the current period
+   Timer    powerDownTimer;
+   bool     usingCache = false;   // the current/last connect uses cache
+   bool     staticLease = false;  // the current/last connect uses the cached address, no DHCP
+   Ssid     ssid;
+   Password password;
 };
 
+extern IpString ip2str (const IPAddress ip);
 extern MyWifi myWifi;
 
-#endif
\ No newline at end of file
+#endif
@@ -15,19 +15,18 @@
 #include "debug.h"
 
 // forwards
-static void setShutterValues(int op, int cp, int sp);
-static void getShutterValues(int &op, int &cp, int &sp);
 static esp_err_t handleStartMove(httpd_req_t *req, int op, int cp, int sp, int nMoves);
-static esp_err_t handleExit(httpd_req_t *req, int op, int cp, int sp, String &eV);
+static esp_err_t handleExit(httpd_req_t *req, int op, int cp, int sp, StringView eV);
+static esp_err_t sendAdjustPage(httpd_req_t *req, unsigned int refreshSeconds, int op, int cp, int sp);
 
 //-----------------
 esp_err_t firstAdjustHandler(httpd_req_t *req)
-// Initial call of adjust handler. This call always closes the shutter first.
+// Initial call of adjust handler. This call always closes the shutter first;
+// the page shows the close through the /ws WebSocket, the server task does not wait for it.
 // Later calls are directly to adjustHandler and require a refresh time
 {
    LOG(">  adjust: firstAdjustHandler\n");
    shutter.close();
-   shutter.waitComplete();
    LOG("<  adjust:calling adjustHandler\n");
    return adjustHandler(req, 0); // no refresh time
 }
@@ -41,24 +40,34 @@ esp_err_t adjustHandler(httpd_req_t *req, unsigned int refreshSeconds)
    int sp;
 
    getShutterValues(op, cp, sp);
+   return sendAdjustPage(req, refreshSeconds, op, cp, sp);
+}
 
+//----------------
+static esp_err_t sendAdjustPage(httpd_req_t *req, unsigned int refreshSeconds, int op, int cp, int sp)
+// op, cp, sp in degrees (per second); the values just posted, which the motion task may not have taken yet
+{
    LOG(">  adjustHander: degrees: op = %d, cp = %d, sp = %d\n", op, cp, sp);
 
    bool _isOpen = shutter.isOpen();
    bool _isClosed = shutter.isClosed();
-   String ps(_isOpen ? "De sluiter is nu open" : _isClosed ? "De sluiter is nu gesloten"
-                                                           : "");
-   String adj(adjustHtml);
-   String totalMoves(shutter.getNShutterMoves());
-   String movesLeft(shutter.movesLeft());
-   adj.replace("$SHUTTERPOS$", ps);
-   adj.replace("$OPENPOS$", String(op));
-   adj.replace("$CLOSEDPOS$", String(cp));
-   adj.replace("$SPEED$", String(sp));
-   adj.replace("$TOTALMOVES$", totalMoves);
-   adj.replace("$MOVESLEFT$", movesLeft);
+   const char *ps = _isOpen ? "De sluiter is nu open" : _isClosed ? "De sluiter is nu gesloten"
+                                                                  : "";
+   FixedString<12> openPos, closedPos, speed, totalMoves, movesLeft;
+   openPos.format("%d", op);
+   closedPos.format("%d", cp);
+   speed.format("%d", sp);
+   totalMoves.format("%u", unsigned(shutter.getNShutterMoves()));
+   movesLeft.format("%u", unsigned(shutter.movesLeft()));
+   const PageField fields[] = {
+       {"$SHUTTERPOS$", ps},
+       {"$OPENPOS$", openPos},
+       {"$CLOSEDPOS$", closedPos},
+       {"$SPEED$", speed},
+       {"$TOTALMOVES$", totalMoves},
+       {"$MOVESLEFT$", movesLeft}};
    LOG("   adjustHandler: calling sendPage; totalMoves = %s, movesLeft = %s\n", totalMoves.c_str(), movesLeft.c_str());
-   return sendPage(req, adj.c_str(), refreshSeconds);
+   return sendPage(req, adjustHtml, refreshSeconds, fields, sizeof(fields) / sizeof(fields[0]));
 }
 
 //--------------------------
@@ -71,7 +80,7 @@ esp_err_t adjust2Handler(httpd_req_t *req)
 
    LOG(">  adjust: adjust2Handler\n");
 
-   String kvps; // key-value pairs
+   Query kvps; // key-value pairs
    result = fetchQuery(req, kvps);
    LOG("   adjust2Handler:After fetch Query, result = %d, kvps = %s\n", result, kvps.c_str());
 
@@ -83,7 +92,7 @@ esp_err_t adjust2Handler(httpd_req_t *req)
       getValue(kvps, "ntimes", nMoves);
       LOG("   adjust2Handler: openpos = %d, clpos = %d, speed = %d, nMoves = %d <deg>\n", op, cp, sp, nMoves);
 
-      String eV;
+      FixedString<32> eV;
       if (getValue(kvps, "Exit", eV))
       {
          LOG("   adjust2Handler: Found exit value = |%s|\n", eV.c_str());
@@ -99,16 +108,14 @@ esp_err_t adjust2Handler(httpd_req_t *req)
          LOG("   button open\n");
          setShutterValues(op, cp, sp);
          shutter.open();
-         shutter.waitComplete();
-         result = adjustHandler(req, 0);
+         result = sendAdjustPage(req, 0, op, cp, sp);
       }
       else if (getValue(kvps, "Sluit", eV))
       {
          LOG("   button close\n");
          setShutterValues(op, cp, sp);
          shutter.close();
-         shutter.waitComplete();
-         result = adjustHandler(req, 0);
+         result = sendAdjustPage(req, 0, op, cp, sp);
       }
       else
       {
@@ -122,24 +129,22 @@ esp_err_t adjust2Handler(httpd_req_t *req)
 
    if (result != ESP_OK)
    {
-      httpd_resp_send_500(req);
+      sendError(req, HTTPD_500_INTERNAL_SERVER_ERROR);
       result = ESP_FAIL;
    }
    LOG("<  adjust2Handler\n");
    return result;
 }
 
-//--static functions---------------------------------------
-
 //--------------------------
-static void setShutterValues(int op, int cp, int sp)
+void setShutterValues(int op, int cp, int sp)
 // set shutter values in degrees (per second)
 {
    shutter.setValues(shutter.toUs(op), shutter.toUs(cp), shutter.speedToUs(sp));
 }
 
 //--------------------------
-static void getShutterValues(int &op, int &cp, int &sp)
+void getShutterValues(int &op, int &cp, int &sp)
 // get shutter values in degrees (per second)
 {
    shutter.getValues(op, cp, sp);
@@ -148,75 +153,49 @@ static void getShutterValues(int &op, int &cp, int &sp)
    sp = shutter.speedToDeg(sp);
 }
 
+//--static functions---------------------------------------
+
 //--------------------------
 static esp_err_t handleStartMove(httpd_req_t *req, int op, int cp, int sp, int nMoves)
 // open pos, closed pos, speed in deg/sec
+// The page follows the progress of the moves through the /ws WebSocket (see websock.cpp),
+// so there is no auto-refresh
 {
-   esp_err_t result = ESP_OK;
-   static bool isRepeatedCall = false;
-
-   LOG(">  handleStartMove; nMoves = %d, it is a %s call\n", nMoves, isRepeatedCall ? "repeated" : "original");
-   if (!isRepeatedCall)
+   LOG(">  handleStartMove; nMoves = %d\n", nMoves);
+   if (nMoves > 0)
    {
-      // this is the first reply to the form; not the result of an auto-refresh
-      if (nMoves > 0)
-      { // kickoff repeated moves
-         LOG("handleStartMove: start %d moves\n", nMoves);
-         setShutterValues(op, cp, sp);
-         shutter.startRepeatedMoves(nMoves);
-         isRepeatedCall = true;          // expect repeated call back
-         result = adjustHandler(req, 1); // continue repeated move, refresh once per second
-      }
-      else
-      {
-         // Start moves called, but nMoves = 0
-         isRepeatedCall = false;
-         result = adjustHandler(req, 0); // no autorepeat; redisplay same screen
-      }
-   }
-   else
-   {
-      // this call is the result of an auto-refresh
-      if (shutter.movesLeft() > 0)
-      {
-         result = adjustHandler(req, 1); // auto-refresh after 1 second
-      }
-      else
-      {
-         // moves are done
-         LOG("   handleStartMove: shutter moves are done\n");
-         isRepeatedCall = false;
-         result = adjustHandler(req, 0); // no auto-refresh
-      }
+      setShutterValues(op, cp, sp);
+      shutter.startRepeatedMoves(nMoves);
    }
+   esp_err_t result = sendAdjustPage(req, 0, op, cp, sp);
    LOG("<  handleStartMove\n");
    return result;
 }
 
 //--------------------------
-static esp_err_t handleExit(httpd_req_t *req, int op, int cp, int sp, String &eV)
+static esp_err_t handleExit(httpd_req_t *req, int op, int cp, int sp, StringView eV)
 // open pos, closed pos, speed in deg/sec
+// The close is only posted, so the shutter is not closed yet: send the normal index page,
+// not index_handler's warning for a shutter that was left open
 {
    esp_err_t result = ESP_OK;
-   LOG(">  adjust: handleExit: exit value = %s\n", eV.c_str());
+   LOG(">  adjust: handleExit: exit value = %.*s\n", int(eV.length()), eV.data());
    if (eV == "OK")
    {
       setShutterValues(op, cp, sp);
       shutter.saveSettings();
       shutter.close();
-      shutter.waitComplete();
-      result = index_handler(req);
+      result = sendPage(req, indexBody, 0);
    }
    else if (eV == "Cancel")
    {
       shutter.restoreSettings();
       shutter.close();
-      shutter.waitComplete();
-      result = index_handler(req);
+      result = sendPage(req, indexBody, 0);
    }
    else
    {
-      ERROR("***** handleExit: got unknown exit value %s\n", eV.c_str());
+      ERROR("***** handleExit: got unknown exit value %.*s\n", int(eV.length()), eV.data());
       result = ESP_FAIL;
    }
    LOG("<  adjust: handleExit\n");
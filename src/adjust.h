@@ -11,4 +11,7 @@ esp_err_t firstAdjustHandler (httpd_req_t *req);
 esp_err_t adjustHandler (httpd_req_t *req, unsigned int refreshSeconds);
 esp_err_t adjust2Handler (httpd_req_t *req);
 
+void      setShutterValues (int op, int cp, int sp);    // open pos, closed pos, speed in deg (per sec)
+void      getShutterValues (int &op, int &cp, int &sp);
+
 #endif
\ No newline at end of file
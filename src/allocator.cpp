@@ -0,0 +1,263 @@
+//
+// allocator.cpp -- allocation policy for large buffers, per tag accounting
+//
+// Ben Slaghekke, 19 October 2026
+//
+#include <Arduino.h>
+#include "esp_heap_caps.h"
+#include "heapscope.h"
+#include "allocator.h"
+
+#define _DEBUG 1
+#include "debug.h"
+
+#define SMALL_ALLOC (512)            // up to this size: internal RAM
+#define INTERNAL_RESERVE (48 * 1024) // a large buffer may not bring free internal RAM below this
+#define N_CLASSES (4)
+#define NO_CLASS (0xFF)              // block is not from a pool
+#define BLOCK_MAGIC (0xA110)
+
+// usable size of the blocks of each class, and how many freed blocks are kept
+static const size_t classSize[N_CLASSES] = {2 * 1024, 8 * 1024, 32 * 1024, 128 * 1024};
+static const int classKeep[N_CLASSES] = {4, 4, 2, 2};
+
+enum Region {RegionInternal, RegionPsram, N_REGIONS};
+
+static const char *tagName[N_MEM_TAGS] = {"jpeg", "profile", "taskList", "motion", "clip"};
+static const Subsystem tagSubsystem[N_MEM_TAGS] = {SubsysCamera, SubsysDebug, SubsysDebug, SubsysCamera, SubsysCamera};
+static const char *regionName[N_REGIONS] = {"internal", "psram"};
+
+// In front of every block; 16 bytes, so the data stays aligned
+struct BlockHeader
+{
+   uint16_t magic;     // BLOCK_MAGIC while allocated
+   uint8_t tag;
+   uint8_t region;
+   uint8_t cls;
+   uint8_t unused[3];
+   uint32_t size;      // usable bytes
+   BlockHeader *next;  // free list of the class, while kept in a pool
+};
+
+struct TagStats
+{
+   uint32_t bytes[N_REGIONS]; // live
+   uint32_t peak;             // highest live bytes, both regions
+   uint32_t blocks;           // live
+   uint32_t allocs;
+   uint32_t failures;
+};
+
+struct Pool
+{
+   BlockHeader *free;
+   int kept;
+   uint32_t hits;   // allocations served from the kept blocks
+   uint32_t misses; // allocations that needed a new block
+};
+
+static TagStats tagStats[N_MEM_TAGS];
+static Pool pools[N_CLASSES];
+static portMUX_TYPE memLock = portMUX_INITIALIZER_UNLOCKED;
+static volatile bool keepBlocks = true;
+
+static const char *cName = "allocator";
+
+//----------------------------
+static BlockHeader *heapAlloc(size_t size, uint32_t caps)
+{
+   return (BlockHeader *)heap_caps_malloc(sizeof(BlockHeader) + size, caps);
+}
+
+//----------------------------
+void *memAlloc(size_t size, MemTag tag, MemPlacement placement)
+{
+   const char *fName = "memAlloc";
+   BlockHeader *h = nullptr;
+   uint8_t cls = NO_CLASS;
+   Region region = RegionInternal;
+   size_t blockSize = size;
+
+   if (placement == MemDma)
+      h = heapAlloc(size, MALLOC_CAP_DMA | MALLOC_CAP_INTERNAL);
+   else if (placement == MemInternal || size <= SMALL_ALLOC)
+      h = heapAlloc(size, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+   else
+   {
+      region = RegionPsram;
+      cls = 0;
+      while (cls < N_CLASSES && classSize[cls] < size)
+         cls++;
+      if (cls < N_CLASSES)
+      {
+         blockSize = classSize[cls];
+         portENTER_CRITICAL(&memLock);
+         Pool &pool = pools[cls];
+         h = pool.free;
+         if (h)
+         {
+            pool.free = h->next;
+            pool.kept--;
+            pool.hits++;
+         }
+         else
+            pool.misses++;
+         portEXIT_CRITICAL(&memLock);
+      }
+      else
+         cls = NO_CLASS; // larger than the largest class: straight from the heap
+
+      if (!h)
+         h = heapAlloc(blockSize, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+      if (!h && heap_caps_get_free_size(MALLOC_CAP_INTERNAL) >= INTERNAL_RESERVE + size)
+      {
+         // no PSRAM (left)
+         region = RegionInternal;
+         cls = NO_CLASS;
+         blockSize = size;
+         h = heapAlloc(size, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+      }
+   }
+
+   TagStats &t = tagStats[tag];
+   if (!h)
+   {
+      portENTER_CRITICAL(&memLock);
+      t.failures++;
+      portEXIT_CRITICAL(&memLock);
+      WARNING("%s: %s: no memory for %u bytes (%s)\n", cName, fName, (unsigned)size, tagName[tag]);
+      return nullptr;
+   }
+   h->magic = BLOCK_MAGIC;
+   h->tag = tag;
+   h->region = region;
+   h->cls = cls;
+   h->size = blockSize;
+   h->next = nullptr;
+
+   portENTER_CRITICAL(&memLock);
+   t.bytes[region] += blockSize;
+   if (t.bytes[RegionInternal] + t.bytes[RegionPsram] > t.peak)
+      t.peak = t.bytes[RegionInternal] + t.bytes[RegionPsram];
+   t.blocks++;
+   t.allocs++;
+   portEXIT_CRITICAL(&memLock);
+   heapTrackAlloc(tagSubsystem[tag], sizeof(BlockHeader) + blockSize);
+   return h + 1;
+}
+
+//----------------------------
+void memFree(void *p)
+{
+   if (!p)
+      return;
+   BlockHeader *h = (BlockHeader *)p - 1;
+   if (h->magic != BLOCK_MAGIC)
+   {
+      ERROR("%s: memFree: %p was not allocated by memAlloc, or freed twice\n", cName, p);
+      return;
+   }
+   h->magic = 0;
+   heapTrackFree(tagSubsystem[h->tag], sizeof(BlockHeader) + h->size);
+
+   bool kept = false;
+   portENTER_CRITICAL(&memLock);
+   TagStats &t = tagStats[h->tag];
+   t.bytes[h->region] -= h->size;
+   t.blocks--;
+   if (keepBlocks && h->cls != NO_CLASS && pools[h->cls].kept < classKeep[h->cls])
+   {
+      Pool &pool = pools[h->cls];
+      h->next = pool.free;
+      pool.free = h;
+      pool.kept++;
+      kept = true;
+   }
+   portEXIT_CRITICAL(&memLock);
+   if (!kept)
+      heap_caps_free(h);
+}
+
+//----------------------------
+void memTrim()
+{
+   size_t freed = 0;
+   for (int c = 0; c < N_CLASSES; c++)
+   {
+      portENTER_CRITICAL(&memLock);
+      BlockHeader *list = pools[c].free;
+      pools[c].free = nullptr;
+      pools[c].kept = 0;
+      portEXIT_CRITICAL(&memLock);
+      while (list)
+      {
+         BlockHeader *next = list->next;
+         heap_caps_free(list);
+         freed += classSize[c];
+         list = next;
+      }
+   }
+   LOG(">< %s: memTrim: %u bytes freed\n", cName, (unsigned)freed);
+}
+
+//----------------------------
+void memKeepBlocks(bool keep)
+{
+   keepBlocks = keep;
+   if (!keep)
+      memTrim();
+}
+
+//----------------------------
+static void writeRegion(JsonWriter &w, const char *key, uint32_t caps)
+{
+   w.beginObject(key);
+   w.add("size", heap_caps_get_total_size(caps));
+   w.add("free", heap_caps_get_free_size(caps));
+   w.add("minFree", heap_caps_get_minimum_free_size(caps));
+   w.add("largestFree", heap_caps_get_largest_free_block(caps));
+   w.endObject();
+}
+
+//----------------------------
+void memWriteReport(JsonWriter &w)
+// heap per region, bytes per tag and region, the pools and the heap per subsystem
+{
+   TagStats tags[N_MEM_TAGS];
+   Pool p[N_CLASSES];
+   portENTER_CRITICAL(&memLock);
+   memcpy(tags, tagStats, sizeof(tags));
+   memcpy(p, pools, sizeof(p));
+   portEXIT_CRITICAL(&memLock);
+
+   w.beginObject();
+   writeRegion(w, regionName[RegionInternal], MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+   writeRegion(w, regionName[RegionPsram], MALLOC_CAP_SPIRAM);
+   w.beginArray("tags");
+   for (int i = 0; i < N_MEM_TAGS; i++)
+   {
+      w.beginObject();
+      w.add("tag", tagName[i]);
+      for (int r = 0; r < N_REGIONS; r++)
+         w.add(regionName[r], tags[i].bytes[r]);
+      w.add("peak", tags[i].peak);
+      w.add("blocks", tags[i].blocks);
+      w.add("allocs", tags[i].allocs);
+      w.add("failures", tags[i].failures);
+      w.endObject();
+   }
+   w.endArray();
+   w.beginArray("pools");
+   for (int c = 0; c < N_CLASSES; c++)
+   {
+      w.beginObject();
+      w.add("size", classSize[c]);
+      w.add("kept", p[c].kept);
+      w.add("hits", p[c].hits);
+      w.add("misses", p[c].misses);
+      w.endObject();
+   }
+   w.endArray();
+   heapWriteReport(w);
+   w.endObject();
+}
@@ -0,0 +1,47 @@
+//
+// allocator.h -- allocation policy for large buffers, per tag accounting
+//
+// Internal RAM is scarce: WiFi, lwIP and the camera DMA need it. So:
+// - MemDma: internal, DMA capable
+// - MemInternal, or a size up to SMALL_ALLOC: internal (hot small objects,
+//   buffers used from an interrupt)
+// - anything else: PSRAM, from a pool of blocks per size class. Freed blocks
+//   are kept for the next allocation of their class, so PSRAM does not
+//   fragment; memTrim () gives the kept blocks back, and memKeepBlocks (false)
+//   stops keeping them (under memory pressure, see pressure.cpp).
+// Without (enough) PSRAM a large buffer comes from internal RAM, but only
+// while that leaves INTERNAL_RESERVE bytes free.
+//
+// Every allocation carries a tag for the site that made it; /api/memory
+// reports bytes per tag and region, and the pool use.
+//
+// Ben Slaghekke, 19 October 2026
+//
+#ifndef _ALLOCATOR_H
+#define _ALLOCATOR_H
+
+#include <stddef.h>
+#include "json.h"
+
+enum MemTag {
+   MemJpeg,        // camera: frame2jpg output
+   MemProfile,     // profiler histogram
+   MemTaskList,    // task report
+   MemMotion,      // motion detection: decoded and background frames
+   MemClip,        // pre-trigger ring of jpg frames
+   N_MEM_TAGS
+};
+
+enum MemPlacement {
+   MemDefault,     // by size: small internal, large PSRAM
+   MemInternal,    // internal RAM, whatever the size
+   MemDma          // internal RAM, DMA capable
+};
+
+extern void *memAlloc       (size_t size, MemTag tag, MemPlacement placement = MemDefault); // nullptr if no memory
+extern void  memFree        (void *p);                    // p from memAlloc, or nullptr
+extern void  memTrim        ();                           // free the blocks kept in the pools
+extern void  memKeepBlocks  (bool keep);                  // keep freed blocks for reuse (default true)
+extern void  memWriteReport (JsonWriter &w);              // the /api/memory document
+
+#endif
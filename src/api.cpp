@@ -0,0 +1,489 @@
+//
+// api.cpp -- JSON control API for shutter and camera
+//
+// GET  /api/status     site, shutter and camera status
+// GET  /api/tasks      FreeRTOS tasks: CPU use, stack high water mark, priority, core
+// GET  /api/memory     heap per region, bytes per allocation tag and region, PSRAM pools
+// GET  /api/profile    sampling profiler histogram (see profiler.cpp)
+// GET  /api/motion     motion detection: changed blocks, recent events, timing (see detector.cpp)
+// GET  /api/activity   visits found from the jpg frame sizes, per hour of the day (see visits.cpp)
+// GET  /api/clip       the frozen pre-trigger clip, multipart jpg (see clip.cpp)
+// POST /api/profile    {"cmd": "start" | "stop" | "clear"}
+// POST /api/clip       {"cmd": "trigger" | "release"}; the reply is the clip state
+// POST /api/shutter    {"cmd": c, "openDeg": o, "closedDeg": c, "speed": s, "n": n}
+//                      cmd = open | close | moves | save | cancel | set
+//                      all other fields are optional; the reply is the shutter status right
+//                      after posting the command, the move itself is followed through /ws
+// POST /api/camera     {"vflip": b, "hmirror": b}; the reply is the camera status
+// GET  /api/stats      latency histogram, status codes and heap delta per uri (see httpsupp.cpp)
+//
+// Replies are serialized by a JsonWriter straight into the http response,
+// without building the document on the heap. The adjust page uses this API
+// instead of submitting its form, so an action costs ~200 bytes instead of a page.
+//
+// Ben Slaghekke, 19 October 2026
+//
+
+#include <Arduino.h>
+#include "esp_heap_caps.h"
+#include "json.h"
+#include "shutter.h"
+#include "camera.h"
+#include "httpsupp.h"
+#include "adjust.h"
+#include "stream.h"
+#include "capture.h"
+#include "profiler.h"
+#include "allocator.h"
+#include "pressure.h"
+#include "detector.h"
+#include "visits.h"
+#include "clip.h"
+#include "boot.h"
+#include "warmboot.h"
+#include "myWifi.h"
+#include "http.h"
+#include "api.h"
+
+#define _DEBUG 1
+#include "debug.h"
+
+#define MAX_BODY_SIZE (160) // largest accepted request body
+#define MAX_RECV_TRIES (5)  // receive time-outs before giving up
+
+static const char *cName = "api";
+
+// forwards
+static bool sendChunk(void *context, const char *data, size_t len);
+static esp_err_t fetchBody(httpd_req_t *req, char *body, size_t bodySize);
+static esp_err_t startReply(httpd_req_t *req);
+static esp_err_t endReply(httpd_req_t *req, JsonWriter &w);
+static bool inRange(int value, int min, int max) { return value >= min && value <= max; }
+
+//----------------
+static esp_err_t apiStatusHandler(httpd_req_t *req)
+{
+   JsonWriter w(sendChunk, req);
+   startReply(req);
+   apiWriteStatus(w);
+   return endReply(req, w);
+}
+
+//----------------
+static esp_err_t apiShutterHandler(httpd_req_t *req)
+{
+   const char *fName = "apiShutterHandler";
+   char body[MAX_BODY_SIZE];
+   esp_err_t result = fetchBody(req, body, sizeof(body));
+   if (result != ESP_OK)
+   {
+      return result;
+   }
+   LOG(">  %s: %s (%s)\n", cName, fName, body);
+
+   // fields that are not present keep their current value
+   int op, cp, sp;
+   int n = 0;
+   getShutterValues(op, cp, sp);
+   JsonReader::getInt(body, "openDeg", op);
+   JsonReader::getInt(body, "closedDeg", cp);
+   JsonReader::getInt(body, "speed", sp);
+   JsonReader::getInt(body, "n", n);
+
+   char cmd[12];
+   const char *error = nullptr;
+   if (!JsonReader::getString(body, "cmd", cmd, sizeof(cmd)))
+      error = "cmd missing";
+   else if (!inRange(op, 0, 180) || !inRange(cp, 0, 180))
+      error = "openDeg and closedDeg must be 0..180";
+   else if (!inRange(sp, 1, 400))
+      error = "speed must be 1..400";
+   else if (strcmp(cmd, "open") == 0)
+   {
+      setShutterValues(op, cp, sp);
+      shutter.open();
+   }
+   else if (strcmp(cmd, "close") == 0)
+   {
+      setShutterValues(op, cp, sp);
+      shutter.close();
+   }
+   else if (strcmp(cmd, "moves") == 0)
+   {
+      setShutterValues(op, cp, sp);
+      if (n > 0)
+         shutter.startRepeatedMoves(n); // does not wait
+   }
+   else if (strcmp(cmd, "save") == 0)
+   {
+      setShutterValues(op, cp, sp);
+      shutter.saveSettings();
+      shutter.close();
+   }
+   else if (strcmp(cmd, "cancel") == 0)
+   {
+      shutter.restoreSettings();
+      shutter.close();
+   }
+   else if (strcmp(cmd, "set") == 0)
+   {
+      setShutterValues(op, cp, sp);
+   }
+   else
+      error = "unknown cmd";
+
+   if (error)
+   {
+      ERROR("***** %s: %s: %s\n", cName, fName, error);
+      sendError(req, HTTPD_400_BAD_REQUEST, error);
+      return ESP_FAIL;
+   }
+
+   JsonWriter w(sendChunk, req);
+   startReply(req);
+   apiWriteShutter(w);
+   result = endReply(req, w);
+   LOG("<  %s: %s\n", cName, fName);
+   return result;
+}
+
+//----------------
+static esp_err_t apiCameraHandler(httpd_req_t *req)
+{
+   const char *fName = "apiCameraHandler";
+   char body[MAX_BODY_SIZE];
+   esp_err_t result = fetchBody(req, body, sizeof(body));
+   if (result != ESP_OK)
+   {
+      return result;
+   }
+   LOG(">  %s: %s (%s)\n", cName, fName, body);
+
+   bool b;
+   if (JsonReader::getBool(body, "vflip", b))
+      camera.setVerticalFlip(b);
+   if (JsonReader::getBool(body, "hmirror", b))
+      camera.setHorizontalMirror(b);
+
+   JsonWriter w(sendChunk, req);
+   startReply(req);
+   apiWriteCamera(w);
+   result = endReply(req, w);
+   LOG("<  %s: %s\n", cName, fName);
+   return result;
+}
+
+//----------------
+static esp_err_t apiStatsHandler(httpd_req_t *req)
+{
+   JsonWriter w(sendChunk, req);
+   startReply(req);
+   writeUriStats(w);
+   return endReply(req, w);
+}
+
+//----------------
+static esp_err_t apiMemoryHandler(httpd_req_t *req)
+{
+   JsonWriter w(sendChunk, req);
+   startReply(req);
+   memWriteReport(w);
+   return endReply(req, w);
+}
+
+//----------------
+static esp_err_t apiMotionHandler(httpd_req_t *req)
+{
+   JsonWriter w(sendChunk, req);
+   startReply(req);
+   detectorWriteReport(w);
+   return endReply(req, w);
+}
+
+//----------------
+static esp_err_t apiActivityHandler(httpd_req_t *req)
+{
+   JsonWriter w(sendChunk, req);
+   startReply(req);
+   visitsWriteReport(w);
+   return endReply(req, w);
+}
+
+//----------------
+static esp_err_t apiClipHandler(httpd_req_t *req)
+{
+   return clipExport(req);
+}
+
+//----------------
+static esp_err_t apiClipControlHandler(httpd_req_t *req)
+{
+   const char *fName = "apiClipControlHandler";
+   char body[MAX_BODY_SIZE];
+   esp_err_t result = fetchBody(req, body, sizeof(body));
+   if (result != ESP_OK)
+   {
+      return result;
+   }
+   LOG(">  %s: %s (%s)\n", cName, fName, body);
+
+   char cmd[8];
+   const char *error = nullptr;
+   if (!JsonReader::getString(body, "cmd", cmd, sizeof(cmd)))
+      error = "cmd missing";
+   else if (strcmp(cmd, "trigger") == 0)
+      clipTrigger(ClipApi); // a clip that is frozen already stays
+   else if (strcmp(cmd, "release") == 0)
+   {
+      if (!clipRelease())
+         error = "no frozen clip, or it is being exported";
+   }
+   else
+      error = "unknown cmd";
+
+   if (error)
+   {
+      ERROR("***** %s: %s: %s\n", cName, fName, error);
+      sendError(req, HTTPD_400_BAD_REQUEST, error);
+      return ESP_FAIL;
+   }
+
+   JsonWriter w(sendChunk, req);
+   startReply(req);
+   clipWriteReport(w);
+   return endReply(req, w);
+}
+
+//----------------
+static esp_err_t apiTasksHandler(httpd_req_t *req)
+{
+   JsonWriter w(sendChunk, req);
+   startReply(req);
+   tasksWriteReport(w);
+   return endReply(req, w);
+}
+
+//----------------
+static esp_err_t apiProfileHandler(httpd_req_t *req)
+{
+   JsonWriter w(sendChunk, req);
+   startReply(req);
+   profilerWriteReport(w);
+   return endReply(req, w);
+}
+
+//----------------
+static esp_err_t apiProfileControlHandler(httpd_req_t *req)
+{
+   const char *fName = "apiProfileControlHandler";
+   char body[MAX_BODY_SIZE];
+   esp_err_t result = fetchBody(req, body, sizeof(body));
+   if (result != ESP_OK)
+   {
+      return result;
+   }
+   LOG(">  %s: %s (%s)\n", cName, fName, body);
+
+   char cmd[8];
+   const char *error = nullptr;
+   if (!JsonReader::getString(body, "cmd", cmd, sizeof(cmd)))
+      error = "cmd missing";
+   else if (strcmp(cmd, "start") == 0)
+   {
+      if (!profilerStart())
+         error = "profiler could not start";
+   }
+   else if (strcmp(cmd, "stop") == 0)
+      profilerStop();
+   else if (strcmp(cmd, "clear") == 0)
+      profilerClear();
+   else
+      error = "unknown cmd";
+
+   if (error)
+   {
+      ERROR("***** %s: %s: %s\n", cName, fName, error);
+      sendError(req, HTTPD_400_BAD_REQUEST, error);
+      return ESP_FAIL;
+   }
+   return apiProfileHandler(req);
+}
+
+//----------------------------
+void apiSetup(httpd_handle_t &httpd)
+{
+   registerUriHandler(httpd, "/api/status", apiStatusHandler);
+   registerUriHandler(httpd, "/api/stats", apiStatsHandler);
+   registerUriHandler(httpd, "/api/tasks", apiTasksHandler);
+   registerUriHandler(httpd, "/api/memory", apiMemoryHandler);
+   registerUriHandler(httpd, "/api/motion", apiMotionHandler);
+   registerUriHandler(httpd, "/api/activity", apiActivityHandler);
+   registerUriHandler(httpd, "/api/clip", apiClipHandler);
+   registerUriHandler(httpd, "/api/clip", apiClipControlHandler, HTTP_POST);
+   registerUriHandler(httpd, "/api/profile", apiProfileHandler);
+   registerUriHandler(httpd, "/api/profile", apiProfileControlHandler, HTTP_POST);
+   registerUriHandler(httpd, "/api/shutter", apiShutterHandler, HTTP_POST);
+   registerUriHandler(httpd, "/api/camera", apiCameraHandler, HTTP_POST);
+}
+
+//----------------------------
+void apiWriteStatus(JsonWriter &w)
+{
+   w.beginObject();
+   w.add("uptime", millis() / 1000);
+   w.add("freeHeap", ESP.getFreeHeap());
+   w.add("largestFreeBlock", heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT)); // fragmentation
+   w.add("site", getSiteName().c_str());
+   w.add("comment", getComment().c_str());
+   w.add("firstRequestMs", firstRequestTime());
+   w.add("httpRamBytes", httpRamUse());
+   bootWriteReport(w);
+   w.beginObject("wifi");
+   apiWriteWifiFields(w);
+   w.endObject();
+   w.beginObject("shutter");
+   apiWriteShutterFields(w);
+   w.add("stepLateUs", shutter.getStepLate());
+   w.add("worstStepLateUs", shutter.getWorstStepLate());
+   w.add("commandLatencyUs", shutter.getCommandLatency());
+   w.add("worstCommandLatencyUs", shutter.getWorstCommandLatency());
+   w.endObject();
+   w.beginObject("camera");
+   apiWriteCameraFields(w);
+   w.endObject();
+   w.add("framesCaptured", captureFrameCount());
+   w.add("resetReason", warmBoot.resetReason());
+   w.add("warmBoot", warmBoot.isWarm());
+   pressureWriteStatus(w);
+   detectorWriteStatus(w);
+   visitsWriteStatus(w);
+   clipWriteStatus(w);
+   streamWriteStatus(w);
+   w.endObject();
+}
+
+//----------------------------
+void apiWriteShutter(JsonWriter &w)
+{
+   w.beginObject();
+   apiWriteShutterFields(w);
+   w.endObject();
+}
+
+//----------------------------
+void apiWriteShutterFields(JsonWriter &w)
+{
+   int op, cp, sp;
+   getShutterValues(op, cp, sp);
+   w.add("state", shutter.stateName());
+   w.add("moving", shutter.isMoving()); // also while a posted command has not yet run
+   w.add("position", shutter.toDeg(shutter.getPosition()));
+   w.add("openDeg", op);
+   w.add("closedDeg", cp);
+   w.add("speed", sp);
+   w.add("totalMoves", shutter.getNShutterMoves());
+   w.add("movesLeft", shutter.movesLeft());
+}
+
+//----------------------------
+void apiWriteWifiFields(JsonWriter &w)
+{
+   w.add("state", myWifi.stateName());
+   w.add("switch", myWifi.switchStateName());
+   w.add("ssid", myWifi.stationSSID().c_str());
+   w.add("ip", ip2str(WiFi.localIP()).c_str());
+   w.add("rssi", myWifi.isConnected() ? int(WiFi.RSSI()) : 0);
+   w.add("retries", myWifi.getRetries());
+   w.add("connectMs", myWifi.getConnectTime());
+   w.add("cachedConnect", myWifi.connectedFromCache());
+   w.add("accessPoint", myWifi.isAccessPointUp());
+   w.add("apStations", int(WiFi.softAPgetStationNum()));
+   w.add("apChannel", myWifi.getApChannel());
+   w.add("powerSave", myWifi.powerModeName(myWifi.getPowerMode()));
+   w.add("powerTransitions", myWifi.getPowerTransitions());
+   w.add("estimatedMa", myWifi.getEstimatedCurrent());
+   w.beginArray("secondsInMode"); // None, Modem, MaxModem
+   for (int m = 0; m < MyWifi::N_POWER_MODES; m++)
+   {
+      w.add(nullptr, myWifi.getTimeInMode(MyWifi::PowerMode(m)));
+   }
+   w.endArray();
+   w.beginArray("channelCosts"); // channels 1, 6, 11
+   for (int i = 0; i < N_CANDIDATE_CHANNELS; i++)
+   {
+      w.add(nullptr, myWifi.getChannelCost(i));
+   }
+   w.endArray();
+}
+
+//----------------------------
+void apiWriteCamera(JsonWriter &w)
+{
+   w.beginObject();
+   apiWriteCameraFields(w);
+   w.endObject();
+}
+
+//----------------------------
+void apiWriteCameraFields(JsonWriter &w)
+{
+   w.add("ready", camera.isReady());
+   w.add("vflip", camera.getVerticalFlip());
+   w.add("hmirror", camera.getHorizontalMirror());
+}
+
+//--static functions---------------------------------------
+
+//----------------------------
+static bool sendChunk(void *context, const char *data, size_t len)
+// JsonFlushFunction: write serialized output to the http response
+{
+   return httpd_resp_send_chunk((httpd_req_t *)context, data, len) == ESP_OK;
+}
+
+//----------------------------
+static esp_err_t fetchBody(httpd_req_t *req, char *body, size_t bodySize)
+// receive the request body into body, '\0' terminated
+{
+   const char *fName = "fetchBody";
+   if (req->content_len >= bodySize)
+   {
+      ERROR("***** %s: %s: body too long (%u bytes)\n", cName, fName, (unsigned)req->content_len);
+      sendError(req, HTTPD_400_BAD_REQUEST, "body too long");
+      return ESP_FAIL;
+   }
+
+   size_t received = 0;
+   int tries = 0;
+   while (received < req->content_len)
+   {
+      int r = httpd_req_recv(req, body + received, req->content_len - received);
+      if (r == HTTPD_SOCK_ERR_TIMEOUT && ++tries < MAX_RECV_TRIES)
+         continue;
+      if (r <= 0)
+      {
+         sendError(req, HTTPD_408_REQ_TIMEOUT);
+         return ESP_FAIL;
+      }
+      received += r;
+   }
+   body[received] = '\0';
+   return ESP_OK;
+}
+
+//----------------------------
+static esp_err_t startReply(httpd_req_t *req)
+{
+   httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+   return httpd_resp_set_type(req, "application/json");
+}
+
+//----------------------------
+static esp_err_t endReply(httpd_req_t *req, JsonWriter &w)
+// flush the writer and terminate the chunked response
+{
+   esp_err_t r = w.finish() ? ESP_OK : ESP_FAIL;
+   if (r == ESP_OK)
+      r = httpd_resp_send_chunk(req, nullptr, 0);
+   return r;
+}
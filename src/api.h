@@ -0,0 +1,20 @@
+//
+// api.h -- JSON control API for shutter and camera
+//
+// Ben Slaghekke, 19 October 2026
+//
+#ifndef _API_H
+#define _API_H
+
+#include "esp_http_server.h"
+#include "json.h"
+
+extern void apiSetup              (httpd_handle_t &httpd);   // register the /api/... handlers
+extern void apiWriteStatus        (JsonWriter &w);           // the /api/status document
+extern void apiWriteShutter       (JsonWriter &w);           // shutter object
+extern void apiWriteShutterFields (JsonWriter &w);           // shutter fields, inside an open object
+extern void apiWriteWifiFields    (JsonWriter &w);           // wifi fields, inside an open object
+extern void apiWriteCamera        (JsonWriter &w);           // camera object
+extern void apiWriteCameraFields  (JsonWriter &w);           // camera fields, inside an open object
+
+#endif
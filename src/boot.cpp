@@ -0,0 +1,43 @@
+//
+// boot.cpp -- boot phase timestamps
+//
+// Times are taken with esp_timer_get_time (), which starts at reset, so they
+// include the ROM and second stage bootloader time before setup ().
+// Every phase is logged when it is reached.
+//
+// Ben Slaghekke, 19 October 2026
+//
+#include <Arduino.h>
+#include "esp_timer.h"
+#include "boot.h"
+
+#define _DEBUG 1
+#include "debug.h"
+
+static const char *phaseNames[N_BOOT_PHASES] = {
+   "setup", "shutter", "accessPoint", "http", "camera", "firstFrame", "station"};
+
+static volatile uint32_t phaseMs[N_BOOT_PHASES]; // ms after reset; 0 = not reached yet
+
+//----------------------------
+void bootMark(BootPhase phase)
+{
+   if (phaseMs[phase] != 0)
+      return;
+   uint32_t ms = uint32_t(esp_timer_get_time() / 1000);
+   phaseMs[phase] = ms ? ms : 1;
+   LOG(">< boot: %s at %u ms\n", phaseNames[phase], (unsigned)ms);
+}
+
+//----------------------------
+void bootWriteReport(JsonWriter &w)
+// phases that were not reached are left out
+{
+   w.beginObject("boot");
+   for (int p = 0; p < N_BOOT_PHASES; p++)
+   {
+      if (phaseMs[p] != 0)
+         w.add(phaseNames[p], phaseMs[p]);
+   }
+   w.endObject();
+}
@@ -0,0 +1,25 @@
+//
+// boot.h -- boot phase timestamps
+//
+// Ben Slaghekke, 19 October 2026
+//
+#ifndef _BOOT_H
+#define _BOOT_H
+
+#include "json.h"
+
+enum BootPhase {
+   BootSetup,        // setup () entered
+   BootShutter,      // servo attached, settings restored
+   BootAccessPoint,  // myWifi.setup () done: access point up, station connecting
+   BootHttp,         // http server accepts requests
+   BootCamera,       // camera initialised (in the capture task)
+   BootFirstFrame,   // first frame captured
+   BootStation,      // station has an IP address
+   N_BOOT_PHASES
+};
+
+extern void bootMark        (BootPhase phase);  // record the time of a phase; only the first call counts
+extern void bootWriteReport (JsonWriter &w);    // "boot": {phase: ms, ...} for /api/status
+
+#endif
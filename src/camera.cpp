@@ -16,10 +16,25 @@
 #define _DEBUG 0
 #include "debug.h"
 
+#include "img_converters.h"
+#include "warmboot.h"
+#include "allocator.h"
+#include "heapscope.h"
 #include "camera.h"
 
+#define JPEG_FIRST_SIZE (32 * 1024) // first buffer for frame2jpg output; doubled while too small
+#define REDUCED_FRAME_SIZE FRAMESIZE_QVGA
+
 Camera camera;
 
+// frame2jpg output buffer
+struct JpegOut
+{
+   uint8_t *buf;
+   size_t size;
+   size_t len;
+};
+
 #define CAMERA_MODEL_AI_THINKER
 // #define CAMERA_MODEL_M5STACK_PSRAM
 // #define CAMERA_MODEL_M5STACK_WITHOUT_PSRAM
@@ -151,7 +166,15 @@ void Camera::setup()
    config.xclk_freq_hz = 20000000;
    config.pixel_format = PIXFORMAT_JPEG;
 
-   if (psramFound())
+   const WarmState &w = warmBoot.state();
+   if (w.cameraValid)
+   {
+      // after a warm reset: the config of the previous run
+      config.frame_size = framesize_t(w.frameSize);
+      config.jpeg_quality = w.jpegQuality;
+      config.fb_count = w.fbCount;
+   }
+   else if (psramFound())
    {
       config.frame_size = FRAMESIZE_VGA;
       config.jpeg_quality = 10;
@@ -165,7 +188,11 @@ void Camera::setup()
    }
 
    // Camera init
-   esp_err_t err = esp_camera_init(&config);
+   esp_err_t err;
+   {
+      HeapScope scope(SubsysCamera);
+      err = esp_camera_init(&config);
+   }
    if (err != ESP_OK)
    {
       ERROR("**** Camera init failed with error 0x%x", err);
@@ -175,77 +202,148 @@ void Camera::setup()
       // set camera effects
       sensor_t *s = esp_camera_sensor_get();
       s->set_special_effect(s, 2); // 2 = effect black and white
+      frameSize = config.frame_size;
+      ready = true;
+      if (w.cameraValid)
+      {
+         setVerticalFlip(w.vflip);
+         setHorizontalMirror(w.hmirror);
+      }
+      WarmState &ws = warmBoot.beginUpdate();
+      ws.frameSize = config.frame_size;
+      ws.jpegQuality = config.jpeg_quality;
+      ws.fbCount = config.fb_count;
+      ws.vflip = vflip;
+      ws.hmirror = hmirror;
+      ws.cameraValid = true;
+      warmBoot.endUpdate();
    }
    LOG("<  Camera::setup\n");
 }
 
 //-------------------------
-esp_err_t Camera::capture(uint8_t **jpgBuffer, size_t &jpgBufferLen)
-// OUT: jpgBuffer:    pointer to jpg frame buffer. MUST BE RELEASED AFTER USE
-//      jpgBufferLen: length of jpg buffer
+static size_t jpegWrite(void *arg, size_t index, const void *data, size_t len)
+// frame2jpg_cb output; returns the number of bytes taken, less than len stops the conversion
+{
+   JpegOut *out = (JpegOut *)arg;
+   if (len == 0)
+      return 0;
+   if (index + len > out->size)
+   {
+      size_t size = out->size ? out->size * 2 : JPEG_FIRST_SIZE;
+      while (size < index + len)
+         size *= 2;
+      uint8_t *buf = (uint8_t *)memAlloc(size, MemJpeg);
+      if (!buf)
+         return 0;
+      if (out->buf)
+         memcpy(buf, out->buf, out->len);
+      memFree(out->buf);
+      out->buf = buf;
+      out->size = size;
+   }
+   memcpy(out->buf + index, data, len);
+   if (index + len > out->len)
+      out->len = index + len;
+   return len;
+}
+
+//-------------------------
+esp_err_t Camera::capture(CameraFrame &frame)
+// OUT: frame: the jpg frame. MUST BE RELEASED AFTER USE
 {
    esp_err_t res = ESP_OK;
-   frameBuf = esp_camera_fb_get();
-   if (!frameBuf)
+   frame.fb = esp_camera_fb_get();
+   frame.buf = nullptr;
+   frame.len = 0;
+   frame.width = 0;
+   frame.height = 0;
+   if (!frame.fb)
    {
       Serial.println("Camera capture failed");
       res = ESP_FAIL;
    }
-   else
+   else if (frame.fb->format != PIXFORMAT_JPEG)
    {
-      if (frameBuf->width > 400)
+      frame.width = frame.fb->width;
+      frame.height = frame.fb->height;
+      // convert to jpg, into a buffer from the PSRAM pools
+      JpegOut out = {nullptr, 0, 0};
+      bool jpeg_converted = frame2jpg_cb(frame.fb, 80, jpegWrite, &out);
+      esp_camera_fb_return(frame.fb); // no longer needed; we now have the jpg buffer
+      frame.fb = nullptr;
+      if (jpeg_converted)
+      {
+         frame.buf = out.buf;
+         frame.len = out.len;
+      }
+      else
       {
-         if (frameBuf->format != PIXFORMAT_JPEG)
-         {
-            // convert to jpg
-            bool jpeg_converted = frame2jpg(frameBuf, 80, &jpgBuf, &jpgBufLen);
-            esp_camera_fb_return(frameBuf); // no longer needed; we now have the jpg buffer
-            frameBuf = nullptr;
-            if (!jpeg_converted)
-            {
-               Serial.println("JPEG compression failed");
-               res = ESP_FAIL;
-            }
-         }
-         else
-         {
-            jpgBufLen = frameBuf->len;
-            jpgBuf = frameBuf->buf;
-         }
+         memFree(out.buf);
+         Serial.println("JPEG compression failed");
+         res = ESP_FAIL;
       }
    }
-   *jpgBuffer = jpgBuf;
-   jpgBufferLen = jpgBufLen;
+   else
+   {
+      frame.buf = frame.fb->buf;
+      frame.len = frame.fb->len;
+      frame.width = frame.fb->width;
+      frame.height = frame.fb->height;
+   }
    return res;
 }
 
 //--------------------------------
-void Camera::releaseFrameBuffer()
-// to be called after sending frame buffer
+void Camera::release(CameraFrame &frame)
+// to be called after sending the frame
 {
-   if (frameBuf)
+   if (frame.fb)
    {
-      esp_camera_fb_return(frameBuf);
-      frameBuf = nullptr;
-      jpgBuf = nullptr; // jpgBuf was part of frameBuf
+      esp_camera_fb_return(frame.fb); // buf was part of fb
    }
-   else if (jpgBuf)
+   else if (frame.buf)
    {
-      free(jpgBuf);
-      jpgBuf = nullptr;
+      memFree(frame.buf);
    }
+   frame.fb = nullptr;
+   frame.buf = nullptr;
+   frame.len = 0;
 }
 
 //---------------------
 void Camera::setVerticalFlip(bool flip)
 {
-   sensor_t *s = esp_camera_sensor_get();
-   s->set_vflip(s, flip ? 1 : 0); // 0 = disable , 1 = enable
+   if (ready)
+   {
+      sensor_t *s = esp_camera_sensor_get();
+      s->set_vflip(s, flip ? 1 : 0); // 0 = disable , 1 = enable
+      vflip = flip;
+      warmBoot.beginUpdate().vflip = flip;
+      warmBoot.endUpdate();
+   }
+}
+
+//-------------------------
+void Camera::setReducedFrames(bool reduce)
+{
+   if (ready && reduce != reduced && frameSize > REDUCED_FRAME_SIZE)
+   {
+      sensor_t *s = esp_camera_sensor_get();
+      s->set_framesize(s, reduce ? REDUCED_FRAME_SIZE : frameSize);
+      reduced = reduce;
+   }
 }
 
 //-------------------------
 void Camera::setHorizontalMirror(bool mirror)
 {
-   sensor_t *s = esp_camera_sensor_get();
-   s->set_hmirror(s, mirror ? 1 : 0); // 0 = disable , 1 = enable
+   if (ready)
+   {
+      sensor_t *s = esp_camera_sensor_get();
+      s->set_hmirror(s, mirror ? 1 : 0); // 0 = disable , 1 = enable
+      hmirror = mirror;
+      warmBoot.beginUpdate().hmirror = mirror;
+      warmBoot.endUpdate();
+   }
 }
@@ -8,6 +8,15 @@
 
 #include "esp_camera.h"
 
+// A captured jpg frame. Every successful capture () must be followed by a release ().
+// Frames are independent, so several streams can capture at the same time.
+struct CameraFrame {
+   camera_fb_t *fb  = nullptr;   // frame buffer; nullptr if buf was converted to jpg
+   uint8_t     *buf = nullptr;   // jpg data
+   size_t       len = 0;         // length of jpg data
+   uint16_t     width = 0;       // pixels
+   uint16_t     height = 0;
+};
 
 class Camera {
  public:
@@ -16,16 +25,23 @@ class Camera {
    void setup ();
    void loop () {}
 
-   esp_err_t capture (uint8_t **jpgBuffer, size_t &jpgBufferLen);
-   void releaseFrameBuffer ();
+   esp_err_t capture (CameraFrame &frame);
+   void release (CameraFrame &frame);
 
    void setVerticalFlip     (bool flip);
    void setHorizontalMirror (bool mirror);
+   void setReducedFrames    (bool reduce);   // smaller frames, under memory pressure
+   bool isReady             () {return ready;}
+   bool hasReducedFrames    () {return reduced;}
+   bool getVerticalFlip     () {return vflip;}
+   bool getHorizontalMirror () {return hmirror;}
 
  private:
-   camera_fb_t *frameBuf  = nullptr;
-   uint8_t     *jpgBuf    = nullptr;
-   size_t       jpgBufLen = 0;
+   bool         ready     = false;
+   bool         vflip     = false;
+   bool         hmirror   = false;
+   bool         reduced   = false;
+   framesize_t  frameSize = FRAMESIZE_VGA;   // as configured in setup ()
 };
 
 extern Camera camera;
@@ -0,0 +1,239 @@
+//
+// capture.cpp -- one task captures camera frames and shares them with all streams
+//
+// The capture task first initialises the camera, so camera probing runs in
+// parallel with the WiFi and http start in setup ().
+//
+// The capture task runs while there are subscribers, at the highest frame rate
+// any of them asked for. Each frame is published as the latest frame; viewers
+// take a reference with captureNext () and drop it with captureRelease ().
+// The camera buffer goes back to the driver when the last reference is gone,
+// so three viewers cost one capture per frame instead of three.
+//
+// The latest frame is dropped before the next capture when nobody is sending it,
+// so with one camera frame buffer (no PSRAM) the driver gets it back in time.
+//
+// Ben Slaghekke, 19 October 2026
+//
+#include <Arduino.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/event_groups.h"
+#include "tasks.h"
+#include "boot.h"
+#include "visits.h"
+#include "clip.h"
+#include "capture.h"
+
+#define _DEBUG 1
+#include "debug.h"
+
+#define N_SHARED_FRAMES (2)   // matches fb_count with PSRAM
+#define MAX_FPS (25)
+#define NEW_FRAME_BIT (1 << 0)
+#define RELEASING (-1)        // SharedFrame::refs while the buffer goes back to the driver
+
+static const char *cName = "capture";
+
+static SharedFrame frames[N_SHARED_FRAMES];
+static SharedFrame *latest = nullptr;
+static int fpsCount[MAX_FPS + 1];     // subscribers per requested frame rate
+static uint32_t frameCount = 0;
+static portMUX_TYPE frameLock = portMUX_INITIALIZER_UNLOCKED;
+static EventGroupHandle_t events = nullptr;
+static TaskHandle_t captureTask = nullptr;
+
+// forwards
+static void captureLoop(void *arg);
+static int wantedFps();
+static SharedFrame *freeFrame();
+static void dropRef(SharedFrame *f);
+
+//----------------------------
+void captureSetup()
+{
+   events = xEventGroupCreate();
+   for (int i = 0; i < N_SHARED_FRAMES; i++)
+   {
+      frames[i].seq = 0;
+      frames[i].refs = 0;
+   }
+   captureTask = startTask(CaptureTask, captureLoop, nullptr);
+}
+
+//----------------------------
+void captureSubscribe(int fps)
+{
+   fps = constrain(fps, 1, MAX_FPS);
+   portENTER_CRITICAL(&frameLock);
+   fpsCount[fps]++;
+   portEXIT_CRITICAL(&frameLock);
+   if (captureTask)
+      xTaskNotifyGive(captureTask);
+}
+
+//----------------------------
+void captureUnsubscribe(int fps)
+{
+   fps = constrain(fps, 1, MAX_FPS);
+   portENTER_CRITICAL(&frameLock);
+   if (fpsCount[fps] > 0)
+      fpsCount[fps]--;
+   portEXIT_CRITICAL(&frameLock);
+}
+
+//----------------------------
+SharedFrame *captureNext(uint32_t seq, TickType_t timeout)
+// wait for a frame newer than seq and take a reference to it
+{
+   TickType_t start = xTaskGetTickCount();
+   while (true)
+   {
+      SharedFrame *f = nullptr;
+      portENTER_CRITICAL(&frameLock);
+      if (latest && latest->seq != seq)
+      {
+         f = latest;
+         f->refs++;
+      }
+      portEXIT_CRITICAL(&frameLock);
+      if (f)
+         return f;
+
+      TickType_t waited = xTaskGetTickCount() - start;
+      if (waited >= timeout)
+         return nullptr;
+      // the bit is set and cleared at once: it wakes all waiting viewers
+      xEventGroupWaitBits(events, NEW_FRAME_BIT, pdFALSE, pdFALSE, timeout - waited);
+   }
+}
+
+//----------------------------
+void captureRelease(SharedFrame *f)
+{
+   if (f)
+      dropRef(f);
+}
+
+//----------------------------
+uint32_t captureFrameCount()
+{
+   return frameCount;
+}
+
+//--static functions---------------------------------------
+
+//----------------------------
+static void captureLoop(void *arg)
+{
+   const char *fName = "captureLoop";
+   camera.setup();
+   if (camera.isReady())
+      bootMark(BootCamera);
+
+   TickType_t nextWake = xTaskGetTickCount();
+   while (true)
+   {
+      int fps = camera.isReady() ? wantedFps() : 0;
+      if (fps == 0)
+      {
+         // nobody watching: let the last frame go, and sleep until a subscription
+         portENTER_CRITICAL(&frameLock);
+         SharedFrame *old = latest;
+         latest = nullptr;
+         portEXIT_CRITICAL(&frameLock);
+         if (old)
+            dropRef(old);
+         ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+         nextWake = xTaskGetTickCount();
+         continue;
+      }
+
+      SharedFrame *f = freeFrame();
+      if (f && camera.capture(f->frame) == ESP_OK)
+      {
+         portENTER_CRITICAL(&frameLock);
+         SharedFrame *old = latest;
+         f->seq = ++frameCount;
+         f->refs = 1; // the latest frame reference
+         latest = f;
+         portEXIT_CRITICAL(&frameLock);
+         bootMark(BootFirstFrame);
+         visitsFrame(f->frame); // only its size: no time to speak of
+         clipFrame(f->frame);   // a copy into the pre-trigger ring, at most its RING_FPS
+         if (old)
+            dropRef(old);
+         xEventGroupSetBits(events, NEW_FRAME_BIT);
+         xEventGroupClearBits(events, NEW_FRAME_BIT);
+      }
+      else if (f)
+         WARNING("%s: %s: capture failed\n", cName, fName);
+
+      // a viewer that falls behind simply gets fewer frames; the grid is not caught up
+      const TickType_t period = pdMS_TO_TICKS(1000 / fps) > 0 ? pdMS_TO_TICKS(1000 / fps) : 1;
+      TickType_t now = xTaskGetTickCount();
+      if (now - nextWake > period)
+         nextWake = now;
+      else
+         vTaskDelayUntil(&nextWake, period);
+   }
+}
+
+//----------------------------
+static int wantedFps()
+{
+   int fps = 0;
+   portENTER_CRITICAL(&frameLock);
+   for (int i = MAX_FPS; i > 0 && fps == 0; i--)
+   {
+      if (fpsCount[i] > 0)
+         fps = i;
+   }
+   portEXIT_CRITICAL(&frameLock);
+   return fps;
+}
+
+//----------------------------
+static SharedFrame *freeFrame()
+// a frame slot nobody uses, or nullptr; the latest frame is dropped if nobody sends it
+{
+   SharedFrame *f = nullptr;
+   SharedFrame *old = nullptr;
+   portENTER_CRITICAL(&frameLock);
+   if (latest && latest->refs == 1)
+   {
+      old = latest;
+      latest = nullptr;
+   }
+   portEXIT_CRITICAL(&frameLock);
+   if (old)
+      dropRef(old);
+
+   portENTER_CRITICAL(&frameLock);
+   for (int i = 0; i < N_SHARED_FRAMES && !f; i++)
+   {
+      if (frames[i].refs == 0)
+         f = &frames[i];
+   }
+   portEXIT_CRITICAL(&frameLock);
+   return f;
+}
+
+//----------------------------
+static void dropRef(SharedFrame *f)
+{
+   bool last = false;
+   portENTER_CRITICAL(&frameLock);
+   if (f->refs > 0 && --f->refs == 0)
+   {
+      last = true;
+      f->refs = RELEASING; // not free until the buffer is back
+   }
+   portEXIT_CRITICAL(&frameLock);
+   if (last)
+   {
+      camera.release(f->frame);
+      portENTER_CRITICAL(&frameLock);
+      f->refs = 0;
+      portEXIT_CRITICAL(&frameLock);
+   }
+}
@@ -0,0 +1,25 @@
+//
+// capture.h -- one task captures camera frames and shares them with all streams
+//
+// Ben Slaghekke, 19 October 2026
+//
+#ifndef _CAPTURE_H
+#define _CAPTURE_H
+
+#include <Arduino.h>
+#include "camera.h"
+
+struct SharedFrame {
+   CameraFrame frame;
+   uint32_t    seq;     // frame number, 0 = never captured
+   int         refs;    // viewers sending it, plus one while it is the latest frame
+};
+
+extern void         captureSetup       ();            // start the capture task, which initialises the camera
+extern void         captureSubscribe   (int fps);     // a viewer wants frames at this rate
+extern void         captureUnsubscribe (int fps);
+extern SharedFrame *captureNext        (uint32_t seq, TickType_t timeout); // a frame newer than seq, or nullptr
+extern void         captureRelease     (SharedFrame *f);
+extern uint32_t     captureFrameCount  ();            // frames captured since boot
+
+#endif
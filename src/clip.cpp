@@ -0,0 +1,252 @@
+//
+// clip.cpp -- pre-trigger clip: the last seconds of jpg frames, frozen on a trigger
+//
+// The capture task copies every frame (at most RING_FPS) into a ring of
+// RING_BYTES in PSRAM; the bookkeeping of the ring, the freeze and the state
+// word is in lib/clipring (clipring.h), so it is tested on the host.
+//
+// A trigger (POST /api/clip, a motion event, the shutter opening) freezes the
+// window: the capture task stops writing at its next frame, and the frames
+// in the ring at that moment are the clip. GET /api/clip sends them from the
+// ring itself, without a copy. The clip stays frozen until it is released
+// (POST /api/clip), or for HOLD_MS when nobody exports it; then recording
+// goes on where it stopped.
+//
+// Like a stream (stream.cpp), GET /api/clip is detached from the http server
+// task and sent by an export task, so neither the wait for an asked freeze
+// nor up to RING_BYTES of frames hold up the server task. One more export
+// may wait for the task; beyond that the reply is a 503.
+//
+// No lock: the capture task is the only writer of the ring. Triggers,
+// exporters and the release only change the state word of the ring.
+//
+// Ben Slaghekke, 19 October 2026
+//
+#include <Arduino.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "capture.h"
+#include "allocator.h"
+#include "tasks.h"
+#include "httpsupp.h"
+#include "clip.h"
+#include "clipring.h"
+
+#define _DEBUG 1
+#include "debug.h"
+
+#define RING_BYTES (1024 * 1024)  // the budget, in PSRAM
+#define WINDOW_MS (10000)         // frames older than this are dropped
+#define RING_FPS (5)              // also the capture subscription
+#define MIN_SPACING_MS (150)      // between kept frames: 3/4 of a RING_FPS period, so capture jitter skips none
+#define HOLD_MS (60000)           // a frozen clip that is not exported is released after this
+#define FREEZE_WAIT_MS (1000)     // an export waits this long for an asked freeze
+#define EXPORT_QUEUE_LEN (1)      // exports waiting for the export task
+#define RETRY_AFTER_SECONDS "5"
+#define CLIP_BOUNDARY "123456789000000000000987654321"
+
+static const char *_CLIP_CONTENT_TYPE = "multipart/x-mixed-replace;boundary=" CLIP_BOUNDARY;
+static const char *_CLIP_FIRST = "--" CLIP_BOUNDARY "\r\n";
+static const char *_CLIP_NEXT = "\r\n--" CLIP_BOUNDARY "\r\n";
+static const char *_CLIP_LAST = "\r\n--" CLIP_BOUNDARY "--\r\n";
+static const char *_CLIP_PART = "Content-Type: image/jpeg\r\nContent-Length: %u\r\nX-Clip-Offset-Ms: %d\r\n\r\n";
+
+static const char *cName = "clip";
+static const char *triggerName[N_CLIP_TRIGGERS] = {"api", "motion", "shutter"};
+
+static const ClipRingConfig ringConfig = {RING_BYTES, WINDOW_MS, MIN_SPACING_MS, HOLD_MS};
+static ClipRing clipRing(ringConfig);
+static QueueHandle_t exportQueue = nullptr; // detached GET /api/clip requests
+static uint32_t triggers[N_CLIP_TRIGGERS];  // freezes, by trigger; written by the capture task
+
+// forwards
+static bool pin();
+static void exportTask(void *arg);
+static esp_err_t sendClip(httpd_req_t *req);
+
+//----------------------------
+void clipSetup()
+{
+   const char *fName = "clipSetup";
+   uint8_t *ring = (uint8_t *)memAlloc(RING_BYTES, MemClip);
+   if (!ring)
+   {
+      ERROR("%s: %s: no memory for the ring, no pre-trigger clips\n", cName, fName);
+      return;
+   }
+   clipRing.begin(ring);
+   exportQueue = xQueueCreate(EXPORT_QUEUE_LEN, sizeof(httpd_req_t *));
+   startTask(ClipTask, exportTask, nullptr);
+   captureSubscribe(RING_FPS);
+   LOG(">< %s: %s: %u KB ring\n", cName, fName, RING_BYTES / 1024);
+}
+
+//----------------------------
+void clipFrame(const CameraFrame &frame)
+// the capture task: the only writer of the ring
+{
+   ClipRing::Event event = clipRing.frame(frame.buf, frame.len, millis());
+   if (event == ClipRing::Released)
+      LOG(">< %s: clip not exported in %u s, released\n", cName, HOLD_MS / 1000);
+   else if (event == ClipRing::Frozen)
+   {
+      const FrozenClip &frozen = clipRing.frozen();
+      triggers[frozen.why]++;
+      LOG(">< %s: frozen by %s: %u frames, %u bytes\n", cName, triggerName[frozen.why], (unsigned)frozen.count,
+          (unsigned)frozen.bytes);
+   }
+}
+
+//----------------------------
+bool clipTrigger(ClipTrigger why)
+{
+   return clipRing.trigger(int(why));
+}
+
+//----------------------------
+bool clipRelease()
+{
+   return clipRing.release();
+}
+
+//----------------------------
+esp_err_t clipExport(httpd_req_t *req)
+// runs in the http server task; hands the request to the export task
+{
+   const char *fName = "clipExport";
+   if (!exportQueue)
+   {
+      sendError(req, HTTPD_404_NOT_FOUND, "no pre-trigger clips");
+      return ESP_FAIL;
+   }
+   if (uxQueueSpacesAvailable(exportQueue) == 0) // only this task sends to the queue: no race
+   {
+      WARNING("%s: %s: busy exporting, refuse\n", cName, fName);
+      httpd_resp_set_hdr(req, "Retry-After", RETRY_AFTER_SECONDS);
+      noteStatus(503);
+      httpd_resp_set_status(req, "503 Service Unavailable");
+      return httpd_resp_send(req, "Busy exporting a clip", HTTPD_RESP_USE_STRLEN);
+   }
+   httpd_req_t *job = nullptr;
+   esp_err_t res = httpd_req_async_handler_begin(req, &job);
+   if (res == ESP_OK && xQueueSend(exportQueue, &job, 0) != pdTRUE)
+   {
+      httpd_req_async_handler_complete(job);
+      res = ESP_FAIL;
+   }
+   if (res != ESP_OK)
+      ERROR("%s: %s: could not hand over export request\n", cName, fName);
+   return res;
+}
+
+//----------------------------
+void clipWriteStatus(JsonWriter &w)
+{
+   w.beginObject("clip");
+   w.add("state", clipRing.isOn() ? ClipRing::stateName(clipRing.state()) : "off");
+   w.add("frames", clipRing.frameCount());
+   w.add("bytes", clipRing.bytes());
+   w.endObject();
+}
+
+//----------------------------
+void clipWriteReport(JsonWriter &w)
+{
+   int s = clipRing.state();
+   w.beginObject();
+   w.add("state", clipRing.isOn() ? ClipRing::stateName(s) : "off");
+   w.add("budgetBytes", clipRing.isOn() ? RING_BYTES : 0);
+   w.add("fps", RING_FPS);
+   w.add("windowMs", WINDOW_MS);
+   w.add("frames", clipRing.frameCount());
+   w.add("bytes", clipRing.bytes());
+   if (clipRing.frameCount())
+      w.add("spanMs", clipRing.spanMs());
+   w.add("stored", clipRing.stored());
+   w.add("evictedBytes", clipRing.evictedBytes());
+   w.add("evictedAge", clipRing.evictedAge());
+   w.add("tooLarge", clipRing.tooLarge());
+   w.add("skippedFrozen", clipRing.skippedFrozen());
+   w.add("busyTriggers", clipRing.busyTriggers());
+   w.beginObject("triggers");
+   for (int i = 0; i < N_CLIP_TRIGGERS; i++)
+      w.add(triggerName[i], triggers[i]);
+   w.endObject();
+   if (s >= 0)
+   {
+      // the capture task does not touch the frozen clip until it is released
+      const FrozenClip &frozen = clipRing.frozen();
+      w.beginObject("frozen");
+      w.add("trigger", triggerName[frozen.why]);
+      w.add("secondsAgo", (millis() - frozen.at) / 1000);
+      w.add("frames", frozen.count);
+      w.add("bytes", frozen.bytes);
+      if (frozen.count)
+         w.add("firstOffsetMs", int(clipRing.frameAt(frozen.first).ms - frozen.at));
+      w.add("exporters", s);
+      w.endObject();
+   }
+   w.endObject();
+}
+
+//--static functions---------------------------------------
+
+//----------------------------
+static bool pin()
+// count an exporter in while a clip is frozen; waits for a freeze that was asked for
+{
+   uint32_t start = millis();
+   ClipRing::PinResult p;
+   while ((p = clipRing.pin()) == ClipRing::Freezing && millis() - start <= FREEZE_WAIT_MS)
+      vTaskDelay(pdMS_TO_TICKS(10));
+   return p == ClipRing::Pinned;
+}
+
+//----------------------------
+static void exportTask(void *arg)
+{
+   httpd_req_t *req;
+   while (true)
+   {
+      if (xQueueReceive(exportQueue, &req, portMAX_DELAY) == pdTRUE)
+      {
+         sendClip(req);
+         httpd_req_async_handler_complete(req);
+      }
+   }
+}
+
+//----------------------------
+static esp_err_t sendClip(httpd_req_t *req)
+// the frames of the frozen clip straight from the ring; oldest first
+{
+   const char *fName = "sendClip";
+   if (!pin())
+   {
+      sendError(req, HTTPD_404_NOT_FOUND, "no frozen clip; POST {\"cmd\": \"trigger\"} first");
+      return ESP_FAIL;
+   }
+   const FrozenClip &frozen = clipRing.frozen();
+   LOG(">  %s: %s: %u frames, %u bytes\n", cName, fName, (unsigned)frozen.count, (unsigned)frozen.bytes);
+
+   char part[112];
+   esp_err_t res = httpd_resp_set_type(req, _CLIP_CONTENT_TYPE);
+   if (res == ESP_OK)
+      res = httpd_resp_send_chunk(req, _CLIP_FIRST, strlen(_CLIP_FIRST));
+   for (uint32_t i = 0; i < frozen.count && res == ESP_OK; i++)
+   {
+      const ClipRingFrame &f = clipRing.frameAt(frozen.first + i);
+      size_t hlen = snprintf(part, sizeof(part), _CLIP_PART, (unsigned)f.len, int(f.ms - frozen.at));
+      res = httpd_resp_send_chunk(req, part, hlen);
+      if (res == ESP_OK)
+         res = httpd_resp_send_chunk(req, (const char *)clipRing.data(f), f.len);
+      const char *boundary = i + 1 < frozen.count ? _CLIP_NEXT : _CLIP_LAST;
+      if (res == ESP_OK)
+         res = httpd_resp_send_chunk(req, boundary, strlen(boundary));
+   }
+   if (res == ESP_OK)
+      res = httpd_resp_send_chunk(req, nullptr, 0);
+   clipRing.unpin();
+   LOG("<  %s: %s: res = %d\n", cName, fName, res);
+   return res;
+}
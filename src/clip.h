@@ -0,0 +1,23 @@
+//
+// clip.h -- pre-trigger clip: the last seconds of jpg frames, frozen on a trigger
+//
+// Ben Slaghekke, 19 October 2026
+//
+#ifndef _CLIP_H
+#define _CLIP_H
+
+#include "esp_http_server.h"
+#include "camera.h"
+#include "json.h"
+
+enum ClipTrigger {ClipApi, ClipMotion, ClipShutter, N_CLIP_TRIGGERS};
+
+extern void      clipSetup       ();                         // allocate the ring and start recording; after captureSetup ()
+extern void      clipFrame       (const CameraFrame &frame); // every captured frame, from the capture task
+extern bool      clipTrigger     (ClipTrigger why);          // freeze the window at the next frame; false if one is frozen
+extern bool      clipRelease     ();                         // record again; false if not frozen or being exported
+extern esp_err_t clipExport      (httpd_req_t *req);         // the frozen window as multipart jpg, sent from the ring by the export task
+extern void      clipWriteStatus (JsonWriter &w);            // "clip": {...} for /api/status
+extern void      clipWriteReport (JsonWriter &w);            // the /api/clip control reply
+
+#endif
@@ -0,0 +1,299 @@
+//
+// detector.cpp -- motion detection on the shared camera frames
+//
+// The detect task subscribes to the capture task at DETECT_FPS, so frames are
+// captured also when nobody watches, and are shared with the streams when
+// somebody does. The capture task then runs at the highest rate subscribed,
+// so the detect task paces itself: one frame per 1/DETECT_FPS s, whatever the
+// number of viewers, which keeps the frame counts in motionConfig in seconds
+// and its CPU load fixed. Of every frame only the DC coefficients of the luminance
+// blocks are decoded (jpegdc.h): the mean of every 8 x 8 block, so a VGA
+// frame becomes 80 x 60 pixels without IDCT or colour conversion. That map
+// is fed to the motion engine (motion.h).
+//
+// Events are logged and the last MAX_EVENTS are kept for /api/motion, with
+// the time spent decoding and detecting.
+//
+// Ben Slaghekke, 19 October 2026
+//
+#include <Arduino.h>
+#include "esp_timer.h"
+#include "jpegdc.h"
+#include "motion.h"
+#include "tasks.h"
+#include "capture.h"
+#include "allocator.h"
+#include "clip.h"
+#include "detector.h"
+
+#define _DEBUG 1
+#include "debug.h"
+
+#define DETECT_FPS (2)
+#define MAX_EVENTS (8)
+#define FRAME_TIMEOUT (pdMS_TO_TICKS(2000))
+
+static const MotionConfig motionConfig = {
+   12,  // blockThreshold: mean difference of a changed block
+   2,   // minBlocks
+   600, // globalPermille: more than 60 % of the blocks changed is the light
+   2,   // startFrames: 1 s at DETECT_FPS
+   6,   // endFrames: 3 s
+   2,   // learnShift: quiet blocks follow the frame with 1/4
+   7,   // holdShift: changed blocks with 1/128, so a bird that stays is absorbed in a few minutes
+};
+
+struct MotionEvent
+{
+   uint32_t startMs; // millis ()
+   uint32_t endMs;   // 0 while going on
+   uint16_t score;
+   MotionBox box;
+};
+
+static MotionEngine engine(motionConfig);
+static JpegDc jpegDc;           // Huffman tables: static, not on the task stack
+static uint8_t *gray = nullptr; // block means of the frame
+static uint8_t *background = nullptr;
+static size_t bufferPixels = 0; // that the buffers hold
+
+// for the reports, under detectLock
+static MotionResult lastResult = {};
+static uint32_t lastMasks[MotionEngine::MAX_HEIGHT / MotionEngine::BLOCK];
+static int blockRows = 0;
+static int frameWidth = 0;
+static int frameHeight = 0;
+static MotionEvent events[MAX_EVENTS]; // ring
+static int nEvents = 0;                // since boot
+static uint32_t framesAnalysed = 0;
+static uint32_t decodeFailures = 0;
+static JpegDc::Result lastFailure = JpegDc::Ok;
+static uint32_t decodeUs = 0;          // last frame
+static uint32_t detectUs = 0;
+static uint32_t maxDecodeUs = 0;
+static uint32_t maxDetectUs = 0;
+static portMUX_TYPE detectLock = portMUX_INITIALIZER_UNLOCKED;
+
+static const char *cName = "detector";
+
+// forwards
+static void detectLoop(void *arg);
+static bool decode(const CameraFrame &frame, int &width, int &height);
+static bool allocBuffers(size_t pixels);
+static void record(const MotionResult &r);
+static void writeBox(JsonWriter &w, const char *key, const MotionBox &b);
+
+//----------------------------
+void detectorSetup()
+{
+   startTask(DetectTask, detectLoop, nullptr);
+}
+
+//----------------------------
+void detectorWriteStatus(JsonWriter &w)
+{
+   w.beginObject("motion");
+   portENTER_CRITICAL(&detectLock);
+   bool inEvent = lastResult.inEvent;
+   int n = nEvents;
+   uint32_t frames = framesAnalysed;
+   portEXIT_CRITICAL(&detectLock);
+   w.add("inEvent", inEvent);
+   w.add("events", n);
+   w.add("frames", frames);
+   w.endObject();
+}
+
+//----------------------------
+void detectorWriteReport(JsonWriter &w)
+{
+   MotionEvent ev[MAX_EVENTS];
+   uint32_t masks[MotionEngine::MAX_HEIGHT / MotionEngine::BLOCK];
+   portENTER_CRITICAL(&detectLock);
+   memcpy(ev, events, sizeof(ev));
+   memcpy(masks, lastMasks, sizeof(masks));
+   int n = nEvents;
+   MotionResult r = lastResult;
+   int rows = blockRows;
+   int width = frameWidth;
+   int height = frameHeight;
+   portEXIT_CRITICAL(&detectLock);
+
+   w.beginObject();
+   w.add("width", width);
+   w.add("height", height);
+   w.add("frames", framesAnalysed);
+   w.add("decodeFailures", decodeFailures);
+   w.add("lastFailure", JpegDc::resultName(lastFailure));
+   w.add("decodeUs", decodeUs);
+   w.add("detectUs", detectUs);
+   w.add("maxDecodeUs", maxDecodeUs);
+   w.add("maxDetectUs", maxDetectUs);
+   w.add("motion", r.motion);
+   w.add("lightChange", r.lightChange);
+   w.add("score", r.score);
+   w.add("inEvent", r.inEvent);
+   w.beginArray("changedBlocks"); // per row of blocks, bit n: column n
+   for (int i = 0; i < rows; i++)
+      w.add(nullptr, masks[i]);
+   w.endArray();
+   w.add("events", n);
+   w.beginArray("recent"); // newest first
+   for (int i = 0; i < n && i < MAX_EVENTS; i++)
+   {
+      const MotionEvent &e = ev[(n - 1 - i) % MAX_EVENTS];
+      w.beginObject();
+      w.add("secondsAgo", (millis() - e.startMs) / 1000);
+      w.add("durationMs", e.endMs ? e.endMs - e.startMs : millis() - e.startMs);
+      w.add("score", e.score);
+      writeBox(w, "box", e.box);
+      w.endObject();
+   }
+   w.endArray();
+   w.endObject();
+}
+
+//--static functions---------------------------------------
+
+//----------------------------
+static void detectLoop(void *arg)
+{
+   const char *fName = "detectLoop";
+   captureSubscribe(DETECT_FPS);
+   uint32_t seq = 0;
+   const TickType_t period = pdMS_TO_TICKS(1000 / DETECT_FPS);
+   TickType_t nextWake = xTaskGetTickCount();
+   while (true)
+   {
+      // fixed grid, as in stream.cpp; after falling behind more than a period, restart it
+      TickType_t now = xTaskGetTickCount();
+      if (now - nextWake > period)
+         nextWake = now;
+      else
+         vTaskDelayUntil(&nextWake, period);
+
+      SharedFrame *f = captureNext(seq, FRAME_TIMEOUT);
+      if (!f)
+         continue; // camera not (yet) ready
+      seq = f->seq;
+      int width, height;
+      int64_t start = esp_timer_get_time();
+      bool decoded = decode(f->frame, width, height);
+      captureRelease(f);
+      int64_t decodedAt = esp_timer_get_time();
+      if (!decoded)
+      {
+         decodeFailures++;
+         continue;
+      }
+
+      if (width != engine.width() || height != engine.height())
+      {
+         // first frame, or the frame size changed (see Camera::setReducedFrames)
+         LOG(">< %s: %s: %d x %d\n", cName, fName, width, height);
+         engine.begin(width, height, background);
+      }
+      const MotionResult &r = engine.update(gray);
+      detectUs = uint32_t(esp_timer_get_time() - decodedAt);
+      decodeUs = uint32_t(decodedAt - start);
+
+      portENTER_CRITICAL(&detectLock);
+      lastResult = r;
+      blockRows = engine.blockRows();
+      for (int i = 0; i < blockRows; i++)
+         lastMasks[i] = engine.changedMask(i);
+      frameWidth = width;
+      frameHeight = height;
+      framesAnalysed++;
+      record(r);
+      portEXIT_CRITICAL(&detectLock);
+      if (decodeUs > maxDecodeUs)
+         maxDecodeUs = decodeUs;
+      if (detectUs > maxDetectUs)
+         maxDetectUs = detectUs;
+
+      if (r.eventStart)
+      {
+         LOG("   %s: motion, score %u, at %u,%u - %u,%u\n", cName, r.score, r.box.x0, r.box.y0, r.box.x1, r.box.y1);
+         clipTrigger(ClipMotion); // the seconds before the motion
+      }
+      if (r.eventEnd)
+         LOG("   %s: motion ended after %u frames, score %u\n", cName, (unsigned)r.eventFrames, r.eventScore);
+   }
+}
+
+//----------------------------
+static bool decode(const CameraFrame &frame, int &width, int &height)
+// the block means of the frame into gray; the width is cut to a multiple of the motion block size
+{
+   const char *fName = "decode";
+   width = (frame.width / 8) & ~(MotionEngine::BLOCK - 1);
+   height = (frame.height + 7) / 8;
+   if (width == 0 || height == 0 || width > MotionEngine::MAX_WIDTH || height > MotionEngine::MAX_HEIGHT ||
+       !allocBuffers(size_t(width) * height))
+      return false;
+   JpegDc::Result r = jpegDc.decode(frame.buf, frame.len, gray, width, height);
+   if (r != JpegDc::Ok)
+   {
+      if (r != lastFailure)
+         WARNING("%s: %s: %s\n", cName, fName, JpegDc::resultName(r));
+      lastFailure = r;
+      return false;
+   }
+   return true;
+}
+
+//----------------------------
+static bool allocBuffers(size_t pixels)
+// buffers for frames of this many pixels; kept while frames do not grow
+{
+   if (pixels <= bufferPixels)
+      return true;
+   memFree(gray);
+   memFree(background);
+   engine.begin(0, 0, nullptr); // the background goes
+   gray = (uint8_t *)memAlloc(pixels, MemMotion);
+   background = (uint8_t *)memAlloc(pixels, MemMotion);
+   if (!gray || !background)
+   {
+      memFree(gray);
+      memFree(background);
+      gray = background = nullptr;
+      bufferPixels = 0;
+      return false;
+   }
+   bufferPixels = pixels;
+   return true;
+}
+
+//----------------------------
+static void record(const MotionResult &r)
+// keep the events; called with detectLock taken
+{
+   if (r.eventStart)
+   {
+      MotionEvent &e = events[nEvents % MAX_EVENTS];
+      e.startMs = millis();
+      e.endMs = 0;
+      nEvents++;
+   }
+   if (r.inEvent || r.eventEnd)
+   {
+      MotionEvent &e = events[(nEvents - 1) % MAX_EVENTS];
+      e.score = r.eventScore;
+      e.box = r.eventBox;
+      if (r.eventEnd)
+         e.endMs = millis();
+   }
+}
+
+//----------------------------
+static void writeBox(JsonWriter &w, const char *key, const MotionBox &b)
+{
+   w.beginArray(key); // x0, y0, x1, y1 in pixels of the decoded frame
+   w.add(nullptr, b.x0);
+   w.add(nullptr, b.y0);
+   w.add(nullptr, b.x1);
+   w.add(nullptr, b.y1);
+   w.endArray();
+}
@@ -0,0 +1,15 @@
+//
+// detector.h -- motion detection on the shared camera frames
+//
+// Ben Slaghekke, 19 October 2026
+//
+#ifndef _DETECTOR_H
+#define _DETECTOR_H
+
+#include "json.h"
+
+extern void detectorSetup       ();              // start the detect task; after captureSetup ()
+extern void detectorWriteStatus (JsonWriter &w); // "motion": {...} for /api/status
+extern void detectorWriteReport (JsonWriter &w); // the /api/motion document
+
+#endif
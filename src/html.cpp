@@ -68,29 +68,42 @@ const char PROGMEM shutterOpenBody[] = R"rawliteral(
    <a href="siteinfo"> Stel site info in </a><br>
 )rawliteral";
 
+// The close is only posted when this page is sent; the script follows it through /ws
 const char PROGMEM page3Body[] = R"rawliteral(
-   <h2>De sluiter is gesloten. U kunt de batterij veilig afkoppelen.</h2>
+   <h2 id="closing">De sluiter wordt gesloten...</h2>
+   <h2 id="closed" style="display:none">De sluiter is gesloten. U kunt de batterij veilig afkoppelen.</h2>
    <a href="page2"> Terug naar het camerabeeld </a><br><br><br>
    <a href="siteinfo"> Stel site info in </a><br>
+
+   <script>
+      // a new client gets the current status first, then every change
+      var ws = new WebSocket("ws://" + window.location.host + "/ws");
+      ws.onmessage = function (e) {
+         var s = JSON.parse(e.data);
+         var closed = s.state == "Closed" && !s.moving;
+         document.getElementById("closing").style.display = closed ? "none" : "";
+         document.getElementById("closed").style.display = closed ? "" : "none";
+      };
+   </script>
 )rawliteral";
 
 const char PROGMEM siteInfoBody[] = R"rawliteral(
 <form action="/siteinfo2" action=GET>
 <br>
   <label for="sitename">Site naam:</label><br>
-  <input type="text" id="sitename" name="sitename" value="$site$"><br>
+  <input type="text" id="sitename" name="sitename" maxlength="47" value="$site$"><br>
 <br>
 <br>
   <label for="Comment">Commentaar:</label><br>
-  <input type="text" id="comment" name="comment" value="$comment$"><br>
+  <input type="text" id="comment" name="comment" maxlength="95" value="$comment$"><br>
 <br>
 <h3>Als de camera moet inloggen op een Wifi netwerk, specificeer het volgende:</h3>
 <br>
   <label for="SSID">SSID:</label><br>
-  <input type="text" id="SSID" name="SSID" value="$SSID$">
+  <input type="text" id="SSID" name="SSID" maxlength="32" value="$SSID$">
 <br> <br>
   <label for="Password">Wachtwoord:</label><br>
-  <input type="text" id="Password" name="Password" value="$pass$"><br>
+  <input type="text" id="Password" name="Password" maxlength="64" value="$pass$"><br>
 <br>
   <input type="submit" id="Exit" name="Exit" value="OK"> <sp> <sp> <sp> <sp> 
   <input type="submit" id="Exit" name="Exit" value="Cancel">
@@ -98,29 +111,39 @@ const char PROGMEM siteInfoBody[] = R"rawliteral(
 </form> 
 )rawliteral";
 
-const char PROGMEM rebootBody[] = R"rawliteral(
-   <h2>De SSID of het wachtwoord is gewijzigd.</h2>
-   <p style="text-align:left">De camera reboot nu en probeert in te loggen op het netwerk. 
-       Controleer dat het WiFi access point is verdwenen. Als het access point na 1 minuut nog is verdwenen 
-       log dan in op het ingestelde WiFi netwerk en zoek de camera. </p>
-   <p style="text-align:left"> Als het WiFi access point nog bestaat, ga dan weer naar de configure page en probeer het opnieuw. </p>
+// $SSID$ is the new network. The script follows the switch through /api/status
+const char PROGMEM wifiSwitchBody[] = R"rawliteral(
+   <h2>De camera probeert in te loggen op netwerk $SSID$</h2>
+   <p id="result" style="text-align:left">Even geduld...</p>
+   <p style="text-align:left"> Als deze pagina niet meer reageert, verbind dan met het WiFi access point
+       van de camera en ga naar http://192.168.1.1 </p>
+   <a href="/"> Terug naar het beginscherm </a>
+
+   <script>
+      function poll() {
+         fetch("/api/status").then(function (r) { return r.json(); }).then(function (st) {
+            var w = st.wifi;
+            if (w.switch == "Succeeded")
+               document.getElementById("result").textContent =
+                  "Gelukt: de camera is verbonden met " + w.ssid + ", IP adres " + w.ip;
+            else if (w.switch == "Failed")
+               document.getElementById("result").textContent =
+                  "Inloggen is niet gelukt. De vorige instellingen zijn weer actief.";
+            else
+               setTimeout(poll, 1000);
+         }).catch(function () { setTimeout(poll, 2000); });
+      }
+      poll();
+   </script>
 )rawliteral";
 
 //
-// NOTE: this page is called http://1.2.3.4/page2/
-// ****
-// The script changes this URI into text   http://1.2.3.4:81/stream
-// So the (0,-6) refers to the length of the page name excluding the /page2/
-// Beware if you change the page name!
+// The stream is served by the same server as this page, at /stream
 //
 const char PROGMEM page2Body[] = R"rawliteral(
-    <img src="" id="photo" >
+    <img src="/stream" id="photo" >
     <br>
     <a href="page3"> Sluit de sluiter </a>
-
-   <script>
-      window.onload = document.getElementById("photo").src = window.location.href.slice(0, -6) + ":81/stream";
-   </script>
 )rawliteral";
 
 const char PROGMEM endHtml[] = R"rawliteral(
@@ -137,9 +160,9 @@ const char PROGMEM adjustHtml[] = R"rawliteral(
 <link rel="stylesheet" href="styles.css">
 </head>
 <body>
-<form action="/adjust2">
+<form action="/adjust2" id="adjust">
   <h3> Sluiter afstelling </h3>
-  <h5>$SHUTTERPOS$</h5>
+  <h5 id="shutterpos">$SHUTTERPOS$</h5>
   <br>
 
   <label for="opos">Open positie (0..180):</label>
@@ -160,7 +183,7 @@ const char PROGMEM adjustHtml[] = R"rawliteral(
   <input type="number" id="speed" name="speed" min="1" max="400" value="$SPEED$" />
   <label unit="spd">gr/sec</label>
   <br><br>
-  <p>Totaal aantal sluiter bewegingen totnutoe: $TOTALMOVES$</p>  <br>
+  <p>Totaal aantal sluiter bewegingen totnutoe: <span id="totalmoves">$TOTALMOVES$</span></p>  <br>
   <br>
   <label for="ntimes">Beweeg de sluiter</label>
   <input type="number" id="ntimes" name="ntimes" min="0" max="1000" value="$MOVESLEFT$" />
@@ -170,5 +193,58 @@ const char PROGMEM adjustHtml[] = R"rawliteral(
   <input type="submit" id="Exit" name="Exit" value="OK">&nbsp&nbsp&nbsp&nbsp
   <input type="submit" id="Exit" name="Exit" value="Cancel">
 </form> 
+
+<script>
+   // The buttons use the JSON api (see api.cpp); the form is only submitted
+   // by browsers that do not tell which button was pressed.
+   function value(id) { return Number(document.getElementById(id).value); }
+
+   var leaving = false; // after OK or Cancel: go to the start page once the shutter is closed
+
+   function show(s) {
+      document.getElementById("shutterpos").textContent =
+         s.moving ? "" : s.state == "Open" ? "De sluiter is nu open" : s.state == "Closed" ? "De sluiter is nu gesloten" : "";
+      document.getElementById("totalmoves").textContent = s.totalMoves;
+      document.getElementById("ntimes").value = s.movesLeft;
+      if (leaving && s.state == "Closed" && !s.moving)
+         window.location.href = "/";
+   }
+
+   // the socket only sends changes, so a close that ends within one frame
+   // interval is not seen; then the status is fetched instead
+   function pollClosed() {
+      fetch("/api/status").then(function (r) { return r.json(); })
+         .then(function (st) { show(st.shutter); setTimeout(pollClosed, 1000); })
+         .catch(function () { setTimeout(pollClosed, 2000); });
+   }
+
+   // progress of (repeated) moves is pushed by the camera
+   var ws = new WebSocket("ws://" + window.location.host + "/ws");
+   ws.onmessage = function (e) { show(JSON.parse(e.data)); };
+
+   // the reply is the status right after the command was posted; the move follows through the socket
+   function shutterCmd(cmd) {
+      var body = { cmd: cmd, openDeg: value("openpos"), closedDeg: value("clpos"),
+                   speed: value("speed"), n: value("ntimes") };
+      return fetch("/api/shutter", { method: "POST", body: JSON.stringify(body) })
+                .then(function (r) { return r.json(); })
+                .then(show);
+   }
+
+   document.getElementById("adjust").onsubmit = function (e) {
+      if (!e.submitter)
+         return; // plain form submit
+      e.preventDefault();
+      var v = e.submitter.value;
+      if (v == "Open")
+         shutterCmd("open");
+      else if (v == "Sluit")
+         shutterCmd("close");
+      else if (v == "Start bewegingen")
+         shutterCmd("moves");
+      else
+         shutterCmd(v == "OK" ? "save" : "cancel").then(function () { leaving = true; pollClosed(); });
+   };
+</script>
 </body>
 )rawliteral";
\ No newline at end of file
@@ -19,6 +19,6 @@ extern const char PROGMEM shutterOpenBody [];
 extern const char PROGMEM page2Body       [];
 extern const char PROGMEM page3Body       [];
 extern const char PROGMEM siteInfoBody    [];
-extern const char PROGMEM rebootBody      [];
+extern const char PROGMEM wifiSwitchBody  [];
 extern const char PROGMEM endHtml         [];
 extern const char PROGMEM adjustHtml      [];
\ No newline at end of file
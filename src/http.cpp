@@ -6,6 +6,8 @@
 //
 #include <Arduino.h>
 #include <Preferences.h>
+#include <lwip/sockets.h>
+#include "esp_heap_caps.h"
 
 #include "html.h"
 #include "camera.h"
@@ -13,21 +15,21 @@
 
 #include "myWifi.h"
 #include "adjust.h"
+#include "api.h"
+#include "websock.h"
+#include "stream.h"
+#include "tasks.h"
 #include "httpsupp.h"
 #include "http.h"
+#include "heapscope.h"
 
 #define _DEBUG 1
 #include "debug.h"
 
-#define PART_BOUNDARY "123456789000000000000987654321"
 #define BLANK_PASSWORD "******"
 
-static const char *_STREAM_CONTENT_TYPE = "multipart/x-mixed-replace;boundary=" PART_BOUNDARY;
-static const char *_STREAM_BOUNDARY = "\r\n--" PART_BOUNDARY "\r\n";
-static const char *_STREAM_PART = "Content-Type: image/jpeg\r\nContent-Length: %u\r\n\r\n";
-
 httpd_handle_t camera_httpd = NULL;
-httpd_handle_t stream_httpd = NULL;
+static size_t ramUse = 0; // internal RAM taken by the server and the stream workers
 
 //----------------
 esp_err_t index_handler(httpd_req_t *req)
@@ -50,21 +52,21 @@ esp_err_t index_handler(httpd_req_t *req)
 
 //----------------
 static esp_err_t page2_handler(httpd_req_t *req)
+// the server task does not wait for the move; the stream shows the shutter opening
 {
    const char *fName = "page2_handler";
    LOG(">< http: %s ()\n", fName);
    shutter.open();
-   shutter.waitComplete();
    return sendPage(req, page2Body, 0);
 }
 
 //----------------
 static esp_err_t page3_handler(httpd_req_t *req)
+// the server task does not wait for the move; the page follows it through /ws
 {
    const char *fName = "page3_handler";
    LOG(">< http: %s ()\n", fName);
    shutter.close();
-   shutter.waitComplete();
    return sendPage(req, page3Body, 0);
 }
 
@@ -73,110 +75,58 @@ static esp_err_t siteInfoHandler(httpd_req_t *req)
 {
    const char *fName = "siteInfoHandler";
    LOG(">< http: %s ()\n", fName);
-   String cbs(siteInfoBody);
-   cbs.replace("$site$", getSiteName());
-   cbs.replace("$comment", getComment());
-   cbs.replace("$SSID$", myWifi.mySSID());
-   cbs.replace("$pass$", BLANK_PASSWORD);
-   return sendPage(req, cbs.c_str(), 0);
-}
-
-//-------------------
-static esp_err_t stream_handler(httpd_req_t *req)
-{
-   const char *fName = "stream_handler";
-   esp_err_t res = ESP_OK;
-   size_t _jpg_buf_len = 0;
-   uint8_t *_jpg_buf = NULL;
-   char *part_buf[64];
-
-   res = httpd_resp_set_type(req, _STREAM_CONTENT_TYPE);
-   if (res != ESP_OK)
-   {
-      return res;
-   }
-
-   int frameNo = 0;
-   while (true)
-   {
-      res = camera.capture(&_jpg_buf, _jpg_buf_len);
-
-      if (res == ESP_OK)
-      {
-         size_t hlen = snprintf((char *)part_buf, 64, _STREAM_PART, _jpg_buf_len);
-         res = httpd_resp_send_chunk(req, (const char *)part_buf, hlen);
-      }
-      if (res == ESP_OK)
-      {
-         res = httpd_resp_send_chunk(req, (const char *)_jpg_buf, _jpg_buf_len);
-      }
-      if (res == ESP_OK)
-      {
-         res = httpd_resp_send_chunk(req, _STREAM_BOUNDARY, strlen(_STREAM_BOUNDARY));
-      }
-      camera.releaseFrameBuffer();
-
-      if (res != ESP_OK)
-      {
-         break;
-      }
-      if (++frameNo % 100 == 0)
-      {
-         LOG(">< http: %s:JPG: frame %d length %u bytes\n", fName, frameNo, (uint32_t)(_jpg_buf_len));
-      }
-   }
-
-   return res;
+   SiteName site(getSiteName());
+   Comment comment(getComment());
+   Ssid ssid(myWifi.mySSID());
+   const PageField fields[] = {
+       {"$site$", site},
+       {"$comment$", comment},
+       {"$SSID$", ssid},
+       {"$pass$", BLANK_PASSWORD}};
+   return sendPage(req, siteInfoBody, 0, fields, sizeof(fields) / sizeof(fields[0]));
 }
 
 //--------------------------
 static esp_err_t siteInfo2Handler(httpd_req_t *req)
 {
    const char *fName = "siteInfo2Handler";
-   bool doReset = false;
+   bool doSwitch = false;
    bool success = true;
-   ;
    LOG(">  http: %s\n", fName);
    esp_err_t result;
-   String kvps; // key-value pairs
+   Query kvps; // key-value pairs
+   Ssid SSID;
+   Password password;
    result = fetchQuery(req, kvps);
    LOG("   http: %s: After fetch Query, result = %d, kvps = %s\n", fName, result, kvps.c_str());
 
    if (result == ESP_OK)
    {
-      String eV;
-      if (getValue(kvps, String("Exit"), eV))
+      FixedString<16> eV;
+      if (getValue(kvps, "Exit", eV))
       {
-         if (eV == String("OK"))
+         if (eV == "OK")
          {
-            String siteName;
-            if (getValue(kvps, String("sitename"), siteName))
+            SiteName siteName;
+            if (getValue(kvps, "sitename", siteName))
             {
-               setSiteName(siteName);
+               setSiteName(siteName.c_str());
             }
-            String comment;
-            if (getValue (kvps, String ("comment"), comment))
+            Comment comment;
+            if (getValue (kvps, "comment", comment))
             {
-               setComment (comment);
+               setComment (comment.c_str());
             }
-            String SSID;
-            String password;
-            if (getValue(kvps, String("SSID"), SSID))
+            if (getValue(kvps, "SSID", SSID))
             {
-               if (getValue(kvps, String("Password"), password))
+               if (getValue(kvps, "Password", password))
                {
                   // we have an ID and a password
-                  if (SSID != myWifi.mySSID())
-                  {
-                     myWifi.setSSID(SSID);
-                     doReset = true;
-                  }
-                  if ((password != String(BLANK_PASSWORD)) &&
-                      (password != myWifi.myPassword()))
+                  if (password == BLANK_PASSWORD)
                   {
-                     myWifi.setPassword(password);
-                     doReset = true;
+                     password = myWifi.myPassword();
                   }
+                  doSwitch = (SSID != myWifi.mySSID()) || (password != myWifi.myPassword());
                }
                else
                   success = false;
@@ -184,7 +134,7 @@ static esp_err_t siteInfo2Handler(httpd_req_t *req)
             else
                success = false;
          }
-         else if (eV == String("Cancel"))
+         else if (eV == "Cancel")
          {
             // 'Cancel': do nothing
          }
@@ -199,15 +149,18 @@ static esp_err_t siteInfo2Handler(httpd_req_t *req)
 
    if (!success)
    {
-      httpd_resp_send_500(req);
+      sendError(req, HTTPD_500_INTERNAL_SERVER_ERROR);
       result = ESP_FAIL;
    }
 
    if (result == ESP_OK)
    {
-      if (doReset)
+      if (doSwitch)
       {
-         performReboot(req);
+         // the credentials are stored by myWifi once it connected with them
+         myWifi.changeNetwork(SSID.c_str(), password.c_str());
+         const PageField field = {"$SSID$", SSID};
+         result = sendPage(req, wifiSwitchBody, 0, &field, 1);
       }
       else
       {
@@ -218,15 +171,41 @@ static esp_err_t siteInfo2Handler(httpd_req_t *req)
    return result;
 }
 
+//----------------------------
+static void closeSocket(httpd_handle_t hd, int fd)
+// close_fn: every socket the server closes passes here, whatever the reason
+{
+   wsSocketClosed(fd);
+   close(fd);
+}
+
 //----------------------------
 void httpSetup()
+// One server serves pages, the api, the WebSocket and the stream.
+// Streams are handed off to worker tasks (see stream.cpp), so they do not block the server task.
 {
    const char *fName = "httpSetup";
    LOG(">  http: %s\n", fName);
+   size_t freeBefore = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
    httpd_config_t config = HTTPD_DEFAULT_CONFIG();
    config.server_port = 80;
-
-   if (httpd_start(&camera_httpd, &config) == ESP_OK)
+   config.max_uri_handlers = 24;
+   config.max_open_sockets = 7; // LWIP allows 10, 3 are used internally
+   // no LRU purge: it may close a socket that a stream worker still sends on;
+   // keep-alive probes free the sockets of clients that went away instead
+   config.lru_purge_enable = false;
+   config.keep_alive_enable = true;
+   config.close_fn = closeSocket;
+   config.task_priority = taskConfig[HttpTask].priority;
+   config.core_id = taskConfig[HttpTask].core;
+   config.stack_size = taskConfig[HttpTask].stackSize;
+
+   esp_err_t started;
+   {
+      HeapScope scope(SubsysHttp);
+      started = httpd_start(&camera_httpd, &config);
+   }
+   if (started == ESP_OK)
    {
       registerUriHandler(camera_httpd, "/", index_handler);
       registerUriHandler(camera_httpd, "/page2", page2_handler);
@@ -235,13 +214,16 @@ void httpSetup()
       registerUriHandler(camera_httpd, "/siteinfo2", siteInfo2Handler);
       registerUriHandler(camera_httpd, "/adjust", firstAdjustHandler);
       registerUriHandler(camera_httpd, "/adjust2", adjust2Handler);
+      apiSetup(camera_httpd);
+      wsSetup(camera_httpd);
+      streamSetup(camera_httpd);
    }
+   ramUse = freeBefore - heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+   LOG("<  http: %s: server and stream workers use %u bytes internal RAM\n", fName, (unsigned)ramUse);
+}
 
-   config.server_port += 1;
-   config.ctrl_port += 1;
-   if (httpd_start(&stream_httpd, &config) == ESP_OK)
-   {
-      registerUriHandler(stream_httpd, "/stream", stream_handler);
-   }
-   LOG("<  http: %s\n", fName);
+//----------------
+size_t httpRamUse()
+{
+   return ramUse;
 }
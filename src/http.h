@@ -10,7 +10,8 @@
 
 #include "esp_http_server.h"
 
-extern void      httpSetup ();
+extern void      httpSetup  ();
+extern size_t    httpRamUse (); // internal RAM taken by httpSetup: the server and the stream workers
 
 extern esp_err_t index_handler (httpd_req_t *req);
 
@@ -5,217 +5,506 @@
 //
 
 #include <Arduino.h>
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
 
 #include "html.h"
 #include <Preferences.h>
 #include "urlencode.h"
+#include "warmboot.h"
+#include "stream.h"
 
 #include "httpsupp.h"
 #define _DEBUG 1
 #include "debug.h"
 
+#define MAX_URI_STATS (24)   // must be >= the number of registered uri's
+#define N_LATENCY_BUCKETS (14)
+#define FIRST_BUCKET_US (256) // bucket 0: < 256 us; bucket n: < 256 << n us; last bucket: the rest
+#define PAGE_CHUNK_SIZE (1024) // sendPage collects small pieces up to this size before sending
+
+// Every handler registered with registerUriHandler is called through
+// instrumentedHandler, which keeps these statistics per uri.
+// All handlers run in the http server task, so there is a single writer.
+struct UriStats
+{
+   const char *uri;
+   httpd_method_t method;
+   esp_err_t (*handler)(httpd_req_t *req);
+   uint32_t calls;
+   uint32_t status2xx;
+   uint32_t status4xx;
+   uint32_t status5xx;
+   uint32_t maxUs;
+   uint64_t totalUs;
+   int32_t minHeapDelta;  // bytes; negative: the handler left less free heap
+   int32_t maxHeapDelta;
+   uint32_t histogram[N_LATENCY_BUCKETS];
+   uint32_t streamingCalls; // handled while a stream was running: the control responsiveness
+   uint32_t streamingMaxUs;
+   uint64_t streamingTotalUs;
+};
+
+static UriStats uriStats[MAX_URI_STATS];
+static int nUriStats = 0;
+static int currentStatus = 200; // of the request being handled
+static uint32_t firstRequestAt = 0; // millis () when the first request was handled
+static volatile uint32_t lastRequestAt = 0;  // millis () when the most recent request was handled
+
+// sendPage output; pages are only sent by the http server task, one at a time
+struct PageOutput
+{
+   httpd_req_t *req;
+   esp_err_t result;
+};
+static FixedString<PAGE_CHUNK_SIZE> pageChunk;
+
 static Preferences preferences;
 
 static const char *cName = "httpsupp";
 
-esp_err_t sendPage(httpd_req_t *req, const char *body, unsigned int refreshSeconds)
+//--------------------------
+static esp_err_t instrumentedHandler(httpd_req_t *req)
+// time the real handler, account heap and status code
+{
+   UriStats *st = (UriStats *)req->user_ctx;
+   currentStatus = 200;
+   lastRequestAt = millis();
+   if (firstRequestAt == 0)
+   {
+      firstRequestAt = millis();
+      LOG("   %s: first request (%s) %u ms after boot\n", cName, st->uri, (unsigned)firstRequestAt);
+   }
+   bool streaming = streamSessionCount() > 0;
+   size_t heapBefore = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+   int64_t start = esp_timer_get_time();
+
+   esp_err_t result = st->handler(req);
+
+   uint32_t us = uint32_t(esp_timer_get_time() - start);
+   int32_t heapDelta = int32_t(heap_caps_get_free_size(MALLOC_CAP_8BIT)) - int32_t(heapBefore);
+   if (result != ESP_OK && currentStatus < 400)
+      currentStatus = 500; // the server closes the connection
+
+   int bucket = us < FIRST_BUCKET_US ? 0 : 32 - __builtin_clz(us / FIRST_BUCKET_US);
+   if (bucket >= N_LATENCY_BUCKETS)
+      bucket = N_LATENCY_BUCKETS - 1;
+   st->histogram[bucket]++;
+   if (st->calls == 0 || heapDelta < st->minHeapDelta)
+      st->minHeapDelta = heapDelta;
+   if (st->calls == 0 || heapDelta > st->maxHeapDelta)
+      st->maxHeapDelta = heapDelta;
+   st->calls++;
+   st->totalUs += us;
+   if (us > st->maxUs)
+      st->maxUs = us;
+   if (streaming)
+   {
+      st->streamingCalls++;
+      st->streamingTotalUs += us;
+      if (us > st->streamingMaxUs)
+         st->streamingMaxUs = us;
+   }
+   if (currentStatus >= 500)
+      st->status5xx++;
+   else if (currentStatus >= 400)
+      st->status4xx++;
+   else
+      st->status2xx++;
+   return result;
+}
+
+//--------------------------
+static void pageFlush(PageOutput &out)
+{
+   if (out.result == ESP_OK && !pageChunk.isEmpty())
+      out.result = httpd_resp_send_chunk(out.req, pageChunk.c_str(), pageChunk.length());
+   pageChunk.clear();
+}
+
+//--------------------------
+static void pagePut(PageOutput &out, StringView s)
+// collect s in pageChunk; a piece that does not fit in it is sent as it is
+{
+   if (s.length() > pageChunk.capacity() - pageChunk.length())
+   {
+      pageFlush(out);
+      if (s.length() >= pageChunk.capacity())
+      {
+         if (out.result == ESP_OK)
+            out.result = httpd_resp_send_chunk(out.req, s.data(), s.length());
+         return;
+      }
+   }
+   pageChunk.append(s);
+}
+
+//--------------------------
+static void pagePut(PageOutput &out, const char *text, const PageField *fields, int nFields)
+// put text, with every field marker replaced by its value
+{
+   StringView t(text);
+   size_t done = 0; // text before this has been put
+   size_t i = 0;
+   while ((i = t.indexOf('$', i)) != StringView::npos)
+   {
+      const PageField *f = fields;
+      while (f < fields + nFields && !t.substring(i).startsWith(f->marker))
+         f++;
+      if (f < fields + nFields)
+      {
+         pagePut(out, t.substring(done, i));
+         pagePut(out, f->value);
+         i += strlen(f->marker);
+         done = i;
+      }
+      else
+         i++;
+   }
+   pagePut(out, t.substring(done));
+}
+
+//--------------------------
+esp_err_t sendPage(httpd_req_t *req, const char *body, unsigned int refreshSeconds, const PageField *fields, int nFields)
+// the page is built from the parts in html.cpp, without copies on the heap
 {
    const char *fName = "sendPage";
    LOG(">  %s: %s: refreshSeconds = %d\n", cName, fName, refreshSeconds);
-   String refreshS("");
+   FixedString<64> refresh;
    if (refreshSeconds > 0)
    {
-      refreshS += String("<meta http-equiv=\"refresh\" content=\"") + String(refreshSeconds) + String("\">");
-      LOG("   %s: %s: refresh clause = %s\n", cName, fName, refreshS.c_str());
-   }
-
-   String head(theHead);
-   head.replace("$REFRESH$", refreshS);
-
-   String siteName("<h1>" + getSiteName() + "</h1>");
-   String comment("<br>" + getComment() + "<br>");
-   esp_err_t r = httpd_resp_set_type(req, "text/html");
-   if (r == ESP_OK)
-      r = httpd_resp_send_chunk(req, head.c_str(), head.length());
-   if (r == ESP_OK)
-      r = httpd_resp_send_chunk(req, (const char *)styleHead, strlen(styleHead));
-   if (r == ESP_OK)
-      r = httpd_resp_send_chunk(req, (const char *)startBody, strlen(startBody));
-   if (r == ESP_OK)
-      r = httpd_resp_send_chunk(req, siteName.c_str(), siteName.length());
-   if (r == ESP_OK)
-      r = httpd_resp_send_chunk(req, comment.c_str(), comment.length());
-   if (r == ESP_OK)
-      r = httpd_resp_send_chunk(req, (const char *)body, strlen(body));
-   if (r == ESP_OK)
-      r = httpd_resp_send_chunk(req, (const char *)endHtml, strlen(endHtml));
-   if (r == ESP_OK)
-      r = httpd_resp_send_chunk(req, nullptr, 0);
+      refresh.format("<meta http-equiv=\"refresh\" content=\"%u\">", refreshSeconds);
+      LOG("   %s: %s: refresh clause = %s\n", cName, fName, refresh.c_str());
+   }
+   const PageField headField = {"$REFRESH$", refresh};
+   SiteName siteName(getSiteName());
+   Comment comment(getComment());
+
+   PageOutput out = {req, httpd_resp_set_type(req, "text/html")};
+   pageChunk.clear();
+   pagePut(out, theHead, &headField, 1);
+   pagePut(out, styleHead);
+   pagePut(out, startBody);
+   pagePut(out, "<h1>");
+   pagePut(out, siteName);
+   pagePut(out, "</h1><br>");
+   pagePut(out, comment);
+   pagePut(out, "<br>");
+   pagePut(out, body, fields, nFields);
+   pagePut(out, endHtml);
+   pageFlush(out);
+   if (out.result == ESP_OK)
+      out.result = httpd_resp_send_chunk(req, nullptr, 0);
    LOG("<  %s: %s ()", cName, fName);
-   return r;
+   return out.result;
 }
 
 //------------------------
-esp_err_t fetchQuery(httpd_req_t *req, String &query)
-// fetch the query string that the client used to access this server
+esp_err_t fetchQuery(httpd_req_t *req, FixedStringBase &query)
+// fetch the query string that the client used to access this server, URL decoded
 {
    const char *fName = "fetchQuery";
    LOG(">  %s: %s (...)\n", cName, fName);
-   char *buf = nullptr;
-   size_t bufLen;
-   int result = ESP_OK;
+   esp_err_t result = ESP_OK;
 
-   bufLen = httpd_req_get_url_query_len(req) + 1;
+   size_t bufLen = httpd_req_get_url_query_len(req) + 1;
    if (bufLen <= 1)
    {
-      httpd_resp_send_404(req); // not found
+      sendError(req, HTTPD_404_NOT_FOUND);
       result = ESP_FAIL;
    }
-   else
+   else if (bufLen > query.capacity() + 1)
    {
-      // we got a buffer size
-      buf = (char *)malloc(bufLen);
-      if (!buf)
-      {
-         httpd_resp_send_500(req); // internal server error
-         result = ESP_FAIL;
-      }
+      sendError(req, HTTPD_414_URI_TOO_LONG);
+      result = ESP_FAIL;
    }
 
    if (result == ESP_OK)
    {
-      // we have a buffer
-      result = httpd_req_get_url_query_str(req, buf, bufLen);
-      LOG("   %s: %s: after get_url_query_str buf = >%s<, len = %d, result = %d\n", cName, fName, buf, bufLen, result);
+      result = httpd_req_get_url_query_str(req, query.buffer(), bufLen);
+      LOG("   %s: %s: after get_url_query_str query = >%s<, len = %d, result = %d\n", cName, fName, query.c_str(),
+          bufLen, result);
       if (result != ESP_OK)
       {
-         httpd_resp_send_404(req); // not found
+         query.clear();
+         sendError(req, HTTPD_404_NOT_FOUND);
       }
       else
-      {
-         query = buf;
-         URLencode::decode(query);
-      }
-   }
-
-   if (buf)
-   {
-      free(buf);
-      buf = nullptr;
+         query.setLength(URLencode::decode(query.buffer(), bufLen - 1)); // in place
    }
    LOG("<   %s: %s\n", cName, fName);
    return result;
 }
 
 //-----------------------------
-bool getValue(String kvps, String key, String &value)
-// from a string with <key=value> pairs, fetch a string value for the key
+static bool findValue(StringView kvps, StringView key, StringView &value)
+// from a string with <key=value> pairs, separated by '&', fetch the value for the key
 {
-   const char *fName = "getValue";
-   LOG(">  %s: %s (key = %s)\n", cName, fName, key.c_str());
-   bool found = false;
-   value = "";
-   int index = kvps.indexOf(key);
-   if (index > -1)
-   {
-      int indexOfEq = index + key.length();
-      if (kvps[indexOfEq] == '=')
+   size_t start = 0;
+   while (start <= kvps.length())
+   {
+      size_t end = kvps.indexOf('&', start);
+      if (end == StringView::npos)
+         end = kvps.length();
+      StringView pair = kvps.substring(start, end);
+      if (pair.startsWith(key) && pair.length() > key.length() && pair[key.length()] == '=')
       {
-         found = true;
-         int endIndex = kvps.indexOf('&', indexOfEq);
-         if (endIndex == -1)
-            endIndex = kvps.length();
-         value = kvps.substring(indexOfEq + 1, endIndex);
-         value.trim();
+         value = pair.substring(key.length() + 1).trim();
+         return true;
       }
+      start = end + 1;
    }
-   LOG("<  %s: %s: key %s: value = '%s', found = %s\n", cName, fName, key.c_str(), value.c_str(), toCCP(found));
+   value = StringView();
+   return false;
+}
+
+//-----------------------------
+bool getValue(StringView kvps, StringView key, FixedStringBase &value)
+// from a string with <key=value> pairs, fetch a string value for the key
+{
+   const char *fName = "getValue";
+   StringView v;
+   bool found = findValue(kvps, key, v);
+   value = v;
+   LOG(">< %s: %s: key %.*s: value = '%s', found = %s\n", cName, fName, int(key.length()), key.data(),
+       value.c_str(), toCCP(found));
    return found;
 }
 
 //-----------------------------
-bool getValue(String kvps, String key, int &value)
+bool getValue(StringView kvps, StringView key, int &value)
 // from a string with <key=value> pairs, fetch an int value for the key
 {
-   String s;
-   bool found = getValue(kvps, key, s);
+   StringView v;
+   bool found = findValue(kvps, key, v);
    if (found)
    {
-      value = s.toInt();
+      value = v.toInt();
    }
-   LOG(">< %s: getValue (int): key %s value = %d\n", cName, key.c_str(), value);
+   LOG(">< %s: getValue (int): key %.*s value = %d\n", cName, int(key.length()), key.data(), value);
    return found;
 }
 
 //--------------------------
-void registerUriHandler(httpd_handle_t &httpd, const char *uri, esp_err_t (*theHandler)(httpd_req_t *req))
+void registerUriHandler(httpd_handle_t &httpd, const char *uri, esp_err_t (*theHandler)(httpd_req_t *req),
+                        httpd_method_t method)
+// the handler is wrapped by instrumentedHandler
 {
    const char *fName = "registerUriHandler";
    LOG(">< %s: %s\n", cName, fName);
+   if (nUriStats >= MAX_URI_STATS)
+   {
+      ERROR("%s: %s: no room for statistics of %s; increase MAX_URI_STATS\n", cName, fName, uri);
+      return;
+   }
+   UriStats *st = &uriStats[nUriStats++];
+   memset(st, 0, sizeof(*st));
+   st->uri = uri;
+   st->method = method;
+   st->handler = theHandler;
+   httpd_uri_t theUri = {
+       .uri = uri,
+       .method = method,
+       .handler = instrumentedHandler,
+       .user_ctx = st,
+       .is_websocket = false,
+       .handle_ws_control_frames = false,
+       .supported_subprotocol = nullptr};
+   httpd_register_uri_handler(httpd, &theUri);
+}
+
+//--------------------------
+void registerWsHandler(httpd_handle_t &httpd, const char *uri, esp_err_t (*theHandler)(httpd_req_t *req))
+// register a WebSocket endpoint; theHandler is called for the handshake and for every received frame
+{
+   const char *fName = "registerWsHandler";
+   LOG(">< %s: %s\n", cName, fName);
    httpd_uri_t theUri = {
        .uri = uri,
        .method = HTTP_GET,
        .handler = theHandler,
        .user_ctx = nullptr,
-       .is_websocket = false,
+       .is_websocket = true,
        .handle_ws_control_frames = false,
        .supported_subprotocol = nullptr};
    httpd_register_uri_handler(httpd, &theUri);
 }
 
 //--------------------------
-void setSiteName(String s)
+esp_err_t sendError(httpd_req_t *req, httpd_err_code_t code, const char *message)
+// send an error reply and record its status code
+{
+   switch (code)
+   {
+   case HTTPD_400_BAD_REQUEST:
+      currentStatus = 400;
+      break;
+   case HTTPD_404_NOT_FOUND:
+      currentStatus = 404;
+      break;
+   case HTTPD_405_METHOD_NOT_ALLOWED:
+      currentStatus = 405;
+      break;
+   case HTTPD_408_REQ_TIMEOUT:
+      currentStatus = 408;
+      break;
+   case HTTPD_414_URI_TOO_LONG:
+      currentStatus = 414;
+      break;
+   default:
+      currentStatus = 500;
+      break;
+   }
+   return httpd_resp_send_err(req, code, message);
+}
+
+//--------------------------
+uint32_t firstRequestTime()
+{
+   return firstRequestAt;
+}
+
+//--------------------------
+uint32_t lastRequestTime()
+{
+   return lastRequestAt;
+}
+
+//--------------------------
+void noteStatus(int status)
+{
+   currentStatus = status;
+}
+
+//--------------------------
+void writeUriStats(JsonWriter &w)
+// per uri: calls, status classes, latency (us) and heap delta (bytes);
+// "whileStreaming": the latency of the calls made while a stream was running
+// "buckets" holds the upper bound (us) of every histogram bucket but the last
+{
+   w.beginObject();
+   w.beginArray("buckets");
+   for (int b = 0; b < N_LATENCY_BUCKETS - 1; b++)
+   {
+      w.add(nullptr, (unsigned long)(FIRST_BUCKET_US) << b);
+   }
+   w.endArray();
+   w.beginArray("uris");
+   for (int i = 0; i < nUriStats; i++)
+   {
+      UriStats &st = uriStats[i];
+      w.beginObject();
+      w.add("uri", st.uri);
+      w.add("method", http_method_str(st.method));
+      w.add("calls", st.calls);
+      w.add("2xx", st.status2xx);
+      w.add("4xx", st.status4xx);
+      w.add("5xx", st.status5xx);
+      w.add("avgUs", st.calls ? (unsigned long)(st.totalUs / st.calls) : 0UL);
+      w.add("maxUs", st.maxUs);
+      w.add("minHeapDelta", st.minHeapDelta);
+      w.add("maxHeapDelta", st.maxHeapDelta);
+      w.beginArray("hist");
+      for (int b = 0; b < N_LATENCY_BUCKETS; b++)
+      {
+         w.add(nullptr, st.histogram[b]);
+      }
+      w.endArray();
+      if (st.streamingCalls)
+      {
+         w.beginObject("whileStreaming");
+         w.add("calls", st.streamingCalls);
+         w.add("avgUs", (unsigned long)(st.streamingTotalUs / st.streamingCalls));
+         w.add("maxUs", st.streamingMaxUs);
+         w.endObject();
+      }
+      w.endObject();
+   }
+   w.endArray();
+   w.endObject();
+}
+
+//--------------------------
+static void readSetting(const char *space, const char *fallback, FixedStringBase &s)
+// read "Name" from namespace space, without a String on the heap
+{
+   preferences.begin(space, true); // read-only
+   size_t n = preferences.getString("Name", s.buffer(), s.capacity() + 1); // incl. the '\0'; 0 on failure
+   if (n > 0)
+      s.setLength(n - 1);
+   else if (preferences.isKey("Name"))
+      s = preferences.getString("Name").c_str(); // stored before the length was limited: cut off
+   else
+      s = fallback;
+   preferences.end();
+}
+
+//--------------------------
+void setSiteName(const char *s)
 {
    const char *fName = "setSiteName";
-   LOG(">  %s::%s (name = %s)\n", cName, fName, s.c_str());
+   LOG(">  %s::%s (name = %s)\n", cName, fName, s);
    preferences.begin("Site", false);
    preferences.putString("Name", s);
    preferences.end();
+   WarmState &w = warmBoot.beginUpdate();
+   w.siteValid = strlen(s) < sizeof(w.site);
+   WarmBoot::copy(w.site, sizeof(w.site), s);
+   warmBoot.endUpdate();
    LOG("<  %s::%s ()\n", cName, fName);
 }
 
 //--------------------------
-String getSiteName()
+SiteName getSiteName()
 {
    const char *fName = "getSiteName";
    LOG(">  %s::%s ()\n", cName, fName);
-   preferences.begin("Site", true); // name, read-only
-   String s(preferences.getString("Name", "*Site naam niet opgegeven*"));
-   preferences.end();
+   SiteName s;
+   if (warmBoot.state().siteValid)
+      s = warmBoot.state().site; // RTC memory: no flash read
+   else
+   {
+      readSetting("Site", "*Site naam niet opgegeven*", s);
+      WarmState &w = warmBoot.beginUpdate();
+      w.siteValid = s.length() < sizeof(w.site);
+      WarmBoot::copy(w.site, sizeof(w.site), s.c_str());
+      warmBoot.endUpdate();
+   }
    LOG("<  %s::%s = %s\n", cName, fName, s.c_str());
    return s;
 }
 
 //--------------------------
-void setComment(String s)
+void setComment(const char *s)
 {
    const char *fName = "setComment";
-   LOG(">  %s::%s (s = '%s')\n", cName, fName, s.c_str());
+   LOG(">  %s::%s (s = '%s')\n", cName, fName, s);
    preferences.begin("Comment", false);
    preferences.putString("Name", s);
    preferences.end();
+   WarmState &w = warmBoot.beginUpdate();
+   w.commentValid = strlen(s) < sizeof(w.comment);
+   WarmBoot::copy(w.comment, sizeof(w.comment), s);
+   warmBoot.endUpdate();
    LOG("<  %s::%s ()\n", cName, fName);
 }
 
 //--------------------------
-String getComment()
+Comment getComment()
 {
    const char *fName = "getComment";
    LOG(">  %s::%s ()\n", cName, fName);
-   preferences.begin("Comment", true); // name, read-only
-   String s(preferences.getString("Name", ""));
-   preferences.end();
+   Comment s;
+   if (warmBoot.state().commentValid)
+      s = warmBoot.state().comment;
+   else
+   {
+      readSetting("Comment", "", s);
+      WarmState &w = warmBoot.beginUpdate();
+      w.commentValid = s.length() < sizeof(w.comment);
+      WarmBoot::copy(w.comment, sizeof(w.comment), s.c_str());
+      warmBoot.endUpdate();
+   }
    LOG("<  %s::%s ()= '%s'\n", cName, fName, s.c_str());
    return s;
 }
-
-//----------------
-void performReboot(httpd_req_t *req)
-{
-   const char *fName = "performReboot";
-   LOG(">  %s::%s ()\n", cName, fName);
-   sendPage(req, rebootBody, 0);
-   LOG("------------------------- Rebooting in 2 seconds------------------------------\n");
-   delay(2000);
-   ESP.restart();
-}
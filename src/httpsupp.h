@@ -8,16 +8,38 @@
 
 #include <Arduino.h>
 #include "esp_http_server.h"
+#include "json.h"
+#include "fixedstring.h"
 
+#define SITE_NAME_LEN (47)  // characters; the form limits the input to this
+#define COMMENT_LEN   (95)
+#define QUERY_LEN     (512) // the server does not accept longer uri's (max_uri_len)
 
-extern esp_err_t sendPage           (httpd_req_t *req, const char *body, unsigned int refreshSeconds);
-extern esp_err_t fetchQuery         (httpd_req_t *req, String &query);
-extern bool      getValue           (String kvps, String key,  String &value);
-extern bool      getValue           (String kvps, String key,  int &value);
-extern void      registerUriHandler (httpd_handle_t &httpd, const char* uri, esp_err_t (*theHandler) (httpd_req_t *req));
-extern String    getSiteName        ();
-extern void      setSiteName        (String s);
-extern String    getComment         ();
-extern void      setComment         (String s);
-extern void      performReboot      (httpd_req_t *req);
+typedef FixedString<SITE_NAME_LEN> SiteName;
+typedef FixedString<COMMENT_LEN>   Comment;
+typedef FixedString<QUERY_LEN>     Query;
+
+// sendPage replaces every marker in the body by its value, e.g. {"$SPEED$", "40"}
+struct PageField {
+   const char *marker;
+   StringView  value;
+};
+
+extern esp_err_t sendPage           (httpd_req_t *req, const char *body, unsigned int refreshSeconds,
+                                     const PageField *fields = nullptr, int nFields = 0);
+extern esp_err_t fetchQuery         (httpd_req_t *req, FixedStringBase &query);
+extern bool      getValue           (StringView kvps, StringView key, FixedStringBase &value);
+extern bool      getValue           (StringView kvps, StringView key, int &value);
+extern void      registerUriHandler (httpd_handle_t &httpd, const char* uri, esp_err_t (*theHandler) (httpd_req_t *req),
+                                     httpd_method_t method = HTTP_GET);
+extern void      registerWsHandler  (httpd_handle_t &httpd, const char* uri, esp_err_t (*theHandler) (httpd_req_t *req));
+extern esp_err_t sendError          (httpd_req_t *req, httpd_err_code_t code, const char *message = nullptr);
+extern void      noteStatus         (int status);   // status code of a reply not sent by sendError
+extern void      writeUriStats      (JsonWriter &w);
+extern uint32_t  firstRequestTime   ();             // ms after boot of the first request; 0 = none yet
+extern uint32_t  lastRequestTime    ();             // ms after boot of the most recent request
+extern SiteName  getSiteName        ();
+extern void      setSiteName        (const char *s);
+extern Comment   getComment         ();
+extern void      setComment         (const char *s);
 #endif
\ No newline at end of file
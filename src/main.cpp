@@ -14,20 +14,52 @@
 
 #include "soc/soc.h" // disable brownout problems
 #include "soc/rtc_cntl_reg.h"
+#include "sdkconfig.h"
+#if CONFIG_PM_ENABLE
+#include "esp_pm.h"
+#endif
 
 #include "camera.h"
 #include "shutter.h"
 #include "myWifi.h"
 #include "http.h"
+#include "websock.h"
+#include "stream.h"
+#include "capture.h"
+#include "tasks.h"
+#include "boot.h"
+#include "pressure.h"
+#include "detector.h"
+#include "clip.h"
+#include "visits.h"
+#include "warmboot.h"
+#include "heapscope.h"
+#include "httpsupp.h"
 #include "timer.h"
+#include "scheduler.h"
 #include "credentials.h"
 
 #define _DEBUG 1
 #include "debug.h"
 
+#define CONTROL_IDLE_TIME (1 MINUTE) // no request for this long: no control clients
+#define MAX_IDLE_TIME (250)          // ms; loop () runs at least this often, for the WiFi timers
+
 static uint32_t startTime;
-static uint32_t previousTime;
-static void loopTime();
+static int loopCount = 0;
+static uint32_t maximumTime = 0;  // longest busy time of a loop, us
+static uint64_t busyTime = 0;     // us the loop was busy since the previous report
+static TaskHandle_t loopTask = nullptr;
+#if CONFIG_PM_ENABLE
+static esp_pm_lock_handle_t busyLock; // no light sleep while the servo moves or a stream runs
+static bool busyLockHeld = false;
+#endif
+static void loopTime(uint32_t thisLoopTime);
+static void reportLoopTime(void *context);
+static void reportActivity();
+static void powerSetup();
+static void holdBusyLock();
+static void wakeLoop();
 
 static void myDebugPrinter(const char *buffer)
 {
@@ -37,63 +69,142 @@ static void myDebugPrinter(const char *buffer)
 //--------------------
 void setup()
 {
-   Serial.begin(115200);
+   {
+      HeapScope scope(SubsysDebug);
+      Serial.begin(115200);
 
-   Serial.print("Serial.begin done\n");
-   DEBUGAddPrintFunction(myDebugPrinter);
+      Serial.print("Serial.begin done\n");
+      DEBUGAddPrintFunction(myDebugPrinter);
+   }
 
    WRITE_PERI_REG(RTC_CNTL_BROWN_OUT_REG, 0); // disable brownout detector
 
    LOG("This is main.setup\n");
+   warmBoot.setup(); // before anything reads its state from flash
+   bootMark(BootSetup);
 
+   // the camera is initialised by the capture task, in parallel with WiFi and http
+   tasksSetup();
    shutter.setup();
-   camera.setup();
+   bootMark(BootShutter);
+   captureSetup();
+   detectorSetup();
+   clipSetup();
    myWifi.setup();
+   visitsSetup();
+   bootMark(BootAccessPoint);
    httpSetup();
+   bootMark(BootHttp);
+
+   loopTask = xTaskGetCurrentTaskHandle();
+   scheduler.setWakeFunction(wakeLoop);
+   powerSetup();
+   pressureSetup();
 
    startTime = millis();
-   previousTime = micros();
+#if _DEBUG == 1
+   scheduler.every(1 MINUTE, reportLoopTime);
+#endif
    LOG("setup done\n");
 }
 
 //-----------
 void loop()
+// does its work, then sleeps until the next scheduled job, a wake up, or MAX_IDLE_TIME
 {
-   loopTime();
-   shutter.loop();
+   uint32_t begin = micros();
+   scheduler.run();
+   reportActivity();
+   myWifi.loop();
+   if (myWifi.isConnected())
+      bootMark(BootStation);
+   holdBusyLock();
+   loopTime(micros() - begin);
+
+   uint32_t wait = scheduler.timeToNext(MAX_IDLE_TIME);
+   if (wait > 0)
+      ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(wait));
 }
 
-static void loopTime()
+static void wakeLoop()
+// SchedulerWake: a job was added, or a WiFi event arrived
 {
-#if _DEBUG == 1
-   static int uptime = 0;
-   static int loopCount = 0;
-   static uint32_t maximumTime = 0;
-   static Timer reportTimer(1 MINUTE);
+   if (loopTask)
+      xTaskNotifyGive(loopTask);
+}
 
-   uint32_t now = micros();
-   uint32_t thisLoopTime = now - previousTime;
-   previousTime = now;
-   if (thisLoopTime > maximumTime)
+static void powerSetup()
+// with CONFIG_PM_ENABLE the CPU clock drops to 80 MHz when all tasks are idle;
+// with tickless idle as well, the chip also enters light sleep then
+{
+#if CONFIG_PM_ENABLE
+   esp_pm_config_t pm = {};
+   pm.max_freq_mhz = 240;
+   pm.min_freq_mhz = 80; // keeps APB at 80 MHz, so the servo and camera clocks are unaffected
+#if CONFIG_FREERTOS_USE_TICKLESS_IDLE
+   pm.light_sleep_enable = true;
+#endif
+   esp_err_t r = esp_pm_configure(&pm);
+   if (r == ESP_OK)
+      r = esp_pm_lock_create(ESP_PM_NO_LIGHT_SLEEP, 0, "busy", &busyLock);
+   LOG("Power management: %s, light sleep %s\n", esp_err_to_name(r),
+       pm.light_sleep_enable ? "enabled" : "not available");
+#else
+   LOG("Power management: not available\n");
+#endif
+}
+
+static void holdBusyLock()
+// light sleep stops the servo pulses and the camera clock
+{
+#if CONFIG_PM_ENABLE
+   bool busy = shutter.isMoving() || streamSessionCount() > 0;
+   if (busyLock && busy != busyLockHeld)
    {
-      maximumTime = thisLoopTime;
+      if (busy)
+         esp_pm_lock_acquire(busyLock);
+      else
+         esp_pm_lock_release(busyLock);
+      busyLockHeld = busy;
    }
+#endif
+}
+
+static void reportActivity()
+// tell the WiFi layer how busy we are, for its power save mode
+{
+   bool controlClients = wsClientCount() > 0 ||
+                         (lastRequestTime() != 0 && millis() - lastRequestTime() < CONTROL_IDLE_TIME);
+   myWifi.setActivity(streamSessionCount(), controlClients);
+}
 
-   if (reportTimer.hasExpired())
+static void loopTime(uint32_t thisLoopTime)
+// the busy part of a loop, in us; the sleep is not counted
+{
+#if _DEBUG == 1
+   busyTime += thisLoopTime;
+   if (thisLoopTime > maximumTime)
    {
-      reportTimer.restart();
-
-      uint32_t m = millis();
-      uint32_t expired = m - startTime;
-
-      float usPerLoop = float(expired) * 1000 / loopCount;
-      LOG("main loop: uptime = %d minutes; avg loop time = %5.1f us, max loop time = %d us\n",
-          uptime, usPerLoop, maximumTime);
-      loopCount = 0;
-      maximumTime = 0;
-      uptime++;
-      startTime = m;
+      maximumTime = thisLoopTime;
    }
    loopCount++;
 #endif
 }
+
+static void reportLoopTime(void *context)
+// scheduled every minute
+{
+   static int uptime = 0;
+   uint32_t m = millis();
+   uint32_t expired = m - startTime;
+
+   float usPerLoop = float(busyTime) / loopCount;
+   float busyPercent = float(busyTime) / 10 / expired; // us / (ms * 1000) * 100
+   LOG("main loop: uptime = %d minutes; %d loops, avg loop time = %5.1f us, max loop time = %d us, busy = %4.2f %%, missed periods = %u\n",
+       uptime, loopCount, usPerLoop, maximumTime, busyPercent, scheduler.missedPeriods());
+   loopCount = 0;
+   maximumTime = 0;
+   busyTime = 0;
+   uptime++;
+   startTime = m;
+}
@@ -0,0 +1,108 @@
+//
+// pressure.cpp -- act on memory pressure
+//
+// Every GOVERNOR_INTERVAL the memory governor (governor.h) gets the free
+// internal RAM, its largest free block and the largest free PSRAM block.
+// Every level adds its action to those of the levels below it:
+//
+//    SmallFrames   QVGA frames instead of the configured size
+//    FewStreams    one stream session; newer sessions are evicted
+//    Shed          the allocator returns its kept PSRAM blocks and keeps no more
+//    Refuse        no stream sessions at all; new viewers get a 503
+//
+// So a stream is cut down before a capture or jpg conversion fails on memory.
+//
+// Ben Slaghekke, 19 October 2026
+//
+#include <Arduino.h>
+#include "esp_heap_caps.h"
+#include "governor.h"
+#include "timer.h"
+#include "scheduler.h"
+#include "camera.h"
+#include "stream.h"
+#include "allocator.h"
+#include "pressure.h"
+
+#define _DEBUG 1
+#include "debug.h"
+
+#define GOVERNOR_INTERVAL (1 SECOND)
+#define RECOVER_TIME (10 SECONDS)  // readings clear of the limits this long: one level back
+#define RECOVER_MARGIN (25)        // %, above the limits
+
+static const MemoryGovernor::Limits limits[MemoryGovernor::N_LEVELS] = {
+   // internal free, largest internal block, largest PSRAM block
+   {0, 0, 0},                           // Normal
+   {40 * 1024, 16 * 1024, 256 * 1024},  // SmallFrames
+   {32 * 1024, 12 * 1024, 128 * 1024},  // FewStreams
+   {26 * 1024, 10 * 1024, 64 * 1024},   // Shed
+   {20 * 1024, 8 * 1024, 32 * 1024},    // Refuse
+};
+
+static MemoryGovernor governor(limits, RECOVER_TIME, RECOVER_MARGIN);
+static MemorySample lastSample = {};
+static uint32_t lowestLargest = UINT32_MAX; // smallest largest internal block seen: fragmentation over time
+
+static const char *cName = "pressure";
+
+//----------------------------
+static void apply(MemoryGovernor::Level level)
+{
+   streamSetMaxViewers(level >= MemoryGovernor::Refuse       ? 0
+                       : level >= MemoryGovernor::FewStreams ? 1
+                                                             : -1);
+   memKeepBlocks(level < MemoryGovernor::Shed);
+}
+
+//----------------------------
+static void governorJob(void *context)
+{
+   MemorySample s;
+   s.internalFree = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+   s.internalLargest = heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+   s.psramLargest = heap_caps_get_total_size(MALLOC_CAP_SPIRAM) > 0 ? heap_caps_get_largest_free_block(MALLOC_CAP_SPIRAM)
+                                                                    : UINT32_MAX;
+   lastSample = s;
+   if (s.internalLargest < lowestLargest)
+      lowestLargest = s.internalLargest;
+   MemoryGovernor::Level before = governor.level();
+   MemoryGovernor::Level level = governor.update(s, millis());
+   if (level != before)
+   {
+      WARNING("%s: %s -> %s (internal free %u, largest %u, PSRAM largest %u)\n", cName,
+              MemoryGovernor::levelName(before), MemoryGovernor::levelName(level), (unsigned)s.internalFree,
+              (unsigned)s.internalLargest, (unsigned)s.psramLargest);
+      apply(level);
+   }
+   // every time: the camera may have become ready since the level changed
+   camera.setReducedFrames(level >= MemoryGovernor::SmallFrames);
+   streamCheckHeap();
+}
+
+//----------------------------
+void pressureSetup()
+{
+   scheduler.every(GOVERNOR_INTERVAL, governorJob);
+   LOG(">< %s: pressureSetup\n", cName);
+}
+
+//----------------------------
+void pressureWriteStatus(JsonWriter &w)
+{
+   w.beginObject("pressure");
+   w.add("level", MemoryGovernor::levelName(governor.level()));
+   w.add("seconds", (millis() - governor.levelSince()) / 1000);
+   w.add("transitions", governor.transitions());
+   w.add("worst", MemoryGovernor::levelName(governor.worstLevel()));
+   w.beginObject("entries");
+   for (int l = MemoryGovernor::SmallFrames; l < MemoryGovernor::N_LEVELS; l++)
+      w.add(MemoryGovernor::levelName(MemoryGovernor::Level(l)), governor.entries(MemoryGovernor::Level(l)));
+   w.endObject();
+   w.add("internalFree", lastSample.internalFree);
+   w.add("internalLargest", lastSample.internalLargest);
+   w.add("internalLargestMin", lowestLargest);
+   if (lastSample.psramLargest != UINT32_MAX)
+      w.add("psramLargest", lastSample.psramLargest);
+   w.endObject();
+}
@@ -0,0 +1,14 @@
+//
+// pressure.h -- act on memory pressure
+//
+// Ben Slaghekke, 19 October 2026
+//
+#ifndef _PRESSURE_H
+#define _PRESSURE_H
+
+#include "json.h"
+
+extern void pressureSetup       ();             // start the governor; after the scheduler is running
+extern void pressureWriteStatus (JsonWriter &w); // "pressure": {...} for /api/status
+
+#endif
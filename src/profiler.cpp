@@ -0,0 +1,338 @@
+//
+// profiler.cpp -- sampling CPU profiler and FreeRTOS task report
+//
+// Profiler: a hardware timer interrupt on each core, PROFILE_HZ times a
+// second, records the program counter of the interrupted task in a histogram.
+// The sample rate is just off 1 kHz, so it does not run in step with the tick.
+// The PC is taken from the interrupt frame, which the interrupt entry code
+// saves on the task's stack and points to with pxTopOfStack. PCs are counted per
+// PROFILE_GRANULE bytes. The histogram is an open addressing table of
+// PROFILE_SLOTS entries that is only allocated while the profiler runs.
+// Samples that find no free entry are counted as dropped; idle task samples and
+// samples that interrupted another interrupt are only counted.
+//
+// It is off by default; POST /api/profile {"cmd":"start"|"stop"|"clear"}.
+// Symbols are resolved on the host, from the ELF of the same build:
+//    curl -s http://<camera>/api/profile | jq -r '.pcs[][0]' |
+//       xtensa-esp32-elf-addr2line -fpC -e .pio/build/esp32cam/firmware.elf
+//
+// Task report: per task the CPU use since the previous report and since boot
+// (in % of one core), the stack high water mark, priority and core. CPU use
+// needs CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS.
+//
+// Ben Slaghekke, 19 October 2026
+//
+#include <Arduino.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "allocator.h"
+#include "profiler.h"
+
+#if PROFILER
+#include "driver/gptimer.h"
+#include "esp_ipc.h"
+#include "xtensa_context.h"
+#endif
+
+#define _DEBUG 1
+#include "debug.h"
+
+#define PROFILE_HZ (997)
+#define PROFILE_GRANULE_SHIFT (4)   // 16 byte granules
+#define PROFILE_SLOTS (256)         // power of 2
+#define PROFILE_PROBES (8)          // probes before a sample is dropped
+#define MAX_REPORTED_PCS (64)
+#define MAX_TASKS (32)              // task report limit
+
+static const char *cName = "profiler";
+
+#if PROFILER
+struct ProfileSlot
+{
+   uint32_t pc;  // granule address, 0 = free
+   uint32_t count;
+};
+
+static ProfileSlot *volatile table = nullptr; // guarded by profileLock
+static gptimer_handle_t timers[portNUM_PROCESSORS];
+static volatile uint32_t samples = 0;
+static volatile uint32_t idleSamples = 0;
+static volatile uint32_t isrSamples = 0;
+static volatile uint32_t dropped = 0;
+static uint32_t startedAt = 0;
+static portMUX_TYPE profileLock = portMUX_INITIALIZER_UNLOCKED;
+
+//----------------------------
+static bool IRAM_ATTR onSample(gptimer_handle_t timer, const gptimer_alarm_event_data_t *event, void *context)
+{
+   uint32_t pc = 0;
+   bool fromIsr = xPortInterruptedFromISRContext();
+   TaskHandle_t task = xTaskGetCurrentTaskHandle();
+   bool idle = task == xTaskGetIdleTaskHandleForCore(xPortGetCoreID());
+   if (!fromIsr && !idle)
+   {
+      // the first member of a TCB is pxTopOfStack, which points to the interrupt frame
+      const XtExcFrame *frame = *(const XtExcFrame *const *)task;
+      pc = frame->pc & ~((1UL << PROFILE_GRANULE_SHIFT) - 1);
+   }
+
+   portENTER_CRITICAL_ISR(&profileLock);
+   ProfileSlot *t = table;
+   if (!t || fromIsr || idle)
+   {
+      if (t)
+      {
+         samples++;
+         if (fromIsr)
+            isrSamples++;
+         else
+            idleSamples++;
+      }
+      portEXIT_CRITICAL_ISR(&profileLock);
+      return false;
+   }
+   samples++;
+   uint32_t i = (pc >> PROFILE_GRANULE_SHIFT) * 2654435761UL >> (32 - 8); // 8 = log2 (PROFILE_SLOTS)
+   int probe = 0;
+   for (; probe < PROFILE_PROBES; probe++, i = (i + 1) & (PROFILE_SLOTS - 1))
+   {
+      if (t[i].pc == pc)
+         break;
+      if (t[i].pc == 0)
+      {
+         t[i].pc = pc;
+         break;
+      }
+   }
+   if (probe < PROFILE_PROBES)
+      t[i].count++;
+   else
+      dropped++;
+   portEXIT_CRITICAL_ISR(&profileLock);
+   return false;
+}
+
+//----------------------------
+static void startTimer(void *arg)
+// runs on the core the timer must interrupt: the interrupt is allocated there
+{
+   gptimer_handle_t *timer = (gptimer_handle_t *)arg;
+   gptimer_config_t config = {};
+   config.clk_src = GPTIMER_CLK_SRC_DEFAULT;
+   config.direction = GPTIMER_COUNT_UP;
+   config.resolution_hz = 1000000;
+   if (gptimer_new_timer(&config, timer) != ESP_OK)
+   {
+      *timer = nullptr;
+      return;
+   }
+   gptimer_event_callbacks_t callbacks = {};
+   callbacks.on_alarm = onSample;
+   gptimer_alarm_config_t alarm = {};
+   alarm.alarm_count = 1000000 / PROFILE_HZ;
+   alarm.reload_count = 0;
+   alarm.flags.auto_reload_on_alarm = true;
+   gptimer_register_event_callbacks(*timer, &callbacks, nullptr);
+   gptimer_enable(*timer);
+   gptimer_set_alarm_action(*timer, &alarm);
+   gptimer_start(*timer);
+}
+
+//----------------------------
+bool profilerStart()
+{
+   const char *fName = "profilerStart";
+   if (table)
+      return true;
+   // read by the timer interrupts: internal RAM
+   ProfileSlot *t = (ProfileSlot *)memAlloc(PROFILE_SLOTS * sizeof(ProfileSlot), MemProfile, MemInternal);
+   if (!t)
+   {
+      ERROR("%s: %s: no memory for the histogram\n", cName, fName);
+      return false;
+   }
+   memset(t, 0, PROFILE_SLOTS * sizeof(ProfileSlot));
+   profilerClear();
+   table = t;
+   startedAt = millis();
+   for (int core = 0; core < portNUM_PROCESSORS; core++)
+   {
+      esp_ipc_call_blocking(core, startTimer, &timers[core]);
+      if (!timers[core])
+         WARNING("%s: %s: no timer for core %d\n", cName, fName, core);
+   }
+   LOG(">< %s: %s: %d Hz, %u bytes\n", cName, fName, PROFILE_HZ, (unsigned)(PROFILE_SLOTS * sizeof(ProfileSlot)));
+   return true;
+}
+
+//----------------------------
+void profilerStop()
+{
+   portENTER_CRITICAL(&profileLock);
+   ProfileSlot *t = table;
+   table = nullptr; // from now on the interrupts do nothing
+   portEXIT_CRITICAL(&profileLock);
+   if (!t)
+      return;
+   for (int core = 0; core < portNUM_PROCESSORS; core++)
+   {
+      if (timers[core])
+      {
+         gptimer_stop(timers[core]);
+         gptimer_disable(timers[core]);
+         gptimer_del_timer(timers[core]);
+         timers[core] = nullptr;
+      }
+   }
+   memFree(t);
+   LOG(">< %s: profilerStop\n", cName);
+}
+
+//----------------------------
+void profilerClear()
+{
+   portENTER_CRITICAL(&profileLock);
+   if (table)
+      memset(table, 0, PROFILE_SLOTS * sizeof(ProfileSlot));
+   samples = idleSamples = isrSamples = dropped = 0;
+   startedAt = millis();
+   portEXIT_CRITICAL(&profileLock);
+}
+
+//----------------------------
+bool profilerRunning()
+{
+   return table != nullptr;
+}
+
+//----------------------------
+void profilerWriteReport(JsonWriter &w)
+// the MAX_REPORTED_PCS most frequent granules, most frequent first
+{
+   w.beginObject();
+   w.add("running", profilerRunning());
+   w.add("hz", PROFILE_HZ);
+   w.add("granule", 1 << PROFILE_GRANULE_SHIFT);
+   w.add("seconds", table ? (millis() - startedAt) / 1000 : 0);
+   w.add("samples", samples);
+   w.add("idle", idleSamples);
+   w.add("isr", isrSamples);
+   w.add("dropped", dropped);
+   w.beginArray("pcs"); // ["0x400d1230", count]
+   ProfileSlot *t = table;
+   uint32_t below = UINT32_MAX; // counts already reported are >= this
+   uint32_t belowPc = 0;
+   for (int n = 0; t && n < MAX_REPORTED_PCS; n++)
+   {
+      // next in (count descending, pc ascending) order; counts may still increase meanwhile
+      int best = -1;
+      for (int i = 0; i < PROFILE_SLOTS; i++)
+      {
+         uint32_t c = t[i].count;
+         if (t[i].pc == 0 || c > below || (c == below && t[i].pc <= belowPc))
+            continue;
+         if (best < 0 || c > t[best].count || (c == t[best].count && t[i].pc < t[best].pc))
+            best = i;
+      }
+      if (best < 0)
+         break;
+      below = t[best].count;
+      belowPc = t[best].pc;
+      char pc[12];
+      snprintf(pc, sizeof(pc), "0x%08x", (unsigned)belowPc);
+      w.beginArray();
+      w.add(nullptr, pc);
+      w.add(nullptr, below);
+      w.endArray();
+   }
+   w.endArray();
+   w.endObject();
+}
+#else
+bool profilerStart() { return false; }
+void profilerStop() {}
+void profilerClear() {}
+bool profilerRunning() { return false; }
+void profilerWriteReport(JsonWriter &w)
+{
+   w.beginObject();
+   w.add("running", false);
+   w.add("error", "profiler not in this build");
+   w.endObject();
+}
+#endif
+
+//----------------------------
+static const char *taskState(eTaskState s)
+{
+   return (s == eRunning     ? "running"
+           : s == eReady     ? "ready"
+           : s == eBlocked   ? "blocked"
+           : s == eSuspended ? "suspended"
+           : s == eDeleted   ? "deleted"
+                             : "invalid");
+}
+
+//----------------------------
+void tasksWriteReport(JsonWriter &w)
+{
+   w.beginObject();
+#if configUSE_TRACE_FACILITY
+   static uint32_t previousTotal = 0;
+   static UBaseType_t previousNumber[MAX_TASKS];
+   static uint32_t previousCounter[MAX_TASKS];
+   static int nPrevious = 0;
+
+   TaskStatus_t *status = (TaskStatus_t *)memAlloc(MAX_TASKS * sizeof(TaskStatus_t), MemTaskList);
+   if (!status)
+   {
+      w.add("error", "no memory");
+      w.endObject();
+      return;
+   }
+   uint32_t total = 0;
+   UBaseType_t n = uxTaskGetSystemState(status, MAX_TASKS, &total);
+   w.add("tasks", int(uxTaskGetNumberOfTasks()));
+   w.add("runTimeStats", configGENERATE_RUN_TIME_STATS != 0);
+   uint32_t interval = total - previousTotal;
+   w.beginArray("list");
+   for (UBaseType_t i = 0; i < n; i++)
+   {
+      TaskStatus_t &s = status[i];
+      w.beginObject();
+      w.add("name", s.pcTaskName);
+      w.add("state", taskState(s.eCurrentState));
+      w.add("priority", (unsigned)s.uxCurrentPriority);
+#if configTASKLIST_INCLUDE_COREID
+      w.add("core", s.xCoreID == tskNO_AFFINITY ? -1 : int(s.xCoreID));
+#endif
+      w.add("stackFree", (unsigned)s.usStackHighWaterMark); // bytes on ESP-IDF
+#if configGENERATE_RUN_TIME_STATS
+      uint32_t before = 0;
+      for (int p = 0; p < nPrevious; p++)
+      {
+         if (previousNumber[p] == s.xTaskNumber)
+            before = previousCounter[p];
+      }
+      // in % of one core
+      w.addFloat("cpu", interval ? 100.0f * (s.ulRunTimeCounter - before) / interval : 0.0f);
+      w.addFloat("cpuTotal", total ? 100.0f * s.ulRunTimeCounter / total : 0.0f);
+#endif
+      w.endObject();
+   }
+   w.endArray();
+   for (UBaseType_t i = 0; i < n; i++)
+   {
+      previousNumber[i] = status[i].xTaskNumber;
+#if configGENERATE_RUN_TIME_STATS
+      previousCounter[i] = status[i].ulRunTimeCounter;
+#endif
+   }
+   nPrevious = n;
+   previousTotal = total;
+   memFree(status);
+#else
+   w.add("error", "needs CONFIG_FREERTOS_USE_TRACE_FACILITY");
+#endif
+   w.endObject();
+}
@@ -0,0 +1,22 @@
+//
+// profiler.h -- sampling CPU profiler and FreeRTOS task report
+//
+// Ben Slaghekke, 19 October 2026
+//
+#ifndef _PROFILER_H
+#define _PROFILER_H
+
+#include "json.h"
+
+#ifndef PROFILER
+#define PROFILER 1          // 0 leaves the sampling profiler out of the build
+#endif
+
+extern bool profilerStart       ();             // start sampling; false if not possible
+extern void profilerStop        ();             // stop sampling and free the histogram
+extern void profilerClear       ();
+extern bool profilerRunning     ();
+extern void profilerWriteReport (JsonWriter &w); // the /api/profile document
+extern void tasksWriteReport    (JsonWriter &w); // the /api/tasks document
+
+#endif
@@ -8,6 +8,10 @@
 #include "debug.h"
 
 #include "ESP32Servo.h"
+#include "tasks.h"
+#include "warmboot.h"
+#include "heapscope.h"
+#include "clip.h"
 #include "shutter.h"
 
 #define STORE_SETTINGS
@@ -30,63 +34,116 @@
 #define SPEED (1000)             // default move speed, us per second must be >= 50!
 #define MAX_N_MOVES (20)         // max # repeated moves
 #define MOVE_INTERVAL_TIME (100) // time between moves
+#define MOTION_IDLE_TIME (1000)  // ms; longest sleep of the motion task
+#define COMMAND_QUEUE_LEN (8)    // commands waiting for the motion task
+#define POST_WAIT (100)          // ms; a full queue drops the command after this
 
 #ifdef STORE_SETTINGS
 static Preferences preferences;
 #endif
 Shutter shutter;
 
+// the moves run in their own high priority task, see tasks.cpp
+static Scheduler motionScheduler(schedulerMillis);
+static TaskHandle_t motionTask = nullptr;
+static QueueHandle_t commandQueue = nullptr; // Shutter::Request, from the other tasks
+
 static const char *cName = "Shutter";
 
+//-------------------
+static void motionWake()
+// SchedulerWake: a move was started; also a command was posted
+{
+   if (motionTask)
+      xTaskNotifyGive(motionTask);
+}
+
+//-------------------
+void Shutter::motionLoop(void *arg)
+// runs the commands and the servo steps; sleeps until the next step is due or a command comes
+{
+   Request r;
+   while (true)
+   {
+      while (xQueueReceive(commandQueue, &r, 0) == pdTRUE)
+      {
+         shutter.execute(r);
+         shutter.pending--; // after execute: a move started by it already shows
+      }
+      motionScheduler.run();
+      uint32_t wait = motionScheduler.timeToNext(MOTION_IDLE_TIME);
+      if (wait > 0)
+         ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(wait));
+   }
+}
+
 //-------------------
 void Shutter::setup()
 {
    const char *fName = "setup";
    LOG(">  %s::%s\n", cName, fName);
+   HeapScope scope(SubsysShutter);
    attach(SHUTTER_GPIO);
    localRestoreSettings();
-   currentPosition = endPosition;
+   // after a warm reset the servo is where the RTC state says; a move that was cut off is finished
+   const WarmState &w = warmBoot.state();
+   int destination = endPosition;
+   if (warmBoot.isWarm() && w.shutterValid)
+      clipWrite(w.currentPosition, currentPosition);
+   else
+      currentPosition = endPosition;
+   endPosition = currentPosition;
    setState();
    writeMicroseconds(currentPosition);
+   saveWarm(false);
+   commandQueue = xQueueCreate(COMMAND_QUEUE_LEN, sizeof(Request));
+   motionScheduler.setWakeFunction(motionWake);
+   motionTask = startTask(MotionTask, motionLoop, nullptr);
+   if (destination != currentPosition)
+   {
+      LOG("   %s::%s: finish the move to %d us\n", cName, fName, destination);
+      post(CmdMoveTo, destination);
+   }
    LOG("<  %s::%s\n", cName, fName);
 }
 
 //-------------------
-void Shutter::loop()
-// call from main loop
+void Shutter::stepMove()
+// scheduled every STEP_INTERVAL while moving
 {
-   const char *fName = "loop";
-   if (state == Moving)
+   const char *fName = "stepMove";
+   uint32_t now = micros();
+   uint32_t interval = now - lastStepAt;
+   uint32_t late = interval > STEP_INTERVAL * 1000 ? interval - STEP_INTERVAL * 1000 : 0;
+   lastStepAt = now;
+   if (late > stepLate)
+      stepLate = late;
+   if (late > worstStepLate)
+      worstStepLate = late;
+
+   int toGo = (endPosition - currentPosition) * moveDirection;
+   if (toGo <= 0)
    {
-      uint32_t m = millis();
-      if (m - recentSample > STEP_INTERVAL)
+      // we are done!;
+      currentPosition = endPosition;
+      writeMicroseconds(currentPosition);
+      motionScheduler.cancel(stepJob);
+      stepJob = Scheduler::NO_JOB;
+      setState();
+      if (nMoves == 0)
       {
-         recentSample = m;
-
-         int toGo = (endPosition - currentPosition) * moveDirection;
-         if (toGo <= 0)
-         {
-            // we are done!;
-            currentPosition = endPosition;
-            writeMicroseconds(currentPosition);
-            setState();
-            if (nMoves == 0)
-               saveSettings(false);      // only nmoves and endposition
-            moveIntervalTime = millis(); // start timer
-            if (nMoves == 0)
-            {
-               LOG("   %s::%s: Move complete; shutter is %s\n", cName, fName, state2str(state));
-            }
-         }
-         else
-         {
-            currentPosition += moveSpeed; // moveSpeed includes direction
-            writeMicroseconds(currentPosition);
-         }
+         writeSettings(false); // only nmoves and endposition
+         LOG("   %s::%s: Move complete; shutter is %s\n", cName, fName, state2str(state));
       }
+      else
+         motionScheduler.after(MOVE_INTERVAL_TIME, repeatCallback, this);
    }
    else
-      repeatMove();
+   {
+      currentPosition += moveSpeed; // moveSpeed includes direction
+      writeMicroseconds(currentPosition);
+      saveWarm(false);
+   }
 }
 
 //----------------
@@ -94,15 +151,13 @@ void Shutter::repeatMove()
 {
    if (nMoves > 0 && state != Moving)
    {
-      if (millis() - moveIntervalTime > MOVE_INTERVAL_TIME)
-      {
-         if (currentPosition != openPosition)
-            open();
-         else
-            close();
-         moveIntervalTime = millis();
-         nMoves--;
-      }
+      if (currentPosition != openPosition)
+         moveTo(openPosition);
+      else
+         moveTo(closedPosition);
+      nMoves--;
+      if (nMoves > 0 && state != Moving) // no move needed, e.g. open == closed
+         motionScheduler.after(MOVE_INTERVAL_TIME, repeatCallback, this);
    }
 }
 
@@ -116,8 +171,7 @@ void Shutter::startRepeatedMoves(int _nMoves)
    if (_nMoves > MAX_N_MOVES)
       _nMoves = MAX_N_MOVES;
 
-   nMoves = _nMoves;
-   repeatMove();
+   post(CmdRepeat, _nMoves);
    LOG("<  %s::%s\n", cName, fName);
 }
 
@@ -126,7 +180,7 @@ void Shutter::open()
 // open the shutter
 {
    LOG(">< Open shutter\n");
-   moveTo(openPosition);
+   post(CmdOpen);
 }
 
 //--------------------
@@ -134,14 +188,26 @@ void Shutter::close()
 // close the shutter
 {
    LOG(">< Close shutter \n");
-   moveTo(closedPosition);
+   post(CmdClose);
 }
 
 //-------------------------------
 void Shutter::step(int stepSize)
 // move stepSize us relative to current pos
 {
-   moveTo(endPosition + stepSize);
+   post(CmdStep, stepSize);
+}
+
+//-------------------------------
+void Shutter::markOpen()
+{
+   post(CmdMarkOpen);
+}
+
+//-------------------------------
+void Shutter::markClosed()
+{
+   post(CmdMarkClosed);
 }
 
 //--------------------------
@@ -168,10 +234,17 @@ uint Shutter::getSpeed()
 
 //---------------------------
 void Shutter::saveSettings(bool saveAll)
+// save the shutter settings to flash, in the motion task
+{
+   post(CmdSave, saveAll);
+}
+
+//---------------------------
+void Shutter::writeSettings(bool saveAll)
 // save the shutter settings to flash
 // they are restored in the init code
 {
-   const char *fName = "saveSettings";
+   const char *fName = "writeSettings";
 #ifdef STORE_SETTINGS
    LOG(">  %s::%s (saveAll = %s)\n", cName, fName, toCCP(saveAll));
    preferences.begin("Servo", false); // name, read-only
@@ -187,14 +260,40 @@ void Shutter::saveSettings(bool saveAll)
    preferences.end();
    LOG("<  %s::%s\n", cName, fName);
 #endif
+   saveWarm(saveAll);
+}
+
+//---------------------------
+void Shutter::saveWarm(bool saveAll)
+// keep the position (and the settings, as saved in flash) in RTC memory
+{
+   WarmState &w = warmBoot.beginUpdate();
+   w.currentPosition = currentPosition;
+   w.endPosition = endPosition;
+   w.nShutterMoves = nShutterMoves;
+   if (saveAll)
+   {
+      w.openPosition = openPosition;
+      w.closedPosition = closedPosition;
+      w.speed = getSpeed();
+      w.shutterValid = true;
+   }
+   warmBoot.endUpdate();
 }
 
 //------------------------------
 void Shutter::restoreSettings()
+// restores settings and moves the shutter to the saved position, in the motion task
+{
+   post(CmdRestore);
+}
+
+//------------------------------
+void Shutter::readSettings()
 // restores settings and moves the shutter
 // to the saved position
 {
-   const char *fName = "restoreSettings";
+   const char *fName = "readSettings";
    LOG(">   %s::%s\n", cName, fName);
    localRestoreSettings();
    if (currentPosition != endPosition)
@@ -213,10 +312,11 @@ void Shutter::report()
 
 //----------------------
 void Shutter::waitComplete()
+// the moves are run by the motion task
 {
    while (isMoving())
    {
-      loop();
+      delay(STEP_INTERVAL);
    }
 }
 
@@ -230,21 +330,85 @@ void Shutter::getValues(int &openPos, int &closedPos, int &moveSpeed)
 
 //---------------------------
 void Shutter::setValues(const int openPos, const int closedPos, const int moveSpeed)
+// an open or closed shutter moves to the new open or closed position.
+// Does not wait: the commands are executed in order, so an open, close or save
+// posted after this uses the new values; getValues shows them once executed
 {
-   bool _isOpen = isOpen();
-   bool _isClosed = isClosed();
-   openPosition = openPos;
-   closedPosition = closedPos;
-   setSpeed(moveSpeed);
-   if (_isOpen)
-      open();
-   else if (_isClosed)
-      close();
-   waitComplete();
+   post(CmdSetValues, openPos, closedPos, moveSpeed);
 }
 
 // -- private methods
 
+//-------------------
+void Shutter::post(Command command, int a, int b, int c)
+{
+   Request r = {command, {a, b, c}, micros()};
+   pending++;
+   if (!commandQueue || xQueueSend(commandQueue, &r, pdMS_TO_TICKS(POST_WAIT)) != pdTRUE)
+   {
+      pending--;
+      WARNING("%s: command %d dropped\n", cName, (int)command);
+      return;
+   }
+   motionWake();
+}
+
+//-------------------
+void Shutter::execute(const Request &r)
+// the motion task: the only one that changes the move, the position and the settings
+{
+   if (r.command == CmdOpen || r.command == CmdClose)
+   {
+      commandLatency = micros() - r.postedAt;
+      if (commandLatency > worstCommandLatency)
+         worstCommandLatency = commandLatency;
+   }
+   switch (r.command)
+   {
+   case CmdOpen:
+      moveTo(openPosition);
+      break;
+   case CmdClose:
+      moveTo(closedPosition);
+      break;
+   case CmdStep:
+      moveTo(endPosition + r.arg[0]);
+      break;
+   case CmdMoveTo:
+      moveTo(r.arg[0]);
+      break;
+   case CmdRepeat:
+      nMoves = r.arg[0];
+      repeatMove();
+      break;
+   case CmdSetValues:
+   {
+      bool _isOpen = state != Moving && currentPosition == openPosition && nMoves == 0;
+      bool _isClosed = state != Moving && currentPosition == closedPosition && nMoves == 0;
+      openPosition = r.arg[0];
+      closedPosition = r.arg[1];
+      setSpeed(r.arg[2]);
+      if (_isOpen)
+         moveTo(openPosition);
+      else if (_isClosed)
+         moveTo(closedPosition);
+      break;
+   }
+   case CmdSave:
+      writeSettings(r.arg[0] != 0);
+      break;
+   case CmdRestore:
+      readSettings();
+      break;
+   case CmdMarkOpen:
+      openPosition = endPosition;
+      break;
+   case CmdMarkClosed:
+      closedPosition = endPosition;
+      break;
+   }
+}
+
 //----------------------
 const char *Shutter::state2str(Shutter::State s)
 {
@@ -278,11 +442,17 @@ void Shutter::moveTo(uint32_t destination)
    const char *fName = "moveTo";
    if (state != Moving && destination != currentPosition)
    {
+      bool wasOpen = state == Open;
       state = Moving;
       clipWrite(destination, endPosition);
+      if (endPosition == openPosition && !wasOpen)
+         clipTrigger(ClipShutter); // it opens: keep the seconds before; not when new values move an open shutter
       moveDirection = (endPosition >= currentPosition) ? 1 : -1;
       moveSpeed = absMoveSpeed * moveDirection;
       nShutterMoves++;
+      stepLate = 0;
+      lastStepAt = micros();
+      stepJob = motionScheduler.every(STEP_INTERVAL, stepCallback, this);
       LOG(">< %s::%s (%d): nbr of shutter moves = %d\n", cName, fName, destination, nShutterMoves);
    }
 }
@@ -294,6 +464,18 @@ void Shutter::localRestoreSettings()
 {
    const char *fName = "localRestoreSettings";
    LOG(">  %s::%s ()\n", cName, fName);
+   const WarmState &w = warmBoot.state();
+   if (w.shutterValid)
+   {
+      // valid after a warm reset, or once flash has been read since the last cold boot
+      clipWrite(w.openPosition, openPosition);
+      clipWrite(w.closedPosition, closedPosition);
+      clipWrite(w.endPosition, endPosition);
+      setSpeed(w.speed);
+      nShutterMoves = w.nShutterMoves;
+      LOG("<  %s::%s: from RTC memory\n", cName, fName);
+      return;
+   }
 #ifdef STORE_SETTINGS
    preferences.begin("Servo", true); // name, read-only
    uint32_t ve = preferences.getUInt("Version", 0);
@@ -326,6 +508,7 @@ void Shutter::localRestoreSettings()
    setSpeed(SPEED);
 
 #endif
+   saveWarm(true);
    LOG("<  %s::%s\n", cName, fName);
 }
 
@@ -6,24 +6,30 @@
 #ifndef _SHUTTER_H
 #define _SHUTTER_H
 
+#include <atomic>
 #include <ESP32Servo.h>
+#include "scheduler.h"
 
 
+// The moves run in the motion task. The commands (open, close, step, repeated moves,
+// settings) are posted to it through a queue, so only the motion task changes the
+// position, the move and the settings; the other tasks only read them.
 class Shutter: public Servo {
   public:
     enum State {Closed, Open, Moving, Idle};  // Idle is a non-moving position not Closed or Open
     Shutter () {}
     void     setup ();            // init Shutter
-    void     loop ();             // call from main loop
     void     open  ();            // open, do not wait for completion
     void     close ();            // close, do not wait for completion
     void     startRepeatedMoves (int nMoves);  // move <nMoves> times
-    bool     isMoving ()          { return (state == Moving || currentPosition != endPosition    || nMoves != 0);}
-    bool     isOpen ()            { return (state != Moving && currentPosition == openPosition   && nMoves == 0);}
-    bool     isClosed ()          { return (state != Moving && currentPosition == closedPosition && nMoves == 0);}
+    bool     isMoving ()          { return (pending != 0 || state == Moving || currentPosition != endPosition || nMoves != 0);}
+    bool     isOpen ()            { return (pending == 0 && state != Moving && currentPosition == openPosition   && nMoves == 0);}
+    bool     isClosed ()          { return (pending == 0 && state != Moving && currentPosition == closedPosition && nMoves == 0);}
+    const char *stateName ()      { return state2str (state);}
+    int      getPosition ()       { return currentPosition;}  // current position in usec
     void     step (int stepSize); // step relative to current position
-    void     markOpen   ()        {openPosition   = endPosition;} // call this the open position
-    void     markClosed ()        {closedPosition = endPosition;} // call this the closed position
+    void     markOpen   ();       // call the current destination the open position
+    void     markClosed ();       // call the current destination the closed position
     uint     getSpeed ();         // in us per second
     void     setSpeed (unsigned int usPerSecond); // set move speed in us per second
     void     saveSettings (bool saveAll = true);     // keep settings in flash 
@@ -31,19 +37,39 @@ class Shutter: public Servo {
     void     report     ();       // print values
 	  uint32_t getNShutterMoves ()  {return nShutterMoves;}  // total shutter moves
 	  uint32_t movesLeft        ()  {return nMoves;}         // moves left for this repeated move
-    void     waitComplete ();     // wait for completion of move(s); 
+    uint32_t getStepLate ()       {return stepLate;}       // us, largest step delay of the current or last move
+    uint32_t getWorstStepLate ()  {return worstStepLate;}  // us, since boot
+    uint32_t getCommandLatency ()      {return commandLatency;}       // us from open/close to the motion task, last command
+    uint32_t getWorstCommandLatency () {return worstCommandLatency;}  // us, since boot
+    void     waitComplete ();     // wait for completion of move(s); not from the motion task
     void     getValues  (int &openPos, int &closedPos, int &moveSpeed);
-    void     setValues  (const int openPos, const int closedPos, const int moveSpeed);
+    void     setValues  (const int openPos, const int closedPos, const int moveSpeed); // do not wait
     int      toUs (const int angle)  {return (speedToUs (angle) + 500);}   // 1000 us = 90 deg
     int      toDeg (const int angle) {return (speedToDeg(angle - 500));}
     int      speedToUs  (const int angle) {return (angle * 11111 + 500) / 1000;} // speed in deg per second
     int      speedToDeg (const int angle) {return (angle * 1000 + 5555) / 11111;}
   private:
+    enum Command {CmdOpen, CmdClose, CmdStep, CmdMoveTo, CmdRepeat, CmdSetValues, CmdSave, CmdRestore,
+                  CmdMarkOpen, CmdMarkClosed};
+    struct Request {
+       Command  command;
+       int      arg[3];
+       uint32_t postedAt;       // micros ()
+    };
+    void     post       (Command command, int a = 0, int b = 0, int c = 0); // to the motion task
+    void     execute    (const Request &r);  // in the motion task
+    void     writeSettings (bool saveAll);
+    void     readSettings ();
+    static void motionLoop (void *arg);
     const char *state2str (State s);
     void     moveTo     (uint32_t destination);
     void     localRestoreSettings (); // restore settings but not servo position
     void     clipWrite  (int value, int &destination);     // clip position and write 
     void     repeatMove (void);
+    void     stepMove   ();       // one step of a move, every STEP_INTERVAL
+    void     saveWarm   (bool saveAll);  // keep state in RTC memory for a warm reset
+    static void stepCallback   (void *context) {((Shutter *)context)->stepMove ();}
+    static void repeatCallback (void *context) {((Shutter *)context)->repeatMove ();}
     State    setState ();
   
     int      openPosition;      // the open position in usec
@@ -55,9 +81,14 @@ class Shutter: public Servo {
     int      currentPosition;   // current position of the servo
     int      moveDirection;     // 1 if moving to higher uS, -1 if moving to lower uS
     int      moveSpeed;         // microseconds per sample time 
-    uint32_t recentSample;      // most recently sampled time [millis ()]
     uint32_t nMoves;            // for repeated moves
-    uint32_t moveIntervalTime;  // for measuring time between moves
+    int      stepJob = Scheduler::NO_JOB;  // scheduler job of the current move
+    uint32_t lastStepAt = 0;    // micros () of the previous step, or of the move command
+    uint32_t stepLate = 0;      // us a step came later than STEP_INTERVAL, max of this move
+    uint32_t worstStepLate = 0; // the same, since boot
+    uint32_t commandLatency = 0;      // us from posting an open or close to its execution
+    uint32_t worstCommandLatency = 0;
+    std::atomic<int> pending {0};     // commands posted, not yet executed
 };
 
 extern Shutter shutter;
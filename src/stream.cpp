@@ -0,0 +1,445 @@
+//
+// stream.cpp -- MJPEG streaming
+//
+// A stream request is not served by the http server task itself: the handler
+// detaches the request with httpd_req_async_handler_begin () and hands it
+// to one of N_STREAM_WORKERS worker tasks. The server task is free again
+// at once, so the control pages stay responsive while streams run, and
+// a single server suffices for both.
+//
+// Every stream is a session:
+// - admission: at most maxViewers sessions. A viewer beyond that gets a single
+//   jpg snapshot (or a 503 if even that fails), both with Retry-After.
+//   Under memory pressure (pressure.cpp) maxViewers is lowered; the newest
+//   sessions above it are evicted. At 0 new viewers get a 503 at once.
+// - pacing: /stream?fps=n caps the frame rate of a session (1..MAX_FPS).
+//   Frames are scheduled on a fixed grid (vTaskDelayUntil), so the rate does
+//   not drift with the time it takes to send a frame.
+// - stale sockets: sends time out after SEND_TIMEOUT_MS instead of the server's
+//   send_wait_timeout, which ends the session.
+// - memory: when the internal heap drops below LOW_HEAP_BYTES, the session that
+//   has gone longest without delivering a frame is evicted, provided it has been
+//   idle for at least IDLE_MS. The governor (pressure.cpp) checks this every
+//   second, so a stalled worker need not send a frame first.
+// - eviction: the socket of an evicted session is shut down, so a send that
+//   blocks on it fails at once instead of after SEND_TIMEOUT_MS. The server
+//   closes the socket when the worker completes the request, and the number
+//   may then be reused; so the worker does not complete it while a shutdown
+//   of its socket is under way.
+// - frames: workers do not capture themselves; they send the latest frame of
+//   the capture task (capture.cpp), so all viewers share one capture per frame.
+//
+// Ben Slaghekke, 19 October 2026 - split off from http.cpp
+//
+#include <Arduino.h>
+#include <lwip/sockets.h>
+#include "esp_idf_version.h"
+#include "esp_heap_caps.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+
+#include "camera.h"
+#include "capture.h"
+#include "tasks.h"
+#include "httpsupp.h"
+#include "stream.h"
+
+#define _DEBUG 1
+#include "debug.h"
+
+#if ESP_IDF_VERSION < ESP_IDF_VERSION_VAL(5, 1, 0)
+#error "stream.cpp needs httpd_req_async_handler_begin (ESP-IDF 5.1 / arduino-esp32 3.x)"
+#endif
+
+#define PART_BOUNDARY "123456789000000000000987654321"
+
+#define N_STREAM_WORKERS (3)        // also the maximum number of viewers
+#define RETRY_AFTER_SECONDS "10"
+#define DEFAULT_FPS (15)
+#define MAX_FPS (25)
+#define SEND_TIMEOUT_MS (2000)      // a send that takes longer ends the session
+#define IDLE_MS (1000)              // no frame delivered for this long: session is idle
+#define FRAME_TIMEOUT_MS (3000)     // no new frame from the capture task for this long: give up
+#define LOW_HEAP_BYTES (24 * 1024)  // internal heap below this: evict an idle session
+
+static const char *_STREAM_CONTENT_TYPE = "multipart/x-mixed-replace;boundary=" PART_BOUNDARY;
+static const char *_STREAM_BOUNDARY = "\r\n--" PART_BOUNDARY "\r\n";
+static const char *_STREAM_PART = "Content-Type: image/jpeg\r\nContent-Length: %u\r\n\r\n";
+
+static const char *cName = "stream";
+
+struct StreamSession
+{
+   bool inUse;
+   int fd;                // socket of the viewer
+   int fps;               // frame rate cap
+   uint32_t startedAt;    // millis ()
+   uint32_t lastFrameAt;  // millis () of the most recently delivered frame
+   uint32_t frames;       // frames delivered
+   volatile bool evict;   // set by the manager; the worker ends the session
+   volatile bool shutting; // the manager is shutting fd down; the worker keeps the request until done
+};
+
+struct StreamJob
+{
+   httpd_req_t *req; // detached request
+   int slot;         // index in sessions
+};
+
+static StreamSession sessions[N_STREAM_WORKERS];
+static int maxViewers = N_STREAM_WORKERS;
+static portMUX_TYPE sessionLock = portMUX_INITIALIZER_UNLOCKED;
+static QueueHandle_t streamQueue = nullptr; // jobs for the workers
+
+// forwards
+static void streamWorker(void *arg);
+static esp_err_t streamFrames(httpd_req_t *req, StreamSession &s);
+static esp_err_t sendSnapshot(httpd_req_t *req);
+static int openSession(int fd, int fps);
+static void closeSession(int slot);
+static void shutdownSessions(const int *slots, int n);
+static void waitShutdown(int slot);
+static int requestedFps(httpd_req_t *req);
+
+//-------------------
+static esp_err_t streamHandler(httpd_req_t *req)
+// runs in the http server task; hands the request to a worker
+{
+   const char *fName = "streamHandler";
+   int fps = requestedFps(req);
+   int slot = openSession(httpd_req_to_sockfd(req), fps);
+   if (slot < 0 && maxViewers == 0)
+   {
+      WARNING("%s: %s: low on memory, refuse viewer\n", cName, fName);
+      httpd_resp_set_hdr(req, "Retry-After", RETRY_AFTER_SECONDS);
+      noteStatus(503);
+      httpd_resp_set_status(req, "503 Service Unavailable");
+      return httpd_resp_send(req, "Low on memory", HTTPD_RESP_USE_STRLEN);
+   }
+   if (slot < 0)
+   {
+      WARNING("%s: %s: %d viewers, send snapshot\n", cName, fName, maxViewers);
+      return sendSnapshot(req);
+   }
+
+   StreamJob job = {nullptr, slot};
+   esp_err_t res = httpd_req_async_handler_begin(req, &job.req);
+   if (res == ESP_OK && xQueueSend(streamQueue, &job, 0) != pdTRUE)
+   {
+      httpd_req_async_handler_complete(job.req);
+      res = ESP_FAIL;
+   }
+   if (res != ESP_OK)
+   {
+      closeSession(slot);
+      ERROR("%s: %s: could not hand over stream request\n", cName, fName);
+   }
+   LOG(">< %s: %s: session %d, %d fps, res = %d\n", cName, fName, slot, fps, res);
+   return res;
+}
+
+//----------------------------
+void streamSetup(httpd_handle_t &httpd)
+{
+   const char *fName = "streamSetup";
+   LOG(">  %s: %s\n", cName, fName);
+   streamQueue = xQueueCreate(N_STREAM_WORKERS, sizeof(StreamJob));
+   for (int i = 0; i < N_STREAM_WORKERS; i++)
+   {
+      sessions[i].inUse = false;
+      startTask(StreamTask, streamWorker, nullptr, i);
+   }
+   registerUriHandler(httpd, "/stream", streamHandler);
+   LOG("<  %s: %s\n", cName, fName);
+}
+
+//----------------------------
+int streamSessionCount()
+{
+   int n = 0;
+   for (int i = 0; i < N_STREAM_WORKERS; i++)
+   {
+      if (sessions[i].inUse)
+         n++;
+   }
+   return n;
+}
+
+//----------------------------
+void streamSetMaxViewers(int n)
+// sessions above the new maximum are evicted, the most recent first
+{
+   if (n < 0 || n > N_STREAM_WORKERS)
+      n = N_STREAM_WORKERS;
+   int evicted = 0;
+   int slots[N_STREAM_WORKERS];
+   portENTER_CRITICAL(&sessionLock);
+   maxViewers = n;
+   int surplus = -n;
+   for (int i = 0; i < N_STREAM_WORKERS; i++)
+   {
+      if (sessions[i].inUse && !sessions[i].evict)
+         surplus++;
+   }
+   for (; surplus > 0; surplus--)
+   {
+      int newest = -1;
+      for (int i = 0; i < N_STREAM_WORKERS; i++)
+      {
+         StreamSession &s = sessions[i];
+         if (s.inUse && !s.evict && (newest < 0 || int32_t(s.startedAt - sessions[newest].startedAt) > 0))
+            newest = i;
+      }
+      sessions[newest].evict = true;
+      sessions[newest].shutting = true;
+      slots[evicted++] = newest;
+   }
+   portEXIT_CRITICAL(&sessionLock);
+   shutdownSessions(slots, evicted);
+   LOG(">< %s: streamSetMaxViewers: %d, %d sessions evicted\n", cName, n, evicted);
+}
+
+//----------------------------
+void streamCheckHeap()
+// evict the session that has been idle longest, if the heap runs low
+{
+   if (heap_caps_get_free_size(MALLOC_CAP_INTERNAL) >= LOW_HEAP_BYTES)
+      return;
+
+   uint32_t now = millis();
+   int oldest = -1;
+   uint32_t oldestIdle = IDLE_MS;
+   portENTER_CRITICAL(&sessionLock);
+   for (int i = 0; i < N_STREAM_WORKERS; i++)
+   {
+      StreamSession &s = sessions[i];
+      if (s.inUse && !s.evict && now - s.lastFrameAt >= oldestIdle)
+      {
+         oldest = i;
+         oldestIdle = now - s.lastFrameAt;
+      }
+   }
+   if (oldest >= 0)
+   {
+      sessions[oldest].evict = true;
+      sessions[oldest].shutting = true;
+   }
+   portEXIT_CRITICAL(&sessionLock);
+   if (oldest >= 0)
+   {
+      WARNING("%s: low heap, evict session %d (idle %u ms)\n", cName, oldest, (unsigned)oldestIdle);
+      shutdownSessions(&oldest, 1);
+   }
+}
+
+//----------------------------
+void streamWriteStatus(JsonWriter &w)
+// array of sessions
+{
+   uint32_t now = millis();
+   w.beginArray("streams");
+   for (int i = 0; i < N_STREAM_WORKERS; i++)
+   {
+      StreamSession &s = sessions[i];
+      if (s.inUse)
+      {
+         w.beginObject();
+         w.add("fps", s.fps);
+         w.add("seconds", (now - s.startedAt) / 1000);
+         w.add("frames", s.frames);
+         w.add("idleMs", now - s.lastFrameAt);
+         w.endObject();
+      }
+   }
+   w.endArray();
+}
+
+//--static functions---------------------------------------
+
+//-------------------
+static void streamWorker(void *arg)
+{
+   StreamJob job;
+   while (true)
+   {
+      if (xQueueReceive(streamQueue, &job, portMAX_DELAY) == pdTRUE)
+      {
+         streamFrames(job.req, sessions[job.slot]);
+         waitShutdown(job.slot); // complete closes the socket
+         httpd_req_async_handler_complete(job.req);
+         LOG(">< %s: session %d ended after %u frames\n", cName, job.slot, (unsigned)sessions[job.slot].frames);
+         closeSession(job.slot);
+      }
+   }
+}
+
+//-------------------
+static esp_err_t streamFrames(httpd_req_t *req, StreamSession &s)
+// send frames until the client goes away, stalls or is evicted
+{
+   const char *fName = "streamFrames";
+   esp_err_t res = ESP_OK;
+   char part_buf[64];
+
+   // a stalled viewer must not hold the worker for the full send_wait_timeout
+   struct timeval tv = {SEND_TIMEOUT_MS / 1000, (SEND_TIMEOUT_MS % 1000) * 1000};
+   setsockopt(s.fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+
+   res = httpd_resp_set_type(req, _STREAM_CONTENT_TYPE);
+   if (res != ESP_OK)
+   {
+      return res;
+   }
+
+   captureSubscribe(s.fps);
+   uint32_t seq = 0; // of the most recently sent frame
+   const TickType_t period = pdMS_TO_TICKS(1000 / s.fps) > 0 ? pdMS_TO_TICKS(1000 / s.fps) : 1;
+   TickType_t nextWake = xTaskGetTickCount();
+   while (!s.evict)
+   {
+      SharedFrame *f = captureNext(seq, pdMS_TO_TICKS(FRAME_TIMEOUT_MS));
+      res = f ? ESP_OK : ESP_FAIL;
+
+      if (res == ESP_OK)
+      {
+         seq = f->seq;
+         size_t hlen = snprintf(part_buf, sizeof(part_buf), _STREAM_PART, (unsigned)f->frame.len);
+         res = httpd_resp_send_chunk(req, part_buf, hlen);
+      }
+      if (res == ESP_OK)
+      {
+         res = httpd_resp_send_chunk(req, (const char *)f->frame.buf, f->frame.len);
+      }
+      if (res == ESP_OK)
+      {
+         res = httpd_resp_send_chunk(req, _STREAM_BOUNDARY, strlen(_STREAM_BOUNDARY));
+      }
+      size_t len = f ? f->frame.len : 0;
+      captureRelease(f);
+
+      if (res != ESP_OK)
+      {
+         break;
+      }
+      s.lastFrameAt = millis();
+      if (++s.frames % 100 == 0)
+      {
+         LOG(">< %s: %s: JPG: frame %u length %u bytes\n", cName, fName, (unsigned)s.frames, (unsigned)len);
+      }
+
+      // fixed grid; after falling behind more than a period, restart the grid instead of bursting
+      TickType_t now = xTaskGetTickCount();
+      if (now - nextWake > period)
+         nextWake = now;
+      else
+         vTaskDelayUntil(&nextWake, period);
+   }
+   captureUnsubscribe(s.fps);
+   if (s.evict)
+      WARNING("%s: %s: session evicted\n", cName, fName);
+   return res;
+}
+
+//-------------------
+static esp_err_t sendSnapshot(httpd_req_t *req)
+// for viewers that are not admitted: one frame instead of a stream.
+// Runs in the http server task, so it does not wait for a capture: the
+// admitted viewers keep the capture task going, and their latest frame is sent.
+{
+   httpd_resp_set_hdr(req, "Retry-After", RETRY_AFTER_SECONDS);
+   SharedFrame *f = captureNext(0, 0);
+   if (!f)
+   {
+      noteStatus(503);
+      httpd_resp_set_status(req, "503 Service Unavailable");
+      return httpd_resp_send(req, "Too many viewers", HTTPD_RESP_USE_STRLEN);
+   }
+   httpd_resp_set_type(req, "image/jpeg");
+   esp_err_t res = httpd_resp_send(req, (const char *)f->frame.buf, f->frame.len);
+   captureRelease(f);
+   return res;
+}
+
+//-------------------
+static int openSession(int fd, int fps)
+// returns the session slot, or -1 if the maximum number of viewers is reached
+{
+   int slot = -1;
+   uint32_t now = millis();
+   portENTER_CRITICAL(&sessionLock);
+   int inUse = 0;
+   for (int i = 0; i < N_STREAM_WORKERS; i++)
+   {
+      if (sessions[i].inUse)
+         inUse++;
+      else if (slot < 0)
+         slot = i;
+   }
+   if (inUse >= maxViewers)
+      slot = -1;
+   if (slot >= 0)
+   {
+      StreamSession &s = sessions[slot];
+      s.inUse = true;
+      s.fd = fd;
+      s.fps = fps;
+      s.startedAt = now;
+      s.lastFrameAt = now;
+      s.frames = 0;
+      s.evict = false;
+      s.shutting = false;
+   }
+   portEXIT_CRITICAL(&sessionLock);
+   return slot;
+}
+
+//-------------------
+static void closeSession(int slot)
+{
+   portENTER_CRITICAL(&sessionLock);
+   sessions[slot].inUse = false;
+   portEXIT_CRITICAL(&sessionLock);
+}
+
+//-------------------
+static void shutdownSessions(const int *slots, int n)
+// a worker blocked in a send on one of these sockets returns at once with an error.
+// The sessions are marked shutting, so their workers keep the requests, and
+// with them the sockets, open until the shutdown is done
+{
+   for (int i = 0; i < n; i++)
+   {
+      StreamSession &s = sessions[slots[i]];
+      shutdown(s.fd, SHUT_RDWR);
+      portENTER_CRITICAL(&sessionLock);
+      s.shutting = false;
+      portEXIT_CRITICAL(&sessionLock);
+   }
+}
+
+//-------------------
+static void waitShutdown(int slot)
+// wait until no manager is shutting down the socket of this session; a shutdown takes microseconds
+{
+   while (sessions[slot].shutting)
+      vTaskDelay(1);
+}
+
+//-------------------
+static int requestedFps(httpd_req_t *req)
+// the fps=n query parameter, clipped to 1..MAX_FPS
+{
+   int fps = DEFAULT_FPS;
+   char query[32];
+   char value[8];
+   if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK &&
+       httpd_query_key_value(query, "fps", value, sizeof(value)) == ESP_OK)
+   {
+      fps = atoi(value);
+   }
+   if (fps < 1)
+      fps = 1;
+   if (fps > MAX_FPS)
+      fps = MAX_FPS;
+   return fps;
+}
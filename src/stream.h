@@ -0,0 +1,18 @@
+//
+// stream.h -- MJPEG streaming
+//
+// Ben Slaghekke, 19 October 2026
+//
+#ifndef _STREAM_H
+#define _STREAM_H
+
+#include "esp_http_server.h"
+#include "json.h"
+
+extern void streamSetup        (httpd_handle_t &httpd);  // start the stream workers and register /stream
+extern int  streamSessionCount ();                       // number of active stream sessions
+extern void streamSetMaxViewers (int n);                 // -1: all workers; 0: refuse new sessions
+extern void streamCheckHeap    ();                       // low on internal heap: evict the longest idle session
+extern void streamWriteStatus  (JsonWriter &w);          // "streams": [...] for /api/status
+
+#endif
@@ -0,0 +1,57 @@
+//
+// tasks.cpp -- task layout
+//
+// Reference: WiFi task priority 23 and lwIP (tcpip) 18, both on core 0;
+// the Arduino loop task runs at priority 1 on CONFIG_ARDUINO_RUNNING_CORE (1).
+//
+// Ben Slaghekke, 19 October 2026
+//
+#include <Arduino.h>
+#include "tasks.h"
+
+#define _DEBUG 1
+#include "debug.h"
+
+static const char *cName = "tasks";
+
+const TaskConfig taskConfig[N_TASK_IDS] = {
+   //  name            stack  prio core
+   {"motion",          3072,  12,  1},  // servo steps: must never wait for the network
+   {"capture",         4096,  8,   1},  // camera init, then frames shared by all streams
+   {"detect",          3072,  2,   1},  // motion detection; the jpg tables are static
+   {"stream",          3072,  5,   0},  // one per viewer: sends frames
+   {"clip",            3072,  4,   0},  // sends a frozen clip; below the live streams
+   {"httpd",           5120,  6,   0},  // the http server task: pages, api, WebSocket; query strings on the stack
+   {"loopTask",        8192,  1,   1},  // Arduino loop: housekeeping and logging
+};
+
+//----------------------------
+TaskHandle_t startTask(TaskId id, TaskFunction_t code, void *arg, int instance)
+{
+   const char *fName = "startTask";
+   const TaskConfig &c = taskConfig[id];
+   char name[configMAX_TASK_NAME_LEN];
+   if (instance >= 0)
+      snprintf(name, sizeof(name), "%s%d", c.name, instance);
+   else
+      snprintf(name, sizeof(name), "%s", c.name);
+
+   TaskHandle_t handle = nullptr;
+   if (xTaskCreatePinnedToCore(code, name, c.stackSize, arg, c.priority, &handle, c.core) != pdPASS)
+   {
+      ERROR("%s: %s: could not create task %s\n", cName, fName, name);
+      return nullptr;
+   }
+   LOG(">< %s: %s: %s, priority %u, core %d\n", cName, fName, name, (unsigned)c.priority, (int)c.core);
+   return handle;
+}
+
+//----------------------------
+void tasksSetup()
+// the loop task is created by the Arduino core: only its priority can be set
+{
+   const TaskConfig &c = taskConfig[HousekeepingTask];
+   vTaskPrioritySet(nullptr, c.priority);
+   if (xPortGetCoreID() != c.core)
+      WARNING("%s: %s runs on core %d, not %d\n", cName, c.name, (int)xPortGetCoreID(), (int)c.core);
+}
@@ -0,0 +1,33 @@
+//
+// tasks.h -- task layout: priority, core and stack of every task we create
+//
+// Network and http run on core 0, next to the WiFi driver and lwIP.
+// Servo motion and frame capture run on core 1, so a busy network does not
+// delay a shutter step. Motion detection runs there too, below capture, so a
+// slow analysis skips frames instead of delaying them. Motion has the highest
+// priority of our tasks; housekeeping (the Arduino loop task: WiFi state
+// machine, scheduler jobs, reports) the lowest.
+//
+// Ben Slaghekke, 19 October 2026
+//
+#ifndef _TASKS_H
+#define _TASKS_H
+
+#include <Arduino.h>
+
+enum TaskId {MotionTask, CaptureTask, DetectTask, StreamTask, ClipTask, HttpTask, HousekeepingTask, N_TASK_IDS};
+
+struct TaskConfig {
+   const char  *name;
+   uint32_t     stackSize;   // bytes
+   UBaseType_t  priority;
+   BaseType_t   core;
+};
+
+extern const TaskConfig taskConfig[N_TASK_IDS];
+
+// create a task according to its table entry; instance >= 0 is appended to the name
+extern TaskHandle_t startTask (TaskId id, TaskFunction_t code, void *arg, int instance = -1);
+extern void         tasksSetup ();  // apply the table to the task that runs setup () and loop ()
+
+#endif
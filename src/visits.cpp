@@ -0,0 +1,204 @@
+//
+// visits.cpp -- bird visits from the jpg frame sizes, per hour of the day
+//
+// Every captured frame (the detector keeps the capture going, see
+// detector.cpp) goes to the activity index (activity.h): a few float
+// operations on its size, no pixels. Visits are kept in an hourly histogram
+// and the last MAX_VISITS are listed, with their time of day.
+//
+// The time of day comes from SNTP once the station is connected. Until then
+// the hours are hours since boot, and /api/activity says so.
+//
+// Ben Slaghekke, 19 October 2026
+//
+#include <Arduino.h>
+#include <time.h>
+#include "activity.h"
+#include "visits.h"
+
+#define _DEBUG 1
+#include "debug.h"
+
+#define TIMEZONE "CET-1CEST,M3.5.0,M10.5.0/3" // Europe/Amsterdam
+#define NTP_SERVER "pool.ntp.org"
+#define VALID_TIME (1700000000)               // a time before this: the clock is not set
+#define MAX_VISITS (16)
+
+static const ActivityConfig activityConfig = {
+   60000,  // baselineMs: 1 minute
+   2000,   // scoreMs
+   1.0f,   // minSigmaPercent: jpg sizes of a still scene vary ~1 %
+   0.5f,   // drift: standard deviations
+   4.0f,   // threshold: e.g. 4.5 standard deviations above the baseline for a second
+   5000,   // minVisitMs
+   300000, // maxVisitMs: 5 minutes; longer is a change of the scene
+};
+
+struct Visit
+{
+   time_t start;     // 0: the clock was not set
+   uint32_t startMs; // millis ()
+   uint32_t durationMs;
+   uint8_t peakScore;
+};
+
+struct HourStats
+{
+   uint16_t visits;
+   uint32_t visitSeconds;
+};
+
+static ActivityIndex activity(activityConfig);
+static uint16_t frameWidth = 0;
+static uint16_t frameHeight = 0;
+static uint32_t frames = 0;
+static uint32_t levelShifts = 0;
+static uint32_t cancelled = 0;
+static Visit visits[MAX_VISITS]; // ring
+static uint32_t nVisits = 0;
+static HourStats hours[24];
+static portMUX_TYPE visitsLock = portMUX_INITIALIZER_UNLOCKED;
+
+static const char *cName = "visits";
+
+// forwards
+static bool clockSet(time_t now);
+static int hourOfDay(time_t start, uint32_t startMs);
+
+//----------------------------
+void visitsSetup()
+{
+   configTzTime(TIMEZONE, NTP_SERVER);
+   LOG(">< %s: visitsSetup\n", cName);
+}
+
+//----------------------------
+void visitsFrame(const CameraFrame &frame)
+{
+   uint32_t now = millis();
+   portENTER_CRITICAL(&visitsLock);
+   if (frame.width != frameWidth || frame.height != frameHeight)
+   {
+      // a frame size change (see Camera::setReducedFrames) is not activity
+      frameWidth = frame.width;
+      frameHeight = frame.height;
+      activity.reset();
+   }
+   frames++;
+   ActivityIndex::Event e = activity.update(frame.len, now);
+   ActivityVisit v = activity.visit();
+   if (e == ActivityIndex::LevelShift)
+      levelShifts++;
+   else if (e == ActivityIndex::VisitCancelled)
+      cancelled++;
+   portEXIT_CRITICAL(&visitsLock);
+   if (e != ActivityIndex::VisitEnd)
+      return;
+
+   // the start of the visit, in wall clock time if we have it
+   time_t t = time(nullptr);
+   time_t start = clockSet(t) ? t - time_t((now - v.startMs) / 1000) : 0;
+   int hour = hourOfDay(start, v.startMs);
+   portENTER_CRITICAL(&visitsLock);
+   Visit &slot = visits[nVisits % MAX_VISITS];
+   slot.start = start;
+   slot.startMs = v.startMs;
+   slot.durationMs = v.endMs - v.startMs;
+   slot.peakScore = v.peakScore;
+   nVisits++;
+   hours[hour].visits++;
+   hours[hour].visitSeconds += slot.durationMs / 1000;
+   portEXIT_CRITICAL(&visitsLock);
+   LOG("   %s: visit of %u s, score %u\n", cName, (unsigned)(slot.durationMs / 1000), v.peakScore);
+}
+
+//----------------------------
+void visitsWriteStatus(JsonWriter &w)
+{
+   portENTER_CRITICAL(&visitsLock);
+   int score = activity.score();
+   bool inVisit = activity.inVisit();
+   uint32_t n = nVisits;
+   portEXIT_CRITICAL(&visitsLock);
+   w.beginObject("activity");
+   w.add("score", score);
+   w.add("inVisit", inVisit);
+   w.add("visits", n);
+   w.endObject();
+}
+
+//----------------------------
+void visitsWriteReport(JsonWriter &w)
+{
+   Visit v[MAX_VISITS];
+   HourStats h[24];
+   portENTER_CRITICAL(&visitsLock);
+   memcpy(v, visits, sizeof(v));
+   memcpy(h, hours, sizeof(h));
+   uint32_t n = nVisits;
+   int score = activity.score();
+   bool inVisit = activity.inVisit();
+   float mean = activity.mean();
+   float sigma = activity.sigma();
+   float z = activity.z();
+   uint32_t changePoints = activity.changePoints();
+   uint32_t nFrames = frames;
+   uint32_t shifts = levelShifts;
+   uint32_t nCancelled = cancelled;
+   portEXIT_CRITICAL(&visitsLock);
+
+   time_t now = time(nullptr);
+   w.beginObject();
+   w.add("clock", clockSet(now) ? "local" : "uptime"); // what the hours are
+   w.add("score", score);
+   w.add("inVisit", inVisit);
+   w.add("meanBytes", int(mean));
+   w.add("sigmaBytes", int(sigma));
+   w.addFloat("z", z, 2);
+   w.add("frames", nFrames);
+   w.add("changePoints", changePoints);
+   w.add("levelShifts", shifts);
+   w.add("cancelled", nCancelled);
+   w.add("visits", n);
+   w.beginArray("visitsPerHour");
+   for (int i = 0; i < 24; i++)
+      w.add(nullptr, h[i].visits);
+   w.endArray();
+   w.beginArray("visitSecondsPerHour");
+   for (int i = 0; i < 24; i++)
+      w.add(nullptr, h[i].visitSeconds);
+   w.endArray();
+   w.beginArray("recent"); // newest first
+   for (uint32_t i = 0; i < n && i < MAX_VISITS; i++)
+   {
+      const Visit &e = v[(n - 1 - i) % MAX_VISITS];
+      w.beginObject();
+      if (e.start)
+         w.add("start", long(e.start)); // seconds since 1970
+      w.add("secondsAgo", (millis() - e.startMs) / 1000);
+      w.add("durationMs", e.durationMs);
+      w.add("score", e.peakScore);
+      w.endObject();
+   }
+   w.endArray();
+   w.endObject();
+}
+
+//--static functions---------------------------------------
+
+//----------------------------
+static bool clockSet(time_t now)
+{
+   return now > VALID_TIME;
+}
+
+//----------------------------
+static int hourOfDay(time_t start, uint32_t startMs)
+// local hour, or the hour since boot modulo 24 without a clock
+{
+   if (!start)
+      return (startMs / 3600000) % 24;
+   struct tm t;
+   localtime_r(&start, &t);
+   return t.tm_hour;
+}
@@ -0,0 +1,17 @@
+//
+// visits.h -- bird visits from the jpg frame sizes, per hour of the day
+//
+// Ben Slaghekke, 19 October 2026
+//
+#ifndef _VISITS_H
+#define _VISITS_H
+
+#include "camera.h"
+#include "json.h"
+
+extern void visitsSetup       ();                          // start the clock (SNTP); after myWifi.setup ()
+extern void visitsFrame       (const CameraFrame &frame);  // every captured frame, from the capture task
+extern void visitsWriteStatus (JsonWriter &w);             // "activity": {...} for /api/status
+extern void visitsWriteReport (JsonWriter &w);             // the /api/activity document
+
+#endif
@@ -0,0 +1,245 @@
+//
+// websock.cpp -- push shutter progress to browsers over a WebSocket
+//
+// Browsers open ws://<camera>/ws. While at least one client is connected,
+// a scheduler job queues a send job on the http server every DISPLAY_INTERVAL.
+// The job serializes the shutter status and sends it to every client whose
+// previous frame differed, so an idle shutter costs no traffic at all.
+// Each client has its own slot; a newly connected client always gets
+// the current status first. The slot is freed when the server closes the
+// socket (wsSocketClosed, from the close_fn in http.cpp), so a browser that
+// went away stops the job, also while the shutter status does not change.
+//
+// Frames are JSON text, the same object as the reply of POST /api/shutter.
+//
+// Ben Slaghekke, 19 October 2026
+//
+
+#include <Arduino.h>
+#include "json.h"
+#include "timer.h"
+#include "scheduler.h"
+#include "httpsupp.h"
+#include "api.h"
+#include "websock.h"
+
+#define _DEBUG 1
+#include "debug.h"
+
+#define MAX_WS_CLIENTS (4)
+#define DISPLAY_INTERVAL (100)  // milliseconds between frames to a client
+#define MAX_FRAME_SIZE (192)
+#define MAX_CLIENT_FRAME (1024) // a longer frame from a client closes its socket
+
+static const char *cName = "websock";
+
+struct WsClient
+{
+   int fd;            // socket, -1 if this slot is free
+   uint32_t lastHash; // hash of the most recently sent frame
+};
+
+struct FrameBuffer
+{
+   char data[MAX_FRAME_SIZE];
+   size_t len;
+};
+
+static httpd_handle_t server = nullptr;
+static WsClient clients[MAX_WS_CLIENTS];
+static volatile bool sendQueued = false;
+static int displayJob = Scheduler::NO_JOB;
+
+// forwards
+static void sendWork(void *arg);
+static void display(void *context);
+static bool addClient(int fd);
+static void removeClient(int slot);
+static bool collect(void *context, const char *data, size_t len);
+static uint32_t hash(const char *data, size_t len);
+
+//----------------
+static esp_err_t wsHandler(httpd_req_t *req)
+{
+   const char *fName = "wsHandler";
+   if (req->method == HTTP_GET)
+   {
+      // handshake done: a new client
+      int fd = httpd_req_to_sockfd(req);
+      bool added = addClient(fd);
+      LOG(">< %s: %s: client fd %d %s\n", cName, fName, fd, added ? "added" : "refused, too many clients");
+      return added ? ESP_OK : ESP_FAIL;
+   }
+
+   // a frame from the client; it is read and ignored. All of its payload
+   // must be read, or the rest would be taken for the next frame
+   httpd_ws_frame_t frame;
+   memset(&frame, 0, sizeof(frame));
+   esp_err_t r = httpd_ws_recv_frame(req, &frame, 0); // fetch the length only
+   if (r != ESP_OK)
+      return r;
+   if (frame.len > MAX_CLIENT_FRAME)
+   {
+      WARNING("%s: %s: frame of %u bytes, close\n", cName, fName, (unsigned)frame.len);
+      return ESP_FAIL;
+   }
+   uint8_t buf[32];
+   size_t left = frame.len;
+   frame.payload = buf;
+   while (r == ESP_OK && left > 0)
+   {
+      // with frame.len set, httpd_ws_recv_frame reads that much more payload
+      frame.len = left < sizeof(buf) ? left : sizeof(buf);
+      r = httpd_ws_recv_frame(req, &frame, sizeof(buf));
+      left -= frame.len;
+   }
+   return r;
+}
+
+//----------------------------
+void wsSetup(httpd_handle_t &httpd)
+{
+   server = httpd;
+   for (int i = 0; i < MAX_WS_CLIENTS; i++)
+   {
+      clients[i].fd = -1;
+   }
+   registerWsHandler(httpd, "/ws", wsHandler);
+}
+
+
+//----------------------------
+int wsClientCount()
+{
+   int n = 0;
+   for (int i = 0; i < MAX_WS_CLIENTS; i++)
+   {
+      if (clients[i].fd >= 0)
+         n++;
+   }
+   return n;
+}
+
+//----------------------------
+void wsSocketClosed(int fd)
+// runs in the http server task, like addClient and sendWork
+{
+   for (int i = 0; i < MAX_WS_CLIENTS; i++)
+   {
+      if (clients[i].fd == fd)
+         removeClient(i);
+   }
+}
+
+//--static functions---------------------------------------
+
+//----------------------------
+static void display(void *context)
+// scheduled every DISPLAY_INTERVAL while there are clients
+{
+   if (wsClientCount() == 0)
+   {
+      scheduler.cancel(displayJob);
+      displayJob = Scheduler::NO_JOB;
+      if (wsClientCount() == 0) // a client may have been added meanwhile
+         return;
+      displayJob = scheduler.every(DISPLAY_INTERVAL, display);
+   }
+   if (!sendQueued)
+   {
+      sendQueued = true;
+      if (httpd_queue_work(server, sendWork, nullptr) != ESP_OK)
+         sendQueued = false;
+   }
+}
+
+//----------------------------
+static void sendWork(void *arg)
+// runs in the http server task
+{
+   FrameBuffer fb;
+   fb.len = 0;
+   JsonWriter w(collect, &fb);
+   apiWriteShutter(w);
+   w.finish();
+   uint32_t h = hash(fb.data, fb.len);
+
+   httpd_ws_frame_t frame;
+   memset(&frame, 0, sizeof(frame));
+   frame.type = HTTPD_WS_TYPE_TEXT;
+   frame.payload = (uint8_t *)fb.data;
+   frame.len = fb.len;
+
+   for (int i = 0; i < MAX_WS_CLIENTS; i++)
+   {
+      WsClient &c = clients[i];
+      if (c.fd < 0 || c.lastHash == h)
+         continue;
+      if (httpd_ws_get_fd_info(server, c.fd) != HTTPD_WS_CLIENT_WEBSOCKET ||
+          httpd_ws_send_frame_async(server, c.fd, &frame) != ESP_OK)
+      {
+         removeClient(i);
+      }
+      else
+         c.lastHash = h;
+   }
+   sendQueued = false;
+}
+
+//----------------------------
+static bool addClient(int fd)
+{
+   int freeSlot = -1;
+   for (int i = 0; i < MAX_WS_CLIENTS; i++)
+   {
+      if (clients[i].fd == fd)
+         return true; // already known
+      if (clients[i].fd < 0 && freeSlot < 0)
+         freeSlot = i;
+      else if (clients[i].fd >= 0 && httpd_ws_get_fd_info(server, clients[i].fd) != HTTPD_WS_CLIENT_WEBSOCKET)
+      {
+         removeClient(i); // closed since the last frame
+         if (freeSlot < 0)
+            freeSlot = i;
+      }
+   }
+   if (freeSlot >= 0)
+   {
+      clients[freeSlot].fd = fd;
+      clients[freeSlot].lastHash = 0; // forces a first frame
+      if (!scheduler.isScheduled(displayJob))
+         displayJob = scheduler.every(DISPLAY_INTERVAL, display);
+   }
+   return freeSlot >= 0;
+}
+
+//----------------------------
+static void removeClient(int slot)
+{
+   LOG(">< %s: removeClient: fd %d\n", cName, clients[slot].fd);
+   clients[slot].fd = -1;
+}
+
+//----------------------------
+static bool collect(void *context, const char *data, size_t len)
+// JsonFlushFunction: collect the frame in a FrameBuffer
+{
+   FrameBuffer *fb = (FrameBuffer *)context;
+   if (fb->len + len > MAX_FRAME_SIZE)
+      return false;
+   memcpy(fb->data + fb->len, data, len);
+   fb->len += len;
+   return true;
+}
+
+//----------------------------
+static uint32_t hash(const char *data, size_t len)
+// FNV-1a; never 0, so a fresh client slot always differs
+{
+   uint32_t h = 2166136261UL;
+   for (size_t i = 0; i < len; i++)
+   {
+      h = (h ^ uint8_t(data[i])) * 16777619UL;
+   }
+   return h ? h : 1;
+}
@@ -0,0 +1,15 @@
+//
+// websock.h -- push shutter progress to browsers over a WebSocket
+//
+// Ben Slaghekke, 19 October 2026
+//
+#ifndef _WEBSOCK_H
+#define _WEBSOCK_H
+
+#include "esp_http_server.h"
+
+extern void wsSetup       (httpd_handle_t &httpd);  // register /ws
+extern int  wsClientCount ();                       // connected WebSocket clients
+extern void wsSocketClosed (int fd);                // the server closed this socket
+
+#endif
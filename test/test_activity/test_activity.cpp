@@ -0,0 +1,186 @@
+//
+// test_activity.cpp -- host simulation of the activity index
+//
+//    pio test -e native -f test_activity
+//
+// The frame sizes are simulated: a still scene of SCENE_BYTES with 1 %
+// sensor noise, at the frame rates the capture task runs at (5 fps for the
+// clip ring, 25 fps while somebody streams). A bird adds a few % for the
+// length of its visit. The index must find the 60 s and the 12 s visit with
+// their start and length, cancel a 1 s glitch, follow a drop of the light
+// without a visit, and find nothing in 24 hours of noise on a slowly
+// changing daylight.
+//
+// BSla, 19 oct 2026
+//
+#include <math.h>
+#include <stdint.h>
+#include <unity.h>
+#include "activity.h"
+
+#define SCENE_BYTES (30000)
+#define NOISE (0.01f)        // standard deviation, fraction of the size
+#define WARMUP_MS (120000)   // the baseline settles first
+#define TOLERANCE_MS (3000)  // on the start and the length of a visit
+
+// the configuration of visits.cpp
+static const ActivityConfig config = {60000, 2000, 1.0f, 0.5f, 4.0f, 5000, 300000};
+
+struct Counts
+{
+   int starts;
+   int ends;
+   int cancelled;
+   int shifts;
+   ActivityVisit last; // the last visit that ended
+};
+
+static uint32_t rng = 1;
+
+void setUp() { rng = 12345; }
+void tearDown() {}
+
+//----------------------
+static float gauss()
+// standard normal: the sum of 12 uniform numbers, minus 6
+{
+   float sum = 0;
+   for (int i = 0; i < 12; i++)
+   {
+      rng ^= rng << 13;
+      rng ^= rng >> 17;
+      rng ^= rng << 5;
+      sum += float(rng) / 4294967296.0f;
+   }
+   return sum - 6;
+}
+
+//----------------------
+static void run(ActivityIndex &a, Counts &c, uint32_t &now, uint32_t ms, int fps, float level)
+// ms of frames at level times the scene size
+{
+   uint32_t period = 1000 / fps;
+   for (uint32_t end = now + ms; now < end; now += period)
+   {
+      float size = SCENE_BYTES * level * (1 + NOISE * gauss());
+      switch (a.update(uint32_t(size), now))
+      {
+      case ActivityIndex::VisitStart:
+         c.starts++;
+         break;
+      case ActivityIndex::VisitEnd:
+         c.ends++;
+         c.last = a.visit();
+         break;
+      case ActivityIndex::VisitCancelled:
+         c.cancelled++;
+         break;
+      case ActivityIndex::LevelShift:
+         c.shifts++;
+         break;
+      default:
+         break;
+      }
+   }
+}
+
+//----------------------
+static void assertVisit(const Counts &c, uint32_t startMs, uint32_t lengthMs)
+{
+   TEST_ASSERT_EQUAL_INT(1, c.starts);
+   TEST_ASSERT_EQUAL_INT(1, c.ends);
+   TEST_ASSERT_EQUAL_INT(0, c.cancelled);
+   TEST_ASSERT_EQUAL_INT(0, c.shifts);
+   TEST_ASSERT_UINT32_WITHIN(TOLERANCE_MS, startMs, c.last.startMs);
+   TEST_ASSERT_UINT32_WITHIN(TOLERANCE_MS, lengthMs, c.last.endMs - c.last.startMs);
+   TEST_ASSERT_GREATER_THAN(20, c.last.peakScore);
+}
+
+//----------------------
+static void visit(int fps, uint32_t lengthMs, float birdLevel)
+{
+   ActivityIndex a(config);
+   Counts c = {};
+   uint32_t now = 0;
+   run(a, c, now, WARMUP_MS, fps, 1);
+   uint32_t start = now;
+   run(a, c, now, lengthMs, fps, birdLevel);
+   run(a, c, now, 30000, fps, 1);
+   assertVisit(c, start, lengthMs);
+   TEST_ASSERT_EQUAL_UINT32(1, a.visits());
+   TEST_ASSERT_FALSE(a.inVisit());
+}
+
+//----------------------
+static void test_visit_60s() { visit(5, 60000, 1.06f); }
+static void test_visit_12s() { visit(5, 12000, 1.05f); }
+static void test_visit_60s_streaming() { visit(25, 60000, 1.06f); }
+static void test_visit_12s_streaming() { visit(25, 12000, 1.05f); }
+
+//----------------------
+static void test_glitch_1s()
+{
+   // a flash or a leaf: starts a visit, but too short to count
+   ActivityIndex a(config);
+   Counts c = {};
+   uint32_t now = 0;
+   run(a, c, now, WARMUP_MS, 5, 1);
+   run(a, c, now, 1000, 5, 1.10f);
+   run(a, c, now, 30000, 5, 1);
+   TEST_ASSERT_EQUAL_INT(0, c.ends);
+   TEST_ASSERT_EQUAL_INT(1, c.cancelled);
+   TEST_ASSERT_EQUAL_INT(0, c.shifts);
+   TEST_ASSERT_EQUAL_UINT32(0, a.visits());
+   TEST_ASSERT_FALSE(a.inVisit());
+}
+
+//----------------------
+static void test_light_drop()
+{
+   // a cloud: 30 % smaller frames from now on. The baseline jumps to the new
+   // size, and a visit on the new level is found as before
+   ActivityIndex a(config);
+   Counts c = {};
+   uint32_t now = 0;
+   run(a, c, now, WARMUP_MS, 5, 1);
+   run(a, c, now, 60000, 5, 0.7f);
+   TEST_ASSERT_EQUAL_INT(1, c.shifts);
+   TEST_ASSERT_EQUAL_INT(0, c.starts);
+   TEST_ASSERT_FLOAT_WITHIN(SCENE_BYTES * 0.7f * 0.02f, SCENE_BYTES * 0.7f, a.mean());
+
+   c = Counts();
+   uint32_t start = now;
+   run(a, c, now, 12000, 5, 0.7f * 1.05f);
+   run(a, c, now, 30000, 5, 0.7f);
+   assertVisit(c, start, 12000);
+}
+
+//----------------------
+static void test_24h_noise()
+{
+   // a day of noise on a daylight that changes the size by +-20 % over 24 hours
+   ActivityIndex a(config);
+   Counts c = {};
+   uint32_t now = 0;
+   const uint32_t day = 24 * 3600 * 1000UL;
+   const uint32_t step = 60000;
+   for (uint32_t t = 0; t < day; t += step)
+      run(a, c, now, step, 5, 1 + 0.2f * sinf(2 * float(M_PI) * t / day));
+   TEST_ASSERT_EQUAL_INT(0, c.starts);
+   TEST_ASSERT_EQUAL_INT(0, c.shifts);
+   TEST_ASSERT_EQUAL_UINT32(0, a.visits());
+}
+
+//----------------------
+int main()
+{
+   UNITY_BEGIN();
+   RUN_TEST(test_visit_60s);
+   RUN_TEST(test_visit_12s);
+   RUN_TEST(test_visit_60s_streaming);
+   RUN_TEST(test_visit_12s_streaming);
+   RUN_TEST(test_glitch_1s);
+   RUN_TEST(test_light_drop);
+   RUN_TEST(test_24h_noise);
+   return UNITY_END();
+}
@@ -0,0 +1,120 @@
+//
+// test_channelscore.cpp -- host tests of the access point channel choice
+//
+//    pio test -e native -f test_channelscore
+//
+// The scans are typical of a garden between houses: channel and RSSI of
+// every network found, as scanLoop in myWifi.cpp passes them to chooseChannel.
+//
+// BSla, 19 oct 2026
+//
+#include <unity.h>
+#include "channelscore.h"
+
+#define N(a) int(sizeof(a) / sizeof(a[0]))
+
+// evening, most neighbours at home: crowded on 1 and 6, one strong router on 11
+static const ScanResult evening[] = {
+   {1, -48}, {1, -71}, {1, -83}, {1, -90}, {2, -86}, {3, -79},
+   {6, -55}, {6, -62}, {6, -77}, {6, -88}, {7, -84},
+   {11, -58}, {13, -91},
+};
+
+// the same spot at night: a few networks left, all weak
+static const ScanResult night[] = {
+   {1, -82}, {6, -85}, {6, -89}, {11, -84}, {13, -92},
+};
+
+// next to the house: the own router on 6 is very strong, nothing else near
+static const ScanResult house[] = {
+   {6, -31}, {1, -87}, {11, -88},
+};
+
+void setUp() {}
+void tearDown() {}
+
+//----------------------
+static void test_cost_of_one_network()
+{
+   ScanResult r = {6, -60}; // strength 40: 400 + 40^2
+   TEST_ASSERT_EQUAL_UINT32(2000, channelCost(&r, 1, 6));
+   TEST_ASSERT_EQUAL_UINT32(1500, channelCost(&r, 1, 5));
+   TEST_ASSERT_EQUAL_UINT32(1500, channelCost(&r, 1, 7));
+   TEST_ASSERT_EQUAL_UINT32(1000, channelCost(&r, 1, 8));
+   TEST_ASSERT_EQUAL_UINT32(500, channelCost(&r, 1, 9));
+   TEST_ASSERT_EQUAL_UINT32(0, channelCost(&r, 1, 10));
+   TEST_ASSERT_EQUAL_UINT32(0, channelCost(&r, 1, 1));
+}
+
+//----------------------
+static void test_strength_is_clipped()
+{
+   ScanResult weak = {1, -104};  // below the noise floor: only the occupancy
+   ScanResult strong = {1, -12}; // at most 80
+   TEST_ASSERT_EQUAL_UINT32(400, channelCost(&weak, 1, 1));
+   TEST_ASSERT_EQUAL_UINT32(400 + 80 * 80, channelCost(&strong, 1, 1));
+}
+
+//----------------------
+static void test_no_networks()
+{
+   uint32_t costs[N_CANDIDATE_CHANNELS];
+   TEST_ASSERT_EQUAL_INT(1, chooseChannel(nullptr, 0, 0, costs));
+   TEST_ASSERT_EACH_EQUAL_UINT32(0, costs, N_CANDIDATE_CHANNELS);
+   TEST_ASSERT_EQUAL_INT(6, chooseChannel(nullptr, 0, 6, costs)); // nothing to gain: stay
+}
+
+//----------------------
+static void test_evening_moves_to_11()
+{
+   uint32_t costs[N_CANDIDATE_CHANNELS];
+   TEST_ASSERT_EQUAL_INT(11, chooseChannel(evening, N(evening), 1, costs));
+   TEST_ASSERT_LESS_THAN_UINT32(costs[0], costs[2]);
+   TEST_ASSERT_LESS_THAN_UINT32(costs[1], costs[2]);
+   TEST_ASSERT_EQUAL_INT(11, chooseChannel(evening, N(evening), 0, costs));
+}
+
+//----------------------
+static void test_night_stays_within_margin()
+{
+   // 1 is a bit better than 11 at night, but not by the switch margin
+   uint32_t costs[N_CANDIDATE_CHANNELS];
+   TEST_ASSERT_EQUAL_INT(1, chooseChannel(night, N(night), 0, costs));
+   TEST_ASSERT_LESS_THAN_UINT32(costs[2], costs[0]);
+   TEST_ASSERT_EQUAL_INT(11, chooseChannel(night, N(night), 11, costs));
+   TEST_ASSERT_EQUAL_INT(1, chooseChannel(night, N(night), 6, costs)); // 6 is worse by more
+}
+
+//----------------------
+static void test_strong_router_is_avoided()
+{
+   uint32_t costs[N_CANDIDATE_CHANNELS];
+   int best = chooseChannel(house, N(house), 6, costs);
+   TEST_ASSERT_TRUE(best == 1 || best == 11);
+   TEST_ASSERT_GREATER_THAN_UINT32(costs[0] * 4, costs[1]);
+}
+
+//----------------------
+static void test_current_channel_outside_candidates()
+{
+   // the AP on channel 3 moves to a candidate when that is much better
+   uint32_t costs[N_CANDIDATE_CHANNELS];
+   TEST_ASSERT_EQUAL_INT(11, chooseChannel(evening, N(evening), 3, costs));
+   ScanResult quiet = {3, -90};
+   TEST_ASSERT_EQUAL_INT(11, chooseChannel(&quiet, 1, 3, costs));
+   TEST_ASSERT_EQUAL_INT(3, chooseChannel(nullptr, 0, 3, costs));
+}
+
+//----------------------
+int main()
+{
+   UNITY_BEGIN();
+   RUN_TEST(test_cost_of_one_network);
+   RUN_TEST(test_strength_is_clipped);
+   RUN_TEST(test_no_networks);
+   RUN_TEST(test_evening_moves_to_11);
+   RUN_TEST(test_night_stays_within_margin);
+   RUN_TEST(test_strong_router_is_avoided);
+   RUN_TEST(test_current_channel_outside_candidates);
+   return UNITY_END();
+}
@@ -0,0 +1,273 @@
+//
+// test_clipring.cpp -- host tests of the pre-trigger clip ring
+//
+//    pio test -e native -f test_clipring
+//
+// 20000 frames of random sizes, from a few bytes to more than the ring, at
+// a jittering frame rate, with triggers, exports and releases in between.
+// After every frame the ring is checked against what was put in: every frame
+// it holds is intact (its bytes carry its frame number), inside the ring and
+// clear of the others; the frames it dropped had to go (they were in the way
+// of the new frame, beyond the end it wrapped at, too old, or out of
+// descriptors); and a frozen clip is not written to.
+//
+// BSla, 19 oct 2026
+//
+#include <string.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <unity.h>
+#include "clipring.h"
+
+#define RING_BYTES (64 * 1024)
+#define N_FRAMES (20000)
+
+// the timing of clip.cpp, on a smaller ring
+static const ClipRingConfig config = {RING_BYTES, 10000, 150, 60000};
+
+static uint8_t buffer[RING_BYTES];
+static uint8_t frameData[RING_BYTES + 4096];
+static uint32_t rng = 1;
+
+void setUp() { rng = 2026; }
+void tearDown() {}
+
+//----------------------
+static uint32_t nextRandom(uint32_t n)
+// 0..n-1
+{
+   rng ^= rng << 13;
+   rng ^= rng >> 17;
+   rng ^= rng << 5;
+   return rng % n;
+}
+
+//----------------------
+static uint8_t fill(uint32_t frameNo, uint32_t i)
+// the contents of a frame tell which frame it is
+{
+   return uint8_t(frameNo * 7 + i * 13 + (i >> 8));
+}
+
+//----------------------
+static uint32_t randomSize()
+// mostly jpg-like sizes; now and then a tiny one, one of about half the ring, or one that does not fit
+{
+   uint32_t r = nextRandom(100);
+   if (r < 5)
+      return 1 + nextRandom(16);
+   if (r < 8)
+      return RING_BYTES / 2 + nextRandom(RING_BYTES / 2);
+   if (r < 9)
+      return RING_BYTES + 1 + nextRandom(4000);
+   return 2000 + nextRandom(10000);
+}
+
+//----------------------
+static void checkFrames(const ClipRing &ring, const uint32_t *frameNos)
+// every frame in the ring: intact, inside the ring, no overlap with the next ones, in time order
+{
+   uint32_t total = 0;
+   for (uint32_t n = ring.tail(); n != ring.head(); n++)
+   {
+      const ClipRingFrame &f = ring.frameAt(n);
+      TEST_ASSERT_TRUE(f.offset + f.len <= RING_BYTES);
+      const uint8_t *d = ring.data(f);
+      for (uint32_t i = 0; i < f.len; i++)
+      {
+         if (d[i] != fill(frameNos[n % ClipRing::MAX_FRAMES], i))
+            TEST_FAIL_MESSAGE("a frame in the ring was overwritten");
+      }
+      for (uint32_t m = n + 1; m != ring.head(); m++)
+      {
+         const ClipRingFrame &g = ring.frameAt(m);
+         TEST_ASSERT_TRUE(f.offset + f.len <= g.offset || g.offset + g.len <= f.offset);
+         TEST_ASSERT_TRUE(int32_t(g.ms - f.ms) >= 0);
+      }
+      total += f.len;
+   }
+   TEST_ASSERT_EQUAL_UINT32(total, ring.bytes());
+   TEST_ASSERT_TRUE(ring.frameCount() <= ClipRing::MAX_FRAMES);
+}
+
+//----------------------
+static void test_random_frames()
+{
+   static ClipRing ring(config);
+   ring.begin(buffer);
+   uint32_t frameNos[ClipRing::MAX_FRAMES]; // input frame number of every ring slot
+   uint32_t now = 0;
+   uint32_t wraps = 0, freezes = 0, releases = 0, exports = 0, expiries = 0;
+   uint32_t lastPos = 0;
+
+   for (uint32_t i = 0; i < N_FRAMES; i++)
+   {
+      now += 40 + nextRandom(200); // 4 .. 25 fps
+      uint32_t len = randomSize();
+      for (uint32_t k = 0; k < len; k++)
+         frameData[k] = fill(i, k);
+
+      // the ring before this frame
+      uint32_t head = ring.head();
+      uint32_t tail = ring.tail();
+      uint32_t writePos = head != tail ? (ring.frameAt(head - 1).offset + ring.frameAt(head - 1).len + 3) & ~3u : lastPos;
+      int state = ring.state();
+      ClipRingFrame before[ClipRing::MAX_FRAMES];
+      for (uint32_t n = tail; n != head; n++)
+         before[n % ClipRing::MAX_FRAMES] = ring.frameAt(n);
+      FrozenClip clip = ring.frozen();
+      uint32_t evictedBefore = ring.evictedBytes() + ring.evictedAge();
+
+      ClipRing::Event e = ring.frame(frameData, len, now);
+
+      if (ring.head() != head)
+      {
+         // stored: the new frame is the newest one, and every frame that was dropped had to go
+         TEST_ASSERT_EQUAL_UINT32(head + 1, ring.head());
+         TEST_ASSERT_TRUE(len <= RING_BYTES);
+         const ClipRingFrame &f = ring.frameAt(head);
+         frameNos[head % ClipRing::MAX_FRAMES] = i;
+         bool wrap = writePos + len > RING_BYTES;
+         TEST_ASSERT_EQUAL_UINT32(wrap ? 0 : writePos, f.offset);
+         if (wrap)
+            wraps++;
+         lastPos = (f.offset + f.len + 3) & ~3u;
+         uint32_t count = head - tail;
+         for (uint32_t n = tail; n != ring.tail(); n++, count--)
+         {
+            const ClipRingFrame &g = before[n % ClipRing::MAX_FRAMES];
+            bool inTheWay = (wrap && g.offset >= writePos) || (g.offset < f.offset + len && f.offset < g.offset + g.len);
+            TEST_ASSERT_TRUE(inTheWay || now - g.ms > config.windowMs || count >= ClipRing::MAX_FRAMES);
+         }
+         TEST_ASSERT_EQUAL_UINT32(ring.tail() - tail, ring.evictedBytes() + ring.evictedAge() - evictedBefore);
+         // the oldest frame kept is within the window
+         if (ring.tail() != ring.head())
+            TEST_ASSERT_TRUE(now - ring.frameAt(ring.tail()).ms <= config.windowMs);
+      }
+      else
+      {
+         // not stored: frozen, too large, or too soon after the previous frame
+         TEST_ASSERT_EQUAL_UINT32(tail, ring.tail());
+         TEST_ASSERT_TRUE(state >= 0 || len > RING_BYTES || (state == ClipRing::RECORDING && e == ClipRing::None));
+      }
+
+      if (state >= 0 && e != ClipRing::Released)
+      {
+         // a frozen clip stays as it was
+         TEST_ASSERT_EQUAL_UINT32(head, ring.head());
+         TEST_ASSERT_EQUAL_UINT32(clip.first, ring.frozen().first);
+         TEST_ASSERT_EQUAL_UINT32(clip.count, ring.frozen().count);
+      }
+      if (e == ClipRing::Released)
+         expiries++;
+      if (e == ClipRing::Frozen)
+      {
+         freezes++;
+         const FrozenClip &c = ring.frozen();
+         TEST_ASSERT_EQUAL_UINT32(ring.tail(), c.first);
+         TEST_ASSERT_EQUAL_UINT32(ring.frameCount(), c.count);
+         TEST_ASSERT_EQUAL_UINT32(ring.bytes(), c.bytes);
+         TEST_ASSERT_EQUAL_UINT32(now, c.at);
+         TEST_ASSERT_EQUAL_INT(2, c.why);
+      }
+      checkFrames(ring, frameNos);
+
+      // now and then: a trigger, an export of the frozen clip, or a release
+      uint32_t r = nextRandom(1000);
+      if (r < 10)
+         ring.trigger(2);
+      else if (r < 20 && ring.pin() == ClipRing::Pinned)
+      {
+         exports++;
+         TEST_ASSERT_FALSE(ring.release()); // not while it is exported
+         ring.unpin();
+      }
+      else if (r < 25 && ring.release())
+         releases++;
+   }
+   char message[192];
+   snprintf(message, sizeof(message), "%u frames: %u stored, %u wraps, %u evicted by bytes, %u by age, %u too large, "
+            "%u freezes, %u exports, %u releases, %u expired",
+            N_FRAMES, (unsigned)ring.stored(), (unsigned)wraps, (unsigned)ring.evictedBytes(), (unsigned)ring.evictedAge(),
+            (unsigned)ring.tooLarge(), (unsigned)freezes, (unsigned)exports, (unsigned)releases, (unsigned)expiries);
+   TEST_MESSAGE(message);
+   // every path was taken
+   TEST_ASSERT_GREATER_THAN_UINT32(100, wraps);
+   TEST_ASSERT_GREATER_THAN_UINT32(100, ring.evictedBytes());
+   TEST_ASSERT_GREATER_THAN_UINT32(100, ring.evictedAge());
+   TEST_ASSERT_GREATER_THAN_UINT32(10, ring.tooLarge());
+   TEST_ASSERT_GREATER_THAN_UINT32(10, freezes);
+   TEST_ASSERT_GREATER_THAN_UINT32(10, exports);
+   TEST_ASSERT_GREATER_THAN_UINT32(0, releases);
+   TEST_ASSERT_GREATER_THAN_UINT32(0, expiries);
+}
+
+//----------------------
+static void test_states()
+{
+   static ClipRing ring(config);
+   TEST_ASSERT_FALSE(ring.trigger(0)); // no buffer
+   ring.begin(buffer);
+   uint8_t jpg[100] = {};
+   ring.frame(jpg, sizeof(jpg), 1000);
+   TEST_ASSERT_EQUAL_INT(ClipRing::NotFrozen, ring.pin());
+   TEST_ASSERT_FALSE(ring.release());
+
+   TEST_ASSERT_TRUE(ring.trigger(1));
+   TEST_ASSERT_FALSE(ring.trigger(0)); // one freeze at a time
+   TEST_ASSERT_EQUAL_UINT32(1, ring.busyTriggers());
+   TEST_ASSERT_EQUAL_STRING("freezing", ClipRing::stateName(ring.state()));
+   TEST_ASSERT_EQUAL_INT(ClipRing::Freezing, ring.pin());
+
+   // the frame of the trigger is kept, even right after the previous one
+   TEST_ASSERT_EQUAL_INT(ClipRing::Frozen, ring.frame(jpg, sizeof(jpg), 1010));
+   TEST_ASSERT_EQUAL_UINT32(2, ring.frozen().count);
+   TEST_ASSERT_EQUAL_INT(1, ring.frozen().why);
+   TEST_ASSERT_EQUAL_STRING("frozen", ClipRing::stateName(ring.state()));
+
+   TEST_ASSERT_EQUAL_INT(ClipRing::Pinned, ring.pin());
+   TEST_ASSERT_EQUAL_INT(ClipRing::Pinned, ring.pin());
+   TEST_ASSERT_EQUAL_INT(2, ring.state());
+   TEST_ASSERT_EQUAL_STRING("exporting", ClipRing::stateName(ring.state()));
+   // held longer than holdMs, but being exported: still frozen
+   TEST_ASSERT_EQUAL_INT(ClipRing::None, ring.frame(jpg, sizeof(jpg), 1010 + config.holdMs + 1));
+   TEST_ASSERT_EQUAL_UINT32(1, ring.skippedFrozen());
+   ring.unpin();
+   ring.unpin();
+   // nobody exports it any more: the next frame records again
+   TEST_ASSERT_EQUAL_INT(ClipRing::Released, ring.frame(jpg, sizeof(jpg), 1010 + config.holdMs + 2));
+   TEST_ASSERT_EQUAL_INT(ClipRing::RECORDING, ring.state());
+   // only that frame is left: the others are older than the window
+   TEST_ASSERT_EQUAL_UINT32(1, ring.frameCount());
+   TEST_ASSERT_EQUAL_UINT32(2, ring.evictedAge());
+}
+
+//----------------------
+static void test_out_of_descriptors()
+{
+   // small frames: the descriptors run out before the bytes or the window
+   static ClipRing ring(config);
+   ring.begin(buffer);
+   uint8_t jpg[100];
+   uint32_t now = config.minSpacingMs; // after the boot, as millis ()
+   for (uint32_t i = 0; i < ClipRing::MAX_FRAMES + 5; i++, now += config.minSpacingMs)
+   {
+      memset(jpg, int(i), sizeof(jpg));
+      ring.frame(jpg, sizeof(jpg), now);
+   }
+   TEST_ASSERT_EQUAL_UINT32(ClipRing::MAX_FRAMES, ring.frameCount());
+   TEST_ASSERT_EQUAL_UINT32(5, ring.evictedAge());
+   TEST_ASSERT_EQUAL_UINT32(0, ring.evictedBytes());
+   TEST_ASSERT_EQUAL_UINT8(5, ring.data(ring.frameAt(ring.tail()))[0]); // the oldest kept frame
+   TEST_ASSERT_EQUAL_UINT32((ClipRing::MAX_FRAMES - 1) * config.minSpacingMs, ring.spanMs());
+}
+
+//----------------------
+int main()
+{
+   UNITY_BEGIN();
+   RUN_TEST(test_random_frames);
+   RUN_TEST(test_states);
+   RUN_TEST(test_out_of_descriptors);
+   return UNITY_END();
+}
@@ -0,0 +1,165 @@
+//
+// test_device_shutter.cpp -- on the ESP32-CAM: shutter latency while three streams run
+//
+//    pio test -e esp32cam_test -f test_device_shutter
+//
+// Builds tasks.cpp and shutter.cpp from src (see env:esp32cam_test) and puts
+// the stream load on the device without a network: three tasks with the
+// priority and core of the stream workers copy 30 KB frames at 25 fps, and so
+// does a task with the priority and core of the capture task. Meanwhile the
+// loop task closes and opens the shutter, as the http server task would.
+// Every command must reach the motion task within MAX_COMMAND_US, and no step
+// of the moves may come more than MAX_STEP_LATE_US after its 20 ms grid.
+// WiFi and lwIP do not run, so their share of core 0 is not in the load.
+//
+// BSla, 19 oct 2026
+//
+#include <Arduino.h>
+#include "esp_heap_caps.h"
+#include <unity.h>
+#include "tasks.h"
+#include "clip.h"
+#include "warmboot.h"
+#include "shutter.h"
+
+#define FRAME_BYTES (30 * 1024)  // a VGA jpg
+#define FRAME_MS (40)            // 25 fps, MAX_FPS of stream.cpp
+#define N_STREAMS (3)
+#define MOVES (6)                // close and open, 3 times
+#define MAX_COMMAND_US (2000)
+#define MAX_STEP_LATE_US (3000)
+
+static uint8_t *frame = nullptr;          // the latest captured frame
+static uint8_t *copies[N_STREAMS + 1];    // the frames being "sent"
+static volatile bool loadRunning = false;
+static volatile uint32_t framesSent = 0;
+
+static volatile int shutterTriggers = 0;
+
+bool clipTrigger(ClipTrigger why) // no pre-trigger clip in this test: count the triggers
+{
+   if (why == ClipShutter)
+      shutterTriggers++;
+   return true;
+}
+
+void setUp() {}
+void tearDown() {}
+
+//----------------------
+static void loadTask(void *arg)
+// copy a frame every FRAME_MS, like a capture or a stream worker
+{
+   uint8_t *dst = (uint8_t *)arg;
+   TickType_t wake = xTaskGetTickCount();
+   while (loadRunning)
+   {
+      memcpy(dst, frame, FRAME_BYTES);
+      framesSent++;
+      vTaskDelayUntil(&wake, pdMS_TO_TICKS(FRAME_MS));
+   }
+   vTaskDelete(nullptr);
+}
+
+//----------------------
+static void startLoad()
+{
+   frame = (uint8_t *)heap_caps_malloc(FRAME_BYTES, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+   TEST_ASSERT_NOT_NULL(frame);
+   memset(frame, 0x55, FRAME_BYTES);
+   loadRunning = true;
+   for (int i = 0; i <= N_STREAMS; i++)
+   {
+      copies[i] = (uint8_t *)heap_caps_malloc(FRAME_BYTES, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+      TEST_ASSERT_NOT_NULL(copies[i]);
+      TEST_ASSERT_NOT_NULL(startTask(i < N_STREAMS ? StreamTask : CaptureTask, loadTask, copies[i], i));
+   }
+}
+
+//----------------------
+static void test_moves_keep_their_latency_under_stream_load()
+{
+   startLoad();
+   delay(500);
+   uint32_t sentBefore = framesSent;
+   uint32_t worstStepLate = 0;
+   for (int i = 0; i < MOVES; i++)
+   {
+      if (i % 2 == 0)
+         shutter.close();
+      else
+         shutter.open();
+      shutter.waitComplete();
+      TEST_ASSERT_LESS_OR_EQUAL_UINT32(MAX_COMMAND_US, shutter.getCommandLatency());
+      TEST_ASSERT_TRUE(i % 2 == 0 ? shutter.isClosed() : shutter.isOpen());
+      if (shutter.getStepLate() > worstStepLate)
+         worstStepLate = shutter.getStepLate();
+   }
+   loadRunning = false;
+   char message[96];
+   snprintf(message, sizeof(message), "worst command latency %u us, worst step late %u us, %u frames copied",
+            (unsigned)shutter.getWorstCommandLatency(), (unsigned)worstStepLate, (unsigned)(framesSent - sentBefore));
+   TEST_MESSAGE(message);
+   TEST_ASSERT_LESS_OR_EQUAL_UINT32(MAX_COMMAND_US, shutter.getWorstCommandLatency());
+   TEST_ASSERT_LESS_OR_EQUAL_UINT32(MAX_STEP_LATE_US, worstStepLate);
+   TEST_ASSERT_GREATER_THAN_UINT32(0, framesSent - sentBefore); // the load did run
+}
+
+//----------------------
+static void test_commands_in_order()
+// a command that comes during a move is ignored, as it always was
+{
+   shutter.close();
+   shutter.waitComplete();
+   TEST_ASSERT_TRUE(shutter.isClosed());
+   shutter.open();
+   shutter.close();
+   TEST_ASSERT_TRUE(shutter.isMoving()); // at once, before the motion task ran the commands
+   shutter.waitComplete();
+   TEST_ASSERT_TRUE(shutter.isOpen());
+   shutter.startRepeatedMoves(2); // close, open
+   shutter.waitComplete();
+   TEST_ASSERT_TRUE(shutter.isOpen());
+   TEST_ASSERT_EQUAL_UINT32(0, shutter.movesLeft());
+}
+
+//----------------------
+static void test_clip_trigger_only_when_it_opens()
+{
+   shutter.close();
+   shutter.waitComplete();
+   int before = shutterTriggers;
+   shutter.open();
+   shutter.waitComplete();
+   TEST_ASSERT_EQUAL_INT(before + 1, shutterTriggers);
+   shutter.open(); // already open: no move, no trigger
+   shutter.waitComplete();
+   shutter.setValues(shutter.toUs(110), shutter.toUs(0), shutter.speedToUs(180)); // moves the open shutter
+   shutter.waitComplete();
+   TEST_ASSERT_TRUE(shutter.isOpen());
+   shutter.setValues(shutter.toUs(120), shutter.toUs(0), shutter.speedToUs(180));
+   shutter.waitComplete();
+   TEST_ASSERT_EQUAL_INT(before + 1, shutterTriggers);
+   shutter.close();
+   shutter.waitComplete();
+   TEST_ASSERT_EQUAL_INT(before + 1, shutterTriggers);
+}
+
+//----------------------
+void setup()
+{
+   delay(2000); // time for the test runner to open the serial port
+   warmBoot.setup();
+   shutter.setup();
+   shutter.setValues(shutter.toUs(120), shutter.toUs(0), shutter.speedToUs(180)); // fast moves: a short test
+   UNITY_BEGIN();
+   RUN_TEST(test_commands_in_order);
+   RUN_TEST(test_clip_trigger_only_when_it_opens);
+   RUN_TEST(test_moves_keep_their_latency_under_stream_load);
+   UNITY_END();
+}
+
+//----------------------
+void loop()
+{
+}
@@ -0,0 +1,211 @@
+//
+// test_fixedstring.cpp -- host tests of FixedString and StringView
+//
+//    pio test -e native -f test_fixedstring
+//
+// Every case that cuts text off checks that the string stays '\0' terminated
+// at its capacity and that truncated () is set.
+//
+// BSla, 19 oct 2026
+//
+#include <string.h>
+#include <unity.h>
+#include "fixedstring.h"
+
+void setUp() {}
+void tearDown() {}
+
+//----------------------
+static void assertFull(const FixedStringBase &s)
+// filled to the capacity and cut off
+{
+   TEST_ASSERT_EQUAL_size_t(s.capacity(), s.length());
+   TEST_ASSERT_EQUAL_size_t(s.capacity(), strlen(s.c_str()));
+   TEST_ASSERT_TRUE(s.truncated());
+}
+
+//----------------------
+static void test_assign_truncates()
+{
+   FixedString<8> s("Birdcam-3f2a");
+   TEST_ASSERT_EQUAL_STRING("Birdcam-", s.c_str());
+   assertFull(s);
+   s = "Tuin";
+   TEST_ASSERT_EQUAL_STRING("Tuin", s.c_str());
+   TEST_ASSERT_FALSE(s.truncated());
+   s = "12345678"; // fits exactly
+   TEST_ASSERT_EQUAL_size_t(8, s.length());
+   TEST_ASSERT_FALSE(s.truncated());
+   s = nullptr;
+   TEST_ASSERT_TRUE(s.isEmpty());
+}
+
+//----------------------
+static void test_copy_between_capacities()
+{
+   FixedString<16> big("Nestkast noord");
+   FixedString<4> small(big.view());
+   TEST_ASSERT_EQUAL_STRING("Nest", small.c_str());
+   TEST_ASSERT_TRUE(small.truncated());
+   FixedString<16> copy(big);
+   TEST_ASSERT_TRUE(copy == big);
+   TEST_ASSERT_TRUE(copy.c_str() != big.c_str()); // own storage
+   FixedStringBase &base = small;
+   base = big; // through the base: copies the contents, not the storage
+   TEST_ASSERT_EQUAL_STRING("Nest", small.c_str());
+}
+
+//----------------------
+static void test_append()
+{
+   FixedString<10> s("Koolmees");
+   s += ' ';
+   s += "nest";
+   TEST_ASSERT_EQUAL_STRING("Koolmees n", s.c_str());
+   assertFull(s);
+   s += 'x'; // full: nothing changes
+   TEST_ASSERT_EQUAL_STRING("Koolmees n", s.c_str());
+   s.clear();
+   TEST_ASSERT_FALSE(s.truncated());
+   s.append(StringView("abcdef", 3)).append('-').append("");
+   TEST_ASSERT_EQUAL_STRING("abc-", s.c_str());
+   s.append(s.view()); // a view of itself
+   TEST_ASSERT_EQUAL_STRING("abc-abc-", s.c_str());
+   TEST_ASSERT_FALSE(s.truncated());
+}
+
+//----------------------
+static void test_format()
+{
+   FixedString<12> s("old");
+   s.format("%d fps", 25);
+   TEST_ASSERT_EQUAL_STRING("25 fps", s.c_str()); // replaces the contents
+   s.appendFormat(", %u%%", 80u);
+   TEST_ASSERT_EQUAL_STRING("25 fps, 80%", s.c_str());
+   TEST_ASSERT_FALSE(s.truncated());
+   s.appendFormat("%s", "abc");
+   TEST_ASSERT_EQUAL_STRING("25 fps, 80%a", s.c_str());
+   assertFull(s);
+   s.format("%x", 0x3f2au);
+   TEST_ASSERT_EQUAL_STRING("3f2a", s.c_str());
+   TEST_ASSERT_FALSE(s.truncated()); // cleared by format ()
+   s.format("%s", "");
+   TEST_ASSERT_TRUE(s.isEmpty());
+}
+
+//----------------------
+static void test_replace()
+{
+   FixedString<16> s("Birdcam-3f2a");
+   TEST_ASSERT_EQUAL_INT(1, s.replace("-", "_"));
+   TEST_ASSERT_EQUAL_STRING("Birdcam_3f2a", s.c_str());
+
+   s = "a+b+c";
+   TEST_ASSERT_EQUAL_INT(2, s.replace("+", " "));
+   TEST_ASSERT_EQUAL_STRING("a b c", s.c_str());
+   TEST_ASSERT_EQUAL_INT(2, s.replace(" ", "")); // shorter
+   TEST_ASSERT_EQUAL_STRING("abc", s.c_str());
+   TEST_ASSERT_EQUAL_INT(0, s.replace("x", "y"));
+   TEST_ASSERT_EQUAL_INT(0, s.replace("", "y"));
+
+   s = "aaa";
+   TEST_ASSERT_EQUAL_INT(3, s.replace("a", "aa")); // the replacement is not searched again
+   TEST_ASSERT_EQUAL_STRING("aaaaaa", s.c_str());
+   TEST_ASSERT_FALSE(s.truncated());
+}
+
+//----------------------
+static void test_replace_truncates()
+{
+   // the text after a longer replacement is cut off at the capacity
+   FixedString<10> s("%20a%20bcd");
+   TEST_ASSERT_EQUAL_INT(2, s.replace("%20", "SPACE"));
+   TEST_ASSERT_EQUAL_STRING("SPACEaSPAC", s.c_str());
+   assertFull(s);
+
+   // not even the replacement fits
+   FixedString<6> t("abc$X$");
+   TEST_ASSERT_EQUAL_INT(1, t.replace("$X$", "value"));
+   TEST_ASSERT_EQUAL_STRING("abcval", t.c_str());
+   assertFull(t);
+}
+
+//----------------------
+static void test_trim_and_set_length()
+{
+   FixedString<16> s("  \tTuin achter \r\n");
+   s.trim();
+   TEST_ASSERT_EQUAL_STRING("Tuin achter", s.c_str());
+   s.clear();
+   s.trim();
+   TEST_ASSERT_TRUE(s.isEmpty());
+
+   FixedString<8> b;
+   strcpy(b.buffer(), "12345");
+   b.setLength(5);
+   TEST_ASSERT_EQUAL_STRING("12345", b.c_str());
+   b.setLength(20); // clipped at the capacity
+   TEST_ASSERT_EQUAL_size_t(8, b.length());
+}
+
+//----------------------
+static void test_view_search()
+{
+   StringView v("openpos=120&clpos=3");
+   TEST_ASSERT_EQUAL_size_t(7, v.indexOf('='));
+   TEST_ASSERT_EQUAL_size_t(17, v.indexOf('=', 8));
+   TEST_ASSERT_EQUAL_size_t(StringView::npos, v.indexOf('x'));
+   TEST_ASSERT_EQUAL_size_t(12, v.indexOf("clpos"));
+   TEST_ASSERT_EQUAL_size_t(StringView::npos, v.indexOf("clpos", 13));
+   TEST_ASSERT_EQUAL_size_t(StringView::npos, v.indexOf("pos=3x"));
+   TEST_ASSERT_EQUAL_size_t(3, v.indexOf("", 3));
+   TEST_ASSERT_TRUE(v.startsWith("open"));
+   TEST_ASSERT_FALSE(v.startsWith("openpos=120&clpos=3&"));
+
+   // a view need not be terminated: the search stops at its length
+   StringView part("abcabc", 4);
+   TEST_ASSERT_EQUAL_size_t(StringView::npos, part.indexOf("bc", 2));
+}
+
+//----------------------
+static void test_view_substring_trim_compare()
+{
+   StringView v("  speed = 40 ");
+   StringView key = v.substring(0, v.indexOf('=')).trim();
+   StringView value = v.substring(v.indexOf('=') + 1).trim();
+   TEST_ASSERT_TRUE(key == "speed");
+   TEST_ASSERT_TRUE(value == "40");
+   TEST_ASSERT_TRUE(value != "4");
+   TEST_ASSERT_EQUAL_size_t(0, v.substring(20).length()); // clipped, not out of range
+   TEST_ASSERT_EQUAL_size_t(0, v.substring(5, 2).length());
+   TEST_ASSERT_TRUE(StringView("   ").trim().isEmpty());
+   TEST_ASSERT_TRUE(StringView() == "");
+}
+
+//----------------------
+static void test_view_to_int()
+{
+   TEST_ASSERT_EQUAL_INT32(120, StringView("120").toInt());
+   TEST_ASSERT_EQUAL_INT32(-20, StringView(" -20").toInt());
+   TEST_ASSERT_EQUAL_INT32(7, StringView("+7fps").toInt());
+   TEST_ASSERT_EQUAL_INT32(0, StringView("fps").toInt());
+   TEST_ASSERT_EQUAL_INT32(0, StringView("").toInt());
+   TEST_ASSERT_EQUAL_INT32(12, StringView("1234", 2).toInt()); // only the viewed digits
+}
+
+//----------------------
+int main()
+{
+   UNITY_BEGIN();
+   RUN_TEST(test_assign_truncates);
+   RUN_TEST(test_copy_between_capacities);
+   RUN_TEST(test_append);
+   RUN_TEST(test_format);
+   RUN_TEST(test_replace);
+   RUN_TEST(test_replace_truncates);
+   RUN_TEST(test_trim_and_set_length);
+   RUN_TEST(test_view_search);
+   RUN_TEST(test_view_substring_trim_compare);
+   RUN_TEST(test_view_to_int);
+   return UNITY_END();
+}
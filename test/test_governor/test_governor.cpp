@@ -0,0 +1,320 @@
+//
+// test_governor.cpp -- host tests of the memory-pressure governor, on a simulated heap
+//
+//    pio test -e native -f test_governor
+//
+// SimHeap is a first-fit allocator over an address range, like the internal
+// heap of the ESP32: it gives the free bytes and the largest free block that
+// governorJob in pressure.cpp reads with heap_caps_*. So the tests can drain
+// the heap, fragment it and give memory back, and step a virtual clock by
+// the GOVERNOR_INTERVAL of pressure.cpp. The limits are those of pressure.cpp.
+//
+// BSla, 19 oct 2026
+//
+#include <unity.h>
+#include "governor.h"
+
+#define INTERVAL (1000)       // GOVERNOR_INTERVAL
+#define RECOVER_TIME (10000)
+#define RECOVER_MARGIN (25)
+#define HEAP_BYTES (96 * 1024)
+#define MAX_BLOCKS (512)
+
+typedef MemoryGovernor G;
+
+static const G::Limits limits[G::N_LEVELS] = {
+   {0, 0, 0},                           // Normal
+   {40 * 1024, 16 * 1024, 256 * 1024},  // SmallFrames
+   {32 * 1024, 12 * 1024, 128 * 1024},  // FewStreams
+   {26 * 1024, 10 * 1024, 64 * 1024},   // Shed
+   {20 * 1024, 8 * 1024, 32 * 1024},    // Refuse
+};
+
+//----------------------
+class SimHeap
+// first fit; blocks are kept sorted by address
+{
+public:
+   int alloc(uint32_t size) // returns a handle, or -1
+   {
+      uint32_t at = 0;
+      int i = 0;
+      for (; i < n; i++)
+      {
+         if (blocks[i].offset - at >= size)
+            break;
+         at = blocks[i].offset + blocks[i].len;
+      }
+      if (n == MAX_BLOCKS || (i == n && HEAP_BYTES - at < size))
+         return -1;
+      for (int j = n; j > i; j--)
+         blocks[j] = blocks[j - 1];
+      blocks[i] = {at, size, ++lastId};
+      n++;
+      return lastId;
+   }
+   void free(int id)
+   {
+      for (int i = 0; i < n; i++)
+      {
+         if (blocks[i].id == id)
+         {
+            for (int j = i; j + 1 < n; j++)
+               blocks[j] = blocks[j + 1];
+            n--;
+            return;
+         }
+      }
+   }
+   uint32_t freeBytes() const
+   {
+      uint32_t used = 0;
+      for (int i = 0; i < n; i++)
+         used += blocks[i].len;
+      return HEAP_BYTES - used;
+   }
+   uint32_t largest() const
+   {
+      uint32_t at = 0;
+      uint32_t best = 0;
+      for (int i = 0; i <= n; i++)
+      {
+         uint32_t end = i < n ? blocks[i].offset : HEAP_BYTES;
+         if (end - at > best)
+            best = end - at;
+         if (i < n)
+            at = blocks[i].offset + blocks[i].len;
+      }
+      return best;
+   }
+
+private:
+   struct Block
+   {
+      uint32_t offset;
+      uint32_t len;
+      int id;
+   };
+   Block blocks[MAX_BLOCKS];
+   int n = 0;
+   int lastId = 0;
+};
+
+static SimHeap heap;
+static uint32_t psramLargest = UINT32_MAX; // no PSRAM
+static uint32_t now = 0;
+
+void setUp()
+{
+   heap = SimHeap();
+   psramLargest = UINT32_MAX;
+   now = 0;
+}
+void tearDown() {}
+
+//----------------------
+static G::Level tick(G &g)
+// one governorJob: read the heap, update, and INTERVAL later the next one
+{
+   MemorySample s = {heap.freeBytes(), heap.largest(), psramLargest};
+   G::Level l = g.update(s, now);
+   now += INTERVAL;
+   return l;
+}
+
+//----------------------
+static G::Level ticks(G &g, int n)
+{
+   G::Level l = g.level();
+   for (int i = 0; i < n; i++)
+      l = tick(g);
+   return l;
+}
+
+//----------------------
+static void fillTo(uint32_t freeBytes, int *ids, int *nIds)
+// allocate 1 KB blocks until at most freeBytes are left
+{
+   while (heap.freeBytes() > freeBytes)
+   {
+      int id = heap.alloc(1024);
+      TEST_ASSERT_NOT_EQUAL(-1, id);
+      ids[(*nIds)++] = id;
+   }
+}
+
+//----------------------
+static void test_plenty_is_normal()
+{
+   G g(limits, RECOVER_TIME, RECOVER_MARGIN);
+   TEST_ASSERT_EQUAL_INT(G::Normal, ticks(g, 30));
+   TEST_ASSERT_EQUAL_UINT32(0, g.transitions());
+   TEST_ASSERT_EQUAL_STRING("Normal", G::levelName(g.level()));
+}
+
+//----------------------
+static void test_escalation_one_level_at_a_time()
+{
+   // the heap drains slowly: every level is entered on the tick that needs it
+   G g(limits, RECOVER_TIME, RECOVER_MARGIN);
+   static int ids[MAX_BLOCKS];
+   int nIds = 0;
+   static const uint32_t steps[] = {39 * 1024, 31 * 1024, 25 * 1024, 19 * 1024};
+   for (int i = 0; i < 4; i++)
+   {
+      fillTo(steps[i] + 1024, ids, &nIds);
+      TEST_ASSERT_EQUAL_INT(G::Level(i), tick(g)); // just above the limit: not yet
+      fillTo(steps[i], ids, &nIds);
+      TEST_ASSERT_EQUAL_INT(G::Level(i + 1), tick(g));
+      TEST_ASSERT_EQUAL_UINT32(1, g.entries(G::Level(i + 1)));
+   }
+   TEST_ASSERT_EQUAL_INT(G::Refuse, g.worstLevel());
+   TEST_ASSERT_EQUAL_UINT32(4, g.transitions());
+}
+
+//----------------------
+static void test_escalation_jumps_levels()
+{
+   // a sudden drop goes straight to the level it needs, without the ones before
+   G g(limits, RECOVER_TIME, RECOVER_MARGIN);
+   tick(g);
+   TEST_ASSERT_NOT_EQUAL(-1, heap.alloc(HEAP_BYTES - 24 * 1024));
+   TEST_ASSERT_EQUAL_INT(G::Shed, tick(g));
+   TEST_ASSERT_EQUAL_UINT32(1, g.transitions());
+   TEST_ASSERT_EQUAL_UINT32(0, g.entries(G::SmallFrames));
+   TEST_ASSERT_EQUAL_UINT32(0, g.entries(G::FewStreams));
+   TEST_ASSERT_EQUAL_UINT32(INTERVAL, g.levelSince());
+}
+
+//----------------------
+static void test_fragmentation_alone_escalates()
+{
+   // plenty free, but in 9 KB holes: the largest block is below the Shed limit
+   G g(limits, RECOVER_TIME, RECOVER_MARGIN);
+   int ids[64];
+   int nIds = 0;
+   while (heap.largest() >= 9 * 1024 + 512)
+   {
+      ids[nIds++] = heap.alloc(9 * 1024);
+      ids[nIds++] = heap.alloc(512);
+   }
+   for (int i = 0; i < nIds; i += 2)
+      heap.free(ids[i]);
+   TEST_ASSERT_GREATER_THAN_UINT32(48 * 1024, heap.freeBytes());
+   TEST_ASSERT_EQUAL_UINT32(9 * 1024, heap.largest());
+   TEST_ASSERT_EQUAL_INT(G::Shed, tick(g));
+}
+
+//----------------------
+static void test_psram_alone_escalates()
+{
+   G g(limits, RECOVER_TIME, RECOVER_MARGIN);
+   psramLargest = 100 * 1024;
+   TEST_ASSERT_EQUAL_INT(G::FewStreams, tick(g));
+   psramLargest = UINT32_MAX;
+   TEST_ASSERT_EQUAL_INT(G::FewStreams, tick(g)); // back only after RECOVER_TIME
+}
+
+//----------------------
+static void test_recovery_one_step_per_recover_time()
+{
+   // from Refuse to Normal: one level per RECOVER_TIME of clear readings
+   G g(limits, RECOVER_TIME, RECOVER_MARGIN);
+   int big = heap.alloc(HEAP_BYTES - 16 * 1024);
+   TEST_ASSERT_EQUAL_INT(G::Refuse, tick(g));
+   heap.free(big);
+   uint32_t start = now;
+   for (int l = G::Refuse; l > G::Normal; l--)
+   {
+      uint32_t entered = now;
+      while (g.level() == G::Level(l))
+         tick(g);
+      TEST_ASSERT_EQUAL_INT(l - 1, g.level());
+      // the first clear reading starts the clock: RECOVER_TIME from there
+      TEST_ASSERT_EQUAL_UINT32(RECOVER_TIME + INTERVAL, now - entered);
+   }
+   TEST_ASSERT_EQUAL_UINT32(4 * (RECOVER_TIME + INTERVAL), now - start);
+   TEST_ASSERT_EQUAL_UINT32(5, g.transitions()); // down at once, up in four steps
+   TEST_ASSERT_EQUAL_INT(G::Refuse, g.worstLevel());
+}
+
+//----------------------
+static void test_no_recovery_within_the_margin()
+{
+   // above the Shed limits, but by less than RECOVER_MARGIN: Shed stays
+   G g(limits, RECOVER_TIME, RECOVER_MARGIN);
+   int big = heap.alloc(HEAP_BYTES - 25 * 1024);
+   TEST_ASSERT_EQUAL_INT(G::Shed, tick(g));
+   heap.free(big);
+   big = heap.alloc(HEAP_BYTES - 32 * 1024); // 32 KB free: 26 KB + 23 %
+   TEST_ASSERT_EQUAL_INT(G::Shed, ticks(g, 60));
+   heap.free(big);
+   big = heap.alloc(HEAP_BYTES - 33 * 1024); // 26 KB + 27 %
+   TEST_ASSERT_EQUAL_INT(G::Shed, ticks(g, RECOVER_TIME / INTERVAL));
+   TEST_ASSERT_EQUAL_INT(G::FewStreams, tick(g));
+   // 33 KB is also clear of the FewStreams limits (32 KB), but not by the margin
+   TEST_ASSERT_EQUAL_INT(G::FewStreams, ticks(g, 60));
+}
+
+//----------------------
+static void test_dip_restarts_the_recover_time()
+{
+   G g(limits, RECOVER_TIME, RECOVER_MARGIN);
+   int big = heap.alloc(HEAP_BYTES - 30 * 1024);
+   TEST_ASSERT_EQUAL_INT(G::FewStreams, tick(g));
+   heap.free(big);
+   ticks(g, RECOVER_TIME / INTERVAL - 1); // almost
+   big = heap.alloc(HEAP_BYTES - 38 * 1024); // above the limit, inside the margin
+   TEST_ASSERT_EQUAL_INT(G::FewStreams, tick(g));
+   heap.free(big);
+   TEST_ASSERT_EQUAL_INT(G::FewStreams, ticks(g, RECOVER_TIME / INTERVAL));
+   TEST_ASSERT_EQUAL_INT(G::SmallFrames, tick(g));
+}
+
+//----------------------
+static void test_no_flapping_at_a_limit()
+{
+   // free memory that swings around the FewStreams limit: SmallFrames on the
+   // first reading, FewStreams on the first dip, and then it holds
+   G g(limits, RECOVER_TIME, RECOVER_MARGIN);
+   int big = heap.alloc(HEAP_BYTES - 34 * 1024);
+   for (int i = 0; i < 200; i++)
+   {
+      int swing = heap.alloc(i % 2 ? 3 * 1024 : 1024); // 31 or 33 KB free
+      tick(g);
+      heap.free(swing);
+   }
+   TEST_ASSERT_EQUAL_INT(G::FewStreams, g.level());
+   TEST_ASSERT_EQUAL_UINT32(2, g.transitions());
+   heap.free(big);
+   TEST_ASSERT_EQUAL_INT(G::SmallFrames, ticks(g, RECOVER_TIME / INTERVAL + 1));
+}
+
+//----------------------
+static void test_recovery_across_a_clock_wrap()
+{
+   now = 0xFFFFFFFFu - 3 * INTERVAL;
+   G g(limits, RECOVER_TIME, RECOVER_MARGIN);
+   int big = heap.alloc(HEAP_BYTES - 39 * 1024);
+   TEST_ASSERT_EQUAL_INT(G::SmallFrames, tick(g));
+   heap.free(big);
+   TEST_ASSERT_EQUAL_INT(G::SmallFrames, ticks(g, RECOVER_TIME / INTERVAL));
+   TEST_ASSERT_EQUAL_INT(G::Normal, tick(g));
+}
+
+//----------------------
+int main()
+{
+   UNITY_BEGIN();
+   RUN_TEST(test_plenty_is_normal);
+   RUN_TEST(test_escalation_one_level_at_a_time);
+   RUN_TEST(test_escalation_jumps_levels);
+   RUN_TEST(test_fragmentation_alone_escalates);
+   RUN_TEST(test_psram_alone_escalates);
+   RUN_TEST(test_recovery_one_step_per_recover_time);
+   RUN_TEST(test_no_recovery_within_the_margin);
+   RUN_TEST(test_dip_restarts_the_recover_time);
+   RUN_TEST(test_no_flapping_at_a_limit);
+   RUN_TEST(test_recovery_across_a_clock_wrap);
+   return UNITY_END();
+}
@@ -0,0 +1,309 @@
+//
+// test_jpegdc.cpp -- host tests and benchmark of the DC luminance map, against libjpeg
+//
+//    pio test -e native_jpeg
+//
+// Needs libjpeg (libjpeg-turbo) and its headers on the host, see
+// env:native_jpeg. The test jpgs are made with libjpeg: 640 x 480 like the
+// camera frames, a quiet scene of about 35 KB and a noisy one of about 88 KB,
+// in 4:2:2 like the camera, and 4:2:0, 4:4:4 with restarts and greyscale.
+// The map must match the means of the luminance blocks that a full libjpeg
+// decode gives; the benchmark compares the DC-only decode with a full decode
+// and with the 1/8 scaled decode of libjpeg. libjpeg-turbo uses SIMD when it
+// can; JSIMD_FORCENONE=1 in the environment gives the portable C numbers,
+// which are closer to what the ESP32 has.
+//
+// BSla, 19 oct 2026
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <vector>
+#include <chrono>
+#include <unity.h>
+#include "jpegdc.h"
+#include <jpeglib.h> // after jpegdc.h: it defines MAX_COMPONENTS
+
+#define W (640)
+#define H (480)
+#define MAP_W (W / 8)
+#define MAP_H (H / 8)
+#define BENCH_MS (500) // per decoder and jpg
+
+typedef std::vector<uint8_t> Bytes;
+
+static Bytes quiet;   // 4:2:2
+static Bytes noisy;   // 4:2:2
+static Bytes jpg420;
+static Bytes jpg444;  // with restart markers
+static Bytes jpgGray;
+static JpegDc jpegDc; // as in detector.cpp: static
+
+void setUp() {}
+void tearDown() {}
+
+//----------------------
+static Bytes encode(int noise, int h, int v, int restartRows, bool gray)
+// a garden: sky, a hedge, a feeder; leaves and sensor noise of up to +-noise
+{
+   static uint8_t rgb[W * H * 3];
+   srand(noise);
+   for (int y = 0; y < H; y++)
+   {
+      for (int x = 0; x < W; x++)
+      {
+         int r, g, b;
+         if (y < H / 3)
+            r = 120 + y / 4, g = 160 + y / 5, b = 220; // sky
+         else
+            r = 50 + x / 20, g = 90 + y / 10, b = 40; // hedge
+         if (x > 260 && x < 380 && y > 200 && y < 400)
+            r = 150, g = 110, b = 70; // feeder
+         if (noise)
+         {
+            int leaf = ((x * 37 + y * 91) ^ (x * y)) % (2 * noise + 1) - noise;
+            int n = rand() % (noise + 1) - noise / 2;
+            r += leaf + n, g += leaf + n, b += n;
+         }
+         uint8_t *px = rgb + 3 * (y * W + x);
+         px[0] = uint8_t(r < 0 ? 0 : r > 255 ? 255 : r);
+         px[1] = uint8_t(g < 0 ? 0 : g > 255 ? 255 : g);
+         px[2] = uint8_t(b < 0 ? 0 : b > 255 ? 255 : b);
+      }
+   }
+
+   jpeg_compress_struct c;
+   jpeg_error_mgr err;
+   c.err = jpeg_std_error(&err);
+   jpeg_create_compress(&c);
+   unsigned char *out = nullptr;
+   unsigned long outLen = 0;
+   jpeg_mem_dest(&c, &out, &outLen);
+   c.image_width = W;
+   c.image_height = H;
+   c.input_components = 3;
+   c.in_color_space = JCS_RGB;
+   jpeg_set_defaults(&c);
+   jpeg_set_quality(&c, 85, TRUE);
+   if (gray)
+      jpeg_set_colorspace(&c, JCS_GRAYSCALE);
+   c.comp_info[0].h_samp_factor = h;
+   c.comp_info[0].v_samp_factor = v;
+   c.restart_in_rows = restartRows;
+   jpeg_start_compress(&c, TRUE);
+   while (c.next_scanline < H)
+   {
+      JSAMPROW row = rgb + 3 * W * c.next_scanline;
+      jpeg_write_scanlines(&c, &row, 1);
+   }
+   jpeg_finish_compress(&c);
+   jpeg_destroy_compress(&c);
+   Bytes jpg(out, out + outLen);
+   free(out);
+   return jpg;
+}
+
+//----------------------
+static Bytes stripHuffmanTables(const Bytes &jpg)
+// as some cameras send MJPEG frames: no DHT segments, the standard tables are meant
+{
+   Bytes out(jpg.begin(), jpg.begin() + 2);
+   size_t i = 2;
+   while (i + 4 <= jpg.size())
+   {
+      uint8_t marker = jpg[i + 1];
+      size_t len = 2 + (jpg[i + 2] << 8 | jpg[i + 3]);
+      if (marker == 0xDA) // the scan: the rest as it is
+      {
+         out.insert(out.end(), jpg.begin() + i, jpg.end());
+         break;
+      }
+      if (marker != 0xC4)
+         out.insert(out.end(), jpg.begin() + i, jpg.begin() + i + len);
+      i += len;
+   }
+   return out;
+}
+
+//----------------------
+static void decodeFull(const Bytes &jpg, J_COLOR_SPACE space, int scaleDenom, uint8_t *out)
+// libjpeg; out gets the image, or nothing when out is null
+{
+   static uint8_t row[W * 3];
+   jpeg_decompress_struct d;
+   jpeg_error_mgr err;
+   d.err = jpeg_std_error(&err);
+   jpeg_create_decompress(&d);
+   jpeg_mem_src(&d, jpg.data(), jpg.size());
+   jpeg_read_header(&d, TRUE);
+   d.out_color_space = space;
+   d.scale_denom = scaleDenom;
+   jpeg_start_decompress(&d);
+   int stride = d.output_width * d.output_components;
+   while (d.output_scanline < d.output_height)
+   {
+      JSAMPROW r = out ? out + stride * d.output_scanline : row;
+      jpeg_read_scanlines(&d, &r, 1);
+   }
+   jpeg_finish_decompress(&d);
+   jpeg_destroy_decompress(&d);
+}
+
+//----------------------
+static void compareWithLibjpeg(const Bytes &jpg, double *maxError, double *meanError)
+// the map against the block means of the luminance of a full decode
+{
+   static uint8_t y[W * H];
+   static uint8_t ycc[W * H * 3];
+   uint8_t map[MAP_W * MAP_H];
+   bool gray = jpg == jpgGray;
+   if (gray)
+      decodeFull(jpg, JCS_GRAYSCALE, 1, y);
+   else
+   {
+      decodeFull(jpg, JCS_YCbCr, 1, ycc); // no colour conversion: Y as it was coded
+      for (int i = 0; i < W * H; i++)
+         y[i] = ycc[3 * i];
+   }
+   TEST_ASSERT_EQUAL_INT(JpegDc::Ok, jpegDc.decode(jpg.data(), jpg.size(), map, MAP_W, MAP_H));
+   TEST_ASSERT_EQUAL_INT(W, jpegDc.width());
+   TEST_ASSERT_EQUAL_INT(H, jpegDc.height());
+   double worst = 0, total = 0;
+   for (int by = 0; by < MAP_H; by++)
+   {
+      for (int bx = 0; bx < MAP_W; bx++)
+      {
+         int sum = 0;
+         for (int j = 0; j < 8; j++)
+            for (int i = 0; i < 8; i++)
+               sum += y[(by * 8 + j) * W + bx * 8 + i];
+         double e = fabs(sum / 64.0 - map[by * MAP_W + bx]);
+         worst = e > worst ? e : worst;
+         total += e;
+      }
+   }
+   *maxError = worst;
+   *meanError = total / (MAP_W * MAP_H);
+}
+
+//----------------------
+static void checkMap(const char *name, const Bytes &jpg)
+{
+   double worst, mean;
+   compareWithLibjpeg(jpg, &worst, &mean);
+   char message[128];
+   snprintf(message, sizeof(message), "%s (%u bytes): block means within %.2f grey levels, %.2f on average", name,
+            unsigned(jpg.size()), worst, mean);
+   TEST_MESSAGE(message);
+   // the DC is rounded to a whole grey level, and the IDCT clamps pixels to 0..255
+   TEST_ASSERT_TRUE_MESSAGE(worst <= 1.0, message);
+   TEST_ASSERT_TRUE_MESSAGE(mean <= 0.3, message);
+}
+
+//----------------------
+static void test_map_422()
+{
+   checkMap("quiet 4:2:2", quiet);
+   checkMap("noisy 4:2:2", noisy);
+}
+
+//----------------------
+static void test_map_other_sampling()
+{
+   checkMap("4:2:0", jpg420);
+   checkMap("4:4:4 with restarts", jpg444);
+   checkMap("greyscale", jpgGray);
+}
+
+//----------------------
+static void test_standard_tables()
+{
+   uint8_t withTables[MAP_W * MAP_H];
+   uint8_t without[MAP_W * MAP_H];
+   // libjpeg codes with the standard tables unless it is asked to optimise them
+   Bytes stripped = stripHuffmanTables(quiet);
+   TEST_ASSERT_LESS_THAN(quiet.size(), stripped.size());
+   TEST_ASSERT_EQUAL_INT(JpegDc::Ok, jpegDc.decode(quiet.data(), quiet.size(), withTables, MAP_W, MAP_H));
+   TEST_ASSERT_EQUAL_INT(JpegDc::Ok, jpegDc.decode(stripped.data(), stripped.size(), without, MAP_W, MAP_H));
+   TEST_ASSERT_EQUAL_MEMORY(withTables, without, sizeof(without));
+}
+
+//----------------------
+static void test_smaller_map()
+{
+   // blocks outside the map are skipped
+   uint8_t full[MAP_W * MAP_H];
+   uint8_t part[40 * 30];
+   TEST_ASSERT_EQUAL_INT(JpegDc::Ok, jpegDc.decode(noisy.data(), noisy.size(), full, MAP_W, MAP_H));
+   TEST_ASSERT_EQUAL_INT(JpegDc::Ok, jpegDc.decode(noisy.data(), noisy.size(), part, 40, 30));
+   for (int y = 0; y < 30; y++)
+      TEST_ASSERT_EQUAL_MEMORY(full + y * MAP_W, part + y * 40, 40);
+}
+
+//----------------------
+static void test_bad_input()
+{
+   uint8_t map[MAP_W * MAP_H];
+   static const uint8_t text[] = "GET /api/status HTTP/1.1";
+   TEST_ASSERT_EQUAL_INT(JpegDc::NotJpeg, jpegDc.decode(text, sizeof(text), map, MAP_W, MAP_H));
+   TEST_ASSERT_EQUAL_INT(JpegDc::Truncated, jpegDc.decode(quiet.data(), 300, map, MAP_W, MAP_H)); // in the headers
+   JpegDc::Result r = jpegDc.decode(noisy.data(), noisy.size() / 2, map, MAP_W, MAP_H);          // in the scan
+   TEST_ASSERT_TRUE_MESSAGE(r == JpegDc::Truncated || r == JpegDc::Corrupt, JpegDc::resultName(r));
+   TEST_ASSERT_NOT_EQUAL(JpegDc::Ok, r);
+}
+
+//----------------------
+template <typename F> static double framesPerSecond(F decode)
+{
+   int n = 0;
+   auto t0 = std::chrono::steady_clock::now();
+   double ms = 0;
+   while (ms < BENCH_MS)
+   {
+      decode();
+      n++;
+      ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+   }
+   return n * 1000.0 / ms;
+}
+
+//----------------------
+static void benchmark(const char *name, const Bytes &jpg)
+{
+   static uint8_t rgb[W * H * 3];
+   uint8_t map[MAP_W * MAP_H];
+   double dc = framesPerSecond([&] { jpegDc.decode(jpg.data(), jpg.size(), map, MAP_W, MAP_H); });
+   double full = framesPerSecond([&] { decodeFull(jpg, JCS_RGB, 1, rgb); });
+   double eighth = framesPerSecond([&] { decodeFull(jpg, JCS_RGB, 8, rgb); });
+   char message[160];
+   snprintf(message, sizeof(message), "%s (%u KB): %.0f fps DC only, %.0f fps full decode, %.0f fps libjpeg 1/8%s",
+            name, unsigned(jpg.size() / 1024), dc, full, eighth, getenv("JSIMD_FORCENONE") ? ", no SIMD" : "");
+   TEST_MESSAGE(message);
+   TEST_ASSERT_GREATER_THAN(full, dc);
+}
+
+//----------------------
+static void test_benchmark()
+{
+   benchmark("quiet scene", quiet);
+   benchmark("noisy scene", noisy);
+}
+
+//----------------------
+int main()
+{
+   quiet = encode(5, 2, 1, 0, false);
+   noisy = encode(15, 2, 1, 0, false);
+   jpg420 = encode(15, 2, 2, 0, false);
+   jpg444 = encode(15, 1, 1, 2, false);
+   jpgGray = encode(5, 1, 1, 0, true);
+   UNITY_BEGIN();
+   RUN_TEST(test_map_422);
+   RUN_TEST(test_map_other_sampling);
+   RUN_TEST(test_standard_tables);
+   RUN_TEST(test_smaller_map);
+   RUN_TEST(test_bad_input);
+   RUN_TEST(test_benchmark);
+   return UNITY_END();
+}
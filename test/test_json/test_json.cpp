@@ -0,0 +1,235 @@
+//
+// test_json.cpp -- host tests of the JSON writer and reader
+//
+//    pio test -e native -f test_json
+//
+// The writer flushes into a string, as sendChunk in httpsupp.cpp flushes
+// into the reply; the reader gets the request bodies that api.cpp parses.
+//
+// BSla, 19 oct 2026
+//
+#include <string.h>
+#include <limits.h>
+#include <string>
+#include <unity.h>
+#include "json.h"
+
+static std::string out;
+static int flushes = 0;
+static int failAfter = -1; // flushes that succeed before one fails; -1: never
+
+void setUp()
+{
+   out.clear();
+   flushes = 0;
+   failAfter = -1;
+}
+void tearDown() {}
+
+//----------------------
+static bool toString(void *, const char *data, size_t len)
+{
+   if (failAfter >= 0 && flushes >= failAfter)
+      return false;
+   flushes++;
+   out.append(data, len);
+   return true;
+}
+
+//----------------------
+static void test_writer_separators_and_nesting()
+{
+   JsonWriter w(toString, nullptr);
+   w.beginObject();
+   w.add("state", "Closed");
+   w.beginObject("shutter");
+   w.add("openDeg", 90);
+   w.add("moving", false);
+   w.endObject();
+   w.beginArray("events");
+   w.beginObject();
+   w.add("score", 12u);
+   w.endObject();
+   w.beginObject();
+   w.endObject();
+   w.add(nullptr, -3L);
+   w.endArray();
+   w.beginArray("none");
+   w.endArray();
+   w.addFloat("fps", 12.345f, 2);
+   w.endObject();
+   TEST_ASSERT_TRUE(w.finish());
+   TEST_ASSERT_EQUAL_STRING("{\"state\":\"Closed\",\"shutter\":{\"openDeg\":90,\"moving\":false},"
+                            "\"events\":[{\"score\":12},{},-3],\"none\":[],\"fps\":12.35}",
+                            out.c_str());
+   TEST_ASSERT_EQUAL_size_t(out.size(), w.bytesWritten());
+}
+
+//----------------------
+static void test_writer_escapes()
+{
+   JsonWriter w(toString, nullptr);
+   w.beginObject();
+   w.add("site", "Tuin \"achter\"\\noord\n\x01");
+   w.endObject();
+   w.finish();
+   TEST_ASSERT_EQUAL_STRING("{\"site\":\"Tuin \\\"achter\\\"\\\\noord\\u000a\\u0001\"}", out.c_str());
+}
+
+//----------------------
+static void test_writer_flushes_full_buffers()
+{
+   // 128 bytes per flush, and nothing lost or doubled at the buffer edges
+   JsonWriter w(toString, nullptr);
+   std::string expected = "[";
+   w.beginArray();
+   for (int i = 0; i < 100; i++)
+   {
+      w.add(nullptr, "abcdefg");
+      expected += i ? ",\"abcdefg\"" : "\"abcdefg\"";
+   }
+   w.endArray();
+   expected += "]";
+   TEST_ASSERT_EQUAL_INT(int(expected.size()) / 128, flushes); // before finish: only full buffers
+   TEST_ASSERT_EQUAL_size_t(expected.size() / 128 * 128, out.size());
+   TEST_ASSERT_TRUE(w.finish());
+   TEST_ASSERT_EQUAL_STRING(expected.c_str(), out.c_str());
+   TEST_ASSERT_EQUAL_size_t(expected.size(), w.bytesWritten());
+}
+
+//----------------------
+static void test_writer_failed_flush()
+{
+   failAfter = 1;
+   JsonWriter w(toString, nullptr);
+   w.beginArray();
+   for (int i = 0; i < 100; i++)
+      w.add(nullptr, 123456789L);
+   w.endArray();
+   TEST_ASSERT_FALSE(w.ok());
+   TEST_ASSERT_FALSE(w.finish());
+   TEST_ASSERT_EQUAL_INT(1, flushes); // no more flushes after the failed one
+   TEST_ASSERT_EQUAL_size_t(128, out.size());
+}
+
+//----------------------
+static void test_reader_values()
+{
+   const char *body = "{ \"cmd\" : \"moves\", \"n\": 3, \"openDeg\":-20, \"vflip\": true, \"hmirror\":false }";
+   char cmd[16];
+   int n = 0;
+   bool b = false;
+   TEST_ASSERT_TRUE(JsonReader::getString(body, "cmd", cmd, sizeof(cmd)));
+   TEST_ASSERT_EQUAL_STRING("moves", cmd);
+   TEST_ASSERT_TRUE(JsonReader::getInt(body, "n", n));
+   TEST_ASSERT_EQUAL_INT(3, n);
+   TEST_ASSERT_TRUE(JsonReader::getInt(body, "openDeg", n));
+   TEST_ASSERT_EQUAL_INT(-20, n);
+   TEST_ASSERT_TRUE(JsonReader::getBool(body, "vflip", b));
+   TEST_ASSERT_TRUE(b);
+   TEST_ASSERT_TRUE(JsonReader::getBool(body, "hmirror", b));
+   TEST_ASSERT_FALSE(b);
+}
+
+//----------------------
+static void test_reader_missing_and_wrong_type()
+{
+   const char *body = "{\"cmd\":\"open\",\"n\":\"3\",\"flag\":1}";
+   char cmd[16];
+   int n = 7;
+   bool b = false;
+   TEST_ASSERT_FALSE(JsonReader::getString(body, "speed", cmd, sizeof(cmd)));
+   TEST_ASSERT_FALSE(JsonReader::getInt(body, "n", n)); // a string, not a number
+   TEST_ASSERT_EQUAL_INT(7, n);
+   TEST_ASSERT_FALSE(JsonReader::getString(body, "flag", cmd, sizeof(cmd)));
+   TEST_ASSERT_FALSE(JsonReader::getBool(body, "flag", b));
+   TEST_ASSERT_FALSE(JsonReader::getString(body, "cm", cmd, sizeof(cmd))); // whole keys only
+   TEST_ASSERT_FALSE(JsonReader::getString("", "cmd", cmd, sizeof(cmd)));
+}
+
+//----------------------
+static void test_reader_values_are_not_keys()
+{
+   // "cmd" as a value, and inside a string, is not the key
+   const char *body = "{\"note\":\"cmd\",\"text\":\"say \\\"cmd\\\": no\",\"cmd\":\"close\"}";
+   char cmd[16];
+   TEST_ASSERT_TRUE(JsonReader::getString(body, "cmd", cmd, sizeof(cmd)));
+   TEST_ASSERT_EQUAL_STRING("close", cmd);
+}
+
+//----------------------
+static void test_reader_skips_nested_values()
+{
+   const char *body = "{\"old\":{\"cmd\":\"open\",\"n\":[1,{\"n\":2}]},\"list\":[\"cmd\",\"n\"],\"n\":5}";
+   char cmd[16];
+   int n = 0;
+   TEST_ASSERT_FALSE(JsonReader::getString(body, "cmd", cmd, sizeof(cmd)));
+   TEST_ASSERT_TRUE(JsonReader::getInt(body, "n", n));
+   TEST_ASSERT_EQUAL_INT(5, n);
+   // braces in strings do not count
+   TEST_ASSERT_TRUE(JsonReader::getInt("{\"s\":\"}{[\",\"n\":6}", "n", n));
+   TEST_ASSERT_EQUAL_INT(6, n);
+   // after the top-level object ends, nothing more is found
+   TEST_ASSERT_FALSE(JsonReader::getInt("{\"a\":1} \"n\":3", "n", n));
+}
+
+//----------------------
+static void test_reader_string_escapes()
+{
+   const char *body = "{\"ssid\":\"Tuin \\\"achter\\\"\\\\1\\n\\t\\/\"}";
+   char s[32];
+   TEST_ASSERT_TRUE(JsonReader::getString(body, "ssid", s, sizeof(s)));
+   TEST_ASSERT_EQUAL_STRING("Tuin \"achter\"\\1\n\t/", s);
+   TEST_ASSERT_FALSE(JsonReader::getString("{\"ssid\":\"no end", "ssid", s, sizeof(s)));
+}
+
+//----------------------
+static void test_reader_string_truncation()
+{
+   const char *body = "{\"cmd\":\"trigger\",\"n\":1}";
+   char s[5];
+   TEST_ASSERT_TRUE(JsonReader::getString(body, "cmd", s, sizeof(s)));
+   TEST_ASSERT_EQUAL_STRING("trig", s); // cut off, and terminated
+   char one[1];
+   TEST_ASSERT_TRUE(JsonReader::getString(body, "cmd", one, sizeof(one)));
+   TEST_ASSERT_EQUAL_STRING("", one);
+   TEST_ASSERT_FALSE(JsonReader::getString(body, "cmd", one, 0));
+}
+
+//----------------------
+static void test_reader_int_range()
+{
+   int n = 7;
+   TEST_ASSERT_TRUE(JsonReader::getInt("{\"n\":2147483647}", "n", n));
+   TEST_ASSERT_EQUAL_INT(INT_MAX, n);
+   TEST_ASSERT_TRUE(JsonReader::getInt("{\"n\":-2147483648}", "n", n));
+   TEST_ASSERT_EQUAL_INT(INT_MIN, n);
+   n = 7;
+   TEST_ASSERT_FALSE(JsonReader::getInt("{\"n\":2147483648}", "n", n));
+   TEST_ASSERT_FALSE(JsonReader::getInt("{\"n\":-2147483649}", "n", n));
+   TEST_ASSERT_FALSE(JsonReader::getInt("{\"n\":99999999999999999999}", "n", n));
+   TEST_ASSERT_FALSE(JsonReader::getInt("{\"n\":2.5}", "n", n));
+   TEST_ASSERT_FALSE(JsonReader::getInt("{\"n\":12abc}", "n", n));
+   TEST_ASSERT_FALSE(JsonReader::getInt("{\"n\":}", "n", n));
+   TEST_ASSERT_EQUAL_INT(7, n);
+   TEST_ASSERT_TRUE(JsonReader::getInt("{\"n\": 42 }", "n", n));
+   TEST_ASSERT_EQUAL_INT(42, n);
+}
+
+//----------------------
+int main()
+{
+   UNITY_BEGIN();
+   RUN_TEST(test_writer_separators_and_nesting);
+   RUN_TEST(test_writer_escapes);
+   RUN_TEST(test_writer_flushes_full_buffers);
+   RUN_TEST(test_writer_failed_flush);
+   RUN_TEST(test_reader_values);
+   RUN_TEST(test_reader_missing_and_wrong_type);
+   RUN_TEST(test_reader_values_are_not_keys);
+   RUN_TEST(test_reader_skips_nested_values);
+   RUN_TEST(test_reader_string_escapes);
+   RUN_TEST(test_reader_string_truncation);
+   RUN_TEST(test_reader_int_range);
+   return UNITY_END();
+}
@@ -0,0 +1,358 @@
+//
+// test_motion.cpp -- host tests and benchmark of the motion engine
+//
+//    pio test -e native -f test_motion
+//
+// The SWAR kernels are checked for every pair of byte values in every byte
+// of the word, and the engine against a scalar engine that does the same
+// per pixel: same changed blocks, same box, same background, frame by frame.
+// The frames are those of the detect task: 80 x 60, a textured scene with
+// sensor noise, a bird that moves through it, and now and then the light.
+// The benchmark runs both engines on the same frames.
+//
+// BSla, 19 oct 2026
+//
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <chrono>
+#include <unity.h>
+#include "motion.h"
+
+#define W (80)
+#define H (60)
+#define N_FRAMES (400)
+#define BENCH_ROUNDS (20)
+
+// the configuration of detector.cpp
+static const MotionConfig config = {12, 2, 600, 2, 6, 2, 7};
+
+static uint32_t scene[W * H / 4];            // 4-byte aligned, as the engine wants
+static uint32_t frames[N_FRAMES][W * H / 4];
+
+void setUp() {}
+void tearDown() {}
+
+//----------------------
+static uint8_t byteOf(uint32_t w, int i) { return uint8_t(w >> (8 * i)); }
+
+//----------------------
+class ScalarMotion
+// MotionEngine::compare and learn, one pixel at a time
+{
+public:
+   void begin(uint8_t *background)
+   {
+      bg = background;
+      primed = false;
+      roundUp = false;
+   }
+   void update(const uint8_t *gray)
+   {
+      if (!primed)
+      {
+         memcpy(bg, gray, W * H);
+         primed = true;
+         return;
+      }
+      compare(gray);
+      lightChange = changedBlocks * 1000 / (COLS * ROWS) > config.globalPermille;
+      if (lightChange)
+         memcpy(bg, gray, W * H);
+      else
+         learn(gray);
+      roundUp = !roundUp;
+   }
+
+   static const int COLS = W / MotionEngine::BLOCK;
+   static const int ROWS = (H + MotionEngine::BLOCK - 1) / MotionEngine::BLOCK;
+   uint32_t changed[ROWS];
+   int changedBlocks = 0;
+   bool lightChange = false;
+   MotionBox box = {};
+
+private:
+   void compare(const uint8_t *gray)
+   {
+      const int B = MotionEngine::BLOCK;
+      int minX = COLS, maxX = -1, minY = ROWS, maxY = -1;
+      changedBlocks = 0;
+      for (int br = 0; br < ROWS; br++)
+      {
+         changed[br] = 0;
+         int y1 = br * B + B < H ? br * B + B : H;
+         for (int bc = 0; bc < COLS; bc++)
+         {
+            uint32_t sum = 0;
+            for (int y = br * B; y < y1; y++)
+               for (int x = bc * B; x < bc * B + B; x++)
+                  sum += abs(gray[y * W + x] - bg[y * W + x]);
+            if (sum > uint32_t(config.blockThreshold) * B * (y1 - br * B))
+            {
+               changed[br] |= 1u << bc;
+               changedBlocks++;
+               minX = bc < minX ? bc : minX;
+               maxX = bc > maxX ? bc : maxX;
+               minY = br < minY ? br : minY;
+               maxY = br;
+            }
+         }
+      }
+      if (changedBlocks)
+         box = {uint16_t(minX * B), uint16_t(minY * B), uint16_t(maxX * B + B - 1),
+                uint16_t(maxY * B + B - 1 < H ? maxY * B + B - 1 : H - 1)};
+      else
+         box = MotionBox();
+   }
+   void learn(const uint8_t *gray)
+   {
+      for (int i = 0; i < W * H; i++)
+      {
+         int bc = (i % W) / MotionEngine::BLOCK;
+         int br = (i / W) / MotionEngine::BLOCK;
+         int shift = (changed[br] >> bc) & 1 ? config.holdShift : config.learnShift;
+         int x = gray[i];
+         for (int s = 0; s < shift; s++)
+            x = (bg[i] + x + roundUp) >> 1;
+         bg[i] = uint8_t(x);
+      }
+   }
+
+   uint8_t *bg = nullptr;
+   bool primed = false;
+   bool roundUp = false;
+};
+
+//----------------------
+static void makeFrames()
+// a bird of 12 x 10 pixels crosses the scene, rests, and leaves; the sun comes out twice
+{
+   srand(2026);
+   uint8_t *s = (uint8_t *)scene;
+   for (int y = 0; y < H; y++)
+      for (int x = 0; x < W; x++)
+         s[y * W + x] = uint8_t(60 + (x * 7 + y * 13) % 90 + rand() % 20);
+   for (int n = 0; n < N_FRAMES; n++)
+   {
+      uint8_t *f = (uint8_t *)frames[n];
+      int light = (n >= 150 && n < 220) || n >= 330 ? 70 : 0;
+      for (int i = 0; i < W * H; i++)
+      {
+         int v = s[i] + light + rand() % 7 - 3;
+         f[i] = uint8_t(v < 0 ? 0 : v > 255 ? 255 : v);
+      }
+      int phase = n % 100;
+      if (phase >= 20 && phase < 80)
+      {
+         int bx = phase < 40 ? (phase - 20) * 3 : phase < 60 ? 60 : 60 - (phase - 60) * 3;
+         int by = 20 + (phase % 7);
+         for (int y = by; y < by + 10; y++)
+            for (int x = bx; x < bx + 12 && x < W; x++)
+               f[y * W + x] = uint8_t(20 + ((x + y) & 1) * 200);
+      }
+   }
+}
+
+//----------------------
+static void test_abs_diff_all_pairs()
+{
+   for (int a = 0; a < 256; a++)
+   {
+      for (int b = 0; b < 256; b++)
+      {
+         // every pair in every byte, next to bytes that borrow and bytes that do not
+         uint32_t x = a | b << 8 | (255 - a) << 16 | uint32_t(a ^ 0x55) << 24;
+         uint32_t y = b | a << 8 | (255 - b) << 16 | uint32_t(b ^ 0xAA) << 24;
+         uint32_t d = MotionEngine::absDiff4(x, y);
+         for (int i = 0; i < 4; i++)
+         {
+            if (byteOf(d, i) != abs(byteOf(x, i) - byteOf(y, i)))
+               TEST_FAIL_MESSAGE("absDiff4 differs from the scalar |a - b|");
+         }
+      }
+   }
+}
+
+//----------------------
+static void test_average_all_pairs()
+{
+   for (int a = 0; a < 256; a++)
+   {
+      for (int b = 0; b < 256; b++)
+      {
+         uint32_t x = a | b << 8 | (255 - a) << 16 | uint32_t(a ^ 0x55) << 24;
+         uint32_t y = b | a << 8 | (255 - b) << 16 | uint32_t(b ^ 0xAA) << 24;
+         uint32_t down = MotionEngine::average4(x, y);
+         uint32_t up = MotionEngine::average4Up(x, y);
+         for (int i = 0; i < 4; i++)
+         {
+            int sum = byteOf(x, i) + byteOf(y, i);
+            if (byteOf(down, i) != sum >> 1 || byteOf(up, i) != (sum + 1) >> 1)
+               TEST_FAIL_MESSAGE("average4 or average4Up differs from the scalar average");
+         }
+      }
+   }
+}
+
+//----------------------
+static void test_blend_all_pairs()
+{
+   for (int shift = 0; shift <= 8; shift++)
+   {
+      for (int a = 0; a < 256; a++)
+      {
+         for (int b = 0; b < 256; b++)
+         {
+            uint32_t bg = a | b << 8 | (255 - a) << 16 | uint32_t(a ^ 0x55) << 24;
+            uint32_t frame = b | a << 8 | (255 - b) << 16 | uint32_t(b ^ 0xAA) << 24;
+            for (int up = 0; up < 2; up++)
+            {
+               uint32_t r = MotionEngine::blend4(bg, frame, shift, up);
+               for (int i = 0; i < 4; i++)
+               {
+                  int x = byteOf(frame, i);
+                  for (int s = 0; s < shift; s++)
+                     x = (byteOf(bg, i) + x + up) >> 1;
+                  if (byteOf(r, i) != x)
+                     TEST_FAIL_MESSAGE("blend4 differs from the scalar blend");
+               }
+            }
+         }
+      }
+   }
+}
+
+//----------------------
+static void test_blend_has_no_bias()
+{
+   // alternating the rounding: a quiet block settles on the frame, from below and from above
+   uint32_t bg = 0x00000000u;
+   uint32_t frame = 0x64646464u;
+   for (int i = 0; i < 200; i++)
+      bg = MotionEngine::blend4(bg, frame, 2, i & 1);
+   TEST_ASSERT_EQUAL_HEX32(frame, bg);
+   bg = 0xFFFFFFFFu;
+   for (int i = 0; i < 200; i++)
+      bg = MotionEngine::blend4(bg, frame, 2, i & 1);
+   TEST_ASSERT_EQUAL_HEX32(frame, bg);
+}
+
+//----------------------
+static void test_engine_matches_scalar()
+{
+   static uint32_t bgSwar[W * H / 4];
+   static uint32_t bgScalar[W * H / 4];
+   MotionEngine engine(config);
+   ScalarMotion scalar;
+   TEST_ASSERT_TRUE(engine.begin(W, H, (uint8_t *)bgSwar));
+   scalar.begin((uint8_t *)bgScalar);
+   int motionFrames = 0, lightFrames = 0;
+   for (int n = 0; n < N_FRAMES; n++)
+   {
+      const MotionResult &r = engine.update((const uint8_t *)frames[n]);
+      scalar.update((const uint8_t *)frames[n]);
+      if (n == 0)
+         continue;
+      char message[64];
+      snprintf(message, sizeof(message), "frame %d", n);
+      TEST_ASSERT_EQUAL_INT_MESSAGE(scalar.changedBlocks, r.changedBlocks, message);
+      TEST_ASSERT_EQUAL_MESSAGE(scalar.lightChange, r.lightChange, message);
+      for (int br = 0; br < engine.blockRows(); br++)
+         TEST_ASSERT_EQUAL_HEX32_MESSAGE(scalar.changed[br], engine.changedMask(br), message);
+      TEST_ASSERT_EQUAL_MEMORY_MESSAGE(&scalar.box, &r.box, sizeof(MotionBox), message);
+      TEST_ASSERT_EQUAL_MEMORY_MESSAGE(bgScalar, bgSwar, W * H, message);
+      motionFrames += r.motion;
+      lightFrames += r.lightChange;
+   }
+   // the frames do test something
+   TEST_ASSERT_GREATER_THAN(100, motionFrames);
+   TEST_ASSERT_GREATER_OR_EQUAL(2, lightFrames);
+}
+
+//----------------------
+static void test_events()
+{
+   // one event per crossing: start after 2 frames with motion, end after 6 without
+   static uint32_t bg[W * H / 4];
+   MotionEngine engine(config);
+   engine.begin(W, H, (uint8_t *)bg);
+   int starts = 0, ends = 0;
+   for (int n = 0; n < 100; n++)
+   {
+      const MotionResult &r = engine.update((const uint8_t *)frames[n]);
+      starts += r.eventStart;
+      ends += r.eventEnd;
+      if (r.eventStart)
+         TEST_ASSERT_EQUAL_INT(21, n); // the bird comes in frame 20
+   }
+   TEST_ASSERT_EQUAL_INT(1, starts);
+   TEST_ASSERT_EQUAL_INT(1, ends);
+   TEST_ASSERT_FALSE(engine.result().inEvent);
+   TEST_ASSERT_GREATER_THAN(0, engine.result().eventScore);
+   TEST_ASSERT_LESS_OR_EQUAL(16, engine.result().eventBox.x0);
+   TEST_ASSERT_GREATER_OR_EQUAL(64, engine.result().eventBox.x1);
+}
+
+//----------------------
+static void test_begin_rejects()
+{
+   static uint32_t bg[W * H / 4 + 1];
+   MotionEngine engine(config);
+   TEST_ASSERT_FALSE(engine.begin(W + 4, H, (uint8_t *)bg));       // width not a multiple of 8
+   TEST_ASSERT_FALSE(engine.begin(W, H, (uint8_t *)bg + 1));       // not aligned
+   TEST_ASSERT_FALSE(engine.begin(MotionEngine::MAX_WIDTH + 8, H, (uint8_t *)bg));
+   TEST_ASSERT_FALSE(engine.begin(W, H, nullptr));
+   TEST_ASSERT_TRUE(engine.begin(W, 52, (uint8_t *)bg)); // a partial block row is fine
+   TEST_ASSERT_EQUAL_INT(7, engine.blockRows());
+}
+
+//----------------------
+static void test_benchmark_update()
+{
+   static uint32_t bgSwar[W * H / 4];
+   static uint32_t bgScalar[W * H / 4];
+   MotionEngine engine(config);
+   ScalarMotion scalar;
+   volatile int sink = 0;
+
+   auto t0 = std::chrono::steady_clock::now();
+   for (int round = 0; round < BENCH_ROUNDS; round++)
+   {
+      scalar.begin((uint8_t *)bgScalar);
+      for (int n = 0; n < N_FRAMES; n++)
+      {
+         scalar.update((const uint8_t *)frames[n]);
+         sink = sink + scalar.changedBlocks;
+      }
+   }
+   auto t1 = std::chrono::steady_clock::now();
+   for (int round = 0; round < BENCH_ROUNDS; round++)
+   {
+      engine.begin(W, H, (uint8_t *)bgSwar);
+      for (int n = 0; n < N_FRAMES; n++)
+         sink = sink + engine.update((const uint8_t *)frames[n]).changedBlocks;
+   }
+   auto t2 = std::chrono::steady_clock::now();
+
+   double before = std::chrono::duration<double, std::micro>(t1 - t0).count() / (BENCH_ROUNDS * N_FRAMES);
+   double after = std::chrono::duration<double, std::micro>(t2 - t1).count() / (BENCH_ROUNDS * N_FRAMES);
+   char message[128];
+   snprintf(message, sizeof(message), "%d x %d: %.2f us per frame with SWAR, %.2f us a pixel at a time", W, H, after, before);
+   TEST_MESSAGE(message);
+}
+
+//----------------------
+int main()
+{
+   makeFrames();
+   UNITY_BEGIN();
+   RUN_TEST(test_abs_diff_all_pairs);
+   RUN_TEST(test_average_all_pairs);
+   RUN_TEST(test_blend_all_pairs);
+   RUN_TEST(test_blend_has_no_bias);
+   RUN_TEST(test_engine_matches_scalar);
+   RUN_TEST(test_events);
+   RUN_TEST(test_begin_rejects);
+   RUN_TEST(test_benchmark_update);
+   return UNITY_END();
+}
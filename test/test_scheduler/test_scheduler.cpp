@@ -0,0 +1,315 @@
+//
+// test_scheduler.cpp -- host tests of the timing wheel scheduler, on a virtual clock
+//
+//    pio test -e native -f test_scheduler
+//
+// The clock is a variable the test sets, so deadlines hours ahead, a clock
+// wrap and long gaps between run () calls take no real time.
+//
+// BSla, 19 oct 2026
+//
+#include <stdlib.h>
+#include <unity.h>
+#include "scheduler.h"
+
+static uint32_t now = 0;
+static uint32_t virtualClock() { return now; }
+
+// what the callbacks saw
+static int calls = 0;
+static uint32_t ranAt[64];
+static int wakes = 0;
+
+void setUp()
+{
+   now = 0;
+   calls = 0;
+   wakes = 0;
+}
+void tearDown() {}
+
+//----------------------
+static void record(void *context)
+{
+   if (calls < 64)
+      ranAt[calls] = now;
+   calls++;
+   if (context)
+      (*(int *)context)++;
+}
+
+//----------------------
+static void runUntil(Scheduler &s, uint32_t end, uint32_t step)
+// call run () every step ticks, like loop () would
+{
+   while (int32_t(end - now) > 0)
+   {
+      now += step;
+      s.run();
+   }
+}
+
+//----------------------
+static void test_after_runs_once_when_due()
+{
+   Scheduler s(virtualClock);
+   int n = 0;
+   int id = s.after(100, record, &n);
+   TEST_ASSERT_NOT_EQUAL(Scheduler::NO_JOB, id);
+   now = 99;
+   TEST_ASSERT_EQUAL_INT(0, s.run());
+   TEST_ASSERT_TRUE(s.isScheduled(id));
+   now = 100;
+   TEST_ASSERT_EQUAL_INT(1, s.run());
+   TEST_ASSERT_EQUAL_INT(1, n);
+   TEST_ASSERT_FALSE(s.isScheduled(id));
+   now = 1000;
+   TEST_ASSERT_EQUAL_INT(0, s.run());
+   TEST_ASSERT_EQUAL_INT(0, s.jobCount());
+}
+
+//----------------------
+static void test_every_keeps_its_grid()
+{
+   Scheduler s(virtualClock);
+   s.every(250, record);
+   runUntil(s, 10000, 7); // run () at odd moments: the job still keeps the 250 grid
+   TEST_ASSERT_EQUAL_INT(40, calls);
+   for (int i = 0; i < calls && i < 64; i++)
+   {
+      TEST_ASSERT_GREATER_OR_EQUAL_UINT32(250 * (i + 1), ranAt[i]);
+      TEST_ASSERT_LESS_THAN_UINT32(250 * (i + 1) + 7, ranAt[i]);
+   }
+   TEST_ASSERT_EQUAL_UINT32(0, s.missedPeriods());
+}
+
+//----------------------
+static void test_late_periodic_job_skips_missed_periods()
+{
+   Scheduler s(virtualClock);
+   s.every(100, record);
+   now = 1050; // ten periods due: one run, nine skipped
+   TEST_ASSERT_EQUAL_INT(1, s.run());
+   TEST_ASSERT_EQUAL_UINT32(9, s.missedPeriods());
+   TEST_ASSERT_LESS_OR_EQUAL_UINT32(50, s.timeToNext(1000)); // back on the grid: 1100
+   now = 1099;
+   TEST_ASSERT_EQUAL_INT(0, s.run());
+   now = 1100;
+   TEST_ASSERT_EQUAL_INT(1, s.run());
+}
+
+//----------------------
+static void orderCallback(void *context)
+{
+   ranAt[calls++] = uint32_t(uintptr_t(context));
+}
+
+//----------------------
+static void test_catch_up_order()
+{
+   Scheduler s(virtualClock);
+   static const uint32_t delays[] = {5000, 3, 70, 4096, 64, 262144, 65, 1};
+   static const uint32_t sorted[] = {1, 3, 64, 65, 70, 4096, 5000, 262144};
+   const int n = sizeof(delays) / sizeof(delays[0]);
+   for (int i = 0; i < n; i++)
+      s.after(delays[i], orderCallback, (void *)uintptr_t(delays[i]));
+   now = 300000;
+   TEST_ASSERT_EQUAL_INT(n, s.run());
+   TEST_ASSERT_EQUAL_UINT32_ARRAY(sorted, ranAt, n);
+}
+
+//----------------------
+static void test_far_deadline_is_replaced()
+{
+   // beyond the 64^4 ticks of the wheel: parked, and re-placed when its slot comes round
+   Scheduler s(virtualClock);
+   const uint32_t tenHours = 10UL * 3600 * 1000;
+   int id = s.after(tenHours, record);
+   now = tenHours / 2;
+   TEST_ASSERT_EQUAL_INT(0, s.run());
+   now = tenHours - 1;
+   TEST_ASSERT_EQUAL_INT(0, s.run());
+   TEST_ASSERT_EQUAL_UINT32(1, s.timeToNext(UINT32_MAX));
+   TEST_ASSERT_TRUE(s.isScheduled(id));
+   now = tenHours;
+   TEST_ASSERT_EQUAL_INT(1, s.run());
+}
+
+//----------------------
+static void test_clock_wrap()
+{
+   now = 0xFFFFFF00u;
+   Scheduler s(virtualClock);
+   s.after(0x80, record);
+   s.every(0x100, record);
+   now = 0xFFFFFF7Fu;
+   TEST_ASSERT_EQUAL_INT(0, s.run());
+   now = 0xFFFFFF80u;
+   TEST_ASSERT_EQUAL_INT(1, s.run());
+   now = 0xFFFFFFFFu;
+   TEST_ASSERT_EQUAL_INT(0, s.run());
+   now = 0; // 0xFFFFFF00 + 0x100
+   TEST_ASSERT_EQUAL_INT(1, s.run());
+   now = 0x100;
+   TEST_ASSERT_EQUAL_INT(1, s.run());
+}
+
+//----------------------
+static void test_time_to_next()
+{
+   Scheduler s(virtualClock);
+   TEST_ASSERT_EQUAL_UINT32(500, s.timeToNext(500)); // no jobs: the limit
+   s.after(300, record);
+   s.after(120, record);
+   TEST_ASSERT_EQUAL_UINT32(50, s.timeToNext(50));
+   // a wake-up may come before the deadline, to move jobs down the wheel; never after it
+   uint32_t t = 0;
+   int waits = 0;
+   for (; calls == 0; waits++)
+   {
+      uint32_t wait = s.timeToNext(500);
+      TEST_ASSERT_GREATER_THAN_UINT32(0, wait);
+      TEST_ASSERT_LESS_OR_EQUAL_UINT32(120 - t, wait);
+      t += wait;
+      now = t;
+      s.run();
+   }
+   TEST_ASSERT_EQUAL_UINT32(120, t);
+   TEST_ASSERT_LESS_OR_EQUAL_INT(3, waits);
+   now = 400; // overdue
+   TEST_ASSERT_EQUAL_UINT32(0, s.timeToNext(500));
+   s.run();
+   TEST_ASSERT_EQUAL_UINT32(500, s.timeToNext(500));
+}
+
+//----------------------
+static Scheduler *current = nullptr;
+static int selfId = Scheduler::NO_JOB;
+
+static void cancelSelf(void *context)
+{
+   record(context);
+   current->cancel(selfId);
+}
+
+static void addAnother(void *context)
+{
+   record(context);
+   current->after(10, record);
+}
+
+//----------------------
+static void test_callbacks_change_the_schedule()
+{
+   Scheduler s(virtualClock);
+   current = &s;
+   selfId = s.every(100, cancelSelf);
+   s.after(50, addAnother);
+   runUntil(s, 1000, 1);
+   TEST_ASSERT_EQUAL_INT(3, calls); // addAnother, its job, cancelSelf once
+   TEST_ASSERT_EQUAL_UINT32(50, ranAt[0]);
+   TEST_ASSERT_EQUAL_UINT32(60, ranAt[1]);
+   TEST_ASSERT_EQUAL_UINT32(100, ranAt[2]);
+   TEST_ASSERT_EQUAL_INT(0, s.jobCount());
+}
+
+//----------------------
+static void test_cancel()
+{
+   Scheduler s(virtualClock);
+   int id = s.after(10, record);
+   s.cancel(id);
+   s.cancel(id);                 // twice: ignored
+   s.cancel(Scheduler::NO_JOB); // ignored
+   now = 100;
+   TEST_ASSERT_EQUAL_INT(0, s.run());
+   TEST_ASSERT_EQUAL_INT(0, calls);
+}
+
+//----------------------
+static void test_full()
+{
+   Scheduler s(virtualClock);
+   for (int i = 0; i < Scheduler::MAX_JOBS; i++)
+      TEST_ASSERT_NOT_EQUAL(Scheduler::NO_JOB, s.after(i + 1, record));
+   TEST_ASSERT_EQUAL_INT(Scheduler::NO_JOB, s.after(1, record));
+   now = Scheduler::MAX_JOBS;
+   TEST_ASSERT_EQUAL_INT(Scheduler::MAX_JOBS, s.run());
+   TEST_ASSERT_NOT_EQUAL(Scheduler::NO_JOB, s.after(1, record));
+}
+
+//----------------------
+static void countWake() { wakes++; }
+
+static void test_add_wakes_the_loop()
+{
+   Scheduler s(virtualClock);
+   s.setWakeFunction(countWake);
+   s.after(10, record);
+   TEST_ASSERT_EQUAL_INT(1, wakes);
+   current = &s;
+   s.after(5, addAnother); // adds a job from inside run (): no wake needed
+   now = 5;
+   s.run();
+   TEST_ASSERT_EQUAL_INT(2, wakes);
+}
+
+//----------------------
+static void test_random_one_shots_against_reference()
+{
+   // every job runs exactly once, in the first run () at or after its deadline
+   Scheduler s(virtualClock);
+   srand(2026);
+   uint32_t due[Scheduler::MAX_JOBS];
+   uint32_t seen[Scheduler::MAX_JOBS];
+   int count[Scheduler::MAX_JOBS] = {};
+   for (int round = 0; round < 2000; round++)
+   {
+      for (int i = 0; i < Scheduler::MAX_JOBS; i++)
+         count[i] = 0;
+      for (int i = 0; i < Scheduler::MAX_JOBS; i++)
+      {
+         uint32_t delay = 1 + ((rand() % 4 == 0) ? uint32_t(rand()) % 20000000 : uint32_t(rand()) % 5000);
+         int id = s.after(delay, [](void *context) { (*(int *)context)++; }, &count[i]);
+         TEST_ASSERT_EQUAL_INT(i, id);
+         due[i] = now + delay;
+         seen[i] = 0;
+      }
+      while (s.jobCount() > 0)
+      {
+         uint32_t previous = now;
+         now += 1 + uint32_t(rand()) % (rand() % 2 ? 300 : 3000000);
+         s.run();
+         for (int i = 0; i < Scheduler::MAX_JOBS; i++)
+         {
+            if (count[i] && !seen[i])
+            {
+               seen[i] = now;
+               TEST_ASSERT_LESS_OR_EQUAL_INT32(0, int32_t(due[i] - now));  // not early
+               TEST_ASSERT_GREATER_THAN_INT32(0, int32_t(due[i] - previous)); // not late
+            }
+         }
+      }
+      for (int i = 0; i < Scheduler::MAX_JOBS; i++)
+         TEST_ASSERT_EQUAL_INT(1, count[i]);
+   }
+}
+
+//----------------------
+int main()
+{
+   UNITY_BEGIN();
+   RUN_TEST(test_after_runs_once_when_due);
+   RUN_TEST(test_every_keeps_its_grid);
+   RUN_TEST(test_late_periodic_job_skips_missed_periods);
+   RUN_TEST(test_catch_up_order);
+   RUN_TEST(test_far_deadline_is_replaced);
+   RUN_TEST(test_clock_wrap);
+   RUN_TEST(test_time_to_next);
+   RUN_TEST(test_callbacks_change_the_schedule);
+   RUN_TEST(test_cancel);
+   RUN_TEST(test_full);
+   RUN_TEST(test_add_wakes_the_loop);
+   RUN_TEST(test_random_one_shots_against_reference);
+   return UNITY_END();
+}
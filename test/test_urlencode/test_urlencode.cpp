@@ -0,0 +1,188 @@
+//
+// test_urlencode.cpp -- host tests and benchmark of the URLencode codec
+//
+//    pio test -e native -f test_urlencode
+//
+// The benchmark decodes two form payloads with the codec and with the
+// char-by-char decoder it replaced (std::string standing in for String).
+//
+// BSla, 19 oct 2026
+//
+#include <string.h>
+#include <stdio.h>
+#include <string>
+#include <chrono>
+#include <unity.h>
+#include "urlencode.h"
+
+#define BENCH_ROUNDS (200000)
+
+// the payloads of the site info and adjust forms
+static const char *form60 = "SSID=Tuin%20achter&password=geheim%21&comment=Nestkast+noord";
+static const char *form136 =
+   "site=Birdcam+Tuin+achter&comment=Koolmees+nestkast+%231%2C+camera+boven+de+invliegopening"
+   "&openDeg=120&closedDeg=3&speed=40&n=3&cmd=moves";
+
+void setUp() {}
+void tearDown() {}
+
+//----------------------
+static std::string decodeBefore(const std::string &in)
+// the decoder before the codec was table driven
+{
+   auto hex2bin = [](char c) -> char {
+      if (c >= '0' && c <= '9')
+         c -= '0';
+      else if (c >= 'A' && c <= 'F')
+         c -= 'A' - 10;
+      else if (c >= 'a' && c <= 'f')
+         c -= 'a' - 10;
+      return c & 0xF;
+   };
+   std::string output;
+   const char *p = in.c_str();
+   char c;
+   while ((c = *p++))
+   {
+      if (c == '%')
+      {
+         char c1 = *p++;
+         char c2 = *p++;
+         output += char(hex2bin(c1) << 4 | hex2bin(c2));
+      }
+      else if (c == '+')
+         output += ' ';
+      else
+         output += c;
+   }
+   return output;
+}
+
+//----------------------
+static std::string decode(const char *s)
+{
+   char buf[256];
+   size_t len = strlen(s);
+   memcpy(buf, s, len + 1);
+   size_t n = URLencode::decode(buf, len);
+   TEST_ASSERT_EQUAL_size_t(strlen(buf), n);
+   return std::string(buf, n);
+}
+
+//----------------------
+static void test_decode_plain_and_plus()
+{
+   TEST_ASSERT_EQUAL_STRING("birdcam", decode("birdcam").c_str());
+   TEST_ASSERT_EQUAL_STRING("tuin achter", decode("tuin+achter").c_str());
+   TEST_ASSERT_EQUAL_STRING("", decode("").c_str());
+}
+
+//----------------------
+static void test_decode_escapes()
+{
+   TEST_ASSERT_EQUAL_STRING("a/b c", decode("a%2Fb%20c").c_str());
+   TEST_ASSERT_EQUAL_STRING("a/b", decode("a%2fb").c_str());
+   TEST_ASSERT_EQUAL_STRING("100%", decode("100%25").c_str());
+   TEST_ASSERT_EQUAL_STRING("\xC3\xA9", decode("%C3%A9").c_str());
+}
+
+//----------------------
+static void test_decode_bad_escapes_are_literal()
+{
+   TEST_ASSERT_EQUAL_STRING("abc%", decode("abc%").c_str());
+   TEST_ASSERT_EQUAL_STRING("abc%4", decode("abc%4").c_str());
+   TEST_ASSERT_EQUAL_STRING("%zz!", decode("%zz!").c_str());
+   TEST_ASSERT_EQUAL_STRING("%%41", decode("%%2541").c_str());
+}
+
+//----------------------
+static void test_decode_stops_at_nul()
+{
+   char buf[] = "ab\0cd";
+   TEST_ASSERT_EQUAL_size_t(2, URLencode::decode(buf, 5));
+   TEST_ASSERT_EQUAL_STRING("ab", buf);
+}
+
+//----------------------
+static void test_encode()
+{
+   char dst[64];
+   const char *s = "Tuin achter/noord-1_a.b~";
+   size_t n = URLencode::encode(s, strlen(s), dst, sizeof(dst));
+   TEST_ASSERT_EQUAL_STRING("Tuin+achter%2Fnoord-1_a.b~", dst);
+   TEST_ASSERT_EQUAL_size_t(strlen(dst), n);
+   TEST_ASSERT_EQUAL_size_t(n, URLencode::encodedLength(s, strlen(s)));
+   TEST_ASSERT_EQUAL_size_t(4, URLencode::encode("0&", 2, dst, sizeof(dst)));
+   TEST_ASSERT_EQUAL_STRING("0%26", dst);
+}
+
+//----------------------
+static void test_encode_too_small()
+{
+   char dst[4];
+   TEST_ASSERT_EQUAL_size_t(0, URLencode::encode("a/b", 3, dst, sizeof(dst))); // "a%2Fb" needs 6
+   TEST_ASSERT_EQUAL_size_t(3, URLencode::encode("abc", 3, dst, sizeof(dst)));
+}
+
+//----------------------
+static void test_round_trip_all_bytes()
+{
+   char src[255];
+   for (int i = 0; i < 255; i++)
+      src[i] = char(i + 1);
+   char enc[3 * 255 + 1];
+   size_t n = URLencode::encode(src, sizeof(src), enc, sizeof(enc));
+   TEST_ASSERT_GREATER_THAN(0, n);
+   TEST_ASSERT_EQUAL_size_t(sizeof(src), URLencode::decode(enc, n));
+   TEST_ASSERT_EQUAL_MEMORY(src, enc, sizeof(src));
+}
+
+//----------------------
+static void benchmark(const char *name, const char *form)
+{
+   size_t len = strlen(form);
+   TEST_ASSERT_EQUAL_STRING(decodeBefore(form).c_str(), decode(form).c_str());
+
+   volatile size_t sink = 0;
+   std::string in(form);
+   auto t0 = std::chrono::steady_clock::now();
+   for (int i = 0; i < BENCH_ROUNDS; i++)
+      sink = sink + decodeBefore(in).size();
+   auto t1 = std::chrono::steady_clock::now();
+   char buf[256];
+   for (int i = 0; i < BENCH_ROUNDS; i++)
+   {
+      memcpy(buf, form, len + 1);
+      sink = sink + URLencode::decode(buf, len);
+   }
+   auto t2 = std::chrono::steady_clock::now();
+
+   double before = std::chrono::duration<double, std::nano>(t1 - t0).count() / BENCH_ROUNDS;
+   double after = std::chrono::duration<double, std::nano>(t2 - t1).count() / BENCH_ROUNDS;
+   char message[128];
+   snprintf(message, sizeof(message), "%s (%u bytes): %.0f ns per decode, was %.0f ns", name, unsigned(len), after,
+            before);
+   TEST_MESSAGE(message);
+}
+
+//----------------------
+static void test_benchmark_decode()
+{
+   benchmark("form60", form60);
+   benchmark("form136", form136);
+}
+
+//----------------------
+int main()
+{
+   UNITY_BEGIN();
+   RUN_TEST(test_decode_plain_and_plus);
+   RUN_TEST(test_decode_escapes);
+   RUN_TEST(test_decode_bad_escapes_are_literal);
+   RUN_TEST(test_decode_stops_at_nul);
+   RUN_TEST(test_encode);
+   RUN_TEST(test_encode_too_small);
+   RUN_TEST(test_round_trip_all_bytes);
+   RUN_TEST(test_benchmark_decode);
+   return UNITY_END();
+}